@@ -40,7 +40,7 @@ typedef enum {
     LLAISYS_DTYPE_U16 = 8,
     LLAISYS_DTYPE_U32 = 9,
     LLAISYS_DTYPE_U64 = 10,
-    LLAISYS_DTYPE_F8 = 11,
+    LLAISYS_DTYPE_F8 = 11, // FP8 E4M3 (no infinities, max 448)
     LLAISYS_DTYPE_F16 = 12,
     LLAISYS_DTYPE_F32 = 13,
     LLAISYS_DTYPE_F64 = 14,
@@ -49,6 +49,7 @@ typedef enum {
     LLAISYS_DTYPE_C64 = 17,
     LLAISYS_DTYPE_C128 = 18,
     LLAISYS_DTYPE_BF16 = 19,
+    LLAISYS_DTYPE_F8_E5M2 = 20, // FP8 E5M2 (IEEE-style infinities, max 57344)
 } llaisysDataType_t;
 
 // Runtime Types
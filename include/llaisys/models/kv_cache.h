@@ -0,0 +1,41 @@
+#ifndef LLAISYS_MODELS_KV_CACHE_H
+#define LLAISYS_MODELS_KV_CACHE_H
+
+#include "../tensor.h"
+
+__C {
+    // Paged KV cache shared by the sequences of one model. Every layer has a K and a V pool of
+    // nblocks blocks of block_size positions ([nblocks, block_size, nkvh, dh] each). A sequence
+    // holds a block table that maps its positions to pool blocks. Blocks are taken from a free
+    // list as the sequence grows and returned when it is freed, so memory follows the tokens
+    // actually cached rather than a per-call maximum.
+    // dtype is the model dtype, or I8 / an FP8 type for a quantized cache: every row of dh values
+    // (one position of one KV head) is then stored with its own fp32 scale, set when the row is
+    // written and applied when attention reads it. I8 takes a quarter of the F32 footprint.
+    // Full blocks are cached by their token prefix (a radix tree over blocks of token ids). A
+    // freed sequence leaves its full blocks cached; a new sequence attaches the longest cached
+    // prefix of its prompt with kvCacheMatchPrefix and only runs the rest. Cached blocks no
+    // sequence uses are evicted, least recently used first, when the free list runs out.
+    typedef struct LlaisysKVCache *llaisysKVCache_t;
+
+    __export llaisysKVCache_t kvCacheCreate(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype,
+                                            size_t block_size, size_t nblocks,
+                                            llaisysDeviceType_t device, int device_id);
+    __export void kvCacheDestroy(llaisysKVCache_t cache);
+    // New empty sequence; returns its id.
+    __export int64_t kvCacheAddSequence(llaisysKVCache_t cache);
+    // Release the sequence and return its blocks to the pool (full blocks stay cached).
+    __export void kvCacheFreeSequence(llaisysKVCache_t cache, int64_t seq);
+    // Positions cached for the sequence.
+    __export size_t kvCacheSequenceLength(llaisysKVCache_t cache, int64_t seq);
+    // Attach the longest cached prefix of token_ids to the new, empty sequence. Whole blocks only,
+    // and at least one token is left to run so that its logits exist. Returns the positions
+    // reused; run the model on token_ids[returned, ntoken).
+    __export size_t kvCacheMatchPrefix(llaisysKVCache_t cache, int64_t seq, const int64_t *token_ids, size_t ntoken);
+    // Blocks available to new positions, including cached blocks no sequence uses.
+    __export size_t kvCacheNumFreeBlocks(llaisysKVCache_t cache);
+    // Cached blocks no sequence uses (evictable).
+    __export size_t kvCacheNumCachedBlocks(llaisysKVCache_t cache);
+}
+
+#endif // LLAISYS_MODELS_KV_CACHE_H
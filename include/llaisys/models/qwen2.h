@@ -1,7 +1,15 @@
 #ifndef LLAISYS_MODELS_QWEN2_H
 #define LLAISYS_MODELS_QWEN2_H
 
+#include "../ops.h"
 #include "../tensor.h"
+#include "kv_cache.h"
+
+// Negative results of the paged calls (llaisysQwen2ModelInferPaged*, Step and Generate).
+typedef enum {
+    LLAISYS_QWEN2_INVALID_ARGUMENT = -1, // rejected before running; reported on stderr
+    LLAISYS_QWEN2_OUT_OF_BLOCKS = -2,    // the KV cache pool has too few free blocks
+} llaisysQwen2Status_t;
 
 __C {
     struct LlaisysQwen2Meta {
@@ -29,16 +37,96 @@ __C {
         llaisysTensor_t *mlp_down_w;
     };
 
+    // Projection weights in the kernels' packed (optionally quantized) layout, built by
+    // llaisysQwen2ModelFinalize. Q, K and V are fused into one [(nh + 2 * nkvh) * dh, hs]
+    // projection per layer, rows in q, k, v order, with the matching concatenated bias.
+    // Gate and up are interleaved into one weight per layer (see linearWeightCreateGateUp)
+    // that yields the SwiGLU output directly.
+    struct LlaisysQwen2PackedWeights {
+        llaisysLinearWeight_t out_embed;
+        llaisysLinearWeight_t *attn_qkv_w;
+        llaisysTensor_t *attn_qkv_b;
+        llaisysLinearWeight_t *attn_o_w;
+        llaisysLinearWeight_t *mlp_gate_up_w;
+        llaisysLinearWeight_t *mlp_down_w;
+    };
+
     struct LlaisysQwen2Model {
         struct LlaisysQwen2Meta *meta;
         llaisysDeviceType_t device;
         int ndevice;
         int *device_ids;
         struct LlaisysQwen2Weights *weights;
+        struct LlaisysQwen2PackedWeights *packed; // NULL until finalized
     };
+    // Request of llaisysQwen2ModelGenerate. Generation stops after max_new_tokens, at
+    // meta->end_token or any of stop_tokens, or once the generated tokens end with one of the
+    // stop sequences: nstop_sequences token-id sequences stored back to back in stop_sequences,
+    // stop_sequence_lens[i] tokens each. The stopping token is still reported.
+    struct LlaisysQwen2GenerateParams {
+        size_t max_new_tokens;
+        LlaisysSamplingParams sampling;
+        uint64_t seed;        // state of the request's generator
+        size_t prefill_chunk; // prompt tokens per forward step; 0 runs the prompt in one step
+        const int64_t *stop_tokens;
+        size_t nstop_tokens;
+        const int64_t *stop_sequences;
+        const size_t *stop_sequence_lens;
+        size_t nstop_sequences;
+    };
+    // Called with every generated token as soon as it is drawn; nonzero stops generation after it.
+    typedef int (*LlaisysQwen2TokenCallback)(int64_t token, void *user_data);
+
     __export struct LlaisysQwen2Model *llaisysQwen2ModelCreate(const LlaisysQwen2Meta *meta, llaisysDeviceType_t device, int *device_ids, int ndevice);
     __export void llaisysQwen2ModelDestroy(struct LlaisysQwen2Model * model);
     __export struct LlaisysQwen2Weights *llaisysQwen2ModelWeights(struct LlaisysQwen2Model * model);
+    // Convert every projection weight to `format` once after all tensorLoad calls, e.g.
+    // LLAISYS_LINEAR_WEIGHT_Q8 for int8 weights with per-output-channel scales, or
+    // LLAISYS_LINEAR_WEIGHT_Q4(_ZP) with `group_size` inputs per scale (see linearWeightCreate).
+    // The 4-bit formats apply to attn_*_w and mlp_*_w only; out_embed is then kept PACKED.
+    // LLAISYS_LINEAR_WEIGHT_W8A8 also quantizes the activations of those projections per token;
+    // out_embed then uses Q8. LLAISYS_LINEAR_WEIGHT_F8 stores those projections in FP8 E4M3
+    // and also keeps out_embed PACKED.
+    // The converted copies replace attn_{q,k,v,o}_w, mlp_{gate,up,down}_w and out_embed in
+    // LlaisysQwen2Weights, which are released and set to NULL. The first llaisysQwen2ModelInfer
+    // finalizes with LLAISYS_LINEAR_WEIGHT_PACKED if this was not called before; later calls are
+    // no-ops. Returns 0, or -1 with the weights untouched (and still auto-finalized as PACKED)
+    // on an invalid format or group size, a format other than PACKED on a non-CPU model, or a
+    // failed allocation, each reported on stderr.
+    __export int llaisysQwen2ModelFinalize(struct LlaisysQwen2Model * model, llaisysLinearWeightFormat_t format, size_t group_size);
+    // kcache/vcache ([maxseq, nkvh, dh] per layer, or NULL to recompute the full sequence) are
+    // in meta->dtype or in an FP8 type; new K/V rows are converted when written.
     __export int64_t llaisysQwen2ModelInfer(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysTensor_t *kcache, llaisysTensor_t *vcache, size_t past_len);
+    // Run ntoken tokens of sequence `seq` of a paged cache (see kv_cache.h), reading its cached
+    // positions and appending the new ones. The cache must have the model's nlayer, nkvh and dh.
+    // Returns LLAISYS_QWEN2_OUT_OF_BLOCKS without changing the sequence if the pool has too few
+    // free blocks, or LLAISYS_QWEN2_INVALID_ARGUMENT.
+    __export int64_t llaisysQwen2ModelInferPaged(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq);
+    // One forward pass over nseq distinct sequences of a paged cache, batched through the
+    // projections and MLP: seqs[s] appends the next ntokens[s] tokens of token_ids (a prompt
+    // chunk, or the one token of a decode step). Long prompts fed in chunks bound the step's
+    // activations, and decode tokens of other sequences can share the step instead of waiting.
+    // next_tokens[s] receives the argmax after the last token of seqs[s]; with next_tokens NULL
+    // the step only appends K/V and skips the final norm and LM head (a prompt chunk that is not
+    // the last). Returns 0, or a llaisysQwen2Status_t without changing any sequence:
+    // LLAISYS_QWEN2_OUT_OF_BLOCKS if the pool has too few free blocks for all of them.
+    __export int llaisysQwen2ModelStep(struct LlaisysQwen2Model * model, const int64_t * token_ids, const size_t * ntokens, const int64_t * seqs, size_t nseq, llaisysKVCache_t cache, int64_t * next_tokens);
+    // llaisysQwen2ModelInferPaged that also returns logits: row j of logits ([npos, voc], any
+    // floating dtype) receives the logits after token_ids[positions[j]], e.g. to score a prompt.
+    // positions NULL means the last token only (npos = 1). Only the requested rows and the last
+    // one go through the final norm and the LM head.
+    __export int64_t llaisysQwen2ModelInferPagedLogits(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq, const size_t * positions, size_t npos, llaisysTensor_t logits);
+    // llaisysQwen2ModelInferPaged that draws the next token with llaisysSample instead of taking
+    // the argmax; the repetition penalty covers every token of the sequence, prompt included.
+    // rng_state is the request's generator and advances by one draw. Greedy params (temperature
+    // <= 0 or top_k == 1, without a penalty) keep the fused LM head argmax.
+    __export int64_t llaisysQwen2ModelInferPagedSample(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq, const LlaisysSamplingParams * params, uint64_t * rng_state);
+    // The whole generation loop of one prompt in C++: a new sequence of the paged cache reuses
+    // the longest cached prefix of the prompt, prefills the rest in chunks and decodes until a
+    // stop condition, reusing the step's sampling buffers and passing each token to callback
+    // (may be NULL). The sequence is freed at the end, its full blocks staying cached. Returns
+    // the number of tokens generated, or LLAISYS_QWEN2_INVALID_ARGUMENT / OUT_OF_BLOCKS (tokens
+    // already reported stand).
+    __export int64_t llaisysQwen2ModelGenerate(struct LlaisysQwen2Model * model, const int64_t * prompt, size_t nprompt, llaisysKVCache_t cache, const struct LlaisysQwen2GenerateParams * params, LlaisysQwen2TokenCallback callback, void * user_data);
 }
 #endif // LLAISYS_MODELS_QWEN2_H
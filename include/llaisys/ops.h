@@ -3,15 +3,106 @@
 
 #include "tensor.h"
 
+// Layouts a linear weight can be converted into once, ahead of inference.
+typedef enum {
+    LLAISYS_LINEAR_WEIGHT_PACKED = 0, // SIMD panel-interleaved for the running CPU, same dtype
+    LLAISYS_LINEAR_WEIGHT_Q8 = 1,     // PACKED layout in int8, symmetric with one fp32 scale per output row
+    LLAISYS_LINEAR_WEIGHT_Q4 = 2,     // PACKED layout in 4 bits, symmetric with an fp16 scale per group of inputs
+    LLAISYS_LINEAR_WEIGHT_Q4_ZP = 3,  // Q4 with an fp16 min (zero point) per group as well
+    LLAISYS_LINEAR_WEIGHT_W8A8 = 4,   // Q8 weights multiplied in integer arithmetic with per-token int8 activations
+    LLAISYS_LINEAR_WEIGHT_F8 = 5,     // PACKED layout in FP8 E4M3, values cast directly (saturating at +-448)
+} llaisysLinearWeightFormat_t;
+
+typedef enum {
+    LLAISYS_ACTIVATION_NONE = 0,
+    LLAISYS_ACTIVATION_SILU = 1,
+    LLAISYS_ACTIVATION_GELU = 2, // exact (erf) form
+} llaisysActivation_t;
+
 __C {
+    // Linear weight converted from a row-major [out_features, in_features] tensor into a
+    // kernel-specific layout. Independent of the source tensor once created.
+    typedef struct LlaisysLinearWeight *llaisysLinearWeight_t;
+
+    // `group_size` is the number of inputs per scale for the Q4 formats (32, 64 or 128, 0 for
+    // the default of 32) and is ignored otherwise.
+    __export llaisysLinearWeight_t linearWeightCreate(llaisysTensor_t weight, llaisysLinearWeightFormat_t format, size_t group_size);
+    // Gate and up projections of a SwiGLU MLP, both [inter_features, in_features], interleaved
+    // into one weight for llaisysLinearSwiGLU.
+    __export llaisysLinearWeight_t linearWeightCreateGateUp(llaisysTensor_t gate, llaisysTensor_t up,
+                                                            llaisysLinearWeightFormat_t format, size_t group_size);
+    __export void linearWeightDestroy(llaisysLinearWeight_t weight);
+
+    // Output stages of llaisysLinearFused, applied in this order to the fp32 product while it is
+    // still in cache, before it is stored in the output dtype. Null tensors and zero counts
+    // disable a stage.
+    typedef struct {
+        llaisysTensor_t bias;            // [out_features]
+        llaisysActivation_t activation;
+        // RoPE as llaisysROPE on the first rope_cols output columns, taken as heads of
+        // rope_head_dim; rope_pos_ids is [batch] int64 and rope_cols a multiple of rope_head_dim.
+        llaisysTensor_t rope_pos_ids;
+        size_t rope_cols;
+        size_t rope_head_dim;
+        float rope_theta;
+        llaisysTensor_t residual;        // [batch, out_features], added last; may be `out` itself
+    } LlaisysLinearEpilogue;
+
+    // Token selection of llaisysSample. Each stage is disabled by its neutral value.
+    typedef struct {
+        float temperature;        // logits are divided by it; <= 0 is greedy (argmax after the penalty)
+        size_t top_k;             // keep the k most likely tokens; 0 keeps all
+        float top_p;              // keep the fewest most likely tokens with probability >= top_p; 1 keeps all
+        float min_p;              // drop tokens less likely than min_p * p(most likely token); 0 keeps all
+        float repetition_penalty; // logits of tokens in the history: divided if > 0, else multiplied; 1 is off
+    } LlaisysSamplingParams;
+
     __export void llaisysAdd(llaisysTensor_t c, llaisysTensor_t a, llaisysTensor_t b);
+    // residual_inout += x, then out_norm = RmsNorm(residual_inout, weight, eps), in one pass.
+    __export void llaisysAddRmsNorm(llaisysTensor_t out_norm, llaisysTensor_t residual_inout, llaisysTensor_t x, llaisysTensor_t weight, float eps);
     __export void llaisysArgmax(llaisysTensor_t max_idx, llaisysTensor_t max_val, llaisysTensor_t vals);
     __export void llaisysEmbedding(llaisysTensor_t out, llaisysTensor_t index, llaisysTensor_t weight);
     __export void llaisysLinear(llaisysTensor_t out, llaisysTensor_t in, llaisysTensor_t weight, llaisysTensor_t bias);
+    __export void llaisysLinearPacked(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t weight, llaisysTensor_t bias);
+    // out = in @ weight^T followed by the stages of `epilogue` (may be NULL).
+    __export void llaisysLinearFused(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t weight, const LlaisysLinearEpilogue *epilogue);
+    // out[m, inter] = silu(in @ gate^T) * (in @ up^T), with `gate_up` from linearWeightCreateGateUp;
+    // gate and up are never materialized.
+    __export void llaisysLinearSwiGLU(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t gate_up);
+    // indices (I64) and values (F32), both [batch, k]: the k largest outputs of each row of
+    // in @ weight^T, best first, e.g. the LM head with its argmax (k = 1). The product is never
+    // stored: the weight is streamed in panels and every thread keeps its own running top-k.
+    // With temperature > 0 outputs are ranked by output / temperature + Gumbel noise drawn from
+    // `seed` (Gumbel-max: index 0 is a sample of softmax(output / temperature), the k together
+    // a sample without replacement); values stay the plain outputs. W8A8 weights are unsupported.
+    __export void llaisysLinearTopK(llaisysTensor_t indices, llaisysTensor_t values, llaisysTensor_t in, llaisysLinearWeight_t weight,
+                                    float temperature, uint64_t seed);
     __export void llaisysRearrange(llaisysTensor_t out, llaisysTensor_t in);
     __export void llaisysRmsNorm(llaisysTensor_t out, llaisysTensor_t in, llaisysTensor_t weight, float eps);
     __export void llaisysROPE(llaisysTensor_t out, llaisysTensor_t in, llaisysTensor_t pos_ids, float theta);
     __export void llaisysSelfAttention(llaisysTensor_t attn_val, llaisysTensor_t q, llaisysTensor_t k, llaisysTensor_t v, float scale);
+    // Self-attention over the first kvlen positions of a paged KV cache: k_blocks/v_blocks are
+    // [nblocks, block_size, nkvh, hd] and position p lives in row p % block_size of block
+    // block_table[p / block_size] (int64).
+    // Quantized blocks (I8, or FP8 with scales) come with k_scales/v_scales of shape
+    // [nblocks, block_size, nkvh] in F32, one per row of hd values (see llaisysQuantizeRows);
+    // pass NULL for both otherwise.
+    __export void llaisysSelfAttentionPaged(llaisysTensor_t attn_val, llaisysTensor_t q, llaisysTensor_t k_blocks, llaisysTensor_t v_blocks,
+                                            llaisysTensor_t k_scales, llaisysTensor_t v_scales,
+                                            llaisysTensor_t block_table, size_t kvlen, float scale);
+    // Symmetric per-row quantization over the last dim of `in` (rows may be strided):
+    // scales[...] = max|in[..., :]| / qmax and out = in / scales, with out in I8 (qmax 127,
+    // rounded to nearest) or FP8 (qmax 448 for E4M3, 57344 for E5M2). scales is F32 with the
+    // shape of `in` minus its last dim; out and scales must be contiguous.
+    __export void llaisysQuantizeRows(llaisysTensor_t out, llaisysTensor_t scales, llaisysTensor_t in);
+    // Draw one token (out_idx, I64 with one element) from logits ([voc], F32/BF16/F16):
+    // repetition penalty on the tokens of history (I64 [n], may be NULL), temperature, then
+    // top-k, min-p and top-p truncation and a draw from the renormalized rest. F32 logits are
+    // penalized and scaled in place. *rng_state is the caller's generator (one per request,
+    // seeded once) and advances by one draw; greedy params leave it unchanged. Tokens more
+    // than 40 below the largest scaled logit (relative probability < e^-40) are never drawn.
+    __export void llaisysSample(llaisysTensor_t out_idx, llaisysTensor_t logits, llaisysTensor_t history,
+                                const LlaisysSamplingParams *params, uint64_t *rng_state);
     __export void llaisysSwiGLU(llaisysTensor_t out, llaisysTensor_t gate, llaisysTensor_t up);
 }
 
@@ -42,6 +42,11 @@ __C {
 
     // Llaisys API for switching device context
     __export void llaisysSetContextRuntime(llaisysDeviceType_t, int);
+
+    // Llaisys API for the CPU intra-op thread pool. The count includes the calling thread;
+    // 0 restores the default (env LLAISYS_NUM_THREADS, else all CPUs in the affinity mask).
+    __export void llaisysSetNumThreads(int);
+    __export int llaisysGetNumThreads();
 }
 
 #endif // LLAISYS_RUNTIME_H
@@ -1,20 +1,28 @@
-from .runtime import RuntimeAPI
+from .runtime import RuntimeAPI, set_num_threads, get_num_threads
 from .libllaisys import DeviceType
 from .libllaisys import DataType
 from .libllaisys import MemcpyKind
+from .libllaisys import LinearWeightFormat
+from .libllaisys import Activation
 from .libllaisys import llaisysStream_t as Stream
 from .tensor import Tensor
+from .linear_weight import LinearWeight
 from .ops import Ops
 from . import models
 from .models import *
 
 __all__ = [
     "RuntimeAPI",
+    "set_num_threads",
+    "get_num_threads",
     "DeviceType",
     "DataType",
     "MemcpyKind",
+    "LinearWeightFormat",
+    "Activation",
     "Stream",
     "Tensor",
+    "LinearWeight",
     "Ops",
     "models",
 ]
@@ -8,10 +8,15 @@ from .runtime import LlaisysRuntimeAPI
 from .llaisys_types import llaisysDeviceType_t, DeviceType
 from .llaisys_types import llaisysDataType_t, DataType
 from .llaisys_types import llaisysMemcpyKind_t, MemcpyKind
+from .llaisys_types import llaisysLinearWeightFormat_t, LinearWeightFormat
+from .llaisys_types import llaisysActivation_t, Activation
 from .llaisys_types import llaisysStream_t
 from .tensor import llaisysTensor_t
 from .tensor import load_tensor
 from .ops import load_ops
+from .ops import llaisysLinearWeight_t
+from .ops import LlaisysLinearEpilogue
+from .ops import LlaisysSamplingParams
 
 
 def load_shared_library():
@@ -51,5 +56,12 @@ __all__ = [
     "DeviceType",
     "llaisysMemcpyKind_t",
     "MemcpyKind",
+    "llaisysLinearWeight_t",
+    "llaisysLinearWeightFormat_t",
+    "LinearWeightFormat",
+    "llaisysActivation_t",
+    "Activation",
+    "LlaisysLinearEpilogue",
+    "LlaisysSamplingParams",
     "llaisysStream_t",
 ]
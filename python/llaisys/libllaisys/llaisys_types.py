@@ -34,6 +34,7 @@ class DataType(IntEnum):
     C64 = 17
     C128 = 18
     BF16 = 19
+    F8_E5M2 = 20
 
 
 llaisysDataType_t = ctypes.c_int
@@ -49,6 +50,28 @@ class MemcpyKind(IntEnum):
 
 llaisysMemcpyKind_t = ctypes.c_int
 
+# Linear Weight Format enum
+class LinearWeightFormat(IntEnum):
+    PACKED = 0
+    Q8 = 1
+    Q4 = 2
+    Q4_ZP = 3
+    W8A8 = 4
+    F8 = 5
+
+
+llaisysLinearWeightFormat_t = ctypes.c_int
+
+
+# Activation of the linear epilogue
+class Activation(IntEnum):
+    NONE = 0
+    SILU = 1
+    GELU = 2
+
+
+llaisysActivation_t = ctypes.c_int
+
 # Stream type (opaque pointer)
 llaisysStream_t = ctypes.c_void_p
 
@@ -59,5 +82,9 @@ __all__ = [
     "DataType",
     "llaisysMemcpyKind_t",
     "MemcpyKind",
+    "llaisysLinearWeightFormat_t",
+    "LinearWeightFormat",
+    "llaisysActivation_t",
+    "Activation",
     "llaisysStream_t",
 ]
@@ -1 +1,3 @@
-from .qwen2 import load_qwen2, LlaisysQwen2Meta, LlaisysQwen2Weights
\ No newline at end of file
+from .kv_cache import load_kv_cache, llaisysKVCache_t
+from .qwen2 import load_qwen2, LlaisysQwen2Meta, LlaisysQwen2Weights, Qwen2Status
+from .qwen2 import LlaisysQwen2GenerateParams, LlaisysQwen2TokenCallback
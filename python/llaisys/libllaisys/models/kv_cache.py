@@ -0,0 +1,39 @@
+from ctypes import POINTER, c_int, c_int64, c_size_t, c_void_p
+from ..llaisys_types import llaisysDeviceType_t, llaisysDataType_t
+
+llaisysKVCache_t = c_void_p
+
+
+def load_kv_cache(lib):
+    lib.kvCacheCreate.argtypes = [
+        c_size_t,  # nlayer
+        c_size_t,  # nkvh
+        c_size_t,  # dh
+        llaisysDataType_t,
+        c_size_t,  # block_size
+        c_size_t,  # nblocks
+        llaisysDeviceType_t,
+        c_int,  # device_id
+    ]
+    lib.kvCacheCreate.restype = llaisysKVCache_t
+
+    lib.kvCacheDestroy.argtypes = [llaisysKVCache_t]
+    lib.kvCacheDestroy.restype = None
+
+    lib.kvCacheAddSequence.argtypes = [llaisysKVCache_t]
+    lib.kvCacheAddSequence.restype = c_int64
+
+    lib.kvCacheFreeSequence.argtypes = [llaisysKVCache_t, c_int64]
+    lib.kvCacheFreeSequence.restype = None
+
+    lib.kvCacheSequenceLength.argtypes = [llaisysKVCache_t, c_int64]
+    lib.kvCacheSequenceLength.restype = c_size_t
+
+    lib.kvCacheMatchPrefix.argtypes = [llaisysKVCache_t, c_int64, POINTER(c_int64), c_size_t]
+    lib.kvCacheMatchPrefix.restype = c_size_t
+
+    lib.kvCacheNumFreeBlocks.argtypes = [llaisysKVCache_t]
+    lib.kvCacheNumFreeBlocks.restype = c_size_t
+
+    lib.kvCacheNumCachedBlocks.argtypes = [llaisysKVCache_t]
+    lib.kvCacheNumCachedBlocks.restype = c_size_t
@@ -1,8 +1,18 @@
-from ctypes import c_int, c_int64, c_size_t
-from ..llaisys_types import llaisysDeviceType_t, llaisysDataType_t
+from ctypes import c_int, c_int64, c_size_t, c_uint64
+from ..llaisys_types import llaisysDeviceType_t, llaisysDataType_t, llaisysLinearWeightFormat_t
 from ..tensor import llaisysTensor_t
+from ..ops import llaisysLinearWeight_t, LlaisysSamplingParams
+from .kv_cache import llaisysKVCache_t
+from enum import IntEnum
 import ctypes
 
+
+class Qwen2Status(IntEnum):
+    """Negative results of the paged Qwen2 calls (llaisysQwen2Status_t)."""
+    INVALID_ARGUMENT = -1
+    OUT_OF_BLOCKS = -2
+
+
 class LlaisysQwen2Meta(ctypes.Structure):
     _fields_ = [
         ("dtype", llaisysDataType_t),
@@ -40,6 +50,32 @@ class LlaisysQwen2Weights(ctypes.Structure):
         ("mlp_down_w",    ctypes.POINTER(llaisysTensor_t)),
     ]
 
+class LlaisysQwen2PackedWeights(ctypes.Structure):
+    _fields_ = [
+        ("out_embed",     llaisysLinearWeight_t),
+        ("attn_qkv_w",    ctypes.POINTER(llaisysLinearWeight_t)),
+        ("attn_qkv_b",    ctypes.POINTER(llaisysTensor_t)),
+        ("attn_o_w",      ctypes.POINTER(llaisysLinearWeight_t)),
+        ("mlp_gate_up_w", ctypes.POINTER(llaisysLinearWeight_t)),
+        ("mlp_down_w",    ctypes.POINTER(llaisysLinearWeight_t)),
+    ]
+
+class LlaisysQwen2GenerateParams(ctypes.Structure):
+    _fields_ = [
+        ("max_new_tokens", ctypes.c_size_t),
+        ("sampling", LlaisysSamplingParams),
+        ("seed", c_uint64),
+        ("prefill_chunk", ctypes.c_size_t),
+        ("stop_tokens", ctypes.POINTER(c_int64)),
+        ("nstop_tokens", ctypes.c_size_t),
+        ("stop_sequences", ctypes.POINTER(c_int64)),
+        ("stop_sequence_lens", ctypes.POINTER(c_size_t)),
+        ("nstop_sequences", ctypes.c_size_t),
+    ]
+
+# int (*)(int64_t token, void *user_data); nonzero stops generation
+LlaisysQwen2TokenCallback = ctypes.CFUNCTYPE(c_int, c_int64, ctypes.c_void_p)
+
 class LlaisysQwen2Model(ctypes.Structure):
     _fields_ = [
         ("meta", ctypes.POINTER(LlaisysQwen2Meta)),
@@ -47,6 +83,7 @@ class LlaisysQwen2Model(ctypes.Structure):
         ("ndevice", ctypes.c_int),
         ("device_ids", ctypes.POINTER(ctypes.c_int)),
         ("weights", ctypes.POINTER(LlaisysQwen2Weights)),
+        ("packed", ctypes.POINTER(LlaisysQwen2PackedWeights)),
     ]
 
 # Load shared library
@@ -61,5 +98,60 @@ def load_qwen2(lib):
     lib.llaisysQwen2ModelWeights.argtypes = [ctypes.POINTER(LlaisysQwen2Model)]
     lib.llaisysQwen2ModelWeights.restype = ctypes.POINTER(LlaisysQwen2Weights)
 
+    lib.llaisysQwen2ModelFinalize.argtypes = [
+        ctypes.POINTER(LlaisysQwen2Model),
+        llaisysLinearWeightFormat_t,
+        ctypes.c_size_t,
+    ]
+    lib.llaisysQwen2ModelFinalize.restype = ctypes.c_int
+
     lib.llaisysQwen2ModelInfer.argtypes = [ctypes.POINTER(LlaisysQwen2Model), ctypes.POINTER(c_int64), c_size_t, ctypes.POINTER(llaisysTensor_t), ctypes.POINTER(llaisysTensor_t), c_size_t]
     lib.llaisysQwen2ModelInfer.restype = c_int64
+
+    lib.llaisysQwen2ModelInferPaged.argtypes = [ctypes.POINTER(LlaisysQwen2Model), ctypes.POINTER(c_int64), c_size_t, llaisysKVCache_t, c_int64]
+    lib.llaisysQwen2ModelInferPaged.restype = c_int64
+
+    lib.llaisysQwen2ModelStep.argtypes = [
+        ctypes.POINTER(LlaisysQwen2Model),
+        ctypes.POINTER(c_int64),  # token_ids
+        ctypes.POINTER(c_size_t),  # ntokens
+        ctypes.POINTER(c_int64),  # seqs
+        c_size_t,  # nseq
+        llaisysKVCache_t,
+        ctypes.POINTER(c_int64),  # next_tokens
+    ]
+    lib.llaisysQwen2ModelStep.restype = ctypes.c_int
+
+    lib.llaisysQwen2ModelInferPagedLogits.argtypes = [
+        ctypes.POINTER(LlaisysQwen2Model),
+        ctypes.POINTER(c_int64),  # token_ids
+        c_size_t,  # ntoken
+        llaisysKVCache_t,
+        c_int64,  # seq
+        ctypes.POINTER(c_size_t),  # positions, NULL for the last token
+        c_size_t,  # npos
+        llaisysTensor_t,  # logits [npos, voc]
+    ]
+    lib.llaisysQwen2ModelInferPagedLogits.restype = c_int64
+
+    lib.llaisysQwen2ModelInferPagedSample.argtypes = [
+        ctypes.POINTER(LlaisysQwen2Model),
+        ctypes.POINTER(c_int64),  # token_ids
+        c_size_t,  # ntoken
+        llaisysKVCache_t,
+        c_int64,  # seq
+        ctypes.POINTER(LlaisysSamplingParams),
+        ctypes.POINTER(c_uint64),  # rng_state
+    ]
+    lib.llaisysQwen2ModelInferPagedSample.restype = c_int64
+
+    lib.llaisysQwen2ModelGenerate.argtypes = [
+        ctypes.POINTER(LlaisysQwen2Model),
+        ctypes.POINTER(c_int64),  # prompt
+        c_size_t,  # nprompt
+        llaisysKVCache_t,
+        ctypes.POINTER(LlaisysQwen2GenerateParams),
+        LlaisysQwen2TokenCallback,
+        ctypes.c_void_p,  # user_data
+    ]
+    lib.llaisysQwen2ModelGenerate.restype = c_int64
@@ -1,10 +1,60 @@
 from .tensor import llaisysTensor_t
-from ctypes import c_float
+from .llaisys_types import llaisysLinearWeightFormat_t, llaisysActivation_t
+from ctypes import Structure, POINTER, c_float, c_size_t, c_uint64, c_void_p
+
+# Handle type
+llaisysLinearWeight_t = c_void_p
+
+
+class LlaisysLinearEpilogue(Structure):
+    _fields_ = [
+        ("bias", llaisysTensor_t),
+        ("activation", llaisysActivation_t),
+        ("rope_pos_ids", llaisysTensor_t),
+        ("rope_cols", c_size_t),
+        ("rope_head_dim", c_size_t),
+        ("rope_theta", c_float),
+        ("residual", llaisysTensor_t),
+    ]
+
+
+class LlaisysSamplingParams(Structure):
+    _fields_ = [
+        ("temperature", c_float),
+        ("top_k", c_size_t),
+        ("top_p", c_float),
+        ("min_p", c_float),
+        ("repetition_penalty", c_float),
+    ]
+
 
 def load_ops(lib):
+    lib.linearWeightCreate.argtypes = [llaisysTensor_t, llaisysLinearWeightFormat_t, c_size_t]
+    lib.linearWeightCreate.restype = llaisysLinearWeight_t
+
+    lib.linearWeightCreateGateUp.argtypes = [
+        llaisysTensor_t,  # gate
+        llaisysTensor_t,  # up
+        llaisysLinearWeightFormat_t,
+        c_size_t,
+    ]
+    lib.linearWeightCreateGateUp.restype = llaisysLinearWeight_t
+
+    lib.linearWeightDestroy.argtypes = [llaisysLinearWeight_t]
+    lib.linearWeightDestroy.restype = None
+
     lib.llaisysAdd.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysTensor_t]
     lib.llaisysAdd.restype = None
 
+    lib.llaisysAddRmsNorm.argtypes = [
+        llaisysTensor_t,  # out_norm
+        llaisysTensor_t,  # residual_inout
+        llaisysTensor_t,  # x
+        llaisysTensor_t,  # weight
+        c_float,  # eps
+    ]
+    lib.llaisysAddRmsNorm.restype = None
+
     lib.llaisysArgmax.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysTensor_t]
     lib.llaisysArgmax.restype = None
 
@@ -14,6 +64,30 @@ def load_ops(lib):
     lib.llaisysLinear.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysTensor_t, llaisysTensor_t]
     lib.llaisysLinear.restype = None
 
+    lib.llaisysLinearPacked.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysLinearWeight_t, llaisysTensor_t]
+    lib.llaisysLinearPacked.restype = None
+
+    lib.llaisysLinearFused.argtypes = [
+        llaisysTensor_t,  # out
+        llaisysTensor_t,  # in
+        llaisysLinearWeight_t,
+        POINTER(LlaisysLinearEpilogue),
+    ]
+    lib.llaisysLinearFused.restype = None
+
+    lib.llaisysLinearSwiGLU.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysLinearWeight_t]
+    lib.llaisysLinearSwiGLU.restype = None
+
+    lib.llaisysLinearTopK.argtypes = [
+        llaisysTensor_t,  # indices
+        llaisysTensor_t,  # values
+        llaisysTensor_t,  # in
+        llaisysLinearWeight_t,
+        c_float,  # temperature
+        c_uint64,  # seed
+    ]
+    lib.llaisysLinearTopK.restype = None
+
     lib.llaisysRearrange.argtypes = [llaisysTensor_t, llaisysTensor_t]
     lib.llaisysRearrange.restype = None
 
@@ -32,5 +106,34 @@ def load_ops(lib):
     ]
     lib.llaisysSelfAttention.restype = None
 
+    lib.llaisysSelfAttentionPaged.argtypes = [
+        llaisysTensor_t,  # attn_val
+        llaisysTensor_t,  # q
+        llaisysTensor_t,  # k_blocks
+        llaisysTensor_t,  # v_blocks
+        llaisysTensor_t,  # k_scales (nullable)
+        llaisysTensor_t,  # v_scales (nullable)
+        llaisysTensor_t,  # block_table
+        c_size_t,  # kvlen
+        c_float    # scale
+    ]
+    lib.llaisysSelfAttentionPaged.restype = None
+
+    lib.llaisysQuantizeRows.argtypes = [
+        llaisysTensor_t,  # out
+        llaisysTensor_t,  # scales
+        llaisysTensor_t,  # in
+    ]
+    lib.llaisysQuantizeRows.restype = None
+
+    lib.llaisysSample.argtypes = [
+        llaisysTensor_t,  # out_idx
+        llaisysTensor_t,  # logits
+        llaisysTensor_t,  # history, may be NULL
+        POINTER(LlaisysSamplingParams),
+        POINTER(c_uint64),  # rng_state
+    ]
+    lib.llaisysSample.restype = None
+
     lib.llaisysSwiGLU.argtypes = [llaisysTensor_t, llaisysTensor_t, llaisysTensor_t]
     lib.llaisysSwiGLU.restype = None
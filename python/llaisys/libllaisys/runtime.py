@@ -46,3 +46,9 @@ def load_runtime(lib):
 
     lib.llaisysSetContextRuntime.argtypes = [llaisysDeviceType_t, c_int]
     lib.llaisysSetContextRuntime.restype = None
+
+    lib.llaisysSetNumThreads.argtypes = [c_int]
+    lib.llaisysSetNumThreads.restype = None
+
+    lib.llaisysGetNumThreads.argtypes = []
+    lib.llaisysGetNumThreads.restype = c_int
@@ -0,0 +1,45 @@
+from .libllaisys import (
+    LIB_LLAISYS,
+    llaisysLinearWeight_t,
+    llaisysLinearWeightFormat_t,
+    LinearWeightFormat,
+)
+from .tensor import Tensor
+
+
+class LinearWeight:
+    """Linear weight converted once into the layout the kernels read directly."""
+
+    def __init__(
+        self,
+        weight: Tensor,
+        format: LinearWeightFormat = LinearWeightFormat.PACKED,
+        group_size: int = 0,
+    ):
+        # group_size: inputs per scale for the Q4 formats (32, 64 or 128; 0 for the default)
+        self._weight: llaisysLinearWeight_t = LIB_LLAISYS.linearWeightCreate(
+            weight.lib_tensor(), llaisysLinearWeightFormat_t(format), group_size
+        )
+
+    @classmethod
+    def gate_up(
+        cls,
+        gate: Tensor,
+        up: Tensor,
+        format: LinearWeightFormat = LinearWeightFormat.PACKED,
+        group_size: int = 0,
+    ) -> "LinearWeight":
+        """Gate and up projections of a SwiGLU MLP interleaved into one weight for Ops.linear_swiglu."""
+        weight = cls.__new__(cls)
+        weight._weight = LIB_LLAISYS.linearWeightCreateGateUp(
+            gate.lib_tensor(), up.lib_tensor(), llaisysLinearWeightFormat_t(format), group_size
+        )
+        return weight
+
+    def __del__(self):
+        if hasattr(self, "_weight") and self._weight is not None:
+            LIB_LLAISYS.linearWeightDestroy(self._weight)
+            self._weight = None
+
+    def lib_weight(self) -> llaisysLinearWeight_t:
+        return self._weight
@@ -1,15 +1,19 @@
-from typing import Sequence, Optional, Union
+from typing import Callable, List, Sequence, Optional, Union
 from pathlib import Path
 import json
 import ctypes
+import random
 
 from huggingface_hub import snapshot_download
 import safetensors
 import torch
 
-from ..libllaisys import LIB_LLAISYS, DeviceType, DataType, llaisysTensor_t
-from ..libllaisys.models import load_qwen2, LlaisysQwen2Meta
+from ..libllaisys import LIB_LLAISYS, DeviceType, DataType, LinearWeightFormat, LlaisysSamplingParams, llaisysTensor_t
+from ..libllaisys.models import load_qwen2, load_kv_cache, LlaisysQwen2Meta, Qwen2Status
+from ..libllaisys.models import LlaisysQwen2GenerateParams, LlaisysQwen2TokenCallback
+from ..tensor import Tensor
 
+load_kv_cache(LIB_LLAISYS)
 load_qwen2(LIB_LLAISYS)
 
 class Qwen2:
@@ -17,15 +21,45 @@ class Qwen2:
     
     DEFAULT_MODEL_ID = "deepseek-ai/DeepSeek-R1-Distill-Qwen-1.5B"
 
-    def __init__(self, model_path: Optional[Union[str, Path]] = None, device: DeviceType = DeviceType.CPU):
+    def __init__(
+        self,
+        model_path: Optional[Union[str, Path]] = None,
+        device: DeviceType = DeviceType.CPU,
+        dtype: Optional[DataType] = None,
+        weight_format: LinearWeightFormat = LinearWeightFormat.PACKED,
+        group_size: int = 0,
+        kv_dtype: Optional[DataType] = None,
+        kv_block_size: int = 16,
+        kv_cache_tokens: int = 8192,
+        prefill_chunk: int = 512,
+    ):
         """Initialize Qwen2 model.
         
         Args:
             model_path: Path to model directory. If None, downloads default model.
             device: Device type for inference.
+            dtype: Weight/activation data type. If None, keeps the checkpoint's torch_dtype.
+            weight_format: Layout of the projection weights. Q8 quantizes them to INT8 with
+                per-output-channel scales at load time; Q4/Q4_ZP quantize attention and MLP
+                weights to 4 bits with per-group scales (and zero points); W8A8 uses Q8 weights
+                and also quantizes their inputs to INT8 per token, for integer prefill GEMMs.
+                F8 stores them in FP8 E4M3, cast directly without calibration.
+            group_size: Inputs per 4-bit group (32, 64 or 128; 0 for the default).
+            kv_dtype: Element type of the KV cache. If None, uses dtype. I8, F8 or F8_E5M2
+                quantize every cached row (one position of one KV head) with its own scale,
+                a quarter of the F32 footprint and decode attention traffic.
+            kv_block_size: Positions per block of the paged KV cache.
+            kv_cache_tokens: Positions the KV cache pool holds, shared by all sequences being
+                generated; generate() fails once they are used up. Finished sequences leave
+                their full blocks cached, so a later prompt with the same prefix (a system
+                prompt, a previous turn) skips prefilling it.
+            prefill_chunk: Prompt tokens run per forward step. Longer prompts are prefilled in
+                chunks, which bounds the activation memory of a step; generate_batch() also
+                runs the decode tokens of other sequences in the same steps.
             
         Raises:
-            ValueError: If unsupported device is specified.
+            ValueError: If unsupported device is specified, or the weights cannot be converted
+                to weight_format with group_size.
             FileNotFoundError: If required model files are missing.
         """
         if device != DeviceType.CPU:
@@ -40,10 +74,21 @@ class Qwen2:
         config = self._load_config()
         self._init_model_params(config)
         
-        self.data_type = DataType.F32 if device == DeviceType.CPU else DataType.BF16
+        self.data_type = dtype if dtype is not None else self._default_data_type()
+        self.kv_data_type = kv_dtype if kv_dtype is not None else self.data_type
+        if prefill_chunk <= 0:
+            raise ValueError("prefill_chunk must be positive")
+        self.prefill_chunk = prefill_chunk
         
         self._create_model()
         self._load_weights()
+        self._create_kv_cache(kv_block_size, kv_cache_tokens)
+        # Convert projection weights into the packed (or quantized) kernel layout once
+        if LIB_LLAISYS.llaisysQwen2ModelFinalize(self.model, weight_format, group_size) != 0:
+            raise ValueError(
+                f"Cannot convert the weights to format {getattr(weight_format, 'name', weight_format)} "
+                f"with group_size {group_size} (see stderr)"
+            )
 
     def _resolve_model_path(self, model_path: Optional[Union[str, Path]]) -> Path:
         """Resolve model path, downloading if necessary."""
@@ -97,6 +142,13 @@ class Qwen2:
         self.per_head_dim = self.hidden_size // self.num_attention_heads
         self.per_kvhead_dim = self.per_head_dim  # For Qwen2, dv = d
 
+    def _default_data_type(self) -> DataType:
+        """Map config.json torch_dtype to the matching llaisys data type."""
+        return {
+            "bfloat16": DataType.BF16,
+            "float16": DataType.F16,
+        }.get(self.torch_dtype, DataType.F32)
+
     def _create_model(self) -> None:
         """Create the model instance."""
         meta = LlaisysQwen2Meta(
@@ -125,17 +177,38 @@ class Qwen2:
         if not self.model:
             raise RuntimeError("Failed to create Qwen2 model.")
 
+    def _create_kv_cache(self, block_size: int, max_tokens: int) -> None:
+        """Create the paged KV cache pool shared by generate() calls."""
+        if block_size <= 0 or max_tokens <= 0:
+            raise ValueError("kv_block_size and kv_cache_tokens must be positive")
+        self.kv_cache = LIB_LLAISYS.kvCacheCreate(
+            self.num_hidden_layers,
+            self.num_key_value_heads,
+            self.per_kvhead_dim,
+            self.kv_data_type,
+            block_size,
+            (max_tokens + block_size - 1) // block_size,
+            self.device,
+            self.device_id,
+        )
+        if not self.kv_cache:
+            raise RuntimeError("Failed to create KV cache.")
+
     def _load_weights(self) -> None:
         """Load model weights from safetensors files."""
         weights = LIB_LLAISYS.llaisysQwen2ModelWeights(self.model)
         if not weights:
             raise RuntimeError("Failed to get Qwen2 weights.")
 
+        torch_dtype = {
+            DataType.BF16: torch.bfloat16,
+            DataType.F16: torch.float16,
+            DataType.F32: torch.float32,
+        }[self.data_type]
+
         def maybe_cast_tensor(tensor):
-            """Cast tensor to appropriate dtype if needed."""
-            if self.device == DeviceType.CPU:
-                return tensor.to(torch.float32).contiguous()
-            return tensor
+            """Cast tensor to the model dtype if needed."""
+            return tensor.to(torch_dtype).contiguous()
 
         for file in sorted(self.model_path.glob("*.safetensors")):
             data = safetensors.safe_open(file, framework="torch", device="cpu")
@@ -201,17 +274,35 @@ class Qwen2:
         top_k: int = 1,
         top_p: float = 0.8,
         temperature: float = 0.8,
-        use_cache: bool = True
+        use_cache: bool = True,
+        min_p: float = 0.0,
+        repetition_penalty: float = 1.0,
+        seed: Optional[int] = None,
+        stop_token_ids: Sequence[int] = (),
+        stop_sequences: Sequence[Sequence[int]] = (),
+        callback: Optional[Callable[[int], Optional[bool]]] = None,
     ) -> Sequence[int]:
         """Generate tokens using the model.
+
+        With the KV cache the whole loop (prefill, decode, sampling and stop checks) runs in C++
+        (llaisysQwen2ModelGenerate); Python only sees each token through the callback. Tokens are
+        drawn natively (see llaisysSample). top_k == 1 or temperature <= 0 without a repetition
+        penalty decodes greedily.
         
         Args:
             inputs: Input token IDs
             max_new_tokens: Maximum number of new tokens to generate
-            top_k: Top-k sampling parameter
+            top_k: Top-k sampling parameter (0 for no limit)
             top_p: Top-p (nucleus) sampling parameter  
             temperature: Sampling temperature
-            use_cache: Whether to use KV cache for efficiency
+            use_cache: Whether to use KV cache for efficiency; required to sample
+            min_p: Drop tokens less likely than min_p times the most likely one
+            repetition_penalty: Penalty on the logits of tokens already in the sequence (1 is off)
+            seed: Seed of this request's generator; random if None
+            stop_token_ids: Tokens that end generation besides eos (reported, like eos)
+            stop_sequences: Token sequences that end generation once the output ends with one
+            callback: Called with each token as it is generated, e.g. to stream it; returning
+                True stops generation after that token
             
         Returns:
             Generated token IDs including input tokens
@@ -220,52 +311,203 @@ class Qwen2:
             raise ValueError("Input tokens cannot be empty")
         if max_new_tokens <= 0:
             raise ValueError("max_new_tokens must be positive")
+
+        params = LlaisysSamplingParams(temperature, top_k, top_p, min_p, repetition_penalty)
+        greedy = (temperature <= 0 or top_k == 1) and repetition_penalty == 1.0
+        seed = random.getrandbits(64) if seed is None else seed
             
         generated = list(inputs)
-        
-        # Create KV cache if enabled
-        kcache_array, vcache_array = self._create_kv_cache(max_new_tokens, len(generated), use_cache)
-        
-        # Prefill phase
-        next_token = self._infer_tokens(generated, kcache_array, vcache_array, 0)
-        generated.append(next_token)
-        
-        # Decode phase  
-        for _ in range(max_new_tokens - 1):
-            if next_token == self.eos_token_id:
-                break
-                
-            if use_cache:
-                next_token = self._infer_tokens([next_token], kcache_array, vcache_array, len(generated) - 1)
-            else:
-                next_token = self._infer_tokens(generated, kcache_array, vcache_array, 0)
-                
+
+        if not use_cache:
+            if not greedy:
+                raise ValueError("Sampling needs use_cache=True")
+            # Recompute the whole sequence for every token
+            next_token = self._infer_tokens(generated)
             generated.append(next_token)
+            for _ in range(max_new_tokens - 1):
+                if next_token == self.eos_token_id:
+                    break
+                next_token = self._infer_tokens(generated)
+                generated.append(next_token)
+            return generated
+
+        stop_lens = [len(stop) for stop in stop_sequences]
+        stop_flat = [token for stop in stop_sequences for token in stop]
+        request = LlaisysQwen2GenerateParams(
+            max_new_tokens=max_new_tokens,
+            sampling=params,
+            seed=seed,
+            prefill_chunk=self.prefill_chunk,
+            stop_tokens=(ctypes.c_int64 * len(stop_token_ids))(*stop_token_ids),
+            nstop_tokens=len(stop_token_ids),
+            stop_sequences=(ctypes.c_int64 * len(stop_flat))(*stop_flat),
+            stop_sequence_lens=(ctypes.c_size_t * len(stop_lens))(*stop_lens),
+            nstop_sequences=len(stop_lens),
+        )
+
+        # An exception in the callback cannot cross the C frames: stop, then raise it here
+        errors = []
 
+        def on_token(token, _user_data):
+            generated.append(token)
+            if callback is None:
+                return 0
+            try:
+                return 1 if callback(token) else 0
+            except BaseException as e:
+                errors.append(e)
+                return 1
+
+        status = LIB_LLAISYS.llaisysQwen2ModelGenerate(
+            self.model,
+            (ctypes.c_int64 * len(inputs))(*inputs),
+            ctypes.c_size_t(len(inputs)),
+            self.kv_cache,
+            ctypes.byref(request),
+            LlaisysQwen2TokenCallback(on_token),
+            None,
+        )
+        if errors:
+            raise errors[0]
+        self._check_status(status, "llaisysQwen2ModelGenerate")
         return generated
 
-    def _create_kv_cache(self, max_new_tokens: int, input_len: int, use_cache: bool):
-        """Create KV cache tensors if needed."""
-        if use_cache:
-            kcache_array = (llaisysTensor_t * self.num_hidden_layers)()
-            vcache_array = (llaisysTensor_t * self.num_hidden_layers)()
-
-            for i in range(self.num_hidden_layers):
-                shape_arr = (ctypes.c_size_t * 3)(
-                    max_new_tokens + input_len,
-                    self.num_key_value_heads,
-                    self.per_kvhead_dim
-                )
-                kcache_array[i] = LIB_LLAISYS.tensorCreate(shape_arr, 3, self.data_type, self.device, self.device_id)
-                vcache_array[i] = LIB_LLAISYS.tensorCreate(shape_arr, 3, self.data_type, self.device, self.device_id)
-        else:
-            kcache_array = ctypes.POINTER(llaisysTensor_t)()
-            vcache_array = ctypes.POINTER(llaisysTensor_t)()
-            
-        return kcache_array, vcache_array
+    def generate_batch(
+        self,
+        inputs: Sequence[Sequence[int]],
+        max_new_tokens: int = 128,
+    ) -> List[List[int]]:
+        """Greedily generate for several prompts at once, sharing forward steps.
+
+        Every step runs one token of each sequence that is decoding, plus up to prefill_chunk
+        tokens of the prompts still being prefilled, so a long prompt does not stall the
+        sequences that are already generating.
+
+        Args:
+            inputs: Input token IDs of every prompt
+            max_new_tokens: Maximum number of new tokens per prompt
 
-    def _infer_tokens(self, tokens: Sequence[int], kcache_array, vcache_array, past_len: int) -> int:
-        """Perform inference on token sequence."""
+        Returns:
+            Generated token IDs of every prompt, including its input tokens
+        """
+        if not inputs or any(not tokens for tokens in inputs):
+            raise ValueError("Input tokens cannot be empty")
+        if max_new_tokens <= 0:
+            raise ValueError("max_new_tokens must be positive")
+
+        generated = [list(tokens) for tokens in inputs]
+        seqs = []
+        try:
+            # prefilled[i]: prompt tokens of sequence i already in the cache
+            prefilled = []
+            for tokens in generated:
+                seqs.append(LIB_LLAISYS.kvCacheAddSequence(self.kv_cache))
+                TokenArrayType = ctypes.c_int64 * len(tokens)
+                prefilled.append(LIB_LLAISYS.kvCacheMatchPrefix(
+                    self.kv_cache, ctypes.c_int64(seqs[-1]), TokenArrayType(*tokens), ctypes.c_size_t(len(tokens))
+                ))
+            prompt_lens = [len(tokens) for tokens in generated]
+            finished = [False] * len(generated)
+
+            while not all(finished):
+                step = []  # (sequence index, tokens)
+                budget = self.prefill_chunk
+                for i, tokens in enumerate(generated):
+                    if finished[i]:
+                        continue
+                    if prefilled[i] == prompt_lens[i]:
+                        step.append((i, tokens[-1:]))
+                    elif budget > 0:
+                        chunk = tokens[prefilled[i]:prefilled[i] + budget]
+                        prefilled[i] += len(chunk)
+                        budget -= len(chunk)
+                        step.append((i, chunk))
+                next_tokens = self._step([seqs[i] for i, _ in step], [chunk for _, chunk in step])
+                for (i, _), next_token in zip(step, next_tokens):
+                    # A prompt that is still partly unprefilled has no next token yet
+                    if prefilled[i] < prompt_lens[i]:
+                        continue
+                    generated[i].append(next_token)
+                    if (next_token == self.eos_token_id
+                            or len(generated[i]) - prompt_lens[i] >= max_new_tokens):
+                        finished[i] = True
+        finally:
+            for seq in seqs:
+                LIB_LLAISYS.kvCacheFreeSequence(self.kv_cache, seq)
+
+        return generated
+
+    def logits(self, inputs: Sequence[int], positions: Optional[Sequence[int]] = None) -> torch.Tensor:
+        """Compute the logits after selected tokens of inputs, e.g. to score a prompt.
+
+        Only the selected rows go through the final norm and the LM head.
+
+        Args:
+            inputs: Input token IDs
+            positions: Indices into inputs whose next-token logits are wanted. If None, the
+                last token only.
+
+        Returns:
+            float32 tensor of shape [len(positions), vocab_size]
+        """
+        if not inputs:
+            raise ValueError("Input tokens cannot be empty")
+        positions = [len(inputs) - 1] if positions is None else list(positions)
+        if not positions or any(p < 0 or p >= len(inputs) for p in positions):
+            raise ValueError("positions must index inputs")
+
+        logits = Tensor((len(positions), self.vocab_size), DataType.F32, self.device, self.device_id)
+        seq = LIB_LLAISYS.kvCacheAddSequence(self.kv_cache)
+        try:
+            TokenArrayType = ctypes.c_int64 * len(inputs)
+            next_token = LIB_LLAISYS.llaisysQwen2ModelInferPagedLogits(
+                self.model,
+                TokenArrayType(*inputs),
+                ctypes.c_size_t(len(inputs)),
+                self.kv_cache,
+                ctypes.c_int64(seq),
+                (ctypes.c_size_t * len(positions))(*positions),
+                ctypes.c_size_t(len(positions)),
+                logits.lib_tensor(),
+            )
+        finally:
+            LIB_LLAISYS.kvCacheFreeSequence(self.kv_cache, seq)
+        self._check_status(next_token, "llaisysQwen2ModelInferPagedLogits")
+
+        result = torch.empty((len(positions), self.vocab_size), dtype=torch.float32)
+        ctypes.memmove(result.data_ptr(), logits.data_ptr(), result.numel() * result.element_size())
+        return result
+
+    def _step(self, seqs: Sequence[int], chunks: Sequence[Sequence[int]]) -> List[int]:
+        """Append chunks[i] to sequence seqs[i] of the paged KV cache, all in one forward step."""
+        tokens = [token for chunk in chunks for token in chunk]
+        token_array = (ctypes.c_int64 * len(tokens))(*tokens)
+        ntokens = (ctypes.c_size_t * len(chunks))(*[len(chunk) for chunk in chunks])
+        seq_array = (ctypes.c_int64 * len(seqs))(*seqs)
+        next_tokens = (ctypes.c_int64 * len(seqs))()
+
+        status = LIB_LLAISYS.llaisysQwen2ModelStep(
+            self.model,
+            token_array,
+            ntokens,
+            seq_array,
+            ctypes.c_size_t(len(seqs)),
+            self.kv_cache,
+            next_tokens,
+        )
+        self._check_status(status, "llaisysQwen2ModelStep")
+        return list(next_tokens)
+
+    @staticmethod
+    def _check_status(result: int, call: str) -> None:
+        """Raise for a negative result (a Qwen2Status) of a paged call."""
+        if result == Qwen2Status.OUT_OF_BLOCKS:
+            raise RuntimeError("KV cache is out of blocks; increase kv_cache_tokens.")
+        if result < 0:
+            raise ValueError(f"{call} rejected its arguments (see stderr)")
+
+    def _infer_tokens(self, tokens: Sequence[int]) -> int:
+        """Perform inference on the full token sequence without a KV cache."""
         ntokens = len(tokens)
         TokenArrayType = ctypes.c_int64 * ntokens
         input_token_array = TokenArrayType(*tokens)
@@ -274,7 +516,7 @@ class Qwen2:
             self.model,
             input_token_array,
             ctypes.c_size_t(ntokens),
-            kcache_array,
-            vcache_array,
-            ctypes.c_size_t(past_len)
-        )
\ No newline at end of file
+            ctypes.POINTER(llaisysTensor_t)(),
+            ctypes.POINTER(llaisysTensor_t)(),
+            ctypes.c_size_t(0)
+        )
@@ -1,6 +1,7 @@
-from .libllaisys import LIB_LLAISYS
+from .libllaisys import LIB_LLAISYS, Activation, LlaisysLinearEpilogue, LlaisysSamplingParams
 from .tensor import Tensor
-from ctypes import c_float, c_int
+from .linear_weight import LinearWeight
+from ctypes import byref, c_float, c_int, c_size_t, c_uint64
 
 
 class Ops:
@@ -8,6 +9,16 @@ class Ops:
     def add(c: Tensor, a: Tensor, b: Tensor):
         LIB_LLAISYS.llaisysAdd(c.lib_tensor(), a.lib_tensor(), b.lib_tensor())
 
+    @staticmethod
+    def add_rms_norm(out_norm: Tensor, residual: Tensor, x: Tensor, weight: Tensor, eps: float):
+        LIB_LLAISYS.llaisysAddRmsNorm(
+            out_norm.lib_tensor(),
+            residual.lib_tensor(),
+            x.lib_tensor(),
+            weight.lib_tensor(),
+            c_float(eps),
+        )
+
     @staticmethod
     def argmax(max_idx: Tensor, max_val: Tensor, vals: Tensor):
         LIB_LLAISYS.llaisysArgmax(max_idx.lib_tensor(), max_val.lib_tensor(), vals.lib_tensor())
@@ -21,7 +32,65 @@ class Ops:
     @staticmethod
     def linear(out: Tensor, inp: Tensor, weight: Tensor, bias: Tensor):
         LIB_LLAISYS.llaisysLinear(
-            out.lib_tensor(), inp.lib_tensor(), weight.lib_tensor(), bias.lib_tensor()
+            out.lib_tensor(),
+            inp.lib_tensor(),
+            weight.lib_tensor(),
+            bias.lib_tensor() if bias is not None else None,
+        )
+
+    @staticmethod
+    def linear_packed(out: Tensor, inp: Tensor, weight: LinearWeight, bias: Tensor):
+        LIB_LLAISYS.llaisysLinearPacked(
+            out.lib_tensor(),
+            inp.lib_tensor(),
+            weight.lib_weight(),
+            bias.lib_tensor() if bias is not None else None,
+        )
+
+    @staticmethod
+    def linear_fused(
+        out: Tensor,
+        inp: Tensor,
+        weight: LinearWeight,
+        bias: Tensor = None,
+        activation: Activation = Activation.NONE,
+        rope_pos_ids: Tensor = None,
+        rope_cols: int = 0,
+        rope_head_dim: int = 0,
+        rope_theta: float = 10000.0,
+        residual: Tensor = None,
+    ):
+        epilogue = LlaisysLinearEpilogue(
+            bias.lib_tensor() if bias is not None else None,
+            int(activation),
+            rope_pos_ids.lib_tensor() if rope_pos_ids is not None else None,
+            rope_cols,
+            rope_head_dim,
+            rope_theta,
+            residual.lib_tensor() if residual is not None else None,
+        )
+        LIB_LLAISYS.llaisysLinearFused(out.lib_tensor(), inp.lib_tensor(), weight.lib_weight(), byref(epilogue))
+
+    @staticmethod
+    def linear_swiglu(out: Tensor, inp: Tensor, gate_up: LinearWeight):
+        LIB_LLAISYS.llaisysLinearSwiGLU(out.lib_tensor(), inp.lib_tensor(), gate_up.lib_weight())
+
+    @staticmethod
+    def linear_topk(
+        indices: Tensor,
+        values: Tensor,
+        inp: Tensor,
+        weight: LinearWeight,
+        temperature: float = 0.0,
+        seed: int = 0,
+    ):
+        LIB_LLAISYS.llaisysLinearTopK(
+            indices.lib_tensor(),
+            values.lib_tensor(),
+            inp.lib_tensor(),
+            weight.lib_weight(),
+            c_float(temperature),
+            c_uint64(seed),
         )
 
     @staticmethod
@@ -50,6 +119,58 @@ class Ops:
             c_float(scale),
         )
 
+    @staticmethod
+    def self_attention_paged(
+        attn_val: Tensor,
+        q: Tensor,
+        k_blocks: Tensor,
+        v_blocks: Tensor,
+        block_table: Tensor,
+        kvlen: int,
+        scale: float,
+        k_scales: Tensor = None,
+        v_scales: Tensor = None,
+    ):
+        LIB_LLAISYS.llaisysSelfAttentionPaged(
+            attn_val.lib_tensor(),
+            q.lib_tensor(),
+            k_blocks.lib_tensor(),
+            v_blocks.lib_tensor(),
+            k_scales.lib_tensor() if k_scales is not None else None,
+            v_scales.lib_tensor() if v_scales is not None else None,
+            block_table.lib_tensor(),
+            c_size_t(kvlen),
+            c_float(scale),
+        )
+
+    @staticmethod
+    def quantize_rows(out: Tensor, scales: Tensor, inp: Tensor):
+        LIB_LLAISYS.llaisysQuantizeRows(out.lib_tensor(), scales.lib_tensor(), inp.lib_tensor())
+
+    @staticmethod
+    def sample(
+        out_idx: Tensor,
+        logits: Tensor,
+        history: Tensor = None,
+        temperature: float = 0.0,
+        top_k: int = 0,
+        top_p: float = 1.0,
+        min_p: float = 0.0,
+        repetition_penalty: float = 1.0,
+        rng_state: int = 0,
+    ) -> int:
+        """Draw a token into out_idx; returns the advanced rng_state to pass to the next call."""
+        params = LlaisysSamplingParams(temperature, top_k, top_p, min_p, repetition_penalty)
+        state = c_uint64(rng_state)
+        LIB_LLAISYS.llaisysSample(
+            out_idx.lib_tensor(),
+            logits.lib_tensor(),
+            history.lib_tensor() if history is not None else None,
+            byref(params),
+            byref(state),
+        )
+        return state.value
+
     @staticmethod
     def swiglu(out: Tensor, gate: Tensor, up: Tensor):
         LIB_LLAISYS.llaisysSwiGLU(out.lib_tensor(), gate.lib_tensor(), up.lib_tensor())
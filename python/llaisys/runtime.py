@@ -66,3 +66,12 @@ class RuntimeAPI:
         self._api.contents.memcpy_async(
             dst, src, size, libllaisys.llaisysMemcpyKind_t(kind), stream
         )
+
+
+def set_num_threads(num_threads: int) -> None:
+    """Size the CPU thread pool (threads per op, including the caller); 0 restores the default."""
+    LIB_LLAISYS.llaisysSetNumThreads(num_threads)
+
+
+def get_num_threads() -> int:
+    return LIB_LLAISYS.llaisysGetNumThreads()
@@ -2,6 +2,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <new>
 
 namespace llaisys::device::cpu {
 
@@ -29,12 +30,15 @@ void streamSynchronize(llaisysStream_t stream) {
     // do nothing
 }
 
+// Cache-line aligned so SIMD kernels and packed weights never straddle lines at row starts.
+constexpr size_t ALIGNMENT = 64;
+
 void *mallocDevice(size_t size) {
-    return std::malloc(size);
+    return ::operator new(size, std::align_val_t(ALIGNMENT), std::nothrow);
 }
 
 void freeDevice(void *ptr) {
-    std::free(ptr);
+    ::operator delete(ptr, std::align_val_t(ALIGNMENT));
 }
 
 void *mallocHost(size_t size) {
@@ -0,0 +1,250 @@
+#include "thread_pool.hpp"
+
+#include "../../utils/cpu_info.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(LLAISYS_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace llaisys::device::cpu {
+namespace {
+// How long an idle worker polls for the next job before parking. Covers the gap between
+// consecutive ops of a forward pass.
+constexpr auto SPIN_TIME = std::chrono::microseconds(200);
+
+inline void cpu_relax() {
+#if defined(LLAISYS_X86)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Busy-wait step; gives the core away instead when threads outnumber cores.
+inline void backoff(bool spin) {
+    if (spin) {
+        cpu_relax();
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+std::vector<int> affinity_cpus() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) {
+                cpus.push_back(c);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        size_t hw = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for (size_t c = 0; c < hw; c++) {
+            cpus.push_back(static_cast<int>(c));
+        }
+    }
+    return cpus;
+}
+
+size_t default_num_threads(size_t ncpus) {
+    const char *env = std::getenv("LLAISYS_NUM_THREADS");
+    if (env != nullptr) {
+        long v = std::strtol(env, nullptr, 10);
+        if (v > 0) {
+            return static_cast<size_t>(v);
+        }
+    }
+    return ncpus;
+}
+
+void pin_to_cpu(std::thread &thread, int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+}
+} // namespace
+
+ThreadPool::ThreadPool() : _cpus(affinity_cpus()) {
+    const char *pin = std::getenv("LLAISYS_PIN_THREADS");
+    _pin = pin != nullptr && std::strcmp(pin, "1") == 0;
+    start(default_num_threads(_cpus.size()));
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+// Workers only help, so they can be replaced while other threads' jobs are in flight.
+void ThreadPool::setNumThreads(size_t nthreads) {
+    std::lock_guard<std::mutex> lock(_resize);
+    stop();
+    start(nthreads == 0 ? default_num_threads(_cpus.size()) : nthreads);
+}
+
+void ThreadPool::start(size_t nthreads) {
+    // Spinning only pays off when every thread has a core to itself.
+    _spin = nthreads <= _cpus.size();
+    _stopping = false;
+    _workers.reserve(nthreads - 1);
+    for (size_t i = 0; i + 1 < nthreads; i++) {
+        _workers.emplace_back(&ThreadPool::workerLoop, this);
+        if (_pin) {
+            pin_to_cpu(_workers.back(), _cpus[(i + 1) % _cpus.size()]);
+        }
+    }
+    _nthreads = nthreads;
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_park_mutex);
+        _stopping = true;
+    }
+    _park_cv.notify_all();
+    for (auto &w : _workers) {
+        w.join();
+    }
+    _workers.clear();
+    _nthreads = 1;
+}
+
+void ThreadPool::runChunks(Job &job) {
+    for (size_t c = job.next_chunk.fetch_add(1, std::memory_order_relaxed); c < job.chunks;
+         c = job.next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+        try {
+            job.fn(job.ctx, job.n * c / job.chunks, job.n * (c + 1) / job.chunks);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_error_mutex);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+        }
+        job.done_chunks.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void ThreadPool::run(size_t n, size_t chunks, job_fn fn, const void *ctx) {
+    Job *job = nullptr;
+    for (Job &slot : _jobs) {
+        int expected = Job::FREE;
+        if (slot.state.compare_exchange_strong(expected, Job::FILLING, std::memory_order_acquire)) {
+            job = &slot;
+            break;
+        }
+    }
+    if (job == nullptr) {
+        // More jobs in flight than slots: nothing to share with anyway
+        for (size_t c = 0; c < chunks; c++) {
+            fn(ctx, n * c / chunks, n * (c + 1) / chunks);
+        }
+        return;
+    }
+
+    job->fn = fn;
+    job->ctx = ctx;
+    job->n = n;
+    job->chunks = chunks;
+    job->error = nullptr;
+    job->next_chunk.store(0, std::memory_order_relaxed);
+    job->done_chunks.store(0, std::memory_order_relaxed);
+    job->state.store(Job::OPEN, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> park_lock(_park_mutex);
+        _epoch.fetch_add(1, std::memory_order_release);
+        if (_parked > 0) {
+            _park_cv.notify_all();
+        }
+    }
+
+    runChunks(*job);
+    // Only this job's chunks are run while waiting: helping others could re-enter a kernel
+    // whose thread-local buffers the caller is still using.
+    bool spin = _spin.load(std::memory_order_relaxed);
+    while (job->done_chunks.load(std::memory_order_acquire) != chunks) {
+        backoff(spin);
+    }
+
+    // Retire the slot once no worker can still be reading it
+    job->state.store(Job::CLOSED, std::memory_order_seq_cst);
+    while (job->users.load(std::memory_order_seq_cst) != 0) {
+        backoff(spin);
+    }
+    std::exception_ptr error = job->error;
+    job->state.store(Job::FREE, std::memory_order_release);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Claim chunks from any open job; returns whether any work was found.
+bool ThreadPool::helpAny() {
+    bool found = false;
+    for (Job &job : _jobs) {
+        if (job.state.load(std::memory_order_relaxed) != Job::OPEN) {
+            continue;
+        }
+        job.users.fetch_add(1, std::memory_order_seq_cst);
+        if (job.state.load(std::memory_order_seq_cst) == Job::OPEN
+            && job.next_chunk.load(std::memory_order_relaxed) < job.chunks) {
+            runChunks(job);
+            found = true;
+        }
+        job.users.fetch_sub(1, std::memory_order_release);
+    }
+    return found;
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        uint64_t epoch = _epoch.load(std::memory_order_acquire);
+        if (helpAny()) {
+            continue;
+        }
+        if (_spin.load(std::memory_order_relaxed)) {
+            auto deadline = std::chrono::steady_clock::now() + SPIN_TIME;
+            for (size_t i = 1; _epoch.load(std::memory_order_acquire) == epoch; i++) {
+                cpu_relax();
+                if (i % 64 == 0 && std::chrono::steady_clock::now() > deadline) {
+                    break;
+                }
+            }
+        }
+        std::unique_lock<std::mutex> lock(_park_mutex);
+        if (_epoch.load(std::memory_order_acquire) == epoch && !_stopping) {
+            _parked++;
+            _park_cv.wait(lock, [&]() {
+                return _stopping || _epoch.load(std::memory_order_acquire) != epoch;
+            });
+            _parked--;
+        }
+        if (_stopping) {
+            return;
+        }
+    }
+}
+
+ThreadPool &threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+} // namespace llaisys::device::cpu
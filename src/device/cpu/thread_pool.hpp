@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llaisys::device::cpu {
+// Persistent intra-op worker pool of the CPU runtime, shared by every thread's context.
+//
+// parallelFor publishes its chunks as a job and runs them on the calling thread together with
+// any idle workers, which claim chunks from every open job. Calls may nest and may come from
+// several threads at once: a caller always finishes its own job, so workers only ever help,
+// and independent ops run from the chunks of an outer parallelFor share the workers between them.
+// Idle workers spin for a short while so back-to-back ops dispatch without a futex wake,
+// then park.
+//
+// Environment:
+//   LLAISYS_NUM_THREADS  threads per op including the caller (default: CPUs in the affinity mask)
+//   LLAISYS_PIN_THREADS  "1" pins worker i to the (i + 1)-th CPU of the affinity mask (Linux)
+class ThreadPool {
+public:
+    ThreadPool();
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Threads available to one op, including the caller. Always >= 1.
+    size_t numThreads() const { return _nthreads.load(std::memory_order_relaxed); }
+    // Resize the pool; 0 restores the default.
+    void setNumThreads(size_t nthreads);
+
+    // Run fn(begin, end) over [0, n) split into equal chunks of at least `grain` items, at most
+    // one chunk per thread. Chunk boundaries only depend on n, grain and numThreads().
+    template <typename F>
+    void parallelFor(size_t n, size_t grain, const F &fn) {
+        if (n == 0) {
+            return;
+        }
+        size_t chunks = std::min(numThreads(), (n + grain - 1) / std::max<size_t>(grain, 1));
+        if (chunks <= 1) {
+            return fn(size_t(0), n);
+        }
+        run(n, chunks, &invoke<F>, &fn);
+    }
+
+private:
+    using job_fn = void (*)(const void *, size_t, size_t);
+
+    template <typename F>
+    static void invoke(const void *fn, size_t begin, size_t end) {
+        (*static_cast<const F *>(fn))(begin, end);
+    }
+
+    // One in-flight parallelFor. Slots are owned by the pool so that a worker holding a stale
+    // slot never touches a finished caller's stack.
+    struct Job {
+        enum State : int { FREE, FILLING, OPEN, CLOSED };
+        std::atomic<int> state{FREE};
+        std::atomic<size_t> users{0}; // workers currently looking at this slot
+        job_fn fn = nullptr;
+        const void *ctx = nullptr;
+        size_t n = 0;
+        size_t chunks = 0;
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<size_t> done_chunks{0};
+        std::exception_ptr error;
+    };
+    static constexpr size_t MAX_JOBS = 64;
+
+    void run(size_t n, size_t chunks, job_fn fn, const void *ctx);
+    void runChunks(Job &job);
+    bool helpAny();
+    void workerLoop();
+    void start(size_t nthreads);
+    void stop();
+
+    std::vector<std::thread> _workers;
+    std::atomic<size_t> _nthreads{1};
+    std::vector<int> _cpus; // affinity mask at startup, for pinning
+    bool _pin;
+    std::atomic<bool> _spin{false};
+    std::mutex _resize;
+
+    Job _jobs[MAX_JOBS];
+    std::mutex _error_mutex;
+
+    // Bumped whenever a job is published; idle workers wait for it to change.
+    std::atomic<uint64_t> _epoch{0};
+    std::mutex _park_mutex;
+    std::condition_variable _park_cv;
+    size_t _parked = 0;
+    bool _stopping = false;
+};
+
+// The process-wide pool, created on first use.
+ThreadPool &threadPool();
+
+// Shorthands for kernels.
+inline size_t num_threads() {
+    return threadPool().numThreads();
+}
+
+template <typename F>
+void parallel_for(size_t n, size_t grain, const F &fn) {
+    threadPool().parallelFor(n, grain, fn);
+}
+} // namespace llaisys::device::cpu
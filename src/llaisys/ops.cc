@@ -3,19 +3,40 @@
 #include "llaisys_tensor.hpp"
 
 #include "../ops/add/op.hpp"
+#include "../ops/add_rms_norm/op.hpp"
 #include "../ops/argmax/op.hpp"
 #include "../ops/embedding/op.hpp"
 #include "../ops/linear/op.hpp"
+#include "../ops/quantize_rows/op.hpp"
 #include "../ops/rearrange/op.hpp"
 #include "../ops/rms_norm/op.hpp"
 #include "../ops/rope/op.hpp"
+#include "../ops/sample/op.hpp"
 #include "../ops/self_attention/op.hpp"
 #include "../ops/swiglu/op.hpp"
 
 __C {
+    typedef struct LlaisysLinearWeight {
+        llaisys::ops::linear_weight_t weight;
+    } LlaisysLinearWeight;
+
+    llaisysLinearWeight_t linearWeightCreate(llaisysTensor_t weight, llaisysLinearWeightFormat_t format, size_t group_size) {
+        return new LlaisysLinearWeight{llaisys::ops::LinearWeight::create(weight->tensor, format, group_size)};
+    }
+    llaisysLinearWeight_t linearWeightCreateGateUp(llaisysTensor_t gate, llaisysTensor_t up,
+                                                   llaisysLinearWeightFormat_t format, size_t group_size) {
+        return new LlaisysLinearWeight{llaisys::ops::LinearWeight::createGateUp(gate->tensor, up->tensor, format, group_size)};
+    }
+    void linearWeightDestroy(llaisysLinearWeight_t weight) {
+        delete weight;
+    }
+
     void llaisysAdd(llaisysTensor_t c, llaisysTensor_t a, llaisysTensor_t b) {
         llaisys::ops::add(c->tensor, a->tensor, b->tensor);
     }
+    void llaisysAddRmsNorm(llaisysTensor_t out_norm, llaisysTensor_t residual_inout, llaisysTensor_t x, llaisysTensor_t weight, float eps) {
+        llaisys::ops::add_rms_norm(out_norm->tensor, residual_inout->tensor, x->tensor, weight->tensor, eps);
+    }
     void llaisysArgmax(llaisysTensor_t max_idx, llaisysTensor_t max_val, llaisysTensor_t vals) {
         llaisys::ops::argmax(max_idx->tensor, max_val->tensor, vals->tensor);
     }
@@ -29,6 +50,29 @@ __C {
             llaisys::ops::linear(out->tensor, in->tensor, weight->tensor, bias->tensor);
         }
     }
+    void llaisysLinearPacked(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t weight, llaisysTensor_t bias) {
+        llaisys::ops::linear(out->tensor, in->tensor, weight->weight, bias ? bias->tensor : nullptr);
+    }
+    void llaisysLinearFused(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t weight, const LlaisysLinearEpilogue *epilogue) {
+        llaisys::ops::LinearEpilogue ep;
+        if (epilogue) {
+            ep.bias = epilogue->bias ? epilogue->bias->tensor : nullptr;
+            ep.activation = epilogue->activation;
+            ep.rope_pos_ids = epilogue->rope_pos_ids ? epilogue->rope_pos_ids->tensor : nullptr;
+            ep.rope_cols = epilogue->rope_cols;
+            ep.rope_head_dim = epilogue->rope_head_dim;
+            ep.rope_theta = epilogue->rope_theta;
+            ep.residual = epilogue->residual ? epilogue->residual->tensor : nullptr;
+        }
+        llaisys::ops::linear(out->tensor, in->tensor, weight->weight, ep);
+    }
+    void llaisysLinearSwiGLU(llaisysTensor_t out, llaisysTensor_t in, llaisysLinearWeight_t gate_up) {
+        llaisys::ops::linear_swiglu(out->tensor, in->tensor, gate_up->weight);
+    }
+    void llaisysLinearTopK(llaisysTensor_t indices, llaisysTensor_t values, llaisysTensor_t in, llaisysLinearWeight_t weight,
+                           float temperature, uint64_t seed) {
+        llaisys::ops::linear_topk(indices->tensor, values->tensor, in->tensor, weight->weight, temperature, seed);
+    }
     void llaisysRearrange(llaisysTensor_t out, llaisysTensor_t in) {
         llaisys::ops::rearrange(out->tensor, in->tensor);
     }
@@ -41,6 +85,28 @@ __C {
     void llaisysSelfAttention(llaisysTensor_t attn_val, llaisysTensor_t q, llaisysTensor_t k, llaisysTensor_t v, float scale) {
         llaisys::ops::self_attention(attn_val->tensor, q->tensor, k->tensor, v->tensor, scale);
     }
+    void llaisysSelfAttentionPaged(llaisysTensor_t attn_val, llaisysTensor_t q, llaisysTensor_t k_blocks, llaisysTensor_t v_blocks,
+                                   llaisysTensor_t k_scales, llaisysTensor_t v_scales,
+                                   llaisysTensor_t block_table, size_t kvlen, float scale) {
+        llaisys::ops::self_attention_paged(attn_val->tensor, q->tensor, k_blocks->tensor, v_blocks->tensor,
+                                           k_scales ? k_scales->tensor : nullptr, v_scales ? v_scales->tensor : nullptr,
+                                           block_table->tensor, kvlen, scale);
+    }
+    void llaisysQuantizeRows(llaisysTensor_t out, llaisysTensor_t scales, llaisysTensor_t in) {
+        llaisys::ops::quantize_rows(out->tensor, scales->tensor, in->tensor);
+    }
+    void llaisysSample(llaisysTensor_t out_idx, llaisysTensor_t logits, llaisysTensor_t history,
+                       const LlaisysSamplingParams *params, uint64_t *rng_state) {
+        llaisys::ops::SamplingParams p;
+        if (params) {
+            p.temperature = params->temperature;
+            p.top_k = params->top_k;
+            p.top_p = params->top_p;
+            p.min_p = params->min_p;
+            p.repetition_penalty = params->repetition_penalty;
+        }
+        llaisys::ops::sample(out_idx->tensor, logits->tensor, history ? history->tensor : nullptr, p, rng_state);
+    }
     void llaisysSwiGLU(llaisysTensor_t out, llaisysTensor_t gate, llaisysTensor_t up) {
         llaisys::ops::swiglu(out->tensor, gate->tensor, up->tensor);
     }
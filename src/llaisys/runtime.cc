@@ -1,6 +1,8 @@
 #include "llaisys/runtime.h"
 #include "../core/context/context.hpp"
+#include "../device/cpu/thread_pool.hpp"
 #include "../device/runtime_api.hpp"
+#include "../utils.hpp"
 
 // Llaisys API for setting context runtime.
 __C void llaisysSetContextRuntime(llaisysDeviceType_t device_type, int device_id) {
@@ -10,4 +12,14 @@ __C void llaisysSetContextRuntime(llaisysDeviceType_t device_type, int device_id
 // Llaisys API for getting the runtime APIs
 __C const LlaisysRuntimeAPI *llaisysGetRuntimeAPI(llaisysDeviceType_t device_type) {
     return llaisys::device::getRuntimeAPI(device_type);
-}
\ No newline at end of file
+}
+
+// Llaisys API for sizing the CPU thread pool
+__C void llaisysSetNumThreads(int nthreads) {
+    CHECK_ARGUMENT(nthreads >= 0, "number of threads must be non-negative");
+    llaisys::device::cpu::threadPool().setNumThreads(static_cast<size_t>(nthreads));
+}
+
+__C int llaisysGetNumThreads() {
+    return static_cast<int>(llaisys::device::cpu::threadPool().numThreads());
+}
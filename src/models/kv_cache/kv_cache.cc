@@ -0,0 +1,316 @@
+#include "kv_cache.hpp"
+
+#include "../../utils.hpp"
+
+namespace llaisys::models {
+KVCache::KVCache(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype, size_t block_size, size_t nblocks,
+                 llaisysDeviceType_t device, int device_id)
+    : _nlayer(nlayer), _nkvh(nkvh), _dh(dh), _dtype(dtype), _block_size(block_size), _nblocks(nblocks) {
+    size_t block_shape[4] = {nblocks, block_size, nkvh, dh};
+    size_t row_shape[3] = {nblocks * block_size, nkvh, dh};
+    for (size_t i = 0; i < nlayer; i++) {
+        _k_blocks.push_back(tensorCreate(block_shape, 4, dtype, device, device_id));
+        _v_blocks.push_back(tensorCreate(block_shape, 4, dtype, device, device_id));
+        _k_rows.push_back(tensorView(_k_blocks.back(), row_shape, 3));
+        _v_rows.push_back(tensorView(_v_blocks.back(), row_shape, 3));
+    }
+    if (quantized()) {
+        size_t scale_shape[3] = {nblocks, block_size, nkvh};
+        size_t scale_row_shape[2] = {nblocks * block_size, nkvh};
+        for (size_t i = 0; i < nlayer; i++) {
+            _k_scales.push_back(tensorCreate(scale_shape, 3, LLAISYS_DTYPE_F32, device, device_id));
+            _v_scales.push_back(tensorCreate(scale_shape, 3, LLAISYS_DTYPE_F32, device, device_id));
+            _k_scale_rows.push_back(tensorView(_k_scales.back(), scale_row_shape, 2));
+            _v_scale_rows.push_back(tensorView(_v_scales.back(), scale_row_shape, 2));
+        }
+    }
+    _refs.assign(nblocks, 0);
+    _node_of_block.assign(nblocks, nullptr);
+    _free_blocks.reserve(nblocks);
+    for (size_t b = nblocks; b > 0; b--) {
+        _free_blocks.push_back(static_cast<int64_t>(b - 1));
+    }
+}
+
+kv_cache_t KVCache::create(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype, size_t block_size,
+                           size_t nblocks, llaisysDeviceType_t device, int device_id) {
+    CHECK_ARGUMENT(nlayer > 0 && nkvh > 0 && dh > 0, "KVCache: empty layer shape");
+    CHECK_ARGUMENT(block_size > 0 && nblocks > 0, "KVCache: empty block pool");
+    return kv_cache_t(new KVCache(nlayer, nkvh, dh, dtype, block_size, nblocks, device, device_id));
+}
+
+KVCache::~KVCache() {
+    for (auto *tensors : {&_k_rows, &_v_rows, &_k_blocks, &_v_blocks,
+                          &_k_scale_rows, &_v_scale_rows, &_k_scales, &_v_scales}) {
+        for (llaisysTensor_t t : *tensors) {
+            tensorDestroy(t);
+        }
+    }
+}
+
+KVCache::Sequence &KVCache::sequence(int64_t seq) {
+    auto it = _sequences.find(seq);
+    CHECK_ARGUMENT(it != _sequences.end(), "KVCache: unknown sequence");
+    return it->second;
+}
+
+const KVCache::Sequence &KVCache::sequence(int64_t seq) const {
+    auto it = _sequences.find(seq);
+    CHECK_ARGUMENT(it != _sequences.end(), "KVCache: unknown sequence");
+    return it->second;
+}
+
+void KVCache::ref(int64_t block) {
+    if (_refs[block]++ == 0 && _node_of_block[block]) {
+        Node *node = _node_of_block[block];
+        _evictable.erase({node->last_used, node});
+        _num_idle--;
+    }
+}
+
+void KVCache::unref(int64_t block) {
+    ASSERT(_refs[block] > 0, "KVCache: block released more often than taken");
+    if (--_refs[block] > 0) {
+        return;
+    }
+    Node *node = _node_of_block[block];
+    if (!node) {
+        _free_blocks.push_back(block);
+        return;
+    }
+    node->last_used = ++_clock;
+    if (node->children.empty()) {
+        _evictable.emplace(node->last_used, node);
+    }
+    _num_idle++;
+}
+
+bool KVCache::evictOne() {
+    if (_evictable.empty()) {
+        return false;
+    }
+    Node *node = _evictable.begin()->second;
+    _evictable.erase(_evictable.begin());
+    _num_idle--;
+    int64_t block = node->block;
+    _node_of_block[block] = nullptr;
+    _free_blocks.push_back(block);
+    // Referenced blocks always have referenced parents, so an idle parent is left idle and may
+    // now be a leaf
+    Node *parent = node->parent;
+    for (auto it = parent->children.begin(); it != parent->children.end(); ++it) {
+        if (it->second.get() == node) {
+            parent->children.erase(it);
+            break;
+        }
+    }
+    if (parent != &_root && parent->children.empty() && _refs[parent->block] == 0) {
+        _evictable.emplace(parent->last_used, parent);
+    }
+    return true;
+}
+
+size_t KVCache::nlayer() const {
+    return _nlayer;
+}
+
+size_t KVCache::nkvh() const {
+    return _nkvh;
+}
+
+size_t KVCache::dh() const {
+    return _dh;
+}
+
+llaisysDataType_t KVCache::dtype() const {
+    return _dtype;
+}
+
+size_t KVCache::blockSize() const {
+    return _block_size;
+}
+
+size_t KVCache::numBlocks() const {
+    return _nblocks;
+}
+
+size_t KVCache::numFreeBlocks() const {
+    return _free_blocks.size() + _num_idle;
+}
+
+size_t KVCache::numCachedBlocks() const {
+    return _num_idle;
+}
+
+bool KVCache::quantized() const {
+    return _dtype == LLAISYS_DTYPE_I8 || utils::is_fp8(_dtype);
+}
+
+int64_t KVCache::addSequence() {
+    int64_t seq = _next_seq++;
+    Sequence s;
+    s.tail = &_root;
+    _sequences.emplace(seq, std::move(s));
+    return seq;
+}
+
+void KVCache::freeSequence(int64_t seq) {
+    Sequence &s = sequence(seq);
+    // Reversed so that the lowest blocks are handed out again first
+    for (auto it = s.blocks.rbegin(); it != s.blocks.rend(); ++it) {
+        unref(*it);
+    }
+    _sequences.erase(seq);
+}
+
+bool KVCache::hasSequence(int64_t seq) const {
+    return _sequences.count(seq) != 0;
+}
+
+size_t KVCache::length(int64_t seq) const {
+    return sequence(seq).length;
+}
+
+size_t KVCache::matchPrefix(int64_t seq, const int64_t *tokens, size_t n) {
+    Sequence &s = sequence(seq);
+    CHECK_ARGUMENT(s.length == 0 && s.blocks.empty(), "KVCache: prefix matched into a non-empty sequence");
+    Node *node = &_root;
+    size_t matched = 0;
+    while (matched + _block_size < n) {
+        auto it = node->children.find(std::vector<int64_t>(tokens + matched, tokens + matched + _block_size));
+        if (it == node->children.end()) {
+            break;
+        }
+        node = it->second.get();
+        ref(node->block);
+        s.blocks.push_back(node->block);
+        matched += _block_size;
+    }
+    s.tokens.assign(tokens, tokens + matched);
+    s.length = matched;
+    s.tail = node;
+    return matched;
+}
+
+size_t KVCache::blocksNeeded(int64_t seq, size_t n) const {
+    const Sequence &s = sequence(seq);
+    size_t needed = (s.length + n + _block_size - 1) / _block_size;
+    return needed > s.blocks.size() ? needed - s.blocks.size() : 0;
+}
+
+bool KVCache::reserve(int64_t seq, size_t n) {
+    Sequence &s = sequence(seq);
+    size_t needed = (s.length + n + _block_size - 1) / _block_size;
+    if (needed <= s.blocks.size()) {
+        return true;
+    }
+    if (needed - s.blocks.size() > _free_blocks.size() + _num_idle) {
+        return false;
+    }
+    // Every idle cached block is reachable by evicting leaves first
+    while (needed - s.blocks.size() > _free_blocks.size()) {
+        evictOne();
+    }
+    while (s.blocks.size() < needed) {
+        s.blocks.push_back(_free_blocks.back());
+        _refs[s.blocks.back()] = 1;
+        _free_blocks.pop_back();
+    }
+    return true;
+}
+
+void KVCache::advance(int64_t seq, const int64_t *tokens, size_t n) {
+    Sequence &s = sequence(seq);
+    ASSERT(s.length + n <= s.blocks.size() * _block_size, "KVCache: advance past the reserved blocks");
+    s.tokens.insert(s.tokens.end(), tokens, tokens + n);
+    // Blocks before length / block_size are already in the tree
+    for (size_t b = s.length / _block_size; b < (s.length + n) / _block_size; b++) {
+        std::vector<int64_t> key(s.tokens.begin() + b * _block_size, s.tokens.begin() + (b + 1) * _block_size);
+        auto it = s.tail->children.find(key);
+        if (it != s.tail->children.end()) {
+            // Another sequence computed the same prefix first: share its block, drop ours
+            Node *node = it->second.get();
+            ref(node->block);
+            unref(s.blocks[b]);
+            s.blocks[b] = node->block;
+            s.tail = node;
+            continue;
+        }
+        auto node = std::make_unique<Node>();
+        node->block = s.blocks[b];
+        node->parent = s.tail;
+        _node_of_block[node->block] = node.get();
+        s.tail = s.tail->children.emplace(std::move(key), std::move(node)).first->second.get();
+    }
+    s.length += n;
+}
+
+const std::vector<int64_t> &KVCache::blockTable(int64_t seq) const {
+    return sequence(seq).blocks;
+}
+
+const std::vector<int64_t> &KVCache::tokens(int64_t seq) const {
+    return sequence(seq).tokens;
+}
+
+llaisysTensor_t KVCache::kBlocks(size_t layer) const {
+    return _k_blocks[layer];
+}
+
+llaisysTensor_t KVCache::vBlocks(size_t layer) const {
+    return _v_blocks[layer];
+}
+
+llaisysTensor_t KVCache::kRows(size_t layer) const {
+    return _k_rows[layer];
+}
+
+llaisysTensor_t KVCache::vRows(size_t layer) const {
+    return _v_rows[layer];
+}
+
+llaisysTensor_t KVCache::kScales(size_t layer) const {
+    return quantized() ? _k_scales[layer] : nullptr;
+}
+
+llaisysTensor_t KVCache::vScales(size_t layer) const {
+    return quantized() ? _v_scales[layer] : nullptr;
+}
+
+llaisysTensor_t KVCache::kScaleRows(size_t layer) const {
+    return quantized() ? _k_scale_rows[layer] : nullptr;
+}
+
+llaisysTensor_t KVCache::vScaleRows(size_t layer) const {
+    return quantized() ? _v_scale_rows[layer] : nullptr;
+}
+} // namespace llaisys::models
+
+__C {
+    llaisysKVCache_t kvCacheCreate(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype,
+                                   size_t block_size, size_t nblocks,
+                                   llaisysDeviceType_t device, int device_id) {
+        return new LlaisysKVCache{llaisys::models::KVCache::create(nlayer, nkvh, dh, dtype, block_size, nblocks, device, device_id)};
+    }
+    void kvCacheDestroy(llaisysKVCache_t cache) {
+        delete cache;
+    }
+    int64_t kvCacheAddSequence(llaisysKVCache_t cache) {
+        return cache->cache->addSequence();
+    }
+    void kvCacheFreeSequence(llaisysKVCache_t cache, int64_t seq) {
+        cache->cache->freeSequence(seq);
+    }
+    size_t kvCacheSequenceLength(llaisysKVCache_t cache, int64_t seq) {
+        return cache->cache->length(seq);
+    }
+    size_t kvCacheNumFreeBlocks(llaisysKVCache_t cache) {
+        return cache->cache->numFreeBlocks();
+    }
+    size_t kvCacheNumCachedBlocks(llaisysKVCache_t cache) {
+        return cache->cache->numCachedBlocks();
+    }
+    size_t kvCacheMatchPrefix(llaisysKVCache_t cache, int64_t seq, const int64_t *token_ids, size_t ntoken) {
+        return cache->cache->matchPrefix(seq, token_ids, ntoken);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "llaisys/models/kv_cache.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace llaisys::models {
+class KVCache;
+using kv_cache_t = std::shared_ptr<KVCache>;
+
+// Block pool and per-sequence block tables of a paged KV cache (see llaisys/models/kv_cache.h).
+// The pools are tensors of the C API so that the models can slice them and hand them to the ops.
+//
+// Full blocks are also kept in a radix tree keyed by their tokens: the path from the root to a
+// node spells the token prefix whose K/V the node's block holds. Blocks are reference counted
+// by the sequences using them; an unreferenced block that is in the tree stays cached and is
+// only evicted, least recently used leaf first, when the free list runs out.
+class KVCache {
+private:
+    struct Node {
+        int64_t block = -1; // -1 for the root
+        Node *parent = nullptr;
+        std::map<std::vector<int64_t>, std::unique_ptr<Node>> children; // keyed by the block's tokens
+        uint64_t last_used = 0;
+    };
+
+    struct Sequence {
+        std::vector<int64_t> blocks; // block table
+        size_t length = 0;           // positions written
+        std::vector<int64_t> tokens; // token of every written position
+        Node *tail = nullptr;        // tree node of the last full block (the root if none)
+    };
+
+    size_t _nlayer;
+    size_t _nkvh;
+    size_t _dh;
+    llaisysDataType_t _dtype;
+    size_t _block_size;
+    size_t _nblocks;
+    std::vector<llaisysTensor_t> _k_blocks; // [nblocks, block_size, nkvh, dh] per layer
+    std::vector<llaisysTensor_t> _v_blocks;
+    std::vector<llaisysTensor_t> _k_rows; // the same storage as [nblocks * block_size, nkvh, dh]
+    std::vector<llaisysTensor_t> _v_rows;
+    // Quantized (I8 / FP8) pools only: one fp32 scale per row of dh values
+    std::vector<llaisysTensor_t> _k_scales; // [nblocks, block_size, nkvh] per layer
+    std::vector<llaisysTensor_t> _v_scales;
+    std::vector<llaisysTensor_t> _k_scale_rows; // the same storage as [nblocks * block_size, nkvh]
+    std::vector<llaisysTensor_t> _v_scale_rows;
+    std::vector<int64_t> _free_blocks; // popped from the back, lowest index first
+    std::unordered_map<int64_t, Sequence> _sequences;
+    int64_t _next_seq = 0;
+
+    std::vector<int> _refs;             // sequences using each block
+    Node _root;
+    std::vector<Node *> _node_of_block; // tree node holding each block, or null
+    std::set<std::pair<uint64_t, Node *>> _evictable; // unreferenced leaves by last use
+    size_t _num_idle = 0;               // unreferenced blocks in the tree
+    uint64_t _clock = 0;
+
+    KVCache(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype, size_t block_size, size_t nblocks,
+            llaisysDeviceType_t device, int device_id);
+    Sequence &sequence(int64_t seq);
+    const Sequence &sequence(int64_t seq) const;
+    void ref(int64_t block);
+    void unref(int64_t block);
+    bool evictOne();
+
+public:
+    static kv_cache_t create(size_t nlayer, size_t nkvh, size_t dh, llaisysDataType_t dtype, size_t block_size,
+                             size_t nblocks, llaisysDeviceType_t device, int device_id);
+    ~KVCache();
+    KVCache(const KVCache &) = delete;
+    KVCache &operator=(const KVCache &) = delete;
+
+    size_t nlayer() const;
+    size_t nkvh() const;
+    size_t dh() const;
+    llaisysDataType_t dtype() const;
+    size_t blockSize() const;
+    size_t numBlocks() const;
+    // Blocks not used by any sequence: free, or cached for their prefix but evictable
+    size_t numFreeBlocks() const;
+    // Unused blocks that still hold a cached prefix
+    size_t numCachedBlocks() const;
+    // Whether rows are stored quantized with per-row scales (I8 or FP8 dtype)
+    bool quantized() const;
+
+    int64_t addSequence();
+    void freeSequence(int64_t seq);
+    bool hasSequence(int64_t seq) const;
+    size_t length(int64_t seq) const;
+    // Attach the longest cached prefix of tokens[0, n) to the empty sequence, in whole blocks and
+    // leaving at least one token to run. Returns the number of positions reused.
+    size_t matchPrefix(int64_t seq, const int64_t *tokens, size_t n);
+    // Blocks that reserve(seq, n) has to take from the pool
+    size_t blocksNeeded(int64_t seq, size_t n) const;
+    // Take the blocks that `n` more positions of the sequence need. Returns false and leaves
+    // the sequence unchanged if the pool does not have them.
+    bool reserve(int64_t seq, size_t n);
+    // Count the n positions of `tokens` as written, after reserve(). Blocks filled by them enter
+    // the prefix tree; a block whose prefix is already cached is replaced by the cached one.
+    void advance(int64_t seq, const int64_t *tokens, size_t n);
+    const std::vector<int64_t> &blockTable(int64_t seq) const;
+    // Token of every written position of the sequence
+    const std::vector<int64_t> &tokens(int64_t seq) const;
+
+    llaisysTensor_t kBlocks(size_t layer) const;
+    llaisysTensor_t vBlocks(size_t layer) const;
+    llaisysTensor_t kRows(size_t layer) const;
+    llaisysTensor_t vRows(size_t layer) const;
+    // Scale pools of a quantized cache, null otherwise
+    llaisysTensor_t kScales(size_t layer) const;
+    llaisysTensor_t vScales(size_t layer) const;
+    llaisysTensor_t kScaleRows(size_t layer) const;
+    llaisysTensor_t vScaleRows(size_t layer) const;
+};
+} // namespace llaisys::models
+
+__C {
+    typedef struct LlaisysKVCache {
+        llaisys::models::kv_cache_t cache;
+    } LlaisysKVCache;
+}
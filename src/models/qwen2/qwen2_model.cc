@@ -1,12 +1,18 @@
 #include "llaisys/models/qwen2.h"
 #include "llaisys/ops.h"
-#include "../../utils/types.hpp"
+#include "../kv_cache/kv_cache.hpp"
+#include "../../device/cpu/thread_pool.hpp"
+#include "../../utils.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 
 
@@ -233,6 +239,24 @@ __C {
             free(model->weights->mlp_down_w);
         }
 
+        if (model->packed) {
+            linearWeightDestroy(model->packed->out_embed);
+            for (size_t i = 0; i < model->meta->nlayer; ++i) {
+                tensorDestroy(model->packed->attn_qkv_b[i]);
+            }
+            free(model->packed->attn_qkv_b);
+            llaisysLinearWeight_t *packed_arrays[] = {
+                model->packed->attn_qkv_w, model->packed->attn_o_w,
+                model->packed->mlp_gate_up_w, model->packed->mlp_down_w};
+            for (llaisysLinearWeight_t *arr : packed_arrays) {
+                for (size_t i = 0; i < model->meta->nlayer; ++i) {
+                    linearWeightDestroy(arr[i]);
+                }
+                free(arr);
+            }
+            free(model->packed);
+        }
+
         if (model->device_ids) {
             free(model->device_ids);
         }
@@ -248,243 +272,875 @@ __C {
         return model->weights;
     }
 
-    int64_t llaisysQwen2ModelInfer(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysTensor_t *kcache, llaisysTensor_t *vcache, size_t past_len) {
-        if (!model || !token_ids || ntoken == 0) return -1;
-
-        // If kv_cache != nullptr, it means KV Cache is used for performance.
-        bool kv_cache_used = (kcache != nullptr && vcache != nullptr);
-        // kcache [max_seq, nkvh, d], vcache [max_seq, nkvh, dv]
-
-        size_t seqlen = ntoken;
-        size_t hs = model->meta->hs;       // hidden size
-        size_t nh = model->meta->nh;       // num heads
-        size_t dh = model->meta->dh;       // head dim
-        size_t nkvh = model->meta->nkvh;   // num key-value heads
-        size_t di = model->meta->di;       // mlp intermediate dim
-        size_t voc = model->meta->voc;     // vocab size
-        size_t nlayer = model->meta->nlayer;
-        float scale = 1.0f / std::sqrt(static_cast<float>(dh)); // scale for attention
-        float rms_eps = model->meta->epsilon; // epsilon for RMSNorm
-        float rope_theta = model->meta->theta; // theta for RoPE
+    int llaisysQwen2ModelFinalize(struct LlaisysQwen2Model * model, llaisysLinearWeightFormat_t format, size_t group_size) {
+        if (!model) return -1;
+        if (model->packed) return 0;
+        // Packed layouts exist for the CPU kernels only; other devices keep the row-major weights
+        if (model->device != LLAISYS_DEVICE_CPU) {
+            if (format != LLAISYS_LINEAR_WEIGHT_PACKED) {
+                std::cerr << "Qwen2 finalize: weight format " << format << " requires the CPU device, keeping unpacked weights" << std::endl;
+                return -1;
+            }
+            return 0;
+        }
 
-        // 1. intput token_ids -> tensor
-        size_t input_tensor_shape[1] = {seqlen};
-        llaisysTensor_t input_tensor = tensorCreate(input_tensor_shape, 1, LLAISYS_DTYPE_I64, model->device, model->device_ids[0]);
-        tensorLoad(input_tensor, token_ids);
+        // Validate everything linearWeightCreate would reject before the first source weight is
+        // released, so a bad request leaves the model usable
+        bool q4 = format == LLAISYS_LINEAR_WEIGHT_Q4 || format == LLAISYS_LINEAR_WEIGHT_Q4_ZP;
+        if (!q4 && format != LLAISYS_LINEAR_WEIGHT_PACKED && format != LLAISYS_LINEAR_WEIGHT_Q8
+            && format != LLAISYS_LINEAR_WEIGHT_W8A8 && format != LLAISYS_LINEAR_WEIGHT_F8) {
+            std::cerr << "Qwen2 finalize: unknown weight format " << format << std::endl;
+            return -1;
+        }
+        if (q4 && group_size != 0 && group_size != 32 && group_size != 64 && group_size != 128) {
+            std::cerr << "Qwen2 finalize: 4-bit group size must be 32, 64 or 128, got " << group_size << std::endl;
+            return -1;
+        }
+        if (llaisys::utils::is_fp8(model->meta->dtype) && format != LLAISYS_LINEAR_WEIGHT_PACKED
+            && format != LLAISYS_LINEAR_WEIGHT_F8) {
+            std::cerr << "Qwen2 finalize: FP8 weights can only be packed" << std::endl;
+            return -1;
+        }
 
-        // 2. Embedding lookup: [seqlen] -> [seqlen, hs]
-        size_t output_embedding_tensor_shape[2] = {seqlen, hs};
-        llaisysTensor_t output_embedding_tensor = tensorCreate(output_embedding_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-        llaisysEmbedding(output_embedding_tensor, input_tensor, model->weights->in_embed);        
+        // All arrays are allocated before any weight is consumed
+        size_t nlayer = model->meta->nlayer;
+        auto packed = static_cast<LlaisysQwen2PackedWeights*>(std::calloc(1, sizeof(LlaisysQwen2PackedWeights)));
+        if (packed) {
+            packed->attn_qkv_w = static_cast<llaisysLinearWeight_t*>(std::calloc(nlayer, sizeof(llaisysLinearWeight_t)));
+            packed->attn_qkv_b = static_cast<llaisysTensor_t*>(std::calloc(nlayer, sizeof(llaisysTensor_t)));
+            packed->attn_o_w = static_cast<llaisysLinearWeight_t*>(std::calloc(nlayer, sizeof(llaisysLinearWeight_t)));
+            packed->mlp_gate_up_w = static_cast<llaisysLinearWeight_t*>(std::calloc(nlayer, sizeof(llaisysLinearWeight_t)));
+            packed->mlp_down_w = static_cast<llaisysLinearWeight_t*>(std::calloc(nlayer, sizeof(llaisysLinearWeight_t)));
+        }
+        if (!packed || !packed->attn_qkv_w || !packed->attn_qkv_b || !packed->attn_o_w || !packed->mlp_gate_up_w
+            || !packed->mlp_down_w) {
+            std::cerr << "Failed to allocate packed weights" << std::endl;
+            if (packed) {
+                free(packed->attn_qkv_w);
+                free(packed->attn_qkv_b);
+                free(packed->attn_o_w);
+                free(packed->mlp_gate_up_w);
+                free(packed->mlp_down_w);
+                free(packed);
+            }
+            return -1;
+        }
 
+        // Pack (and quantize) once, then release the row-major source so weights are not held twice
+        auto pack_as = [group_size](llaisysTensor_t &weight, llaisysLinearWeightFormat_t fmt) -> llaisysLinearWeight_t {
+            llaisysLinearWeight_t packed_weight = linearWeightCreate(weight, fmt, group_size);
+            tensorDestroy(weight);
+            weight = nullptr;
+            return packed_weight;
+        };
+        auto pack_layer_array = [&](llaisysLinearWeight_t *dst, llaisysTensor_t *src) {
+            for (size_t i = 0; i < nlayer; ++i) {
+                dst[i] = pack_as(src[i], format);
+            }
+        };
 
-        
-        // output_hidden_layer_tensor is used to store the output of the hidden layer
-        llaisysTensor_t output_hidden_layer_tensor = output_embedding_tensor;
-        size_t position_shape[1] = {seqlen};
-        llaisysTensor_t position_ids = tensorCreate(position_shape, 1, LLAISYS_DTYPE_I64, model->device, model->device_ids[0]);
-        int64_t* pos_data = (int64_t*)tensorGetData(position_ids);
-        for (size_t i = 0; i < seqlen; i++) {
-            if(kv_cache_used)
-                pos_data[i] = (int64_t)(past_len + i);  // When using KV cache, position ids continue from past_len
-            else
-                pos_data[i] = (int64_t) i;
-        }
-
-
-
-        // 3. Transformer hidden layers
-        for (size_t i = 0; i < nlayer; i++) {
-            // 3.1 LayerNorm before Self-attention
-            llaisysTensor_t attn_norm_w = model->weights->attn_norm_w[i];
-            size_t output_input_layernorm_shape[2] = {seqlen, hs};
-            llaisysTensor_t output_input_layernorm_tensor = tensorCreate(output_input_layernorm_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysRmsNorm(output_input_layernorm_tensor, output_hidden_layer_tensor, attn_norm_w, rms_eps);
-
-
-
-            // 3.2 Q projection
-            llaisysTensor_t attn_q_w = model->weights->attn_q_w[i];
-            llaisysTensor_t attn_q_b = model->weights->attn_q_b[i];
-            size_t q_tensor_shape[2] = {seqlen, nh * dh};
-            llaisysTensor_t q_tensor = tensorCreate(q_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(q_tensor, output_input_layernorm_tensor, attn_q_w, attn_q_b);
-
-            size_t q_tensor_reshape_shape[3] = {seqlen, nh, dh};
-            q_tensor = tensorReshape(q_tensor, q_tensor_reshape_shape, 3);
-            llaisysTensor_t q_rope_tensor = tensorCreate(q_tensor_reshape_shape, 3, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysROPE(q_rope_tensor, q_tensor, position_ids, rope_theta);
-
-
-
-            // 3.3 K projection
-            llaisysTensor_t attn_k_w = model->weights->attn_k_w[i];
-            llaisysTensor_t attn_k_b = model->weights->attn_k_b[i];
-            size_t k_tensor_shape[2] = {seqlen, nkvh * dh};
-            llaisysTensor_t k_tensor = tensorCreate(k_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(k_tensor, output_input_layernorm_tensor, attn_k_w, attn_k_b);
-
-            size_t k_tensor_reshape_shape[3] = {seqlen, nkvh, dh};
-            k_tensor = tensorReshape(k_tensor, k_tensor_reshape_shape, 3);
-            llaisysTensor_t k_rope_tensor; 
-            if (kv_cache_used) {
-                // When using KV cache, we need to update the kcache tensor
-                // kcache shape: [max_seq, nkvh, dh]
-                // Slice the kcache to get the current position to update
-                k_rope_tensor = tensorSlice(kcache[i], 0, past_len, past_len + seqlen); // Write to kcache
+        // 4 bits (and unscaled FP8, whose small weights fall into subnormals) are too coarse for
+        // the LM head logits, and quantizing the final hidden state would perturb them directly
+        llaisysLinearWeightFormat_t head_format = format;
+        if (q4 || format == LLAISYS_LINEAR_WEIGHT_F8) {
+            head_format = LLAISYS_LINEAR_WEIGHT_PACKED;
+        } else if (format == LLAISYS_LINEAR_WEIGHT_W8A8) {
+            head_format = LLAISYS_LINEAR_WEIGHT_Q8;
+        }
+        packed->out_embed = pack_as(model->weights->out_embed, head_format);
+
+        // Fuse Q/K/V: one projection reads the normalized input once. Rows (and bias entries)
+        // are concatenated in q, k, v order.
+        size_t q_dim = model->meta->nh * model->meta->dh;
+        size_t kv_dim = model->meta->nkvh * model->meta->dh;
+        size_t qkv_dim = q_dim + 2 * kv_dim;
+        auto concat_rows = [&](llaisysTensor_t *parts, size_t ndim) -> llaisysTensor_t {
+            size_t shape[2] = {qkv_dim, model->meta->hs};
+            llaisysTensor_t fused = tensorCreate(shape, ndim, model->meta->dtype, model->device, model->device_ids[0]);
+            size_t offset = 0;
+            for (size_t p = 0; p < 3; ++p) {
+                size_t rows = p == 0 ? q_dim : kv_dim;
+                llaisysTensor_t dst = tensorSlice(fused, 0, offset, offset + rows);
+                llaisysRearrange(dst, parts[p]);
+                tensorDestroy(dst);
+                offset += rows;
+            }
+            return fused;
+        };
+        for (size_t i = 0; i < nlayer; ++i) {
+            llaisysTensor_t weights[3] = {model->weights->attn_q_w[i], model->weights->attn_k_w[i], model->weights->attn_v_w[i]};
+            llaisysTensor_t biases[3] = {model->weights->attn_q_b[i], model->weights->attn_k_b[i], model->weights->attn_v_b[i]};
+            llaisysTensor_t fused = concat_rows(weights, 2);
+            packed->attn_qkv_w[i] = pack_as(fused, format);
+            packed->attn_qkv_b[i] = concat_rows(biases, 1);
+            for (llaisysTensor_t *src : {model->weights->attn_q_w, model->weights->attn_k_w, model->weights->attn_v_w}) {
+                tensorDestroy(src[i]);
+                src[i] = nullptr;
+            }
+        }
+        pack_layer_array(packed->attn_o_w, model->weights->attn_o_w);
+        // Gate/up interleaved so the SwiGLU is applied as the projection's epilogue
+        for (size_t i = 0; i < nlayer; ++i) {
+            packed->mlp_gate_up_w[i] = linearWeightCreateGateUp(model->weights->mlp_gate_w[i], model->weights->mlp_up_w[i], format, group_size);
+            for (llaisysTensor_t *src : {model->weights->mlp_gate_w, model->weights->mlp_up_w}) {
+                tensorDestroy(src[i]);
+                src[i] = nullptr;
+            }
+        }
+        pack_layer_array(packed->mlp_down_w, model->weights->mlp_down_w);
+
+        model->packed = packed;
+        return 0;
+    }
+}
+
+namespace {
+// Where a forward pass reads and appends K/V: nothing (recompute the whole sequence), the
+// contiguous per-layer kcache/vcache of llaisysQwen2ModelInfer, or sequences of a paged cache.
+// A paged step batches nseq sequences: seqs[s] appends the next ntokens[s] of token_ids.
+struct KVTarget {
+    llaisysTensor_t *kcache;
+    llaisysTensor_t *vcache;
+    size_t past_len;
+    llaisys::models::KVCache *paged;
+    const int64_t *seqs;
+    const size_t *ntokens;
+    size_t nseq;
+};
+
+// The per-step tensors of qwen2_forward over one sequence of a paged cache, allocated once per
+// request for up to `rows` tokens a step and a block table of up to `blocks` entries. A forward
+// pass uses the leading rows of each, so a generation loop does not allocate per step and layer.
+struct ForwardWorkspace {
+    size_t rows;
+    size_t blocks;
+    llaisysTensor_t input, positions, block_table;            // [rows] / [blocks] I64
+    llaisysTensor_t hidden, normed, o, down;                  // [rows, hs]
+    llaisysTensor_t qkv;                                      // [rows, (nh + 2 * nkvh) * dh]
+    llaisysTensor_t q_rope, attn;                             // [rows, nh, dh]
+    llaisysTensor_t k_rope;                                   // [rows, nkvh, dh]
+    llaisysTensor_t swiglu;                                   // [rows, di]
+    llaisysTensor_t head;                                     // [1, voc], the LM head output
+    llaisysTensor_t top_index, top_value;                     // [1, 1] I64 / F32
+    llaisysTensor_t index, value;                             // [1] I64 / dtype
+
+    ForwardWorkspace(const struct LlaisysQwen2Model *model, size_t rows, size_t blocks) : rows(rows), blocks(blocks) {
+        const LlaisysQwen2Meta &m = *model->meta;
+        auto create = [model](std::initializer_list<size_t> shape, llaisysDataType_t dtype) {
+            std::vector<size_t> dims(shape);
+            return tensorCreate(dims.data(), dims.size(), dtype, model->device, model->device_ids[0]);
+        };
+        input = create({rows}, LLAISYS_DTYPE_I64);
+        positions = create({rows}, LLAISYS_DTYPE_I64);
+        block_table = create({blocks}, LLAISYS_DTYPE_I64);
+        hidden = create({rows, m.hs}, m.dtype);
+        normed = create({rows, m.hs}, m.dtype);
+        o = create({rows, m.hs}, m.dtype);
+        down = create({rows, m.hs}, m.dtype);
+        qkv = create({rows, (m.nh + 2 * m.nkvh) * m.dh}, m.dtype);
+        q_rope = create({rows, m.nh, m.dh}, m.dtype);
+        attn = create({rows, m.nh, m.dh}, m.dtype);
+        k_rope = create({rows, m.nkvh, m.dh}, m.dtype);
+        swiglu = create({rows, m.di}, m.dtype);
+        head = create({1, m.voc}, m.dtype);
+        top_index = create({1, 1}, LLAISYS_DTYPE_I64);
+        top_value = create({1, 1}, LLAISYS_DTYPE_F32);
+        index = create({1}, LLAISYS_DTYPE_I64);
+        value = create({1}, m.dtype);
+    }
+    ForwardWorkspace(const ForwardWorkspace &) = delete;
+    ForwardWorkspace &operator=(const ForwardWorkspace &) = delete;
+    ~ForwardWorkspace() {
+        for (llaisysTensor_t t : {input, positions, block_table, hidden, normed, o, down, qkv, q_rope, attn, k_rope,
+                                  swiglu, head, top_index, top_value, index, value}) {
+            tensorDestroy(t);
+        }
+    }
+};
+
+// Writes the argmax after the last token of every sequence (one for the unpaged targets) to
+// next_tokens. If logits is given, its row j also receives the logits after token positions[j].
+// The final norm and the LM head only run on the rows these need. With neither (next_tokens
+// NULL, paged cache only), the pass just appends K/V: the last layer stops once it has written
+// them. A workspace (one paged sequence) provides the per-step tensors.
+void qwen2_forward(struct LlaisysQwen2Model *model, const int64_t *token_ids, size_t ntoken, const KVTarget &kv,
+                   int64_t *next_tokens, const size_t *positions = nullptr, size_t npos = 0,
+                   llaisysTensor_t logits = nullptr, ForwardWorkspace *ws = nullptr) {
+    llaisysTensor_t *kcache = kv.kcache;
+    llaisysTensor_t *vcache = kv.vcache;
+    size_t past_len = kv.past_len;
+
+    llaisysQwen2ModelFinalize(model, LLAISYS_LINEAR_WEIGHT_PACKED, 0);
+    // Projections go through the packed weights once finalized
+    LlaisysQwen2PackedWeights *packed = model->packed;
+    auto linear = [packed](llaisysTensor_t out, llaisysTensor_t in, llaisysTensor_t weight,
+                           llaisysLinearWeight_t *packed_weights, size_t layer, llaisysTensor_t bias) {
+        if (packed) {
+            llaisysLinearPacked(out, in, packed_weights[layer], bias);
+        } else {
+            llaisysLinear(out, in, weight, bias);
+        }
+    };
+
+    // out[:, col0 : col0 + rows(weight)] = in @ weight^T + bias, through a temporary
+    auto linear_into_columns = [&model](llaisysTensor_t out, size_t col0, llaisysTensor_t in,
+                                        llaisysTensor_t weight, llaisysTensor_t bias) {
+        size_t shape[2];
+        tensorGetShape(out, shape);
+        size_t cols;
+        tensorGetShape(weight, &cols);
+        size_t tmp_shape[2] = {shape[0], cols};
+        llaisysTensor_t tmp = tensorCreate(tmp_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
+        llaisysLinear(tmp, in, weight, bias);
+        llaisysTensor_t dst = tensorSlice(out, 1, col0, col0 + cols);
+        llaisysRearrange(dst, tmp);
+        tensorDestroy(dst);
+        tensorDestroy(tmp);
+    };
+
+    // Independent ops of a layer share the CPU thread pool instead of running back to back;
+    // their own parallel loops are shared out to the remaining workers. Tasks must not create
+    // tensors (allocation goes through the calling thread's context).
+    bool on_cpu = model->device == LLAISYS_DEVICE_CPU;
+    auto run_concurrently = [on_cpu](size_t ntask, const std::function<void(size_t)> &task) {
+        if (on_cpu) {
+            llaisys::device::cpu::parallel_for(ntask, 1, [&task](size_t t0, size_t t1) {
+                for (size_t t = t0; t < t1; t++) {
+                    task(t);
+                }
+            });
+        } else {
+            for (size_t t = 0; t < ntask; t++) {
+                task(t);
+            }
+        }
+    };
+
+    // Per-step tensors: the leading rows of the workspace's when they fit, or new ones. Either
+    // is released with tensorDestroy.
+    ASSERT(!ws || (kv.paged && kv.nseq == 1), "Qwen2: a workspace serves one paged sequence");
+    auto scratch = [&](llaisysTensor_t ForwardWorkspace::*buffer, const size_t *shape, size_t ndim,
+                       llaisysDataType_t dtype) {
+        size_t ws_shape[3] = {0, 0, 0};
+        if (ws) {
+            tensorGetShape(ws->*buffer, ws_shape);
+        }
+        if (ws && shape[0] <= ws_shape[0]) {
+            return tensorSlice(ws->*buffer, 0, 0, shape[0]);
+        }
+        return tensorCreate(const_cast<size_t *>(shape), ndim, dtype, model->device, model->device_ids[0]);
+    };
+
+    // If kv_cache != nullptr, it means KV Cache is used for performance.
+    bool paged = kv.paged != nullptr;
+    bool kv_cache_used = paged || (kcache != nullptr && vcache != nullptr);
+    // kcache [max_seq, nkvh, d], vcache [max_seq, nkvh, dv]
+    // The cache may be stored in FP8 to halve its footprint; new K/V rows are then converted on write
+    bool kv_cache_cast = kv_cache_used && !paged && tensorGetDataType(kcache[0]) != model->meta->dtype;
+
+    size_t seqlen = ntoken;
+    size_t hs = model->meta->hs;       // hidden size
+    size_t nh = model->meta->nh;       // num heads
+    size_t dh = model->meta->dh;       // head dim
+    size_t nkvh = model->meta->nkvh;   // num key-value heads
+    size_t di = model->meta->di;       // mlp intermediate dim
+    size_t voc = model->meta->voc;     // vocab size
+    size_t nlayer = model->meta->nlayer;
+    float scale = 1.0f / std::sqrt(static_cast<float>(dh)); // scale for attention
+    float rms_eps = model->meta->epsilon; // epsilon for RMSNorm
+    float rope_theta = model->meta->theta; // theta for RoPE
+
+    // The rows of token_ids each sequence owns: one segment, or one per sequence of a paged step
+    struct Segment {
+        size_t begin, len, past_len;
+        llaisysTensor_t block_table;
+    };
+    std::vector<Segment> segments;
+    if (!paged) {
+        segments.push_back({0, ntoken, kv_cache_used ? past_len : 0, nullptr});
+    }
+    // Paged cache: the block table of every sequence, and the runs of new positions that are
+    // contiguous in the pool rows (one per block touched), shared by all layers
+    struct RowRun {
+        size_t src, dst, len;
+    };
+    std::vector<RowRun> row_runs;
+    for (size_t s = 0, begin = 0; paged && s < kv.nseq; begin += kv.ntokens[s++]) {
+        const std::vector<int64_t> &table = kv.paged->blockTable(kv.seqs[s]);
+        size_t table_shape[1] = {table.size()};
+        llaisysTensor_t block_table = scratch(&ForwardWorkspace::block_table, table_shape, 1, LLAISYS_DTYPE_I64);
+        tensorLoad(block_table, table.data());
+        size_t past = kv.paged->length(kv.seqs[s]);
+        segments.push_back({begin, kv.ntokens[s], past, block_table});
+        size_t block_size = kv.paged->blockSize();
+        for (size_t p = past; p < past + kv.ntokens[s];) {
+            size_t off = p % block_size;
+            size_t len = std::min(block_size - off, past + kv.ntokens[s] - p);
+            row_runs.push_back({begin + p - past, static_cast<size_t>(table[p / block_size]) * block_size + off, len});
+            p += len;
+        }
+    }
+    // rows[run.dst ...] = src[run.src ...], converting to the cache dtype, or quantizing with
+    // the per-row scales written to scale_rows for a quantized cache
+    auto write_paged = [&row_runs](llaisysTensor_t rows, llaisysTensor_t scale_rows, llaisysTensor_t src) {
+        for (const RowRun &run : row_runs) {
+            llaisysTensor_t dst_rows = tensorSlice(rows, 0, run.dst, run.dst + run.len);
+            llaisysTensor_t src_rows = tensorSlice(src, 0, run.src, run.src + run.len);
+            if (scale_rows) {
+                llaisysTensor_t dst_scales = tensorSlice(scale_rows, 0, run.dst, run.dst + run.len);
+                llaisysQuantizeRows(dst_rows, dst_scales, src_rows);
+                tensorDestroy(dst_scales);
             } else {
-                k_rope_tensor = tensorCreate(k_tensor_reshape_shape, 3, model->meta->dtype, model->device, model->device_ids[0]);
+                llaisysRearrange(dst_rows, src_rows);
             }
-            llaisysROPE(k_rope_tensor, k_tensor, position_ids, rope_theta);
+            tensorDestroy(src_rows);
+            tensorDestroy(dst_rows);
+        }
+    };
+
+    // Rows of the sequence whose logits are computed, each once: the last token of every
+    // segment, then the requested positions. Consecutive rows are normed in one run.
+    std::vector<size_t> logit_rows;
+    auto logit_slot = [&logit_rows](size_t row) {
+        size_t slot = std::find(logit_rows.begin(), logit_rows.end(), row) - logit_rows.begin();
+        if (slot == logit_rows.size()) {
+            logit_rows.push_back(row);
+        }
+        return slot;
+    };
+    std::vector<size_t> last_slots, position_slots;
+    for (size_t s = 0; next_tokens && s < segments.size(); s++) {
+        last_slots.push_back(logit_slot(segments[s].begin + segments[s].len - 1));
+    }
+    for (size_t j = 0; logits && j < npos; j++) {
+        position_slots.push_back(logit_slot(positions[j]));
+    }
+    std::vector<RowRun> logit_runs; // src: row of the sequence, dst: slot
+    for (size_t slot = 0; slot < logit_rows.size(); slot++) {
+        if (!logit_runs.empty() && logit_runs.back().src + logit_runs.back().len == logit_rows[slot]) {
+            logit_runs.back().len++;
+        } else {
+            logit_runs.push_back({logit_rows[slot], slot, 1});
+        }
+    }
+    size_t nlogit = logit_rows.size();
 
+    // 1. intput token_ids -> tensor
+    size_t input_tensor_shape[1] = {seqlen};
+    llaisysTensor_t input_tensor = scratch(&ForwardWorkspace::input, input_tensor_shape, 1, LLAISYS_DTYPE_I64);
+    tensorLoad(input_tensor, token_ids);
 
+    // 2. Embedding lookup: [seqlen] -> [seqlen, hs]
+    size_t output_embedding_tensor_shape[2] = {seqlen, hs};
+    llaisysTensor_t output_embedding_tensor = scratch(&ForwardWorkspace::hidden, output_embedding_tensor_shape, 2, model->meta->dtype);
+    llaisysEmbedding(output_embedding_tensor, input_tensor, model->weights->in_embed);        
 
-            // 3.4 V projection
-            llaisysTensor_t attn_v_w = model->weights->attn_v_w[i];
-            llaisysTensor_t attn_v_b = model->weights->attn_v_b[i];
-            size_t v_tensor_shape[2] = {seqlen, nkvh * dh};
-            llaisysTensor_t v_tensor;
-            if (kv_cache_used) {
-                // When using KV cache, we need to update the vcache tensor
-                // vcache shape: [max_seq, nkvh, dh]
-                // Slice the vcache to get the current position to update
-                v_tensor = tensorView(tensorSlice(vcache[i], 0, past_len, past_len + seqlen), v_tensor_shape, 2);
-            } else {
-                v_tensor = tensorCreate(v_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            }
-            llaisysLinear(v_tensor, output_input_layernorm_tensor, attn_v_w, attn_v_b);
+
+    
+    // output_hidden_layer_tensor is used to store the output of the hidden layer
+    llaisysTensor_t output_hidden_layer_tensor = output_embedding_tensor;
+    size_t position_shape[1] = {seqlen};
+    llaisysTensor_t position_ids = scratch(&ForwardWorkspace::positions, position_shape, 1, LLAISYS_DTYPE_I64);
+    int64_t* pos_data = (int64_t*)tensorGetData(position_ids);
+    for (const Segment &seg : segments) {
+        for (size_t i = 0; i < seg.len; i++) {
+            // When using KV cache, position ids continue from the cached length
+            pos_data[seg.begin + i] = (int64_t)(seg.past_len + i);
+        }
+    }
+
+
+
+    // 3. Transformer hidden layers
+    // output_hidden_layer_tensor is the residual stream, updated in place. Every RMSNorm after
+    // the first is fused with the residual add before it, all writing normed_tensor.
+    size_t normed_tensor_shape[2] = {seqlen, hs};
+    llaisysTensor_t normed_tensor = scratch(&ForwardWorkspace::normed, normed_tensor_shape, 2, model->meta->dtype);
+
+    // 3.1 LayerNorm before the first Self-attention
+    llaisysTensor_t first_norm_w = nlayer > 0 ? model->weights->attn_norm_w[0] : model->weights->out_norm_w;
+    llaisysRmsNorm(normed_tensor, output_hidden_layer_tensor, first_norm_w, rms_eps);
+
+    for (size_t i = 0; i < nlayer; i++) {
 
 
-            // 3.5 Self-attention
-            size_t output_self_attn_multihead_tensor_shape[3] = {seqlen, nh, dh};
-            llaisysTensor_t output_self_attn_tensor = tensorCreate(output_self_attn_multihead_tensor_shape, 3, model->meta->dtype, model->device, model->device_ids[0]);
-            
-            if (kv_cache_used) {
-                // Use KV cache to speed up inference
-                // kcache [max_seq, nkvh, d], vcache [max_seq, nkvh, dv]
-                k_rope_tensor = tensorSlice(kcache[i], 0, 0, past_len + seqlen);
-                v_tensor = tensorSlice(vcache[i], 0, 0, past_len + seqlen);
-                llaisysSelfAttention(output_self_attn_tensor, q_rope_tensor, k_rope_tensor, v_tensor, scale);
-            } else {
-                size_t v_tensor_reshape_shape[3] = {seqlen, nkvh, dh};
-                v_tensor = tensorReshape(v_tensor, v_tensor_reshape_shape, 3);
 
-                llaisysSelfAttention(output_self_attn_tensor, q_rope_tensor, k_rope_tensor, v_tensor, scale);
+        // 3.2-3.4 Fused Q/K/V projection: [seqlen, hs] -> [seqlen, nh + 2 * nkvh, dh]
+        size_t qkv_tensor_shape[2] = {seqlen, (nh + 2 * nkvh) * dh};
+        llaisysTensor_t qkv_tensor = scratch(&ForwardWorkspace::qkv, qkv_tensor_shape, 2, model->meta->dtype);
+        if (packed) {
+            llaisysLinearPacked(qkv_tensor, normed_tensor, packed->attn_qkv_w[i], packed->attn_qkv_b[i]);
+        } else {
+            // Unfinalized weights (non-CPU devices): project separately into the column blocks of qkv_tensor
+            linear_into_columns(qkv_tensor, 0, normed_tensor, model->weights->attn_q_w[i], model->weights->attn_q_b[i]);
+            linear_into_columns(qkv_tensor, nh * dh, normed_tensor, model->weights->attn_k_w[i], model->weights->attn_k_b[i]);
+            linear_into_columns(qkv_tensor, (nh + nkvh) * dh, normed_tensor, model->weights->attn_v_w[i], model->weights->attn_v_b[i]);
+        }
+        // q/k/v are strided views of the fused output, no copies
+        size_t qkv_heads_shape[3] = {seqlen, nh + 2 * nkvh, dh};
+        llaisysTensor_t qkv_heads = tensorView(qkv_tensor, qkv_heads_shape, 3);
+        llaisysTensor_t q_tensor = tensorSlice(qkv_heads, 1, 0, nh);
+        llaisysTensor_t k_tensor = tensorSlice(qkv_heads, 1, nh, nh + nkvh);
+        llaisysTensor_t v_tensor = tensorSlice(qkv_heads, 1, nh + nkvh, nh + 2 * nkvh);
+
+        // Q and K RoPE, run concurrently. K is rotated straight into the cache slice when the
+        // cache has the activation dtype.
+        size_t q_rope_shape[3] = {seqlen, nh, dh};
+        llaisysTensor_t q_rope_tensor = scratch(&ForwardWorkspace::q_rope, q_rope_shape, 3, model->meta->dtype);
+        size_t kv_shape[3] = {seqlen, nkvh, dh};
+        llaisysTensor_t k_rope_tensor;
+        if (kv_cache_used && !paged && !kv_cache_cast) {
+            // kcache shape: [max_seq, nkvh, dh], the slice of the current positions
+            k_rope_tensor = tensorSlice(kcache[i], 0, past_len, past_len + seqlen);
+        } else {
+            k_rope_tensor = scratch(&ForwardWorkspace::k_rope, kv_shape, 3, model->meta->dtype);
+        }
+        run_concurrently(2, [&](size_t t) {
+            if (t == 0) {
+                llaisysROPE(q_rope_tensor, q_tensor, position_ids, rope_theta);
+            } else {
+                llaisysROPE(k_rope_tensor, k_tensor, position_ids, rope_theta);
             }
-            size_t output_self_attn_tensor_shape[2] = {seqlen, nh * dh};
-            output_self_attn_tensor = tensorReshape(output_self_attn_tensor, output_self_attn_tensor_shape, 2);
+        });
+        if (paged) {
+            // Scatter the rotated rows into the blocks of the sequence
+            write_paged(kv.paged->kRows(i), kv.paged->kScaleRows(i), k_rope_tensor);
+            tensorDestroy(k_rope_tensor);
+        } else if (kv_cache_cast) {
+            // The cache is stored in another dtype (e.g. FP8): rotated in the activation dtype,
+            // then converted into the cache slice
+            llaisysTensor_t k_cache_slice = tensorSlice(kcache[i], 0, past_len, past_len + seqlen);
+            llaisysRearrange(k_cache_slice, k_rope_tensor);
+            tensorDestroy(k_cache_slice);
+            tensorDestroy(k_rope_tensor);
+        } else if (kv_cache_used) {
+            // The rotated rows are in the cache already
+            tensorDestroy(k_rope_tensor);
+        }
 
+        // V, written straight into the cache slice when there is one
+        if (paged) {
+            write_paged(kv.paged->vRows(i), kv.paged->vScaleRows(i), v_tensor);
+            tensorDestroy(v_tensor);
+        } else if (kv_cache_used) {
+            // vcache shape: [max_seq, nkvh, dh], converted on write if stored in another dtype
+            llaisysTensor_t v_cache_slice = tensorSlice(vcache[i], 0, past_len, past_len + seqlen);
+            llaisysRearrange(v_cache_slice, v_tensor);
+            tensorDestroy(v_cache_slice);
+            tensorDestroy(v_tensor);
+        } else {
+            // Self-attention reads contiguous V
+            llaisysTensor_t v_view = v_tensor;
+            v_tensor = tensorCreate(kv_shape, 3, model->meta->dtype, model->device, model->device_ids[0]);
+            llaisysRearrange(v_tensor, v_view);
+            tensorDestroy(v_view);
+        }
+        if (nlogit == 0 && i + 1 == nlayer) {
+            // No logits wanted: the rest of the last layer only feeds the LM head
+            tensorDestroy(q_tensor);
+            tensorDestroy(q_rope_tensor);
+            tensorDestroy(k_tensor);
+            tensorDestroy(qkv_heads);
+            tensorDestroy(qkv_tensor);
+            break;
+        }
 
-            // 3.6 Self-attention output projection
-            llaisysTensor_t attn_o_w = model->weights->attn_o_w[i];
-            size_t o_tensor_shape[2] = {seqlen, hs};
-            llaisysTensor_t o_tensor = tensorCreate(o_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(o_tensor, output_self_attn_tensor, attn_o_w, nullptr);
+
+        // 3.5 Self-attention
+        size_t output_self_attn_multihead_tensor_shape[3] = {seqlen, nh, dh};
+        llaisysTensor_t output_self_attn_tensor = scratch(&ForwardWorkspace::attn, output_self_attn_multihead_tensor_shape, 3, model->meta->dtype);
+        
+        if (paged) {
+            // Each sequence attends to its own blocks; the sequences of a step run concurrently
+            std::vector<llaisysTensor_t> q_segs, out_segs;
+            for (const Segment &seg : segments) {
+                bool whole = segments.size() == 1;
+                q_segs.push_back(whole ? q_rope_tensor : tensorSlice(q_rope_tensor, 0, seg.begin, seg.begin + seg.len));
+                out_segs.push_back(whole ? output_self_attn_tensor
+                                         : tensorSlice(output_self_attn_tensor, 0, seg.begin, seg.begin + seg.len));
+            }
+            run_concurrently(segments.size(), [&](size_t s) {
+                llaisysSelfAttentionPaged(out_segs[s], q_segs[s], kv.paged->kBlocks(i), kv.paged->vBlocks(i),
+                                          kv.paged->kScales(i), kv.paged->vScales(i), segments[s].block_table,
+                                          segments[s].past_len + segments[s].len, scale);
+            });
+            if (segments.size() > 1) {
+                for (size_t s = 0; s < segments.size(); s++) {
+                    tensorDestroy(q_segs[s]);
+                    tensorDestroy(out_segs[s]);
+                }
+            }
+        } else if (kv_cache_used) {
+            // Use KV cache to speed up inference
+            // kcache [max_seq, nkvh, d], vcache [max_seq, nkvh, dv]
+            llaisysTensor_t k_past = tensorSlice(kcache[i], 0, 0, past_len + seqlen);
+            llaisysTensor_t v_past = tensorSlice(vcache[i], 0, 0, past_len + seqlen);
+            llaisysSelfAttention(output_self_attn_tensor, q_rope_tensor, k_past, v_past, scale);
+            tensorDestroy(k_past);
+            tensorDestroy(v_past);
+        } else {
+            llaisysSelfAttention(output_self_attn_tensor, q_rope_tensor, k_rope_tensor, v_tensor, scale);
+        }
+        size_t output_self_attn_tensor_shape[2] = {seqlen, nh * dh};
+        llaisysTensor_t output_self_attn_heads = output_self_attn_tensor;
+        output_self_attn_tensor = tensorReshape(output_self_attn_heads, output_self_attn_tensor_shape, 2);
+        tensorDestroy(output_self_attn_heads);
 
 
+        // 3.6 Self-attention output projection
+        llaisysTensor_t attn_o_w = model->weights->attn_o_w[i];
+        size_t o_tensor_shape[2] = {seqlen, hs};
+        llaisysTensor_t o_tensor = scratch(&ForwardWorkspace::o, o_tensor_shape, 2, model->meta->dtype);
+        linear(o_tensor, output_self_attn_tensor, attn_o_w, packed ? packed->attn_o_w : nullptr, i, nullptr);
 
-            // 3.7 Residual connection after attn
-            size_t output_res1_tensor_shape[2] = {seqlen, hs};
-            llaisysTensor_t output_res1_tensor = tensorCreate(output_res1_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysAdd(output_res1_tensor, output_hidden_layer_tensor, o_tensor);
 
 
-            // 3.8 Post-attention LayerNorm
-            llaisysTensor_t post_attn_norm_w = model->weights->mlp_norm_w[i];
-            size_t output_post_self_attn_layernorm_tensor_shape[2] = {seqlen, hs};
-            llaisysTensor_t output_post_self_attn_layernorm_tensor = tensorCreate(output_post_self_attn_layernorm_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysRmsNorm(output_post_self_attn_layernorm_tensor, output_res1_tensor, post_attn_norm_w, rms_eps);
+        // 3.7-3.8 Residual connection after attn + Post-attention LayerNorm
+        llaisysAddRmsNorm(normed_tensor, output_hidden_layer_tensor, o_tensor, model->weights->mlp_norm_w[i], rms_eps);
 
 
-            // 3.9 MLP (Gate, Up, Down)
-            llaisysTensor_t mlp_gate_w = model->weights->mlp_gate_w[i];
-            llaisysTensor_t mlp_up_w = model->weights->mlp_up_w[i];
-            llaisysTensor_t mlp_down_w = model->weights->mlp_down_w[i];
+        // 3.9 MLP (Gate, Up, Down)
+        llaisysTensor_t mlp_down_w = model->weights->mlp_down_w[i];
 
+        size_t swiglu_tensor_shape[2] = {seqlen, di};
+        llaisysTensor_t swiglu_tensor = scratch(&ForwardWorkspace::swiglu, swiglu_tensor_shape, 2, model->meta->dtype);
+        if (packed) {
+            // Fused gate/up projection, SwiGLU applied to the finished tiles
+            llaisysLinearSwiGLU(swiglu_tensor, normed_tensor, packed->mlp_gate_up_w[i]);
+        } else {
             size_t mlp_gate_tensor_shape[2] = {seqlen, di};
             llaisysTensor_t mlp_gate_tensor = tensorCreate(mlp_gate_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(mlp_gate_tensor, output_post_self_attn_layernorm_tensor, mlp_gate_w, nullptr);
-
-
             size_t mlp_up_tensor_shape[2] = {seqlen, di};
             llaisysTensor_t mlp_up_tensor = tensorCreate(mlp_up_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(mlp_up_tensor, output_post_self_attn_layernorm_tensor, mlp_up_w, nullptr);
 
-
-            size_t swiglu_tensor_shape[2] = {seqlen, di};
-            llaisysTensor_t swiglu_tensor = tensorCreate(swiglu_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
+            llaisysLinear(mlp_gate_tensor, normed_tensor, model->weights->mlp_gate_w[i], nullptr);
+            llaisysLinear(mlp_up_tensor, normed_tensor, model->weights->mlp_up_w[i], nullptr);
             llaisysSwiGLU(swiglu_tensor, mlp_gate_tensor, mlp_up_tensor);
+            tensorDestroy(mlp_gate_tensor);
+            tensorDestroy(mlp_up_tensor);
+        }
 
 
-            size_t mlp_down_tensor_shape[2] = {seqlen, hs};
-            llaisysTensor_t mlp_down_tensor = tensorCreate(mlp_down_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-            llaisysLinear(mlp_down_tensor, swiglu_tensor, mlp_down_w, nullptr);
-
+        size_t mlp_down_tensor_shape[2] = {seqlen, hs};
+        llaisysTensor_t mlp_down_tensor = scratch(&ForwardWorkspace::down, mlp_down_tensor_shape, 2, model->meta->dtype);
+        linear(mlp_down_tensor, swiglu_tensor, mlp_down_w, packed ? packed->mlp_down_w : nullptr, i, nullptr);
 
 
-            // 3.10 Residual connection after MLP
-            llaisysAdd(output_hidden_layer_tensor, output_res1_tensor, mlp_down_tensor);
 
+        // 3.10 Residual connection after MLP + the next LayerNorm (next layer's 3.1, or 4.)
+        if (i + 1 < nlayer) {
+            llaisysAddRmsNorm(normed_tensor, output_hidden_layer_tensor, mlp_down_tensor, model->weights->attn_norm_w[i + 1], rms_eps);
+        } else {
+            // Only the rows that need logits, gathered into the first nlogit rows of normed_tensor
+            for (const RowRun &run : logit_runs) {
+                llaisysTensor_t dst = tensorSlice(normed_tensor, 0, run.dst, run.dst + run.len);
+                llaisysTensor_t residual = tensorSlice(output_hidden_layer_tensor, 0, run.src, run.src + run.len);
+                llaisysTensor_t x = tensorSlice(mlp_down_tensor, 0, run.src, run.src + run.len);
+                llaisysAddRmsNorm(dst, residual, x, model->weights->out_norm_w, rms_eps);
+                tensorDestroy(x);
+                tensorDestroy(residual);
+                tensorDestroy(dst);
+            }
+        }
 
 
 
 
-            if(!kv_cache_used){
-                tensorDestroy(k_rope_tensor);
-                tensorDestroy(v_tensor);
-            }
 
-            // release intermediate tensors
-            tensorDestroy(output_input_layernorm_tensor);
-            tensorDestroy(q_tensor);
-            tensorDestroy(q_rope_tensor);
-            tensorDestroy(k_tensor);
-            tensorDestroy(output_self_attn_tensor);
-            tensorDestroy(o_tensor);
-            tensorDestroy(output_res1_tensor);
-            tensorDestroy(output_post_self_attn_layernorm_tensor);
-            tensorDestroy(mlp_gate_tensor);
-            tensorDestroy(mlp_up_tensor);
-            tensorDestroy(swiglu_tensor);
-            tensorDestroy(mlp_down_tensor);
+        if(!kv_cache_used){
+            tensorDestroy(k_rope_tensor);
+            tensorDestroy(v_tensor);
         }
 
-        // 4. Output LayerNorm
-        llaisysTensor_t final_layernorm_w = model->weights->out_norm_w;
-        size_t output_final_layernorm_shape[2] = {seqlen, hs};
-        llaisysTensor_t output_final_layernorm_tensor = tensorCreate(output_final_layernorm_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-        llaisysRmsNorm(output_final_layernorm_tensor, output_hidden_layer_tensor, final_layernorm_w, rms_eps);
+        // release intermediate tensors
+        tensorDestroy(q_tensor);
+        tensorDestroy(q_rope_tensor);
+        tensorDestroy(k_tensor);
+        tensorDestroy(qkv_heads);
+        tensorDestroy(qkv_tensor);
+        tensorDestroy(output_self_attn_tensor);
+        tensorDestroy(o_tensor);
+        tensorDestroy(swiglu_tensor);
+        tensorDestroy(mlp_down_tensor);
+    }
 
+    // 4. Output LayerNorm: already in normed_tensor, fused into the last layer's 3.10
 
 
-        // 5. Output [seqlen, voc]
-        size_t output_tensor_shape[2] = {seqlen, voc};
-        llaisysTensor_t output_tensor = tensorCreate(output_tensor_shape, 2, model->meta->dtype, model->device, model->device_ids[0]);
-        llaisysLinear(output_tensor, output_final_layernorm_tensor, model->weights->out_embed, nullptr);
-    
 
+    // 5. Output [nlogit, voc], for the gathered rows only (none if only K/V were wanted)
+    llaisysTensor_t logit_input = tensorSlice(normed_tensor, 0, 0, nlogit);
+    if (nlogit == 1 && position_slots.empty() && packed) {
+        // A single row and no logits wanted (one decode step or prompt): fused LM head and argmax
+        // over vocabulary tiles, the [1, voc] logits are never written
+        size_t top_shape[2] = {1, 1};
+        llaisysTensor_t top_index = scratch(&ForwardWorkspace::top_index, top_shape, 2, LLAISYS_DTYPE_I64);
+        llaisysTensor_t top_value = scratch(&ForwardWorkspace::top_value, top_shape, 2, LLAISYS_DTYPE_F32);
+        llaisysLinearTopK(top_index, top_value, logit_input, packed->out_embed, 0.0f, 0);
+        next_tokens[0] = *((int64_t *) tensorGetData(top_index));
+        tensorDestroy(top_index);
+        tensorDestroy(top_value);
+    } else if (nlogit > 0) {
+        size_t output_tensor_shape[2] = {nlogit, voc};
+        llaisysTensor_t output_tensor = scratch(&ForwardWorkspace::head, output_tensor_shape, 2, model->meta->dtype);
+        linear(output_tensor, logit_input, model->weights->out_embed, packed ? &packed->out_embed : nullptr, 0, nullptr);
 
-        // [seqlen, voc] -> [1, voc]
+        // [nlogit, voc] -> [1, voc] per sequence: the logits after its last token
+        size_t index_shape[1] = {1};
+        llaisysTensor_t index_tensor = scratch(&ForwardWorkspace::index, index_shape, 1, LLAISYS_DTYPE_I64);
+        llaisysTensor_t value_tensor = scratch(&ForwardWorkspace::value, index_shape, 1, model->meta->dtype);
         size_t output_tensor_slice_reshape_shape[1] = {voc};
-        llaisysTensor_t output_tensor_slice = tensorSlice(output_tensor, 0, seqlen-1, seqlen); // only need the last token's logits
-
+        for (size_t s = 0; s < last_slots.size(); s++) {
+            llaisysTensor_t output_tensor_slice = tensorSlice(output_tensor, 0, last_slots[s], last_slots[s] + 1);
+            llaisysTensor_t last_logits = tensorView(output_tensor_slice, output_tensor_slice_reshape_shape, 1);
+            llaisysArgmax(index_tensor, value_tensor, last_logits);
+            next_tokens[s] = *((int64_t *) tensorGetData(index_tensor));
+            tensorDestroy(last_logits);
+            tensorDestroy(output_tensor_slice);
+        }
+        // Requested rows, converted to the dtype of the caller's tensor
+        for (size_t j = 0; j < position_slots.size(); j++) {
+            llaisysTensor_t src = tensorSlice(output_tensor, 0, position_slots[j], position_slots[j] + 1);
+            llaisysTensor_t dst = tensorSlice(logits, 0, j, j + 1);
+            llaisysRearrange(dst, src);
+            tensorDestroy(dst);
+            tensorDestroy(src);
+        }
+        tensorDestroy(output_tensor);
+        tensorDestroy(index_tensor);
+        tensorDestroy(value_tensor);
+    }
+    tensorDestroy(logit_input);
+
+    tensorDestroy(position_ids);
+    tensorDestroy(input_tensor);
+    tensorDestroy(output_embedding_tensor);
+    tensorDestroy(normed_tensor);
+    for (const Segment &seg : segments) {
+        if (seg.block_table) {
+            tensorDestroy(seg.block_table);
+        }
+    }
+}
+
+// One forward pass over sequences of a paged cache (see llaisysQwen2ModelStep); logits, the
+// NULL next_tokens mode and the workspace as in qwen2_forward
+int qwen2_paged_step(struct LlaisysQwen2Model *model, const int64_t *token_ids, const size_t *ntokens, const int64_t *seqs,
+                     size_t nseq, llaisysKVCache_t cache, int64_t *next_tokens, const size_t *positions, size_t npos,
+                     llaisysTensor_t logits, ForwardWorkspace *ws = nullptr) {
+    if (!model || !token_ids || !ntokens || !seqs || nseq == 0 || !cache) return LLAISYS_QWEN2_INVALID_ARGUMENT;
+    llaisys::models::KVCache &kv = *cache->cache;
+    if (kv.nlayer() != model->meta->nlayer || kv.nkvh() != model->meta->nkvh || kv.dh() != model->meta->dh) {
+        std::cerr << "KV cache shape does not match the Qwen2 model" << std::endl;
+        return LLAISYS_QWEN2_INVALID_ARGUMENT;
+    }
+    size_t ntoken = 0;
+    size_t needed = 0;
+    for (size_t s = 0; s < nseq; s++) {
+        if (!kv.hasSequence(seqs[s]) || ntokens[s] == 0 || std::find(seqs, seqs + s, seqs[s]) != seqs + s) {
+            std::cerr << "Every sequence of a step must exist, have tokens and appear once" << std::endl;
+            return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        }
+        ntoken += ntokens[s];
+        needed += kv.blocksNeeded(seqs[s], ntokens[s]);
+    }
+    // Take the blocks of the new positions up front so that a full pool fails before any work
+    if (needed > kv.numFreeBlocks()) {
+        std::cerr << "KV cache is out of blocks" << std::endl;
+        return LLAISYS_QWEN2_OUT_OF_BLOCKS;
+    }
+    // Cannot fail after the check. numFreeBlocks() counts the free list plus the idle cached
+    // blocks, and reserve() only evicts idle ones: a block referenced by a sequence (these
+    // included) is never idle, and every idle block is reachable by evicting leaves, since
+    // a referenced block's parents are referenced too. So the count is what reserve can take.
+    for (size_t s = 0; s < nseq; s++) {
+        kv.reserve(seqs[s], ntokens[s]);
+    }
+    qwen2_forward(model, token_ids, ntoken, KVTarget{nullptr, nullptr, 0, &kv, seqs, ntokens, nseq}, next_tokens,
+                  positions, npos, logits, ws);
+    for (size_t s = 0, begin = 0; s < nseq; begin += ntokens[s++]) {
+        kv.advance(seqs[s], token_ids + begin, ntokens[s]);
+    }
+    return 0;
+}
+
+// Tensors of sampled steps, created once per request and reused by each of its decode steps
+struct SampleBuffers {
+    struct LlaisysQwen2Model *model;
+    llaisysTensor_t logits = nullptr;  // [1, voc] F32
+    llaisysTensor_t row = nullptr;     // logits as [voc]
+    llaisysTensor_t index = nullptr;   // [1] I64
+    llaisysTensor_t history = nullptr; // tokens of the sequence, [capacity] I64
+    size_t capacity = 0;
+    size_t nhistory = 0;               // valid prefix of history
+
+    explicit SampleBuffers(struct LlaisysQwen2Model *model) : model(model) {}
+    SampleBuffers(const SampleBuffers &) = delete;
+    SampleBuffers &operator=(const SampleBuffers &) = delete;
+    ~SampleBuffers() {
+        for (llaisysTensor_t t : {row, logits, index, history}) {
+            if (t) {
+                tensorDestroy(t);
+            }
+        }
+    }
 
+    void ensure() {
+        if (logits) return;
+        size_t voc = model->meta->voc;
+        size_t logits_shape[2] = {1, voc};
+        logits = tensorCreate(logits_shape, 2, LLAISYS_DTYPE_F32, model->device, model->device_ids[0]);
+        size_t row_shape[1] = {voc};
+        row = tensorView(logits, row_shape, 1);
         size_t index_shape[1] = {1};
-        llaisysTensor_t index_tensor = tensorCreate(index_shape, 1, LLAISYS_DTYPE_I64, model->device, model->device_ids[0]);
-        llaisysTensor_t value_tensor = tensorCreate(index_shape, 1, model->meta->dtype, model->device, model->device_ids[0]);
-        llaisysArgmax(index_tensor, value_tensor, tensorView(output_tensor_slice, output_tensor_slice_reshape_shape, 1));
+        index = tensorCreate(index_shape, 1, LLAISYS_DTYPE_I64, model->device, model->device_ids[0]);
+    }
 
+    // history[0, n) = tokens[0, n); only the tokens added since the last call are copied, and
+    // the tensor grows geometrically
+    void syncHistory(const std::vector<int64_t> &tokens) {
+        if (tokens.size() > capacity) {
+            if (history) tensorDestroy(history);
+            capacity = std::max<size_t>(2 * tokens.size(), 256);
+            size_t shape[1] = {capacity};
+            history = tensorCreate(shape, 1, LLAISYS_DTYPE_I64, model->device, model->device_ids[0]);
+            nhistory = 0;
+        }
+        if (tokens.size() < nhistory) nhistory = 0;
+        std::memcpy(static_cast<int64_t *>(tensorGetData(history)) + nhistory, tokens.data() + nhistory,
+                    (tokens.size() - nhistory) * sizeof(int64_t));
+        nhistory = tokens.size();
+    }
+};
+
+// Run ntoken tokens of sequence `seq` and draw the next token with `params` (see
+// llaisysQwen2ModelInferPagedSample), through the reusable buffers and workspace. Returns the
+// token or a llaisysQwen2Status_t.
+int64_t qwen2_sample_step(struct LlaisysQwen2Model *model, int64_t *token_ids, size_t ntoken, llaisysKVCache_t cache,
+                          int64_t seq, const LlaisysSamplingParams *params, uint64_t *rng_state, SampleBuffers &buffers,
+                          ForwardWorkspace *ws = nullptr) {
+    int64_t next;
+    bool greedy = !params || ((params->temperature <= 0.0f || params->top_k == 1) && params->repetition_penalty == 1.0f);
+    if (greedy) {
+        int status = qwen2_paged_step(model, token_ids, &ntoken, &seq, 1, cache, &next, nullptr, 0, nullptr, ws);
+        return status != 0 ? status : next;
+    }
+    buffers.ensure();
+    size_t last = ntoken - 1;
+    int status = qwen2_paged_step(model, token_ids, &ntoken, &seq, 1, cache, &next, &last, 1, buffers.logits, ws);
+    if (status != 0) return status;
+
+    // The sequence now holds its new tokens as well, all of which the penalty sees
+    llaisysTensor_t history = nullptr;
+    if (params->repetition_penalty != 1.0f) {
+        buffers.syncHistory(cache->cache->tokens(seq));
+        history = tensorSlice(buffers.history, 0, 0, buffers.nhistory);
+    }
+    llaisysSample(buffers.index, buffers.row, history, params, rng_state);
+    if (history) tensorDestroy(history);
+    return *((int64_t *) tensorGetData(buffers.index));
+}
+} // namespace
 
-        int64_t index = *((int64_t *) tensorGetData(index_tensor));
+__C {
+    int64_t llaisysQwen2ModelInfer(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysTensor_t *kcache, llaisysTensor_t *vcache, size_t past_len) {
+        if (!model || !token_ids || ntoken == 0) return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        int64_t next;
+        qwen2_forward(model, token_ids, ntoken, KVTarget{kcache, vcache, past_len, nullptr, nullptr, nullptr, 0}, &next);
+        return next;
+    }
 
-        tensorDestroy(position_ids);
-        tensorDestroy(input_tensor);
-        tensorDestroy(output_embedding_tensor);
-        tensorDestroy(output_final_layernorm_tensor);
-        tensorDestroy(output_tensor);
-        tensorDestroy(index_tensor);
-        tensorDestroy(value_tensor);
+    int64_t llaisysQwen2ModelInferPaged(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq) {
+        int64_t next;
+        int status = llaisysQwen2ModelStep(model, token_ids, &ntoken, &seq, 1, cache, &next);
+        return status != 0 ? status : next;
+    }
+
+    int llaisysQwen2ModelStep(struct LlaisysQwen2Model * model, const int64_t * token_ids, const size_t * ntokens, const int64_t * seqs, size_t nseq, llaisysKVCache_t cache, int64_t * next_tokens) {
+        return qwen2_paged_step(model, token_ids, ntokens, seqs, nseq, cache, next_tokens, nullptr, 0, nullptr);
+    }
 
-        return index;
+    int64_t llaisysQwen2ModelInferPagedLogits(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq, const size_t * positions, size_t npos, llaisysTensor_t logits) {
+        if (!model || !token_ids || ntoken == 0 || !logits) return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        // Default: the logits after the last token
+        size_t last = ntoken - 1;
+        if (!positions) {
+            positions = &last;
+            npos = 1;
+        }
+        size_t shape[2] = {0, 0};
+        if (tensorGetNdim(logits) == 2) {
+            tensorGetShape(logits, shape);
+        }
+        if (npos == 0 || shape[0] != npos || shape[1] != model->meta->voc) {
+            std::cerr << "Logits tensor must be [npos, voc]" << std::endl;
+            return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        }
+        if (std::any_of(positions, positions + npos, [ntoken](size_t p) { return p >= ntoken; })) {
+            std::cerr << "Logit positions must index the new tokens" << std::endl;
+            return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        }
+        int64_t next;
+        int status = qwen2_paged_step(model, token_ids, &ntoken, &seq, 1, cache, &next, positions, npos, logits);
+        return status != 0 ? status : next;
+    }
+    int64_t llaisysQwen2ModelInferPagedSample(struct LlaisysQwen2Model * model, int64_t * token_ids, size_t ntoken, llaisysKVCache_t cache, int64_t seq, const LlaisysSamplingParams * params, uint64_t * rng_state) {
+        if (!model || !token_ids || ntoken == 0 || !cache) return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        SampleBuffers buffers(model);
+        return qwen2_sample_step(model, token_ids, ntoken, cache, seq, params, rng_state, buffers);
+    }
+
+    int64_t llaisysQwen2ModelGenerate(struct LlaisysQwen2Model * model, const int64_t * prompt, size_t nprompt, llaisysKVCache_t cache, const LlaisysQwen2GenerateParams * params, LlaisysQwen2TokenCallback callback, void * user_data) {
+        if (!model || !prompt || nprompt == 0 || !cache || !params) return LLAISYS_QWEN2_INVALID_ARGUMENT;
+        if (params->max_new_tokens == 0) return 0;
+        llaisys::models::KVCache &kv = *cache->cache;
+        // The sequence takes blocks as it grows and returns them when done, however it ends
+        struct SequenceGuard {
+            llaisys::models::KVCache &kv;
+            int64_t seq;
+            ~SequenceGuard() { kv.freeSequence(seq); }
+        } guard{kv, kv.addSequence()};
+        int64_t seq = guard.seq;
+
+        uint64_t rng_state = params->seed;
+        SampleBuffers buffers(model);
+        size_t chunk = params->prefill_chunk > 0 ? params->prefill_chunk : nprompt;
+        std::vector<int64_t> generated;
+        generated.reserve(params->max_new_tokens);
+
+        // Prefill the part of the prompt that is not cached. Chunks before the last only append
+        // their K/V; the last one is sampled from.
+        size_t begin = kv.matchPrefix(seq, prompt, nprompt);
+        // Activations for the largest step of the request, and the block table of its longest sequence
+        size_t max_blocks = (nprompt + params->max_new_tokens + kv.blockSize() - 1) / kv.blockSize();
+        ForwardWorkspace ws(model, std::min(chunk, nprompt - begin), max_blocks);
+        int64_t next = -1;
+        for (; begin < nprompt; begin += chunk) {
+            size_t n = std::min(chunk, nprompt - begin);
+            int64_t *tokens = const_cast<int64_t *>(prompt + begin);
+            if (begin + n < nprompt) {
+                int status = qwen2_paged_step(model, tokens, &n, &seq, 1, cache, nullptr, nullptr, 0, nullptr, &ws);
+                if (status != 0) return status;
+                continue;
+            }
+            next = qwen2_sample_step(model, tokens, n, cache, seq, &params->sampling, &rng_state, buffers, &ws);
+            if (next < 0) return next;
+        }
+
+        while (true) {
+            generated.push_back(next);
+            bool stop = next == model->meta->end_token
+                     || std::find(params->stop_tokens, params->stop_tokens + params->nstop_tokens, next) != params->stop_tokens + params->nstop_tokens;
+            for (size_t i = 0, offset = 0; !stop && i < params->nstop_sequences; offset += params->stop_sequence_lens[i++]) {
+                size_t len = params->stop_sequence_lens[i];
+                stop = len > 0 && len <= generated.size()
+                    && std::equal(params->stop_sequences + offset, params->stop_sequences + offset + len, generated.end() - len);
+            }
+            if (callback && callback(next, user_data) != 0) stop = true;
+            if (stop || generated.size() == params->max_new_tokens) break;
+            next = qwen2_sample_step(model, &next, 1, cache, seq, &params->sampling, &rng_state, buffers, &ws);
+            if (next < 0) return next;
+        }
+        return static_cast<int64_t>(generated.size());
     }
 }   
@@ -1,18 +1,24 @@
 #include "add_cpu.hpp"
 
+#include "../../../device/cpu/thread_pool.hpp"
 #include "../../../utils.hpp"
 
 #include <cmath>
 
+// 低于此元素数时单线程处理
+constexpr size_t MIN_ELEMS_PER_THREAD = size_t(1) << 15;
+
 template <typename T>
 void add_(T *c, const T *a, const T *b, size_t numel) {
-    for (size_t i = 0; i < numel; i++) {
-        if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-            c[i] = llaisys::utils::cast<T>(llaisys::utils::cast<float>(a[i]) + llaisys::utils::cast<float>(b[i]));
-        } else {
-            c[i] = a[i] + b[i];
+    llaisys::device::cpu::parallel_for(numel, MIN_ELEMS_PER_THREAD, [&](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; i++) {
+            if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
+                c[i] = llaisys::utils::cast<T>(llaisys::utils::cast<float>(a[i]) + llaisys::utils::cast<float>(b[i]));
+            } else {
+                c[i] = a[i] + b[i];
+            }
         }
-    }
+    });
 }
 
 namespace llaisys::ops::cpu {
@@ -0,0 +1,83 @@
+#include "add_rms_norm_cpu.hpp"
+
+#include "../../../device/cpu/thread_pool.hpp"
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// 低于此元素数时单线程处理
+constexpr size_t MIN_ELEMS_PER_THREAD = size_t(1) << 15;
+
+// 残差相加与 RMS Normalization 融合:
+//   R_i = R_i + X_i (原地写回残差流)
+//   Y_i = (W_i × R_i) / sqrt((1/d) * sum(R_j^2) + epsilon)
+// 每行只读一次 R 和 X, 在 float 精度下完成加法与归一化
+// 归一化使用写回后的残差 (半精度下先舍入), 与先 Add 再 RmsNorm 的结果一致
+template <typename T>
+void add_rms_norm_(T *out, T *residual, const T *x, const T *weight,
+                   size_t batch_size, size_t feature_dim, float eps) {
+    std::vector<float> w(feature_dim);
+    llaisys::utils::simd::to_f32(w.data(), weight, feature_dim);
+
+    // 按行并行, 每个线程至少处理 MIN_ELEMS_PER_THREAD 个元素
+    size_t grain = std::max<size_t>(MIN_ELEMS_PER_THREAD / std::max<size_t>(feature_dim, 1), 1);
+    llaisys::device::cpu::parallel_for(batch_size, grain, [&](size_t b0, size_t b1) {
+        std::vector<float> row(feature_dim);
+        for (size_t b = b0; b < b1; b++) {
+            T *res = residual + b * feature_dim;
+            llaisys::utils::simd::to_f32(row.data(), res, feature_dim);
+            llaisys::utils::simd::axpy(row.data(), 1.0f, x + b * feature_dim, feature_dim);
+            llaisys::utils::simd::from_f32(res, row.data(), feature_dim);
+            if constexpr (!std::is_same_v<T, float>) {
+                llaisys::utils::simd::to_f32(row.data(), res, feature_dim);
+            }
+
+            // rms = sqrt((1/d) * sum(r^2) + eps)
+            float sum_of_squares = llaisys::utils::simd::dot(row.data(), row.data(), feature_dim);
+            float inv_rms = 1.0f / std::sqrt(sum_of_squares / static_cast<float>(feature_dim) + eps);
+
+            // Y_i = (W_i * R_i) / rms
+            for (size_t i = 0; i < feature_dim; i++) {
+                row[i] = (w[i] * row[i]) * inv_rms;
+            }
+            llaisys::utils::simd::from_f32(out + b * feature_dim, row.data(), feature_dim);
+        }
+    });
+}
+
+namespace llaisys::ops::cpu {
+void add_rms_norm(std::byte *out, std::byte *residual, const std::byte *x, const std::byte *weight,
+                  llaisysDataType_t type, size_t batch_size, size_t feature_dim, float eps) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return add_rms_norm_(
+            reinterpret_cast<float *>(out),
+            reinterpret_cast<float *>(residual),
+            reinterpret_cast<const float *>(x),
+            reinterpret_cast<const float *>(weight),
+            batch_size, feature_dim, eps
+        );
+    case LLAISYS_DTYPE_BF16:
+        return add_rms_norm_(
+            reinterpret_cast<llaisys::bf16_t *>(out),
+            reinterpret_cast<llaisys::bf16_t *>(residual),
+            reinterpret_cast<const llaisys::bf16_t *>(x),
+            reinterpret_cast<const llaisys::bf16_t *>(weight),
+            batch_size, feature_dim, eps
+        );
+    case LLAISYS_DTYPE_F16:
+        return add_rms_norm_(
+            reinterpret_cast<llaisys::fp16_t *>(out),
+            reinterpret_cast<llaisys::fp16_t *>(residual),
+            reinterpret_cast<const llaisys::fp16_t *>(x),
+            reinterpret_cast<const llaisys::fp16_t *>(weight),
+            batch_size, feature_dim, eps
+        );
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+} // namespace llaisys::ops::cpu
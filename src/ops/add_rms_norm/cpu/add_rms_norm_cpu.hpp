@@ -0,0 +1,9 @@
+#pragma once
+#include "llaisys.h"
+
+#include <cstddef>
+
+namespace llaisys::ops::cpu {
+void add_rms_norm(std::byte *out, std::byte *residual, const std::byte *x, const std::byte *weight,
+                  llaisysDataType_t type, size_t batch_size, size_t feature_dim, float eps);
+}
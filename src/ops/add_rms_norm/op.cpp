@@ -0,0 +1,43 @@
+#include "op.hpp"
+
+#include "../../core/llaisys_core.hpp"
+#include "../../utils.hpp"
+
+#include "cpu/add_rms_norm_cpu.hpp"
+
+namespace llaisys::ops {
+void add_rms_norm(tensor_t out, tensor_t residual, tensor_t x, tensor_t weight, float eps) {
+    CHECK_SAME_DEVICE(out, residual, x, weight);
+    CHECK_SAME_DTYPE(out->dtype(), residual->dtype(), x->dtype(), weight->dtype());
+    ASSERT(out->isContiguous() && residual->isContiguous() && x->isContiguous() && weight->isContiguous(),
+           "Add RMS Norm: all tensors must be contiguous");
+
+    ASSERT(residual->ndim() == 2, "Add RMS Norm: residual must be 2D tensor");
+    ASSERT(weight->ndim() == 1, "Add RMS Norm: weight must be 1D tensor");
+    CHECK_SAME_SHAPE(out->shape(), residual->shape(), x->shape());
+    size_t batch_size = residual->shape()[0];
+    size_t feature_dim = residual->shape()[1];
+    ASSERT(weight->shape()[0] == feature_dim, "Add RMS Norm: weight size must match feature dim");
+
+    // always support cpu calculation
+    if (out->deviceType() == LLAISYS_DEVICE_CPU) {
+        return cpu::add_rms_norm(out->data(), residual->data(), x->data(), weight->data(),
+                                 out->dtype(), batch_size, feature_dim, eps);
+    }
+
+    llaisys::core::context().setDevice(out->deviceType(), out->deviceId());
+
+    switch (out->deviceType()) {
+    case LLAISYS_DEVICE_CPU:
+        return cpu::add_rms_norm(out->data(), residual->data(), x->data(), weight->data(),
+                                 out->dtype(), batch_size, feature_dim, eps);
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+} // namespace llaisys::ops
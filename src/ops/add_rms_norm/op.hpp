@@ -0,0 +1,8 @@
+#pragma once
+
+#include "../../tensor/tensor.hpp"
+
+namespace llaisys::ops {
+// residual += x, then out = rms_norm(residual, weight, eps), in one pass over each row.
+void add_rms_norm(tensor_t out, tensor_t residual, tensor_t x, tensor_t weight, float eps);
+}
@@ -1,54 +1,65 @@
 #include "embedding_cpu.hpp"
 
 #include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
 
 #include <cstring>
+#include <type_traits>
+#include <vector>
 
-template <typename T>
-void embedding_(T *out, const int64_t *index, const T *weight, size_t idx_len, size_t embed_dim) {
+// T 为输出类型, TW 为嵌入表类型 (T 本身或 FP8)
+template <typename T, typename TW = T>
+void embedding_(T *out, const int64_t *index, const TW *weight, size_t idx_len, size_t embed_dim) {
+    std::vector<float> row_f32(std::is_same_v<T, TW> ? 0 : embed_dim);
     for (size_t i = 0; i < idx_len; i++) {
         int64_t idx = index[i];
-        const T *src_row = weight + idx * embed_dim;  // 源行指针
+        const TW *src_row = weight + idx * embed_dim; // 源行指针
         T *dst_row = out + i * embed_dim;             // 目标行指针
-        
-        // 复制整行数据
-        if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-            // 对于半精度类型，逐元素复制
-            for (size_t j = 0; j < embed_dim; j++) {
-                dst_row[j] = src_row[j];
-            }
-        } else {
-            // 对于标准类型，使用内存复制
+
+        if constexpr (std::is_same_v<T, TW>) {
+            // 复制整行数据 (半精度同样按位复制, 无需转换)
             std::memcpy(dst_row, src_row, embed_dim * sizeof(T));
+        } else {
+            // FP8 行先展开为 float 再写成输出类型
+            llaisys::utils::simd::to_f32(row_f32.data(), src_row, embed_dim);
+            if constexpr (std::is_same_v<T, float>) {
+                std::memcpy(dst_row, row_f32.data(), embed_dim * sizeof(float));
+            } else {
+                llaisys::utils::simd::from_f32(dst_row, row_f32.data(), embed_dim);
+            }
         }
     }
 }
 
 namespace llaisys::ops::cpu {
-void embedding(std::byte *out, const std::byte *index, const std::byte *weight, 
-               llaisysDataType_t type, size_t idx_len, size_t embed_dim) {
+namespace {
+template <typename T>
+void embedding_weights(std::byte *out, const std::byte *index, const std::byte *weight,
+                       llaisysDataType_t type, llaisysDataType_t weight_type, size_t idx_len, size_t embed_dim) {
+    switch (weight_type) {
+    case LLAISYS_DTYPE_F8:
+        return embedding_(reinterpret_cast<T *>(out), reinterpret_cast<const int64_t *>(index),
+                          reinterpret_cast<const llaisys::f8e4m3_t *>(weight), idx_len, embed_dim);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return embedding_(reinterpret_cast<T *>(out), reinterpret_cast<const int64_t *>(index),
+                          reinterpret_cast<const llaisys::f8e5m2_t *>(weight), idx_len, embed_dim);
+    default:
+        CHECK_ARGUMENT(weight_type == type, "Embedding: weight type must match the output or be FP8");
+        return embedding_(reinterpret_cast<T *>(out), reinterpret_cast<const int64_t *>(index),
+                          reinterpret_cast<const T *>(weight), idx_len, embed_dim);
+    }
+}
+} // namespace
+
+void embedding(std::byte *out, const std::byte *index, const std::byte *weight,
+               llaisysDataType_t type, llaisysDataType_t weight_type, size_t idx_len, size_t embed_dim) {
     switch (type) {
     case LLAISYS_DTYPE_F32:
-        return embedding_(
-            reinterpret_cast<float *>(out),
-            reinterpret_cast<const int64_t *>(index),
-            reinterpret_cast<const float *>(weight),
-            idx_len, embed_dim
-        );
+        return embedding_weights<float>(out, index, weight, type, weight_type, idx_len, embed_dim);
     case LLAISYS_DTYPE_BF16:
-        return embedding_(
-            reinterpret_cast<llaisys::bf16_t *>(out),
-            reinterpret_cast<const int64_t *>(index),
-            reinterpret_cast<const llaisys::bf16_t *>(weight),
-            idx_len, embed_dim
-        );
+        return embedding_weights<llaisys::bf16_t>(out, index, weight, type, weight_type, idx_len, embed_dim);
     case LLAISYS_DTYPE_F16:
-        return embedding_(
-            reinterpret_cast<llaisys::fp16_t *>(out),
-            reinterpret_cast<const int64_t *>(index),
-            reinterpret_cast<const llaisys::fp16_t *>(weight),
-            idx_len, embed_dim
-        );
+        return embedding_weights<llaisys::fp16_t>(out, index, weight, type, weight_type, idx_len, embed_dim);
     default:
         EXCEPTION_UNSUPPORTED_DATATYPE(type);
     }
@@ -4,6 +4,7 @@
 #include <cstddef>
 
 namespace llaisys::ops::cpu {
-void embedding(std::byte *out, const std::byte *index, const std::byte *weight, 
-               llaisysDataType_t type, size_t idx_len, size_t embed_dim);
+// `weight_type` is `type`, or FP8 widened to `type` while copying rows.
+void embedding(std::byte *out, const std::byte *index, const std::byte *weight,
+               llaisysDataType_t type, llaisysDataType_t weight_type, size_t idx_len, size_t embed_dim);
 }
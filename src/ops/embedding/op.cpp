@@ -12,7 +12,9 @@ void embedding(tensor_t out, tensor_t index, tensor_t weight) {
     
     // Check data types
     ASSERT(index->dtype() == LLAISYS_DTYPE_I64, "Embedding: index must be int64");
-    CHECK_SAME_DTYPE(out->dtype(), weight->dtype());
+    if (!utils::is_fp8(weight->dtype())) {
+        CHECK_SAME_DTYPE(out->dtype(), weight->dtype());
+    }
     
     // Check contiguity
     ASSERT(out->isContiguous() && index->isContiguous() && weight->isContiguous(), 
@@ -32,7 +34,7 @@ void embedding(tensor_t out, tensor_t index, tensor_t weight) {
     // always support cpu calculation
     if (out->deviceType() == LLAISYS_DEVICE_CPU) {
         return cpu::embedding(out->data(), index->data(), weight->data(), 
-                             out->dtype(), idx_len, embed_dim);
+                             out->dtype(), weight->dtype(), idx_len, embed_dim);
     }
 
     llaisys::core::context().setDevice(out->deviceType(), out->deviceId());
@@ -40,7 +42,7 @@ void embedding(tensor_t out, tensor_t index, tensor_t weight) {
     switch (out->deviceType()) {
     case LLAISYS_DEVICE_CPU:
         return cpu::embedding(out->data(), index->data(), weight->data(), 
-                             out->dtype(), idx_len, embed_dim);
+                             out->dtype(), weight->dtype(), idx_len, embed_dim);
 #ifdef ENABLE_NVIDIA_API
     case LLAISYS_DEVICE_NVIDIA:
         TO_BE_IMPLEMENTED();
@@ -0,0 +1,219 @@
+#pragma once
+#include "llaisys.h"
+
+#include "gemm_kernels.hpp"
+#include "linear_epilogue.hpp"
+
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace llaisys::ops::cpu {
+// silu(g) = g * sigmoid(g), with the same cut-offs as the SwiGLU op
+inline float silu(float g) {
+    if (g > 20.0f) {
+        return g;
+    }
+    if (g < -20.0f) {
+        return 0.0f;
+    }
+    return g / (1.0f + std::exp(-g));
+}
+
+// gelu(x) = x * Phi(x), the exact form of torch.nn.functional.gelu
+inline float gelu(float x) {
+    return 0.5f * x * (1.0f + std::erf(x * 0.70710678118654752f));
+}
+
+// Fused SwiGLU over an interleaved gate/up weight (see linear_interleave_gate_up): every
+// packed panel of nr rows holds nr / 2 gate rows followed by the matching nr / 2 up rows, so
+// the finished fp32 results of one panel reduce to nr / 2 outputs starting at column j / 2.
+// out[c] = silu(acc[c]) * acc[half + c] for c in [0, count), count <= half <= gemm::MAX_NR / 2
+template <typename T>
+inline void swiglu_store(T *out, const float *acc, size_t half, size_t count) {
+    float row[gemm::MAX_NR / 2];
+    for (size_t c = 0; c < count; c++) {
+        row[c] = silu(acc[c]) * acc[half + c];
+    }
+    if constexpr (std::is_same_v<T, float>) {
+        std::copy(row, row + count, out);
+    } else {
+        utils::simd::from_f32(out, row, count);
+    }
+}
+
+// A LinearEpilogue bound to one call with output type T, finishing fp32 row segments of the
+// product into C. Every combination of the elementwise stages is its own loop, picked once
+// per call, so a tile row costs one indirect call and no per-element branches.
+//   col_scale  per-column dequantization scale applied first (Q8 weights), or null
+//   n          columns of the product; the interleaved rows for a gate/up weight
+//   ldc        row stride of C and of the residual
+//   swiglu_n   gate/up weight: the store reduces each panel to its SwiGLU outputs (see
+//              swiglu_store), swiglu_n of them in total; 0 otherwise
+template <typename T>
+class Epilogue {
+public:
+    Epilogue(const LinearEpilogue &ep, const float *col_scale, size_t n, size_t ldc, size_t swiglu_n)
+        : _col_scale(col_scale), _rope_pos(ep.rope_pos), _rope_cols(ep.rope_pos ? ep.rope_cols : 0),
+          _head_dim(ep.rope_head_dim), _residual(reinterpret_cast<const T *>(ep.residual)), _ldc(ldc),
+          _swiglu_n(swiglu_n), _panel(swiglu_n ? gemm::microkernel(utils::cpu_info().isa).nr : 0) {
+        if (ep.bias) {
+            _bias.resize(n);
+            utils::simd::to_f32(_bias.data(), reinterpret_cast<const T *>(ep.bias), n);
+        }
+        // Same frequencies as the RoPE op: theta ** (2 * i / head_dim)
+        if (_rope_cols) {
+            _freq_base.resize(_head_dim / 2);
+            for (size_t i = 0; i < _freq_base.size(); i++) {
+                float freq_exp = (2.0f * static_cast<float>(i)) / static_cast<float>(_head_dim);
+                _freq_base[i] = std::pow(ep.rope_theta, freq_exp);
+            }
+        }
+        _pre = pick_pre(col_scale != nullptr, ep.bias != nullptr, ep.activation);
+        if (_swiglu_n) {
+            _store = &store_swiglu;
+        } else {
+            _store = _residual ? &store<true> : &store<false>;
+        }
+    }
+
+    // Column granularity of RoPE: blocks and thread splits of the output must be multiples of it.
+    size_t align() const {
+        return _rope_cols ? _head_dim : 1;
+    }
+    // Whether the stages after pre() need segments of whole heads, see post().
+    bool rowwise() const {
+        return _rope_cols > 0;
+    }
+    // Whether fp32 C can be accumulated and finished in place.
+    bool in_place() const {
+        return std::is_same_v<T, float> && !_swiglu_n && !_residual && !_rope_cols;
+    }
+
+    // Finish columns [j, j + len) of row i, held in `row` (overwritten), into C. With a gate/up
+    // weight the segment is made of whole panels; with RoPE, of whole heads.
+    void finish(T *c, float *row, size_t i, size_t j, size_t len) const {
+        _pre(*this, row, j, len);
+        post(c, row, i, j, len);
+    }
+    // The two halves of finish(): the elementwise stages up to the activation, which work on
+    // any tile, and RoPE, the residual and the store.
+    void pre(float *row, size_t j, size_t len) const {
+        _pre(*this, row, j, len);
+    }
+    void post(T *c, float *row, size_t i, size_t j, size_t len) const {
+        if (_rope_cols) {
+            rope(row, i, j, len);
+        }
+        _store(*this, c, row, i, j, len);
+    }
+
+private:
+    using pre_fn = void (*)(const Epilogue &, float *, size_t, size_t);
+    using store_fn = void (*)(const Epilogue &, T *, float *, size_t, size_t, size_t);
+
+    template <bool SCALE, bool BIAS, llaisysActivation_t ACT>
+    static void pre_stages(const Epilogue &e, float *row, size_t j, size_t len) {
+        for (size_t c = 0; c < len; c++) {
+            float v = row[c];
+            if constexpr (SCALE) {
+                v *= e._col_scale[j + c];
+            }
+            if constexpr (BIAS) {
+                v += e._bias[j + c];
+            }
+            if constexpr (ACT == LLAISYS_ACTIVATION_SILU) {
+                v = silu(v);
+            } else if constexpr (ACT == LLAISYS_ACTIVATION_GELU) {
+                v = gelu(v);
+            }
+            row[c] = v;
+        }
+    }
+
+    template <bool SCALE, bool BIAS>
+    static pre_fn pick_activation(llaisysActivation_t act) {
+        switch (act) {
+        case LLAISYS_ACTIVATION_SILU:
+            return &pre_stages<SCALE, BIAS, LLAISYS_ACTIVATION_SILU>;
+        case LLAISYS_ACTIVATION_GELU:
+            return &pre_stages<SCALE, BIAS, LLAISYS_ACTIVATION_GELU>;
+        default:
+            return &pre_stages<SCALE, BIAS, LLAISYS_ACTIVATION_NONE>;
+        }
+    }
+
+    static pre_fn pick_pre(bool scale, bool bias, llaisysActivation_t act) {
+        if (scale) {
+            return bias ? pick_activation<true, true>(act) : pick_activation<true, false>(act);
+        }
+        return bias ? pick_activation<false, true>(act) : pick_activation<false, false>(act);
+    }
+
+    // Rotate the heads of [j, j + len) that lie in [0, rope_cols); j is a multiple of head_dim.
+    // The angles only depend on the row, so they are computed once for all heads of the segment.
+    void rope(float *row, size_t i, size_t j, size_t len) const {
+        size_t end = std::min(j + len, _rope_cols);
+        if (j >= end) {
+            return;
+        }
+        size_t half = _head_dim / 2;
+        float position = static_cast<float>(_rope_pos[i]);
+        thread_local std::vector<float> cos_sin;
+        cos_sin.resize(2 * half);
+        for (size_t t = 0; t < half; t++) {
+            float angle = position / _freq_base[t];
+            cos_sin[t] = std::cos(angle);
+            cos_sin[half + t] = std::sin(angle);
+        }
+        for (size_t h = j; h < end; h += _head_dim) {
+            float *a = row + (h - j), *b = a + half;
+            for (size_t t = 0; t < half; t++) {
+                float av = a[t], bv = b[t];
+                a[t] = av * cos_sin[t] - bv * cos_sin[half + t];
+                b[t] = bv * cos_sin[t] + av * cos_sin[half + t];
+            }
+        }
+    }
+
+    template <bool RESIDUAL>
+    static void store(const Epilogue &e, T *c, float *row, size_t i, size_t j, size_t len) {
+        if constexpr (RESIDUAL) {
+            utils::simd::axpy(row, 1.0f, e._residual + i * e._ldc + j, len);
+        }
+        T *dst = c + i * e._ldc + j;
+        if constexpr (std::is_same_v<T, float>) {
+            if (dst != row) {
+                std::copy(row, row + len, dst);
+            }
+        } else {
+            utils::simd::from_f32(dst, row, len);
+        }
+    }
+
+    static void store_swiglu(const Epilogue &e, T *c, float *row, size_t i, size_t j, size_t len) {
+        size_t half = e._panel / 2;
+        for (size_t q = j; q < j + len && q / 2 < e._swiglu_n; q += e._panel) {
+            swiglu_store(c + i * e._ldc + q / 2, row + (q - j), half, std::min(half, e._swiglu_n - q / 2));
+        }
+    }
+
+    const float *_col_scale;
+    std::vector<float> _bias; // widened once per call
+    const int64_t *_rope_pos;
+    size_t _rope_cols;
+    size_t _head_dim;
+    std::vector<float> _freq_base;
+    const T *_residual;
+    size_t _ldc;
+    size_t _swiglu_n;
+    size_t _panel;
+    pre_fn _pre;
+    store_fn _store;
+};
+} // namespace llaisys::ops::cpu
@@ -0,0 +1,676 @@
+#include "gemm_cpu.hpp"
+
+#include "epilogue.hpp"
+#include "gemm_kernels.hpp"
+#include "quantize_cpu.hpp"
+
+#include "../../../device/cpu/thread_pool.hpp"
+#include "../../../utils.hpp"
+#include "../../../utils/cpu_info.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <vector>
+
+// Cache-blocked GEMM in the BLIS style:
+//   jc: nc columns of B, packed once per kc slice and kept in L3
+//   pc: kc slice of the reduction, sized so one B micro-panel stays in L1
+//   ic: mc rows of A, packed and kept in L2
+//   jr/ir: mr x nr register tiles computed by the ISA-specific microkernel
+namespace llaisys::ops::cpu::gemm {
+namespace {
+constexpr size_t ALIGNMENT = 64;
+constexpr size_t MAX_KC = 512;
+// Bound on the fp32 accumulation buffer used when C is not fp32.
+constexpr size_t SCRATCH_BYTES = 4 * 1024 * 1024;
+// Below this many flops per thread, waking workers costs more than it saves.
+constexpr size_t MIN_FLOPS_PER_THREAD = size_t(1) << 23;
+
+template <typename T>
+class AlignedBuffer {
+private:
+    T *_data = nullptr;
+    size_t _capacity = 0;
+
+public:
+    AlignedBuffer() = default;
+    ~AlignedBuffer() {
+        if (_data) {
+            ::operator delete(_data, std::align_val_t(ALIGNMENT));
+        }
+    }
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    T *get(size_t numel) {
+        if (numel > _capacity) {
+            if (_data) {
+                ::operator delete(_data, std::align_val_t(ALIGNMENT));
+            }
+            _data = static_cast<T *>(::operator new(numel * sizeof(T), std::align_val_t(ALIGNMENT)));
+            _capacity = numel;
+        }
+        return _data;
+    }
+};
+
+// Packing buffers are reused across calls on the same thread.
+struct Workspace {
+    AlignedBuffer<float> a;
+    AlignedBuffer<float> b;
+    AlignedBuffer<float> c;
+    // W8A8: quantized A panels and their per-row scales
+    AlignedBuffer<int8_t> qa;
+    AlignedBuffer<float> qa_scales;
+};
+
+Workspace &workspace() {
+    thread_local Workspace ws;
+    return ws;
+}
+
+struct Blocking {
+    size_t mc;
+    size_t nc;
+    size_t kc;
+};
+
+size_t round_down(size_t x, size_t multiple) {
+    return std::max(x / multiple, size_t(1)) * multiple;
+}
+
+size_t ceil_div(size_t x, size_t y) {
+    return (x + y - 1) / y;
+}
+
+// `nalign` is a multiple of nr that blocks of columns must keep to (see Epilogue::align).
+Blocking choose_blocking(const Microkernel &uk, size_t nalign, size_t nthreads) {
+    const auto &info = utils::cpu_info();
+    Blocking bk;
+    // One B micro-panel (kc x nr) takes half of L1, leaving room for the A micro-panel.
+    bk.kc = std::clamp(round_down(info.l1d_size / 2 / (uk.nr * sizeof(float)), 8), size_t(64), MAX_KC);
+    // The packed A block (mc x kc) takes half of L2.
+    bk.mc = std::clamp(round_down(info.l2_size / 2 / (bk.kc * sizeof(float)), uk.mr), uk.mr, 40 * uk.mr);
+    // The packed B block (kc x nc) takes half of this thread's share of L3.
+    size_t l3_share = info.l3_size / (2 * nthreads);
+    bk.nc = std::clamp(round_down(l3_share / (bk.kc * sizeof(float)), nalign), nalign, round_down(128 * uk.nr, nalign));
+    return bk;
+}
+
+// Pack rows [0, rows) x [0, kc) of a row-major matrix into k-major panels of `width` rows,
+// zero-padding the last panel. Used for both A (width = mr) and B (width = nr).
+// Half-precision rows are widened with the SIMD converters before being interleaved.
+template <typename T>
+void pack_panels(float *dst, const T *src, size_t ld, size_t rows, size_t kc, size_t width) {
+    float row_f32[MAX_KC];
+    for (size_t r0 = 0; r0 < rows; r0 += width) {
+        size_t valid = std::min(width, rows - r0);
+        for (size_t r = 0; r < width; r++) {
+            if (r < valid) {
+                const float *row;
+                if constexpr (std::is_same_v<T, float>) {
+                    row = src + (r0 + r) * ld;
+                } else {
+                    utils::simd::to_f32(row_f32, src + (r0 + r) * ld, kc);
+                    row = row_f32;
+                }
+                for (size_t p = 0; p < kc; p++) {
+                    dst[p * width + r] = row[p];
+                }
+            } else {
+                for (size_t p = 0; p < kc; p++) {
+                    dst[p * width + r] = 0.0f;
+                }
+            }
+        }
+        dst += kc * width;
+    }
+}
+
+// Pre-packed B (see pack_b): panel q holds rows [q * nr, q * nr + nr) of B as [k][nr].
+template <typename T>
+void pack_b_(T *dst, const T *src, size_t ld, size_t n, size_t k, size_t nr) {
+    for (size_t r0 = 0; r0 < n; r0 += nr) {
+        size_t valid = std::min(nr, n - r0);
+        for (size_t r = 0; r < nr; r++) {
+            const T *row = src + (r0 + r) * ld;
+            for (size_t p = 0; p < k; p++) {
+                dst[p * nr + r] = r < valid ? row[p] : utils::cast<T>(0.0f);
+            }
+        }
+        dst += k * nr;
+    }
+}
+
+// T is the activation/output type, TB the weight type: T itself, FP8, int8 for Q8, or uint8
+// holding two 4-bit codes for Q4.
+template <typename T, typename TB = T>
+struct Problem {
+    T *c;
+    size_t ldc;
+    const T *a;
+    size_t lda;
+    const TB *b;
+    size_t ldb;     // unused when b_packed
+    bool b_packed;  // b is laid out by pack_b for this ISA's nr
+    const Epilogue<T> &ep; // bias, Q8 column scales and the fused output stages
+    const fp16_t *group_scales; // Q4 only, see PackedWeight
+    const fp16_t *group_mins;
+    size_t group_size;
+    size_t m;
+    size_t n;
+    size_t k;
+};
+
+// Make the kc x nc block of B at (jc, pc) available as fp32 micro-panels of nr columns.
+// Returns the first panel; consecutive panels are `stride` floats apart.
+// Packed fp32 B is read in place, packed half-precision/fp8/int8 B only needs a contiguous
+// widening and 4-bit B is expanded with its group scales.
+template <typename T, typename TB>
+const float *load_b_block(const Problem<T, TB> &p, float *bp, size_t nr, size_t jc, size_t nc, size_t pc, size_t kc, size_t &stride) {
+    if constexpr (std::is_same_v<TB, uint8_t>) {
+        size_t groups = quantize::q4_groups(p.k, p.group_size);
+        for (size_t q = 0; q < ceil_div(nc, nr); q++) {
+            size_t panel = jc / nr + q;
+            quantize::dequantize_q4_panel(bp + q * kc * nr, p.b + panel * p.k * nr / 2,
+                                          p.group_scales + panel * groups * nr,
+                                          p.group_mins ? p.group_mins + panel * groups * nr : nullptr,
+                                          nr, pc, kc, p.group_size);
+        }
+        stride = kc * nr;
+        return bp;
+    } else {
+        if (!p.b_packed) {
+            pack_panels(bp, p.b + jc * p.ldb + pc, p.ldb, nc, kc, nr);
+            stride = kc * nr;
+            return bp;
+        }
+        const TB *src = p.b + (jc / nr) * p.k * nr + pc * nr;
+        if constexpr (std::is_same_v<TB, float>) {
+            stride = p.k * nr;
+            return src;
+        } else {
+            for (size_t q = 0; q < ceil_div(nc, nr); q++) {
+                utils::simd::to_f32(bp + q * kc * nr, src + q * p.k * nr, kc * nr);
+            }
+            stride = kc * nr;
+            return bp;
+        }
+    }
+}
+
+template <typename T, typename TB>
+void gemm_range(const Problem<T, TB> &p, const Microkernel &uk, const Blocking &bk,
+                size_t m0, size_t m1, size_t n0, size_t n1) {
+    // Stages that change the width of C or read it as a residual need the fp32 buffer.
+    const bool direct = p.ep.in_place();
+    // RoPE needs whole heads: tiles only get the elementwise stages, and the rest runs on each
+    // finished mc x nc block while it is still in L2.
+    const bool rowwise = p.ep.rowwise();
+    const size_t mr = uk.mr, nr = uk.nr;
+
+    Workspace &ws = workspace();
+    float *ap = ws.a.get(ceil_div(bk.mc, mr) * mr * bk.kc);
+    float *bp = ws.b.get(ceil_div(bk.nc, nr) * nr * bk.kc);
+
+    // fp32 C is accumulated in place; otherwise through a bounded fp32 buffer of mb x nc.
+    size_t mb = m1 - m0;
+    float *scratch = nullptr;
+    if (!direct) {
+        mb = std::min(mb, round_down(SCRATCH_BYTES / sizeof(float) / bk.nc, bk.mc));
+        scratch = ws.c.get(mb * bk.nc);
+    }
+
+    float edge[MAX_MR * MAX_NR] = {};
+
+    for (size_t ms = m0; ms < m1; ms += mb) {
+        size_t me = std::min(ms + mb, m1);
+        for (size_t jc = n0; jc < n1; jc += bk.nc) {
+            size_t nc = std::min(bk.nc, n1 - jc);
+            float *cbuf;
+            size_t ldcb;
+            if (direct) {
+                cbuf = reinterpret_cast<float *>(p.c) + ms * p.ldc + jc;
+                ldcb = p.ldc;
+            } else {
+                cbuf = scratch;
+                ldcb = bk.nc;
+            }
+            for (size_t pc = 0; pc < p.k; pc += bk.kc) {
+                size_t kc = std::min(bk.kc, p.k - pc);
+                bool accumulate = pc > 0;
+                bool last = pc + kc >= p.k;
+                size_t panel_stride;
+                const float *bblock = load_b_block(p, bp, nr, jc, nc, pc, kc, panel_stride);
+                for (size_t ic = ms; ic < me; ic += bk.mc) {
+                    size_t mc = std::min(bk.mc, me - ic);
+                    pack_panels(ap, p.a + ic * p.lda + pc, p.lda, mc, kc, mr);
+                    for (size_t jr = 0; jr < nc; jr += nr) {
+                        size_t ni = std::min(nr, nc - jr);
+                        const float *bpanel = bblock + (jr / nr) * panel_stride;
+                        for (size_t ir = 0; ir < mc; ir += mr) {
+                            size_t mi = std::min(mr, mc - ir);
+                            const float *apanel = ap + ir * kc;
+                            float *ctile = cbuf + (ic - ms + ir) * ldcb + jr;
+                            if (mi == mr && ni == nr) {
+                                uk.compute(kc, apanel, bpanel, ctile, ldcb, accumulate);
+                            } else {
+                                // Partial tile: run the full kernel on a local tile and copy the valid part.
+                                if (accumulate) {
+                                    for (size_t r = 0; r < mi; r++) {
+                                        std::copy(ctile + r * ldcb, ctile + r * ldcb + ni, edge + r * nr);
+                                    }
+                                }
+                                uk.compute(kc, apanel, bpanel, edge, nr, accumulate);
+                                for (size_t r = 0; r < mi; r++) {
+                                    std::copy(edge + r * nr, edge + r * nr + ni, ctile + r * ldcb);
+                                }
+                            }
+                            if (last) {
+                                for (size_t r = 0; r < mi; r++) {
+                                    if (rowwise) {
+                                        p.ep.pre(ctile + r * ldcb, jc + jr, ni);
+                                    } else {
+                                        p.ep.finish(p.c, ctile + r * ldcb, ic + ir + r, jc + jr, ni);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    if (last && rowwise) {
+                        for (size_t r = 0; r < mc; r++) {
+                            p.ep.post(p.c, cbuf + (ic - ms + r) * ldcb, ic + r, jc, nc);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Split the output into a tm x tn grid of mr/nr-aligned blocks that minimizes padded work per thread.
+void partition(size_t m, size_t n, size_t mr, size_t nr, size_t nthreads, size_t &tm, size_t &tn) {
+    size_t best = std::numeric_limits<size_t>::max();
+    tm = 1;
+    tn = nthreads;
+    for (size_t cm = 1; cm <= nthreads; cm++) {
+        if (nthreads % cm != 0) {
+            continue;
+        }
+        size_t cn = nthreads / cm;
+        size_t rows = ceil_div(ceil_div(m, mr), cm) * mr;
+        size_t cols = ceil_div(ceil_div(n, nr), cn) * nr;
+        // Packing cost grows with the other dimension, so prefer square-ish blocks on ties.
+        size_t cost = rows * cols + rows + cols;
+        if (cost < best) {
+            best = cost;
+            tm = cm;
+            tn = cn;
+        }
+    }
+}
+
+// Boundaries of block `idx` out of `parts` over [0, len), aligned to `align`.
+size_t split_point(size_t len, size_t align, size_t parts, size_t idx) {
+    size_t units = ceil_div(len, align);
+    return std::min(len, (units * idx / parts) * align);
+}
+
+size_t gemm_threads(size_t m, size_t n, size_t k) {
+    size_t flops = 2 * m * n * k;
+    return std::clamp<size_t>(flops / MIN_FLOPS_PER_THREAD, 1, device::cpu::num_threads());
+}
+
+// Run range(m0, m1, n0, n1) over a tm x tn partition of the m x n output on the thread pool.
+template <typename Range>
+void run_partitioned(size_t m, size_t n, size_t mr, size_t nr, size_t nthreads, const Range &range) {
+    if (nthreads == 1) {
+        return range(size_t(0), m, size_t(0), n);
+    }
+    size_t tm, tn;
+    partition(m, n, mr, nr, nthreads, tm, tn);
+    device::cpu::parallel_for(nthreads, 1, [&](size_t t0, size_t t1) {
+        for (size_t t = t0; t < t1; t++) {
+            size_t im = t / tn, in = t % tn;
+            size_t m0 = split_point(m, mr, tm, im), m1 = split_point(m, mr, tm, im + 1);
+            size_t n0 = split_point(n, nr, tn, in), n1 = split_point(n, nr, tn, in + 1);
+            if (m0 < m1 && n0 < n1) {
+                range(m0, m1, n0, n1);
+            }
+        }
+    });
+}
+
+template <typename T, typename TB>
+void gemm_(const Problem<T, TB> &p) {
+    if (p.m == 0 || p.n == 0) {
+        return;
+    }
+    if (p.k == 0) {
+        // An empty product still goes through the output stages
+        std::vector<float> row(p.n);
+        for (size_t i = 0; i < p.m; i++) {
+            std::fill(row.begin(), row.end(), 0.0f);
+            p.ep.finish(p.c, row.data(), i, 0, p.n);
+        }
+        return;
+    }
+
+    const Microkernel &uk = microkernel(utils::cpu_info().isa);
+    size_t nthreads = gemm_threads(p.m, p.n, p.k);
+    size_t nalign = std::lcm(uk.nr, p.ep.align());
+    Blocking bk = choose_blocking(uk, nalign, nthreads);
+    run_partitioned(p.m, p.n, uk.mr, nalign, nthreads, [&](size_t m0, size_t m1, size_t n0, size_t n1) {
+        gemm_range(p, uk, bk, m0, m1, n0, n1);
+    });
+}
+
+template <typename T, typename TB = T>
+void gemm_typed(std::byte *c, size_t ldc, const std::byte *a, size_t lda, const std::byte *b, size_t ldb, bool b_packed,
+                const PackedWeight *bq, const LinearEpilogue &epilogue, size_t m, size_t n, size_t k) {
+    Epilogue<T> ep(epilogue, bq ? bq->scales : nullptr, n, ldc, bq ? bq->swiglu_features : 0);
+    Problem<T, TB> p{reinterpret_cast<T *>(c), ldc,
+                     reinterpret_cast<const T *>(a), lda,
+                     reinterpret_cast<const TB *>(b), ldb, b_packed,
+                     ep,
+                     bq ? bq->group_scales : nullptr,
+                     bq ? bq->group_mins : nullptr,
+                     bq ? bq->group_size : 0,
+                     m, n, k};
+    gemm_(p);
+}
+
+// W8A8: activation rows are quantized per call, the product is accumulated in int32 over the
+// full k by the integer microkernel and rescaled per tile. A is packed as [kq][mr][4] panels
+// of kp = 4 * kq codes per row; rows past the last full panel stay plain for compute_row.
+template <typename T>
+struct ProblemI8 {
+    T *c;
+    size_t ldc;
+    const int8_t *a;
+    const float *a_scales;
+    const int8_t *b;         // W8A8 panels, see PackedWeight
+    const float *b_scales;
+    const int32_t *b_sums;   // row sums of B when A carries the +128 offset, else null
+    const Epilogue<T> &ep;
+    size_t m;
+    size_t n;
+    size_t kp;
+};
+
+size_t round_up4(size_t k) {
+    return ceil_div(k, 4) * 4;
+}
+
+// Columns are walked in groups of `group` (nr, or whole RoPE heads): with RoPE the tiles of a
+// group are finished into an fp32 block of mc x group and its rows completed once it is full.
+template <typename T>
+void gemm_i8_range(const ProblemI8<T> &p, const MicrokernelI8 &uk, size_t mc, size_t group,
+                   size_t m0, size_t m1, size_t n0, size_t n1) {
+    const size_t mr = uk.mr, nr = uk.nr, kq = p.kp / 4;
+    const bool rowwise = p.ep.rowwise();
+    int32_t tile[MAX_MR * MAX_NR];
+    float row[MAX_NR];
+    float *block = rowwise ? workspace().c.get(mc * group) : nullptr;
+    // mc rows of A stay in L2 while the B panels of this block stream past them.
+    for (size_t ic = m0; ic < m1; ic += mc) {
+        size_t me = std::min(ic + mc, m1);
+        for (size_t jg = n0; jg < n1; jg += group) {
+            size_t ge = std::min(jg + group, n1);
+            for (size_t j = jg; j < ge; j += nr) {
+                size_t ni = std::min(nr, ge - j);
+                const int8_t *bpanel = p.b + (j / nr) * nr * p.kp;
+                for (size_t i = ic; i < me; i += mr) {
+                    size_t mi = std::min(mr, me - i);
+                    const int8_t *apanel = p.a + i * p.kp;
+                    if (mi == mr) {
+                        uk.compute(kq, apanel, bpanel, tile);
+                    } else {
+                        for (size_t r = 0; r < mi; r++) {
+                            uk.compute_row(kq, apanel + r * p.kp, bpanel, tile + r * nr);
+                        }
+                    }
+                    for (size_t r = 0; r < mi; r++) {
+                        const int32_t *acc = tile + r * nr;
+                        float sa = p.a_scales[i + r];
+                        float *dst = rowwise ? block + (i + r - ic) * group + (j - jg) : row;
+                        for (size_t col = 0; col < ni; col++) {
+                            int32_t v = p.b_sums ? acc[col] - 128 * p.b_sums[j + col] : acc[col];
+                            dst[col] = float(v) * sa * p.b_scales[j + col];
+                        }
+                        if (rowwise) {
+                            p.ep.pre(dst, j, ni);
+                        } else {
+                            p.ep.finish(p.c, dst, i + r, j, ni);
+                        }
+                    }
+                }
+            }
+            if (rowwise) {
+                for (size_t i = ic; i < me; i++) {
+                    p.ep.post(p.c, block + (i - ic) * group, i, jg, ge - jg);
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void gemm_w8a8(std::byte *c, size_t ldc, const std::byte *a, size_t lda, const PackedWeight &b,
+               const LinearEpilogue &epilogue, llaisysDataType_t type, size_t m, size_t n, size_t k) {
+    CHECK_ARGUMENT(b.scales && b.row_sums, "GEMM: W8A8 weights come with scales and row sums");
+    if (m == 0 || n == 0) {
+        return;
+    }
+    if (k == 0) {
+        return gemm_typed<T>(c, ldc, a, lda, nullptr, 0, true, &b, epilogue, m, n, k);
+    }
+    const MicrokernelI8 &uk = microkernel_i8(utils::cpu_info().isa);
+    const size_t mr = uk.mr, kp = round_up4(k);
+
+    // Quantize A; rows of full panels go through a row buffer and are interleaved by 4 codes.
+    Workspace &ws = workspace();
+    int8_t *qa = ws.qa.get(m * kp + kp);
+    float *qa_scales = ws.qa_scales.get(m);
+    int8_t *qrow = qa + m * kp;
+    const int8_t pad = uk.unsigned_a ? int8_t(-128) : int8_t(0);
+    size_t full = m / mr * mr;
+    size_t elem = utils::dsize(type);
+    for (size_t i = 0; i < m; i++) {
+        int8_t *dst = i < full ? qrow : qa + i * kp;
+        quantize::quantize_rows_a8(dst, kp, qa_scales + i, a + i * lda * elem, lda, type, 1, k, uk.unsigned_a);
+        std::fill(dst + k, dst + kp, pad);
+        if (i < full) {
+            int8_t *panel = qa + (i / mr) * mr * kp;
+            for (size_t q = 0; q < kp / 4; q++) {
+                std::copy(qrow + q * 4, qrow + q * 4 + 4, panel + (q * mr + i % mr) * 4);
+            }
+        }
+    }
+
+    Epilogue<T> ep(epilogue, nullptr, n, ldc, b.swiglu_features);
+    ProblemI8<T> p{reinterpret_cast<T *>(c), ldc, qa, qa_scales,
+                   reinterpret_cast<const int8_t *>(b.data), b.scales, uk.unsigned_a ? b.row_sums : nullptr,
+                   ep, m, n, kp};
+
+    // The A block shares half of L2 with one B panel.
+    size_t l2_rows = utils::cpu_info().l2_size / 2 / kp;
+    size_t mc = std::clamp(round_down(l2_rows > uk.nr ? l2_rows - uk.nr : 0, mr), mr, 64 * mr);
+    size_t nthreads = gemm_threads(m, n, k);
+    size_t group = std::lcm(uk.nr, ep.align());
+    run_partitioned(m, n, mr, group, nthreads, [&](size_t m0, size_t m1, size_t n0, size_t n1) {
+        gemm_i8_range(p, uk, mc, group, m0, m1, n0, n1);
+    });
+}
+
+// Unquantized B, plain or packed (then `bq` describes it): FP8 is widened while loading a
+// block of B like half precision; any other type must match the activations.
+template <typename T>
+void gemm_float_weights(std::byte *c, size_t ldc, const std::byte *a, size_t lda, const std::byte *b, size_t ldb,
+                        const PackedWeight *bq, const LinearEpilogue &epilogue, llaisysDataType_t type, llaisysDataType_t b_type,
+                        size_t m, size_t n, size_t k) {
+    bool b_packed = bq != nullptr;
+    switch (b_type) {
+    case LLAISYS_DTYPE_F8:
+        return gemm_typed<T, llaisys::f8e4m3_t>(c, ldc, a, lda, b, ldb, b_packed, bq, epilogue, m, n, k);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return gemm_typed<T, llaisys::f8e5m2_t>(c, ldc, a, lda, b, ldb, b_packed, bq, epilogue, m, n, k);
+    default:
+        CHECK_ARGUMENT(b_type == type, "GEMM: weight type must match the activations or be FP8");
+        return gemm_typed<T>(c, ldc, a, lda, b, ldb, b_packed, bq, epilogue, m, n, k);
+    }
+}
+
+// Dispatch on the packed weight format; `bq` is null for unpacked B of `b_type`.
+template <typename T>
+void gemm_weights(std::byte *c, size_t ldc, const std::byte *a, size_t lda, const std::byte *b, size_t ldb,
+                  llaisysDataType_t b_type, const PackedWeight *bq, const LinearEpilogue &epilogue, llaisysDataType_t type,
+                  size_t m, size_t n, size_t k) {
+    if (!bq) {
+        return gemm_float_weights<T>(c, ldc, a, lda, b, ldb, nullptr, epilogue, type, b_type, m, n, k);
+    }
+    switch (bq->format) {
+    case LLAISYS_LINEAR_WEIGHT_PACKED:
+    case LLAISYS_LINEAR_WEIGHT_F8:
+        return gemm_float_weights<T>(c, ldc, a, lda, bq->data, 0, bq, epilogue, type, bq->dtype, m, n, k);
+    case LLAISYS_LINEAR_WEIGHT_Q8:
+        CHECK_ARGUMENT(bq->scales, "GEMM: int8 weights come with scales");
+        return gemm_typed<T, int8_t>(c, ldc, a, lda, bq->data, 0, true, bq, epilogue, m, n, k);
+    case LLAISYS_LINEAR_WEIGHT_Q4:
+    case LLAISYS_LINEAR_WEIGHT_Q4_ZP:
+        CHECK_ARGUMENT(bq->group_scales && bq->group_size > 0, "GEMM: 4-bit weights come with group scales");
+        return gemm_typed<T, uint8_t>(c, ldc, a, lda, bq->data, 0, true, bq, epilogue, m, n, k);
+    case LLAISYS_LINEAR_WEIGHT_W8A8:
+        return gemm_w8a8<T>(c, ldc, a, lda, *bq, epilogue, type, m, n, k);
+    default:
+        CHECK_ARGUMENT(false, "GEMM: unknown packed weight format");
+    }
+}
+
+void gemm_dispatch(std::byte *c, size_t ldc, const std::byte *a, size_t lda, const std::byte *b, size_t ldb,
+                   llaisysDataType_t b_type, const PackedWeight *bq, const LinearEpilogue &epilogue, llaisysDataType_t type,
+                   size_t m, size_t n, size_t k) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return gemm_weights<float>(c, ldc, a, lda, b, ldb, b_type, bq, epilogue, type, m, n, k);
+    case LLAISYS_DTYPE_BF16:
+        return gemm_weights<llaisys::bf16_t>(c, ldc, a, lda, b, ldb, b_type, bq, epilogue, type, m, n, k);
+    case LLAISYS_DTYPE_F16:
+        return gemm_weights<llaisys::fp16_t>(c, ldc, a, lda, b, ldb, b_type, bq, epilogue, type, m, n, k);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+} // namespace
+
+void gemm(std::byte *c, size_t ldc,
+          const std::byte *a, size_t lda,
+          const std::byte *b, size_t ldb,
+          const LinearEpilogue &epilogue,
+          llaisysDataType_t type, llaisysDataType_t b_type, size_t m, size_t n, size_t k) {
+    gemm_dispatch(c, ldc, a, lda, b, ldb, b_type, nullptr, epilogue, type, m, n, k);
+}
+
+size_t panel_width() {
+    return microkernel(utils::cpu_info().isa).nr;
+}
+
+size_t packed_numel(size_t n, size_t k) {
+    return ceil_div(n, panel_width()) * panel_width() * k;
+}
+
+void pack_b(std::byte *dst, const std::byte *b, size_t ldb, llaisysDataType_t type, size_t n, size_t k) {
+    size_t nr = panel_width();
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return pack_b_(reinterpret_cast<float *>(dst), reinterpret_cast<const float *>(b), ldb, n, k, nr);
+    case LLAISYS_DTYPE_BF16:
+        return pack_b_(reinterpret_cast<llaisys::bf16_t *>(dst), reinterpret_cast<const llaisys::bf16_t *>(b), ldb, n, k, nr);
+    case LLAISYS_DTYPE_F16:
+        return pack_b_(reinterpret_cast<llaisys::fp16_t *>(dst), reinterpret_cast<const llaisys::fp16_t *>(b), ldb, n, k, nr);
+    case LLAISYS_DTYPE_F8:
+        return pack_b_(reinterpret_cast<llaisys::f8e4m3_t *>(dst), reinterpret_cast<const llaisys::f8e4m3_t *>(b), ldb, n, k, nr);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return pack_b_(reinterpret_cast<llaisys::f8e5m2_t *>(dst), reinterpret_cast<const llaisys::f8e5m2_t *>(b), ldb, n, k, nr);
+    case LLAISYS_DTYPE_I8:
+        return pack_b_(reinterpret_cast<int8_t *>(dst), reinterpret_cast<const int8_t *>(b), ldb, n, k, nr);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+size_t packed_q4_bytes(size_t n, size_t k) {
+    return packed_numel(n, k) / 2;
+}
+
+size_t packed_q4_groups_numel(size_t n, size_t k, size_t group) {
+    return ceil_div(n, panel_width()) * panel_width() * quantize::q4_groups(k, group);
+}
+
+void pack_b_q4(std::byte *dst, fp16_t *dst_scales, fp16_t *dst_mins,
+               const uint8_t *codes, const fp16_t *scales, const fp16_t *mins, size_t n, size_t k, size_t group) {
+    size_t nr = panel_width(), half = nr / 2;
+    size_t groups = quantize::q4_groups(k, group);
+    auto *out = reinterpret_cast<uint8_t *>(dst);
+    // Padding rows get code 0 with zero scale and min, i.e. weight 0 in both variants.
+    for (size_t r0 = 0; r0 < n; r0 += nr) {
+        size_t valid = std::min(nr, n - r0);
+        for (size_t p = 0; p < k; p++) {
+            for (size_t i = 0; i < half; i++) {
+                uint8_t lo = i < valid ? codes[(r0 + i) * k + p] : 0;
+                uint8_t hi = i + half < valid ? codes[(r0 + i + half) * k + p] : 0;
+                out[p * half + i] = uint8_t(lo | (hi << 4));
+            }
+        }
+        for (size_t g = 0; g < groups; g++) {
+            for (size_t r = 0; r < nr; r++) {
+                dst_scales[g * nr + r] = r < valid ? scales[(r0 + r) * groups + g] : utils::cast<fp16_t>(0.0f);
+                if (dst_mins) {
+                    dst_mins[g * nr + r] = r < valid ? mins[(r0 + r) * groups + g] : utils::cast<fp16_t>(0.0f);
+                }
+            }
+        }
+        out += k * half;
+        dst_scales += groups * nr;
+        if (dst_mins) {
+            dst_mins += groups * nr;
+        }
+    }
+}
+
+size_t packed_w8a8_bytes(size_t n, size_t k) {
+    return ceil_div(n, panel_width()) * panel_width() * round_up4(k);
+}
+
+void pack_b_w8a8(std::byte *dst, int32_t *row_sums, const int8_t *codes, size_t n, size_t k) {
+    size_t nr = panel_width(), kp = round_up4(k);
+    auto *out = reinterpret_cast<int8_t *>(dst);
+    for (size_t r0 = 0; r0 < n; r0 += nr) {
+        size_t valid = std::min(nr, n - r0);
+        for (size_t r = 0; r < nr; r++) {
+            const int8_t *row = codes + (r0 + r) * k;
+            int32_t sum = 0;
+            for (size_t p = 0; p < kp; p++) {
+                int8_t q = r < valid && p < k ? row[p] : int8_t(0);
+                out[((p / 4) * nr + r) * 4 + p % 4] = q;
+                sum += q;
+            }
+            if (r < valid) {
+                row_sums[r0 + r] = sum;
+            }
+        }
+        out += nr * kp;
+    }
+}
+
+void gemm_packed(std::byte *c, size_t ldc,
+                 const std::byte *a, size_t lda,
+                 const PackedWeight &b,
+                 const LinearEpilogue &epilogue,
+                 llaisysDataType_t type, size_t m, size_t n, size_t k) {
+    gemm_dispatch(c, ldc, a, lda, nullptr, 0, b.dtype, &b, epilogue, type, m, n, k);
+}
+} // namespace llaisys::ops::cpu::gemm
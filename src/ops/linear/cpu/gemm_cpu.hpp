@@ -0,0 +1,54 @@
+#pragma once
+#include "llaisys.h"
+
+#include "linear_epilogue.hpp"
+#include "packed_weight.hpp"
+
+#include <cstddef>
+
+namespace llaisys::ops::cpu::gemm {
+// C[m, n] = epilogue(A[m, k] * B[n, k]^T)
+// All operands are row-major with leading dimensions lda/ldb/ldc in elements. C, A and the
+// epilogue's bias and residual share `type`; B is of `b_type`, the same or FP8 (E4M3/E5M2)
+// with any activation type. Narrow operands are widened to fp32 while packing; accumulation
+// is always fp32, and the epilogue runs on each finished tile (on each mc x nc block when it
+// has RoPE) before it is stored.
+void gemm(std::byte *c, size_t ldc,
+          const std::byte *a, size_t lda,
+          const std::byte *b, size_t ldb,
+          const LinearEpilogue &epilogue,
+          llaisysDataType_t type, llaisysDataType_t b_type, size_t m, size_t n, size_t k);
+
+// Packed B layout, built once per weight: rows of B are grouped into panels of panel_width()
+// rows (the microkernel width of the running ISA), each panel stored k-major as [k][nr] in
+// B's own dtype, with the last panel zero-padded. Consecutive k steps of a panel are
+// contiguous, so both the GEMM microkernel and the decode GEMV stream it sequentially.
+size_t panel_width();
+// Elements of the packed buffer for an [n, k] matrix.
+size_t packed_numel(size_t n, size_t k);
+// `type` may also be FP8, or I8 for quantized weights.
+void pack_b(std::byte *dst, const std::byte *b, size_t ldb, llaisysDataType_t type, size_t n, size_t k);
+
+// 4-bit variant of the packed layout (see PackedWeight): bytes of codes, elements of the
+// per-panel [group][nr] scales and mins, and the packing from quantize::quantize_rows_q4
+// output. `dst_mins` and `mins` are null for symmetric weights.
+size_t packed_q4_bytes(size_t n, size_t k);
+size_t packed_q4_groups_numel(size_t n, size_t k, size_t group);
+void pack_b_q4(std::byte *dst, fp16_t *dst_scales, fp16_t *dst_mins,
+               const uint8_t *codes, const fp16_t *scales, const fp16_t *mins, size_t n, size_t k, size_t group);
+
+// W8A8 variant of the packed layout (see PackedWeight): bytes of the panels, and the packing
+// from quantize::quantize_rows_i8 output, which also stores the [n] row sums of the codes.
+size_t packed_w8a8_bytes(size_t n, size_t k);
+void pack_b_w8a8(std::byte *dst, int32_t *row_sums, const int8_t *codes, size_t n, size_t k);
+
+// Same as gemm() with B given in the packed layout, possibly quantized. Q8 scales are applied
+// to the accumulated tile before the epilogue; Q4 panels are expanded to fp32 with their group
+// scales while loading a block of B. W8A8 quantizes each row of A to int8 and multiplies in
+// integer arithmetic, applying both scales to the int32 result.
+void gemm_packed(std::byte *c, size_t ldc,
+                 const std::byte *a, size_t lda,
+                 const PackedWeight &b,
+                 const LinearEpilogue &epilogue,
+                 llaisysDataType_t type, size_t m, size_t n, size_t k);
+} // namespace llaisys::ops::cpu::gemm
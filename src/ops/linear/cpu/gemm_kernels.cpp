@@ -0,0 +1,324 @@
+#include "gemm_kernels.hpp"
+
+#if defined(LLAISYS_X86)
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+namespace llaisys::ops::cpu::gemm {
+namespace {
+// Portable 4x8 tile; plain loops that the compiler can auto-vectorize with the baseline ISA.
+void kernel_scalar_4x8(size_t kc, const float *a, const float *b, float *c, size_t ldc, bool accumulate) {
+    float acc[4][8] = {};
+    for (size_t p = 0; p < kc; p++) {
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 8; j++) {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+        a += 4;
+        b += 8;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+// Portable int8 tile; MR = 1 serves as the single-row kernel.
+template <size_t MR>
+void kernel_i8_scalar(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    int32_t acc[MR][8] = {};
+    for (size_t p = 0; p < kq; p++) {
+        for (size_t i = 0; i < MR; i++) {
+            for (size_t j = 0; j < 8; j++) {
+                for (size_t t = 0; t < 4; t++) {
+                    acc[i][j] += int32_t(a[i * 4 + t]) * int32_t(b[j * 4 + t]);
+                }
+            }
+        }
+        a += MR * 4;
+        b += 32;
+    }
+    std::memcpy(c, acc, sizeof(acc));
+}
+
+#if defined(LLAISYS_X86)
+// 6x16 tile: 12 ymm accumulators, 2 B loads and 6 broadcasts per k step.
+LLAISYS_TARGET_AVX2 void kernel_avx2_6x16(size_t kc, const float *a, const float *b, float *c, size_t ldc, bool accumulate) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+        __m256 av;
+        av = _mm256_broadcast_ss(a + 0);
+        c00 = _mm256_fmadd_ps(av, b0, c00);
+        c01 = _mm256_fmadd_ps(av, b1, c01);
+        av = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(av, b0, c10);
+        c11 = _mm256_fmadd_ps(av, b1, c11);
+        av = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(av, b0, c20);
+        c21 = _mm256_fmadd_ps(av, b1, c21);
+        av = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(av, b0, c30);
+        c31 = _mm256_fmadd_ps(av, b1, c31);
+        av = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(av, b0, c40);
+        c41 = _mm256_fmadd_ps(av, b1, c41);
+        av = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(av, b0, c50);
+        c51 = _mm256_fmadd_ps(av, b1, c51);
+        a += 6;
+        b += 16;
+    }
+    __m256 acc[6][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}};
+    for (size_t i = 0; i < 6; i++) {
+        float *row = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(row));
+            acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(row + 8));
+        }
+        _mm256_storeu_ps(row, acc[i][0]);
+        _mm256_storeu_ps(row + 8, acc[i][1]);
+    }
+}
+
+// 12x32 tile: 24 zmm accumulators, 2 B loads and 12 broadcasts per k step.
+LLAISYS_TARGET_AVX512 void kernel_avx512_12x32(size_t kc, const float *a, const float *b, float *c, size_t ldc, bool accumulate) {
+    __m512 c0[12], c1[12];
+    for (size_t i = 0; i < 12; i++) {
+        c0[i] = _mm512_setzero_ps();
+        c1[i] = _mm512_setzero_ps();
+    }
+    for (size_t p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+        for (size_t i = 0; i < 12; i++) {
+            __m512 av = _mm512_set1_ps(a[i]);
+            c0[i] = _mm512_fmadd_ps(av, b0, c0[i]);
+            c1[i] = _mm512_fmadd_ps(av, b1, c1[i]);
+        }
+        a += 12;
+        b += 32;
+    }
+    for (size_t i = 0; i < 12; i++) {
+        float *row = c + i * ldc;
+        if (accumulate) {
+            c0[i] = _mm512_add_ps(c0[i], _mm512_loadu_ps(row));
+            c1[i] = _mm512_add_ps(c1[i], _mm512_loadu_ps(row + 16));
+        }
+        _mm512_storeu_ps(row, c0[i]);
+        _mm512_storeu_ps(row + 16, c1[i]);
+    }
+}
+
+// Signed int8 dot products without VNNI: VPMADDUBSW wants an unsigned operand, so the sign of
+// `a` is moved onto `b`. Codes are within +-127, so the pairwise int16 sums cannot saturate.
+LLAISYS_TARGET_AVX2 inline __m256i dot_i8_avx2(__m256i acc, __m256i a, __m256i b) {
+    __m256i prod = _mm256_maddubs_epi16(_mm256_abs_epi8(a), _mm256_sign_epi8(b, a));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(prod, _mm256_set1_epi16(1)));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512i dot_i8_avx512(__m512i acc, __m512i a, __m512i b) {
+    __m512i signed_b = _mm512_mask_sub_epi8(b, _mm512_movepi8_mask(a), _mm512_setzero_si512(), b);
+    __m512i prod = _mm512_maddubs_epi16(_mm512_abs_epi8(a), signed_b);
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(prod, _mm512_set1_epi16(1)));
+}
+
+inline int32_t load_quad(const int8_t *p) {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 6x16 int8 tile: 12 ymm accumulators, each k step covers 4 k.
+LLAISYS_TARGET_AVX2 void kernel_i8_avx2_6x16(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m256i c0[6], c1[6];
+    for (size_t i = 0; i < 6; i++) {
+        c0[i] = _mm256_setzero_si256();
+        c1[i] = _mm256_setzero_si256();
+    }
+    for (size_t p = 0; p < kq; p++) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 32));
+        for (size_t i = 0; i < 6; i++) {
+            __m256i av = _mm256_set1_epi32(load_quad(a + i * 4));
+            c0[i] = dot_i8_avx2(c0[i], av, b0);
+            c1[i] = dot_i8_avx2(c1[i], av, b1);
+        }
+        a += 24;
+        b += 64;
+    }
+    for (size_t i = 0; i < 6; i++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(c + i * 16), c0[i]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(c + i * 16 + 8), c1[i]);
+    }
+}
+
+// Single row: two independent k streams hide the dot-product latency.
+LLAISYS_TARGET_AVX2 void kernel_i8_avx2_row(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m256i c0 = _mm256_setzero_si256(), c1 = _mm256_setzero_si256();
+    __m256i c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+    size_t p = 0;
+    for (; p + 2 <= kq; p += 2) {
+        __m256i a0 = _mm256_set1_epi32(load_quad(a));
+        __m256i a1 = _mm256_set1_epi32(load_quad(a + 4));
+        c0 = dot_i8_avx2(c0, a0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+        c1 = dot_i8_avx2(c1, a0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 32)));
+        c2 = dot_i8_avx2(c2, a1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 64)));
+        c3 = dot_i8_avx2(c3, a1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 96)));
+        a += 8;
+        b += 128;
+    }
+    if (p < kq) {
+        __m256i a0 = _mm256_set1_epi32(load_quad(a));
+        c0 = dot_i8_avx2(c0, a0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+        c1 = dot_i8_avx2(c1, a0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 32)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(c), _mm256_add_epi32(c0, c2));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(c + 8), _mm256_add_epi32(c1, c3));
+}
+
+// 8x32 int8 tile for AVX-512 without VNNI; the sign fix-up needs spare registers, hence fewer rows.
+LLAISYS_TARGET_AVX512 void kernel_i8_avx512_8x32(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m512i c0[8], c1[8];
+    for (size_t i = 0; i < 8; i++) {
+        c0[i] = _mm512_setzero_si512();
+        c1[i] = _mm512_setzero_si512();
+    }
+    for (size_t p = 0; p < kq; p++) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 64);
+        for (size_t i = 0; i < 8; i++) {
+            __m512i av = _mm512_set1_epi32(load_quad(a + i * 4));
+            c0[i] = dot_i8_avx512(c0[i], av, b0);
+            c1[i] = dot_i8_avx512(c1[i], av, b1);
+        }
+        a += 32;
+        b += 128;
+    }
+    for (size_t i = 0; i < 8; i++) {
+        _mm512_storeu_si512(c + i * 32, c0[i]);
+        _mm512_storeu_si512(c + i * 32 + 16, c1[i]);
+    }
+}
+
+LLAISYS_TARGET_AVX512 void kernel_i8_avx512_row(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+    size_t p = 0;
+    for (; p + 2 <= kq; p += 2) {
+        __m512i a0 = _mm512_set1_epi32(load_quad(a));
+        __m512i a1 = _mm512_set1_epi32(load_quad(a + 4));
+        c0 = dot_i8_avx512(c0, a0, _mm512_loadu_si512(b));
+        c1 = dot_i8_avx512(c1, a0, _mm512_loadu_si512(b + 64));
+        c2 = dot_i8_avx512(c2, a1, _mm512_loadu_si512(b + 128));
+        c3 = dot_i8_avx512(c3, a1, _mm512_loadu_si512(b + 192));
+        a += 8;
+        b += 256;
+    }
+    if (p < kq) {
+        __m512i a0 = _mm512_set1_epi32(load_quad(a));
+        c0 = dot_i8_avx512(c0, a0, _mm512_loadu_si512(b));
+        c1 = dot_i8_avx512(c1, a0, _mm512_loadu_si512(b + 64));
+    }
+    _mm512_storeu_si512(c, _mm512_add_epi32(c0, c2));
+    _mm512_storeu_si512(c + 16, _mm512_add_epi32(c1, c3));
+}
+
+// 12x32 VNNI tile: 24 zmm accumulators, one VPDPBUSD per row and B vector covers 4 k.
+LLAISYS_TARGET_AVX512VNNI void kernel_i8_vnni_12x32(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m512i c0[12], c1[12];
+    for (size_t i = 0; i < 12; i++) {
+        c0[i] = _mm512_setzero_si512();
+        c1[i] = _mm512_setzero_si512();
+    }
+    for (size_t p = 0; p < kq; p++) {
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 64);
+        for (size_t i = 0; i < 12; i++) {
+            __m512i av = _mm512_set1_epi32(load_quad(a + i * 4));
+            c0[i] = _mm512_dpbusd_epi32(c0[i], av, b0);
+            c1[i] = _mm512_dpbusd_epi32(c1[i], av, b1);
+        }
+        a += 48;
+        b += 128;
+    }
+    for (size_t i = 0; i < 12; i++) {
+        _mm512_storeu_si512(c + i * 32, c0[i]);
+        _mm512_storeu_si512(c + i * 32 + 16, c1[i]);
+    }
+}
+
+LLAISYS_TARGET_AVX512VNNI void kernel_i8_vnni_row(size_t kq, const int8_t *a, const int8_t *b, int32_t *c) {
+    __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+    size_t p = 0;
+    for (; p + 2 <= kq; p += 2) {
+        __m512i a0 = _mm512_set1_epi32(load_quad(a));
+        __m512i a1 = _mm512_set1_epi32(load_quad(a + 4));
+        c0 = _mm512_dpbusd_epi32(c0, a0, _mm512_loadu_si512(b));
+        c1 = _mm512_dpbusd_epi32(c1, a0, _mm512_loadu_si512(b + 64));
+        c2 = _mm512_dpbusd_epi32(c2, a1, _mm512_loadu_si512(b + 128));
+        c3 = _mm512_dpbusd_epi32(c3, a1, _mm512_loadu_si512(b + 192));
+        a += 8;
+        b += 256;
+    }
+    if (p < kq) {
+        __m512i a0 = _mm512_set1_epi32(load_quad(a));
+        c0 = _mm512_dpbusd_epi32(c0, a0, _mm512_loadu_si512(b));
+        c1 = _mm512_dpbusd_epi32(c1, a0, _mm512_loadu_si512(b + 64));
+    }
+    _mm512_storeu_si512(c, _mm512_add_epi32(c0, c2));
+    _mm512_storeu_si512(c + 16, _mm512_add_epi32(c1, c3));
+}
+#endif
+} // namespace
+
+const Microkernel &microkernel(utils::CpuIsa isa) {
+    static const Microkernel scalar{4, 8, &kernel_scalar_4x8};
+#if defined(LLAISYS_X86)
+    static const Microkernel avx2{6, 16, &kernel_avx2_6x16};
+    static const Microkernel avx512{12, 32, &kernel_avx512_12x32};
+    switch (isa) {
+    case utils::CpuIsa::AVX512:
+        return avx512;
+    case utils::CpuIsa::AVX2:
+        return avx2;
+    default:
+        return scalar;
+    }
+#else
+    (void)isa;
+    return scalar;
+#endif
+}
+
+const MicrokernelI8 &microkernel_i8(utils::CpuIsa isa) {
+    static const MicrokernelI8 scalar{4, 8, false, &kernel_i8_scalar<4>, &kernel_i8_scalar<1>};
+#if defined(LLAISYS_X86)
+    static const MicrokernelI8 avx2{6, 16, false, &kernel_i8_avx2_6x16, &kernel_i8_avx2_row};
+    static const MicrokernelI8 avx512{8, 32, false, &kernel_i8_avx512_8x32, &kernel_i8_avx512_row};
+    static const MicrokernelI8 vnni{12, 32, true, &kernel_i8_vnni_12x32, &kernel_i8_vnni_row};
+    switch (isa) {
+    case utils::CpuIsa::AVX512:
+        return utils::cpu_info().avx512_vnni ? vnni : avx512;
+    case utils::CpuIsa::AVX2:
+        return avx2;
+    default:
+        return scalar;
+    }
+#else
+    (void)isa;
+    return scalar;
+#endif
+}
+} // namespace llaisys::ops::cpu::gemm
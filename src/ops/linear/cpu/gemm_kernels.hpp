@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../../../utils/cpu_info.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace llaisys::ops::cpu::gemm {
+// Register-tiled microkernel: C[mr, nr] (+)= A_panel * B_panel over kc steps.
+// A_panel is packed k-major as [kc][mr], B_panel as [kc][nr], C is row-major with stride ldc.
+typedef void (*microkernel_fn)(size_t kc, const float *a, const float *b, float *c, size_t ldc, bool accumulate);
+
+struct Microkernel {
+    size_t mr;
+    size_t nr;
+    microkernel_fn compute;
+};
+
+// Largest tile over all kernels, for stack-allocated edge tiles.
+constexpr size_t MAX_MR = 12;
+constexpr size_t MAX_NR = 32;
+
+const Microkernel &microkernel(utils::CpuIsa isa);
+
+// Integer microkernel for W8A8: C[mr, nr] = A_panel * B_panel in int32 over kq steps of 4 k each.
+// A_panel is packed as [kq][mr][4] int8 codes, B_panel as [kq][nr][4]; C is [mr][nr] and
+// overwritten. compute_row is the single-row case, with A a plain row of 4 * kq codes.
+// When unsigned_a is set, A codes are stored offset by 128 and read as uint8 (VPDPBUSD), and
+// the caller subtracts 128 * sum(B column) from each result.
+typedef void (*microkernel_i8_fn)(size_t kq, const int8_t *a, const int8_t *b, int32_t *c);
+
+struct MicrokernelI8 {
+    size_t mr;
+    size_t nr;
+    bool unsigned_a;
+    microkernel_i8_fn compute;
+    microkernel_i8_fn compute_row;
+};
+
+// Same nr as microkernel(isa), so W8A8 weights share the panel width of the other formats.
+const MicrokernelI8 &microkernel_i8(utils::CpuIsa isa);
+} // namespace llaisys::ops::cpu::gemm
@@ -0,0 +1,750 @@
+#include "../../../utils/simd_x86.hpp"
+
+#include "gemv_cpu.hpp"
+
+#include "epilogue.hpp"
+#include "gemm_kernels.hpp"
+#include "quantize_cpu.hpp"
+
+#include "../../../device/cpu/thread_pool.hpp"
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+// Matrix-vector product for batch_size == 1. Every weight byte is used once, so the kernel
+// is bound by memory bandwidth: it keeps ROWS independent row streams in flight, prefetches
+// each of them ahead of the loads and reuses every x register across those rows.
+namespace llaisys::ops::cpu::gemv {
+namespace {
+// Rows reduced per pass.
+constexpr size_t ROWS = 4;
+// Software prefetch distance along each row; ROWS * PREFETCH_BYTES stays well inside L1.
+constexpr size_t PREFETCH_BYTES = 1024;
+// Threads write disjoint output ranges aligned to a cache line of fp32 results.
+constexpr size_t SPLIT_ALIGN = 16;
+// Below this many weight bytes per thread, waking workers costs more than it saves.
+constexpr size_t MIN_BYTES_PER_THREAD = size_t(1) << 20;
+
+// out[r] = dot(x, w[r * ldw : r * ldw + k]) for r in [0, R)
+template <typename T>
+using rows_fn = void (*)(float *out, const float *x, const T *w, size_t ldw, size_t k);
+
+template <size_t R, typename T>
+void rows_scalar(float *out, const float *x, const T *w, size_t ldw, size_t k) {
+    for (size_t r = 0; r < R; r++) {
+        out[r] = utils::simd::dot(x, w + r * ldw, k);
+    }
+}
+
+#if defined(LLAISYS_X86)
+template <size_t BYTES>
+inline void prefetch_ahead(const void *p) {
+    const char *c = static_cast<const char *>(p) + PREFETCH_BYTES;
+    for (size_t off = 0; off < BYTES; off += 64) {
+        _mm_prefetch(c + off, _MM_HINT_T0);
+    }
+}
+
+template <size_t R, typename T>
+LLAISYS_TARGET_AVX2 void rows_avx2(float *out, const float *x, const T *w, size_t ldw, size_t k) {
+    __m256 acc0[R], acc1[R];
+    for (size_t r = 0; r < R; r++) {
+        acc0[r] = _mm256_setzero_ps();
+        acc1[r] = _mm256_setzero_ps();
+    }
+    size_t i = 0;
+    for (; i + 16 <= k; i += 16) {
+        __m256 x0 = _mm256_loadu_ps(x + i);
+        __m256 x1 = _mm256_loadu_ps(x + i + 8);
+        for (size_t r = 0; r < R; r++) {
+            const T *row = w + r * ldw + i;
+            prefetch_ahead<16 * sizeof(T)>(row);
+            acc0[r] = _mm256_fmadd_ps(x0, utils::simd::load8(row), acc0[r]);
+            acc1[r] = _mm256_fmadd_ps(x1, utils::simd::load8(row + 8), acc1[r]);
+        }
+    }
+    for (size_t r = 0; r < R; r++) {
+        out[r] = utils::simd::hsum8(_mm256_add_ps(acc0[r], acc1[r]));
+        for (size_t t = i; t < k; t++) {
+            out[r] += x[t] * utils::cast<float>(w[r * ldw + t]);
+        }
+    }
+}
+
+template <size_t R, typename T>
+LLAISYS_TARGET_AVX512 void rows_avx512(float *out, const float *x, const T *w, size_t ldw, size_t k) {
+    __m512 acc0[R], acc1[R];
+    for (size_t r = 0; r < R; r++) {
+        acc0[r] = _mm512_setzero_ps();
+        acc1[r] = _mm512_setzero_ps();
+    }
+    size_t i = 0;
+    for (; i + 32 <= k; i += 32) {
+        __m512 x0 = _mm512_loadu_ps(x + i);
+        __m512 x1 = _mm512_loadu_ps(x + i + 16);
+        for (size_t r = 0; r < R; r++) {
+            const T *row = w + r * ldw + i;
+            prefetch_ahead<32 * sizeof(T)>(row);
+            acc0[r] = _mm512_fmadd_ps(x0, utils::simd::load16(row), acc0[r]);
+            acc1[r] = _mm512_fmadd_ps(x1, utils::simd::load16(row + 16), acc1[r]);
+        }
+    }
+    if (i + 16 <= k) {
+        __m512 x0 = _mm512_loadu_ps(x + i);
+        for (size_t r = 0; r < R; r++) {
+            acc0[r] = _mm512_fmadd_ps(x0, utils::simd::load16(w + r * ldw + i), acc0[r]);
+        }
+        i += 16;
+    }
+    for (size_t r = 0; r < R; r++) {
+        out[r] = _mm512_reduce_add_ps(_mm512_add_ps(acc0[r], acc1[r]));
+        for (size_t t = i; t < k; t++) {
+            out[r] += x[t] * utils::cast<float>(w[r * ldw + t]);
+        }
+    }
+}
+
+// Packed weights (gemm::pack_b): one panel of NR rows is a single [k][NR] stream, so the
+// kernel broadcasts x[p] and accumulates whole rows of the panel without horizontal sums.
+template <typename T>
+LLAISYS_TARGET_AVX2 void panel_avx2_16(float *out, const float *x, const T *w, size_t k) {
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+    size_t p = 0;
+    for (; p + 2 <= k; p += 2) {
+        prefetch_ahead<32 * sizeof(T)>(w);
+        __m256 x0 = _mm256_set1_ps(x[p]);
+        __m256 x1 = _mm256_set1_ps(x[p + 1]);
+        a0 = _mm256_fmadd_ps(x0, utils::simd::load8(w), a0);
+        a1 = _mm256_fmadd_ps(x0, utils::simd::load8(w + 8), a1);
+        b0 = _mm256_fmadd_ps(x1, utils::simd::load8(w + 16), b0);
+        b1 = _mm256_fmadd_ps(x1, utils::simd::load8(w + 24), b1);
+        w += 32;
+    }
+    if (p < k) {
+        __m256 x0 = _mm256_set1_ps(x[p]);
+        a0 = _mm256_fmadd_ps(x0, utils::simd::load8(w), a0);
+        a1 = _mm256_fmadd_ps(x0, utils::simd::load8(w + 8), a1);
+    }
+    _mm256_storeu_ps(out, _mm256_add_ps(a0, b0));
+    _mm256_storeu_ps(out + 8, _mm256_add_ps(a1, b1));
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 void panel_avx512_32(float *out, const float *x, const T *w, size_t k) {
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+    __m512 b0 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+    size_t p = 0;
+    for (; p + 2 <= k; p += 2) {
+        prefetch_ahead<64 * sizeof(T)>(w);
+        __m512 x0 = _mm512_set1_ps(x[p]);
+        __m512 x1 = _mm512_set1_ps(x[p + 1]);
+        a0 = _mm512_fmadd_ps(x0, utils::simd::load16(w), a0);
+        a1 = _mm512_fmadd_ps(x0, utils::simd::load16(w + 16), a1);
+        b0 = _mm512_fmadd_ps(x1, utils::simd::load16(w + 32), b0);
+        b1 = _mm512_fmadd_ps(x1, utils::simd::load16(w + 48), b1);
+        w += 64;
+    }
+    if (p < k) {
+        __m512 x0 = _mm512_set1_ps(x[p]);
+        a0 = _mm512_fmadd_ps(x0, utils::simd::load16(w), a0);
+        a1 = _mm512_fmadd_ps(x0, utils::simd::load16(w + 16), a1);
+    }
+    _mm512_storeu_ps(out, _mm512_add_ps(a0, b0));
+    _mm512_storeu_ps(out + 16, _mm512_add_ps(a1, b1));
+}
+
+// 4-bit panels: the codes of each group are accumulated as is and dequantized once per group,
+// out[r] = sum_g scale[g][r] * dot(x_g, q_g[r]) + min[g][r] * sum(x_g), so the inner loop is
+// one nibble unpack and two FMAs per k step.
+LLAISYS_TARGET_AVX2 void panel_q4_avx2_16(float *out, const float *x, const float *xsum, const uint8_t *w,
+                                          const fp16_t *scales, const fp16_t *mins, size_t k, size_t group) {
+    __m256 y0 = _mm256_setzero_ps(), y1 = _mm256_setzero_ps();
+    for (size_t k0 = 0, g = 0; k0 < k; k0 += group, g++) {
+        size_t k1 = std::min(k, k0 + group);
+        __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+        __m256 b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+        __m256 lo, hi;
+        size_t p = k0;
+        for (; p + 4 <= k1; p += 4) {
+            prefetch_ahead<32>(w);
+            __m256 x0 = _mm256_set1_ps(x[p]), x1 = _mm256_set1_ps(x[p + 1]);
+            __m256 x2 = _mm256_set1_ps(x[p + 2]), x3 = _mm256_set1_ps(x[p + 3]);
+            utils::simd::load8_u4(w, lo, hi);
+            a0 = _mm256_fmadd_ps(x0, lo, a0);
+            a1 = _mm256_fmadd_ps(x0, hi, a1);
+            utils::simd::load8_u4(w + 8, lo, hi);
+            b0 = _mm256_fmadd_ps(x1, lo, b0);
+            b1 = _mm256_fmadd_ps(x1, hi, b1);
+            utils::simd::load8_u4(w + 16, lo, hi);
+            a0 = _mm256_fmadd_ps(x2, lo, a0);
+            a1 = _mm256_fmadd_ps(x2, hi, a1);
+            utils::simd::load8_u4(w + 24, lo, hi);
+            b0 = _mm256_fmadd_ps(x3, lo, b0);
+            b1 = _mm256_fmadd_ps(x3, hi, b1);
+            w += 32;
+        }
+        for (; p < k1; p++) {
+            __m256 x0 = _mm256_set1_ps(x[p]);
+            utils::simd::load8_u4(w, lo, hi);
+            a0 = _mm256_fmadd_ps(x0, lo, a0);
+            a1 = _mm256_fmadd_ps(x0, hi, a1);
+            w += 8;
+        }
+        __m256 s0 = utils::simd::load8(scales + g * 16), s1 = utils::simd::load8(scales + g * 16 + 8);
+        __m256 m0, m1;
+        if (mins) {
+            m0 = utils::simd::load8(mins + g * 16);
+            m1 = utils::simd::load8(mins + g * 16 + 8);
+        } else {
+            m0 = _mm256_mul_ps(s0, _mm256_set1_ps(-8.0f));
+            m1 = _mm256_mul_ps(s1, _mm256_set1_ps(-8.0f));
+        }
+        __m256 xs = _mm256_set1_ps(xsum[g]);
+        y0 = _mm256_fmadd_ps(s0, _mm256_add_ps(a0, b0), _mm256_fmadd_ps(m0, xs, y0));
+        y1 = _mm256_fmadd_ps(s1, _mm256_add_ps(a1, b1), _mm256_fmadd_ps(m1, xs, y1));
+    }
+    _mm256_storeu_ps(out, y0);
+    _mm256_storeu_ps(out + 8, y1);
+}
+
+LLAISYS_TARGET_AVX512 void panel_q4_avx512_32(float *out, const float *x, const float *xsum, const uint8_t *w,
+                                              const fp16_t *scales, const fp16_t *mins, size_t k, size_t group) {
+    __m512 y0 = _mm512_setzero_ps(), y1 = _mm512_setzero_ps();
+    for (size_t k0 = 0, g = 0; k0 < k; k0 += group, g++) {
+        size_t k1 = std::min(k, k0 + group);
+        __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+        __m512 b0 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+        __m512 lo, hi;
+        size_t p = k0;
+        for (; p + 4 <= k1; p += 4) {
+            prefetch_ahead<64>(w);
+            __m512 x0 = _mm512_set1_ps(x[p]), x1 = _mm512_set1_ps(x[p + 1]);
+            __m512 x2 = _mm512_set1_ps(x[p + 2]), x3 = _mm512_set1_ps(x[p + 3]);
+            utils::simd::load16_u4(w, lo, hi);
+            a0 = _mm512_fmadd_ps(x0, lo, a0);
+            a1 = _mm512_fmadd_ps(x0, hi, a1);
+            utils::simd::load16_u4(w + 16, lo, hi);
+            b0 = _mm512_fmadd_ps(x1, lo, b0);
+            b1 = _mm512_fmadd_ps(x1, hi, b1);
+            utils::simd::load16_u4(w + 32, lo, hi);
+            a0 = _mm512_fmadd_ps(x2, lo, a0);
+            a1 = _mm512_fmadd_ps(x2, hi, a1);
+            utils::simd::load16_u4(w + 48, lo, hi);
+            b0 = _mm512_fmadd_ps(x3, lo, b0);
+            b1 = _mm512_fmadd_ps(x3, hi, b1);
+            w += 64;
+        }
+        for (; p < k1; p++) {
+            __m512 x0 = _mm512_set1_ps(x[p]);
+            utils::simd::load16_u4(w, lo, hi);
+            a0 = _mm512_fmadd_ps(x0, lo, a0);
+            a1 = _mm512_fmadd_ps(x0, hi, a1);
+            w += 16;
+        }
+        __m512 s0 = utils::simd::load16(scales + g * 32), s1 = utils::simd::load16(scales + g * 32 + 16);
+        __m512 m0, m1;
+        if (mins) {
+            m0 = utils::simd::load16(mins + g * 32);
+            m1 = utils::simd::load16(mins + g * 32 + 16);
+        } else {
+            m0 = _mm512_mul_ps(s0, _mm512_set1_ps(-8.0f));
+            m1 = _mm512_mul_ps(s1, _mm512_set1_ps(-8.0f));
+        }
+        __m512 xs = _mm512_set1_ps(xsum[g]);
+        y0 = _mm512_fmadd_ps(s0, _mm512_add_ps(a0, b0), _mm512_fmadd_ps(m0, xs, y0));
+        y1 = _mm512_fmadd_ps(s1, _mm512_add_ps(a1, b1), _mm512_fmadd_ps(m1, xs, y1));
+    }
+    _mm512_storeu_ps(out, y0);
+    _mm512_storeu_ps(out + 16, y1);
+}
+#endif
+
+template <size_t NR, typename T>
+void panel_scalar(float *out, const float *x, const T *w, size_t k) {
+    float acc[NR] = {};
+    for (size_t p = 0; p < k; p++) {
+        for (size_t r = 0; r < NR; r++) {
+            acc[r] += x[p] * utils::cast<float>(w[r]);
+        }
+        w += NR;
+    }
+    std::copy(acc, acc + NR, out);
+}
+
+// Portable 4-bit panel kernel: expand one group at a time and reuse the fp32 panel kernel.
+template <size_t NR>
+void panel_q4_scalar(float *out, const float *x, const float *, const uint8_t *w,
+                     const fp16_t *scales, const fp16_t *mins, size_t k, size_t group) {
+    float acc[NR] = {};
+    float part[NR];
+    thread_local std::vector<float> buf;
+    buf.resize(group * NR);
+    for (size_t k0 = 0; k0 < k; k0 += group) {
+        size_t kc = std::min(group, k - k0);
+        quantize::dequantize_q4_panel(buf.data(), w, scales, mins, NR, k0, kc, group);
+        panel_scalar<NR>(part, x + k0, buf.data(), kc);
+        for (size_t r = 0; r < NR; r++) {
+            acc[r] += part[r];
+        }
+    }
+    std::copy(acc, acc + NR, out);
+}
+
+// out[r] = dot(x, row r of the panel) for the nr rows of one packed panel
+template <typename T>
+using panel_fn = void (*)(float *out, const float *x, const T *w, size_t k);
+
+// out[r] = dot(x, dequantized row r) for one 4-bit panel; xsum holds sum(x) per group.
+using panel_q4_fn = void (*)(float *out, const float *x, const float *xsum, const uint8_t *w,
+                             const fp16_t *scales, const fp16_t *mins, size_t k, size_t group);
+
+panel_q4_fn panel_q4_kernel(size_t nr) {
+    switch (nr) {
+#if defined(LLAISYS_X86)
+    case 32:
+        return &panel_q4_avx512_32;
+    case 16:
+        return &panel_q4_avx2_16;
+#endif
+    default:
+        break;
+    }
+    CHECK_ARGUMENT(nr == 8, "GEMV: unsupported packed panel width");
+    return &panel_q4_scalar<8>;
+}
+
+// The panel width is fixed by the ISA the weights were packed for.
+template <typename T>
+panel_fn<T> panel_kernel(size_t nr) {
+    switch (nr) {
+#if defined(LLAISYS_X86)
+    case 32:
+        return &panel_avx512_32<T>;
+    case 16:
+        return &panel_avx2_16<T>;
+#endif
+    default:
+        break;
+    }
+    CHECK_ARGUMENT(nr == 8, "GEMV: unsupported packed panel width");
+    return &panel_scalar<8, T>;
+}
+
+template <typename T>
+struct Kernels {
+    rows_fn<T> block; // ROWS rows
+    rows_fn<T> single;
+};
+
+template <typename T>
+Kernels<T> kernels(utils::CpuIsa isa) {
+#if defined(LLAISYS_X86)
+    switch (isa) {
+    case utils::CpuIsa::AVX512:
+        return {&rows_avx512<ROWS, T>, &rows_avx512<1, T>};
+    case utils::CpuIsa::AVX2:
+        return {&rows_avx2<ROWS, T>, &rows_avx2<1, T>};
+    default:
+        break;
+    }
+#else
+    (void)isa;
+#endif
+    return {&rows_scalar<ROWS, T>, &rows_scalar<1, T>};
+}
+
+// Gumbel(0, 1) noise for output `index`, a pure function of (seed, index) so that the sample
+// does not depend on how the outputs are split across threads. u has 24 bits, so the noise is
+// below GUMBEL_MAX.
+constexpr float GUMBEL_MAX = 17.5f;
+
+inline float gumbel(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull * (index + 1); // splitmix64
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    double u = (static_cast<double>(z >> 40) + 0.5) * (1.0 / 16777216.0);
+    return static_cast<float>(-std::log(-std::log(u)));
+}
+
+// Running selection of the k best outputs of a row: the highest keys, ties going to the lower
+// index as in the argmax op. The key is the output itself, or output / temperature + Gumbel
+// noise to sample. Kept as a heap with the worst entry in front, so most outputs cost one
+// compare against it (a whole segment at once without noise).
+class Selection {
+public:
+    Selection(size_t k, float temperature, uint64_t seed)
+        : _k(k), _inv_temp(temperature > 0.0f ? 1.0f / temperature : 0.0f), _seed(seed) {
+        _heap.reserve(k);
+    }
+
+    // Offer outputs [j, j + len)
+    void push(const float *vals, size_t j, size_t len) {
+        if (_inv_temp == 0.0f) {
+            // Outputs arrive in index order, so one equal to the worst entry loses the tie
+            if (full() && *std::max_element(vals, vals + len) <= _worst) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                offer({vals[i], vals[i], static_cast<int64_t>(j + i)});
+            }
+            return;
+        }
+        for (size_t i = 0; i < len; i++) {
+            float scaled = vals[i] * _inv_temp;
+            if (full() && scaled + GUMBEL_MAX <= _worst) {
+                continue;
+            }
+            offer({scaled + gumbel(_seed, j + i), vals[i], static_cast<int64_t>(j + i)});
+        }
+    }
+
+    void merge(const Selection &other) {
+        for (const Entry &e : other._heap) {
+            offer(e);
+        }
+    }
+
+    // The selected indices and their outputs, best first; fewer than k if the row is shorter.
+    void write(int64_t *indices, float *values) {
+        std::sort_heap(_heap.begin(), _heap.end(), &better);
+        for (size_t i = 0; i < _heap.size(); i++) {
+            indices[i] = _heap[i].index;
+            values[i] = _heap[i].value;
+        }
+    }
+
+    Selection like() const {
+        Selection s(_k, 0.0f, _seed);
+        s._inv_temp = _inv_temp;
+        return s;
+    }
+
+private:
+    struct Entry {
+        float key;
+        float value;
+        int64_t index;
+    };
+
+    static bool better(const Entry &a, const Entry &b) {
+        return a.key > b.key || (a.key == b.key && a.index < b.index);
+    }
+
+    bool full() const {
+        return _heap.size() == _k;
+    }
+
+    void offer(const Entry &e) {
+        if (!full()) {
+            _heap.push_back(e);
+            std::push_heap(_heap.begin(), _heap.end(), &better);
+        } else if (better(e, _heap.front())) {
+            std::pop_heap(_heap.begin(), _heap.end(), &better);
+            _heap.back() = e;
+            std::push_heap(_heap.begin(), _heap.end(), &better);
+        } else {
+            return;
+        }
+        if (full()) {
+            _worst = _heap.front().key;
+        }
+    }
+
+    size_t _k;
+    float _inv_temp;
+    uint64_t _seed;
+    float _worst = -std::numeric_limits<float>::infinity();
+    std::vector<Entry> _heap;
+};
+
+// The selection of one row, filled by every thread's own Selection at the end of its range
+struct SharedSelection {
+    Selection best;
+    std::mutex mutex;
+
+    void merge(const Selection &part) {
+        std::lock_guard<std::mutex> lock(mutex);
+        best.merge(part);
+    }
+};
+
+// T is the activation/output type, TB the weight type (T itself, FP8, or int8 for quantized weights).
+template <typename T, typename TB = T>
+struct Problem {
+    T *y;
+    const float *x; // widened to fp32 once per call
+    const TB *w;
+    size_t ldw;
+    const Epilogue<T> &ep; // bias, Q8 row scales and the fused output stages
+    float *staged;         // with RoPE: [n] fp32 results awaiting Epilogue::post, else null
+    size_t k;
+    SharedSelection *select = nullptr; // select outputs instead of storing y
+};
+
+// A thread's part of Problem::select, empty if the outputs are stored
+template <typename T, typename TB>
+std::optional<Selection> local_selection(const Problem<T, TB> &p) {
+    return p.select ? std::optional<Selection>(p.select->best.like()) : std::nullopt;
+}
+
+// Finish outputs [j, j + len) of y, stage them when RoPE needs the whole row first, or offer
+// them to the thread's selection.
+template <typename T, typename TB>
+void emit(const Problem<T, TB> &p, float *acc, size_t j, size_t len, Selection *sel = nullptr) {
+    if (sel) {
+        p.ep.pre(acc, j, len);
+        sel->push(acc, j, len);
+    } else if (p.staged) {
+        p.ep.pre(acc, j, len);
+        std::copy(acc, acc + len, p.staged + j);
+    } else {
+        p.ep.finish(p.y, acc, 0, j, len);
+    }
+}
+
+// The staged row is finished on the calling thread; it is only n floats.
+template <typename T, typename TB>
+void finish_staged(const Problem<T, TB> &p, size_t n) {
+    if (p.staged) {
+        p.ep.post(p.y, p.staged, 0, 0, n);
+    }
+}
+
+template <typename T, typename TB>
+void gemv_range(const Problem<T, TB> &p, const Kernels<TB> &ks, size_t n0, size_t n1) {
+    float acc[ROWS];
+    size_t j = n0;
+    for (; j + ROWS <= n1; j += ROWS) {
+        ks.block(acc, p.x, p.w + j * p.ldw, p.ldw, p.k);
+        emit(p, acc, j, ROWS);
+    }
+    for (; j < n1; j++) {
+        ks.single(acc, p.x, p.w + j * p.ldw, p.ldw, p.k);
+        emit(p, acc, j, 1);
+    }
+}
+
+// 4-bit weights: one panel is k * nr / 2 bytes, its scales/mins groups * nr halves.
+template <typename T>
+void gemv_q4_range(const Problem<T, uint8_t> &p, const PackedWeight &w, const float *xsum, panel_q4_fn kernel,
+                   size_t nr, size_t n, size_t q0, size_t q1) {
+    size_t groups = quantize::q4_groups(p.k, w.group_size);
+    float acc[gemm::MAX_NR];
+    std::optional<Selection> sel = local_selection(p);
+    for (size_t q = q0; q < q1; q++) {
+        kernel(acc, p.x, xsum, p.w + q * p.k * nr / 2, w.group_scales + q * groups * nr,
+               w.group_mins ? w.group_mins + q * groups * nr : nullptr, p.k, w.group_size);
+        size_t j0 = q * nr;
+        emit(p, acc, j0, std::min(nr, n - j0), sel ? &*sel : nullptr);
+    }
+    if (sel) {
+        p.select->merge(*sel);
+    }
+}
+
+template <typename T, typename TB>
+void gemv_packed_range(const Problem<T, TB> &p, panel_fn<TB> kernel, size_t nr, size_t n, size_t q0, size_t q1) {
+    float acc[gemm::MAX_NR];
+    std::optional<Selection> sel = local_selection(p);
+    for (size_t q = q0; q < q1; q++) {
+        kernel(acc, p.x, p.w + q * p.k * nr, p.k);
+        size_t j0 = q * nr;
+        emit(p, acc, j0, std::min(nr, n - j0), sel ? &*sel : nullptr);
+    }
+    if (sel) {
+        p.select->merge(*sel);
+    }
+}
+
+// Run fn(u0, u1) over [0, units) on the thread pool, streaming `bytes` of weights in total:
+// each thread gets at least MIN_BYTES_PER_THREAD of them.
+template <typename F>
+void split_run(size_t units, size_t bytes, const F &fn) {
+    size_t unit_bytes = std::max<size_t>(bytes / std::max<size_t>(units, 1), 1);
+    device::cpu::parallel_for(units, (MIN_BYTES_PER_THREAD + unit_bytes - 1) / unit_bytes, fn);
+}
+
+// Widen x once per call; fp32 x is used in place.
+template <typename T>
+const float *widen_x(const std::byte *x, size_t k) {
+    thread_local std::vector<float> x_buf;
+    if constexpr (std::is_same_v<T, float>) {
+        return reinterpret_cast<const float *>(x);
+    } else {
+        x_buf.resize(k);
+        utils::simd::to_f32(x_buf.data(), reinterpret_cast<const T *>(x), k);
+        return x_buf.data();
+    }
+}
+
+// Scratch row for Problem::staged, empty unless the epilogue has RoPE.
+template <typename T>
+std::vector<float> staging(const Epilogue<T> &ep, size_t n) {
+    return std::vector<float>(ep.rowwise() ? n : 0);
+}
+
+template <typename T, typename TB = T>
+void gemv_packed_typed(std::byte *y, const std::byte *x, const std::byte *w, size_t nr, const float *w_scales,
+                       const LinearEpilogue &epilogue, size_t n, size_t k, size_t swiglu_n, SharedSelection *select) {
+    if (n == 0) {
+        return;
+    }
+    Epilogue<T> ep(epilogue, w_scales, n, n, swiglu_n);
+    std::vector<float> staged = staging(ep, n);
+    Problem<T, TB> p{reinterpret_cast<T *>(y), widen_x<T>(x, k),
+                     reinterpret_cast<const TB *>(w), 0,
+                     ep, staged.empty() ? nullptr : staged.data(), k, select};
+    panel_fn<TB> kernel = panel_kernel<TB>(nr);
+    size_t panels = (n + nr - 1) / nr;
+    split_run(panels, panels * nr * k * sizeof(TB), [&p, kernel, nr, n](size_t q0, size_t q1) {
+        gemv_packed_range(p, kernel, nr, n, q0, q1);
+    });
+    finish_staged(p, n);
+}
+
+template <typename T, typename TB = T>
+void gemv_typed(std::byte *y, const std::byte *x, const std::byte *w, size_t ldw, const LinearEpilogue &epilogue,
+                size_t n, size_t k) {
+    if (n == 0) {
+        return;
+    }
+    Epilogue<T> ep(epilogue, nullptr, n, n, 0);
+    std::vector<float> staged = staging(ep, n);
+    Problem<T, TB> p{reinterpret_cast<T *>(y), widen_x<T>(x, k),
+                     reinterpret_cast<const TB *>(w), ldw,
+                     ep, staged.empty() ? nullptr : staged.data(), k};
+    const Kernels<TB> ks = kernels<TB>(utils::cpu_info().isa);
+    size_t units = (n + SPLIT_ALIGN - 1) / SPLIT_ALIGN;
+    split_run(units, n * k * sizeof(TB), [&p, &ks, n](size_t u0, size_t u1) {
+        gemv_range(p, ks, std::min(n, u0 * SPLIT_ALIGN), std::min(n, u1 * SPLIT_ALIGN));
+    });
+    finish_staged(p, n);
+}
+// FP8 weights are widened in registers like the half-precision ones; any other weight type
+// must match the activations.
+template <typename T>
+void gemv_weights(std::byte *y, const std::byte *x, const std::byte *w, size_t ldw, const LinearEpilogue &epilogue,
+                  llaisysDataType_t type, llaisysDataType_t w_type, size_t n, size_t k) {
+    switch (w_type) {
+    case LLAISYS_DTYPE_F8:
+        return gemv_typed<T, llaisys::f8e4m3_t>(y, x, w, ldw, epilogue, n, k);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return gemv_typed<T, llaisys::f8e5m2_t>(y, x, w, ldw, epilogue, n, k);
+    default:
+        CHECK_ARGUMENT(w_type == type, "GEMV: weight type must match the activations or be FP8");
+        return gemv_typed<T>(y, x, w, ldw, epilogue, n, k);
+    }
+}
+} // namespace
+
+void gemv(std::byte *y, const std::byte *x, const std::byte *w, size_t ldw, const LinearEpilogue &epilogue,
+          llaisysDataType_t type, llaisysDataType_t w_type, size_t n, size_t k) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return gemv_weights<float>(y, x, w, ldw, epilogue, type, w_type, n, k);
+    case LLAISYS_DTYPE_BF16:
+        return gemv_weights<llaisys::bf16_t>(y, x, w, ldw, epilogue, type, w_type, n, k);
+    case LLAISYS_DTYPE_F16:
+        return gemv_weights<llaisys::fp16_t>(y, x, w, ldw, epilogue, type, w_type, n, k);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+namespace {
+template <typename T>
+void gemv_q4_typed(std::byte *y, const std::byte *x, const PackedWeight &w, size_t nr, const LinearEpilogue &epilogue,
+                   size_t n, size_t k, SharedSelection *select) {
+    if (n == 0) {
+        return;
+    }
+    Epilogue<T> ep(epilogue, nullptr, n, n, w.swiglu_features);
+    std::vector<float> staged = staging(ep, n);
+    Problem<T, uint8_t> p{reinterpret_cast<T *>(y), widen_x<T>(x, k),
+                          reinterpret_cast<const uint8_t *>(w.data), 0,
+                          ep, staged.empty() ? nullptr : staged.data(), k, select};
+    // sum(x) per group carries the min (zero point) term of every row.
+    std::vector<float> xsum(quantize::q4_groups(k, w.group_size));
+    for (size_t g = 0; g < xsum.size(); g++) {
+        size_t k0 = g * w.group_size, k1 = std::min(k, k0 + w.group_size);
+        xsum[g] = std::accumulate(p.x + k0, p.x + k1, 0.0f);
+    }
+    panel_q4_fn kernel = panel_q4_kernel(nr);
+    size_t panels = (n + nr - 1) / nr;
+    split_run(panels, panels * nr * k / 2, [&p, &w, &xsum, kernel, nr, n](size_t q0, size_t q1) {
+        gemv_q4_range(p, w, xsum.data(), kernel, nr, n, q0, q1);
+    });
+    finish_staged(p, n);
+}
+
+template <typename T>
+void gemv_packed_weights(std::byte *y, const std::byte *x, const PackedWeight &w, size_t nr,
+                         const LinearEpilogue &epilogue, size_t n, size_t k, SharedSelection *select = nullptr) {
+    switch (w.format) {
+    case LLAISYS_LINEAR_WEIGHT_PACKED:
+    case LLAISYS_LINEAR_WEIGHT_F8:
+        switch (w.dtype) {
+        case LLAISYS_DTYPE_F8:
+            return gemv_packed_typed<T, llaisys::f8e4m3_t>(y, x, w.data, nr, nullptr, epilogue, n, k, w.swiglu_features, select);
+        case LLAISYS_DTYPE_F8_E5M2:
+            return gemv_packed_typed<T, llaisys::f8e5m2_t>(y, x, w.data, nr, nullptr, epilogue, n, k, w.swiglu_features, select);
+        default:
+            return gemv_packed_typed<T>(y, x, w.data, nr, nullptr, epilogue, n, k, w.swiglu_features, select);
+        }
+    case LLAISYS_LINEAR_WEIGHT_Q8:
+        CHECK_ARGUMENT(w.scales, "GEMV: int8 weights come with scales");
+        return gemv_packed_typed<T, int8_t>(y, x, w.data, nr, w.scales, epilogue, n, k, w.swiglu_features, select);
+    case LLAISYS_LINEAR_WEIGHT_Q4:
+    case LLAISYS_LINEAR_WEIGHT_Q4_ZP:
+        CHECK_ARGUMENT(w.group_scales && w.group_size > 0, "GEMV: 4-bit weights come with group scales");
+        return gemv_q4_typed<T>(y, x, w, nr, epilogue, n, k, select);
+    default:
+        CHECK_ARGUMENT(false, "GEMV: unknown packed weight format");
+    }
+}
+} // namespace
+
+void gemv_packed(std::byte *y, const std::byte *x, const PackedWeight &w, size_t nr, const LinearEpilogue &epilogue,
+                 llaisysDataType_t type, size_t n, size_t k) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return gemv_packed_weights<float>(y, x, w, nr, epilogue, n, k);
+    case LLAISYS_DTYPE_BF16:
+        return gemv_packed_weights<llaisys::bf16_t>(y, x, w, nr, epilogue, n, k);
+    case LLAISYS_DTYPE_F16:
+        return gemv_packed_weights<llaisys::fp16_t>(y, x, w, nr, epilogue, n, k);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+void gemv_packed_topk(int64_t *indices, float *values, size_t topk, const std::byte *x, const PackedWeight &w,
+                      size_t nr, llaisysDataType_t type, size_t n, size_t k, float temperature, uint64_t seed) {
+    CHECK_ARGUMENT(!w.swiglu_features, "GEMV: gate/up weights cannot be selected from");
+    SharedSelection select{Selection(topk, temperature, seed), {}};
+    LinearEpilogue epilogue;
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        gemv_packed_weights<float>(nullptr, x, w, nr, epilogue, n, k, &select);
+        break;
+    case LLAISYS_DTYPE_BF16:
+        gemv_packed_weights<llaisys::bf16_t>(nullptr, x, w, nr, epilogue, n, k, &select);
+        break;
+    case LLAISYS_DTYPE_F16:
+        gemv_packed_weights<llaisys::fp16_t>(nullptr, x, w, nr, epilogue, n, k, &select);
+        break;
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+    select.best.write(indices, values);
+}
+} // namespace llaisys::ops::cpu::gemv
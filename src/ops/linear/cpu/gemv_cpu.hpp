@@ -0,0 +1,30 @@
+#pragma once
+#include "llaisys.h"
+
+#include "linear_epilogue.hpp"
+#include "packed_weight.hpp"
+
+#include <cstddef>
+
+namespace llaisys::ops::cpu::gemv {
+// y[n] = epilogue(W[n, k] * x[k])
+// W is row-major with leading dimension ldw in elements; y, x and the epilogue's bias and
+// residual share `type`, W is of `w_type`: the same, or FP8 (E4M3/E5M2) with any activation type.
+// Single-token decode is bound by streaming W, so rows are read exactly once, several
+// at a time, with narrow weights widened in registers and fp32 accumulation.
+void gemv(std::byte *y, const std::byte *x, const std::byte *w, size_t ldw, const LinearEpilogue &epilogue,
+          llaisysDataType_t type, llaisysDataType_t w_type, size_t n, size_t k);
+
+// Same with W in the packed panel layout of gemm::pack_b, `nr` rows per panel, possibly
+// quantized. Quantized codes are widened in registers; Q8 is scaled once per output and Q4
+// once per group (the min term via sum(x) of the group).
+void gemv_packed(std::byte *y, const std::byte *x, const PackedWeight &w, size_t nr, const LinearEpilogue &epilogue,
+                 llaisysDataType_t type, size_t n, size_t k);
+
+// The same product without storing y: each thread keeps a running selection of the `topk`
+// best outputs of its panels, merged at the end into indices/values (best first; values are
+// the fp32 outputs). With temperature > 0 outputs are ranked by y / temperature + Gumbel(0, 1)
+// noise drawn from (seed, index), which samples without replacement from softmax(y / temperature).
+void gemv_packed_topk(int64_t *indices, float *values, size_t topk, const std::byte *x, const PackedWeight &w,
+                      size_t nr, llaisysDataType_t type, size_t n, size_t k, float temperature, uint64_t seed);
+} // namespace llaisys::ops::cpu::gemv
@@ -1,86 +1,168 @@
 #include "linear_cpu.hpp"
 
+#include "gemm_cpu.hpp"
+#include "gemv_cpu.hpp"
+#include "quantize_cpu.hpp"
+
 #include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 // 矩阵乘法: Y = X * W^T + bias
 // X: (batch_size, in_features)
-// W: (out_features, in_features)  
+// W: (out_features, in_features)
 // Y: (batch_size, out_features)
 // bias: (out_features) 可选
-template <typename T>
-void linear_(T *out, const T *in, const T *weight, const T *bias,
-             size_t batch_size, size_t in_features, size_t out_features) {
-    
-    // 对每个批次的每个输出特征计算
-    for (size_t b = 0; b < batch_size; b++) {
-        for (size_t o = 0; o < out_features; o++) {
-            if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                // 对半精度类型，使用float进行累加以避免精度损失
-                float sum_float = 0.0f;
-                
-                // 计算点积: X[b,:] · W[o,:]
-                for (size_t i = 0; i < in_features; i++) {
-                    float x_float = llaisys::utils::cast<float>(in[b * in_features + i]);
-                    float w_float = llaisys::utils::cast<float>(weight[o * in_features + i]);
-                    sum_float += x_float * w_float;
-                }
-                
-                // 添加偏置（如果有）
-                if (bias != nullptr) {
-                    sum_float += llaisys::utils::cast<float>(bias[o]);
-                }
-                
-                out[b * out_features + o] = llaisys::utils::cast<T>(sum_float);
-            } else {
-                // 对全精度类型，直接计算
-                T sum = T(0);
-                
-                // 计算点积: X[b,:] · W[o,:]
-                for (size_t i = 0; i < in_features; i++) {
-                    sum += in[b * in_features + i] * weight[o * in_features + i];
-                }
-                
-                // 添加偏置（如果有）
-                if (bias != nullptr) {
-                    sum += bias[o];
-                }
-                
-                out[b * out_features + o] = sum;
+// 收尾阶段 (bias, 激活, RoPE, 残差, 类型转换) 在输出块仍在缓存中时完成, 见 LinearEpilogue
+// W 可以是 FP8 (E4M3/E5M2), 在寄存器中展开为 fp32, 此时 X/Y 可为任意浮点类型
+namespace llaisys::ops::cpu {
+void linear(std::byte *out, const std::byte *in, const std::byte *weight, const LinearEpilogue &epilogue,
+            llaisysDataType_t type, llaisysDataType_t weight_type, size_t batch_size, size_t in_features,
+            size_t out_features) {
+    // 单 token 解码: 权重只读一遍, 走带宽优化的 GEMV
+    if (batch_size == 1) {
+        return gemv::gemv(out, in, weight, in_features, epilogue, type, weight_type, out_features, in_features);
+    }
+    gemm::gemm(out, out_features, in, in_features, weight, in_features, epilogue,
+               type, weight_type, batch_size, out_features, in_features);
+}
+
+size_t linear_packed_numel(size_t in_features, size_t out_features) {
+    return gemm::packed_numel(out_features, in_features);
+}
+
+void linear_pack_weight(std::byte *packed, const std::byte *weight, llaisysDataType_t type,
+                        size_t in_features, size_t out_features) {
+    gemm::pack_b(packed, weight, in_features, type, out_features, in_features);
+}
+
+// 直接转换为 FP8 E4M3 (饱和到 +-448, 无缩放), 再按相同面板布局打包
+void linear_pack_weight_f8(std::byte *packed, const std::byte *weight, llaisysDataType_t type,
+                           size_t in_features, size_t out_features) {
+    std::vector<f8e4m3_t> w8(out_features * in_features);
+    if (type == LLAISYS_DTYPE_F8) {
+        std::copy_n(reinterpret_cast<const f8e4m3_t *>(weight), w8.size(), w8.data());
+    } else {
+        std::vector<float> row(in_features);
+        size_t elem = utils::dsize(type);
+        for (size_t i = 0; i < out_features; i++) {
+            const std::byte *src = weight + i * in_features * elem;
+            switch (type) {
+            case LLAISYS_DTYPE_F32:
+                std::copy_n(reinterpret_cast<const float *>(src), in_features, row.data());
+                break;
+            case LLAISYS_DTYPE_BF16:
+                utils::simd::to_f32(row.data(), reinterpret_cast<const bf16_t *>(src), in_features);
+                break;
+            case LLAISYS_DTYPE_F16:
+                utils::simd::to_f32(row.data(), reinterpret_cast<const fp16_t *>(src), in_features);
+                break;
+            case LLAISYS_DTYPE_F8_E5M2:
+                utils::simd::to_f32(row.data(), reinterpret_cast<const f8e5m2_t *>(src), in_features);
+                break;
+            default:
+                EXCEPTION_UNSUPPORTED_DATATYPE(type);
             }
+            utils::simd::from_f32(w8.data() + i * in_features, row.data(), in_features);
         }
     }
+    gemm::pack_b(packed, reinterpret_cast<const std::byte *>(w8.data()), in_features, LLAISYS_DTYPE_F8,
+                 out_features, in_features);
 }
 
-namespace llaisys::ops::cpu {
-void linear(std::byte *out, const std::byte *in, const std::byte *weight, const std::byte *bias,
-            llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features) {
-    switch (type) {
-    case LLAISYS_DTYPE_F32:
-        return linear_(
-            reinterpret_cast<float *>(out),
-            reinterpret_cast<const float *>(in),
-            reinterpret_cast<const float *>(weight),
-            bias ? reinterpret_cast<const float *>(bias) : nullptr,
-            batch_size, in_features, out_features
-        );
-    case LLAISYS_DTYPE_BF16:
-        return linear_(
-            reinterpret_cast<llaisys::bf16_t *>(out),
-            reinterpret_cast<const llaisys::bf16_t *>(in),
-            reinterpret_cast<const llaisys::bf16_t *>(weight),
-            bias ? reinterpret_cast<const llaisys::bf16_t *>(bias) : nullptr,
-            batch_size, in_features, out_features
-        );
-    case LLAISYS_DTYPE_F16:
-        return linear_(
-            reinterpret_cast<llaisys::fp16_t *>(out),
-            reinterpret_cast<const llaisys::fp16_t *>(in),
-            reinterpret_cast<const llaisys::fp16_t *>(weight),
-            bias ? reinterpret_cast<const llaisys::fp16_t *>(bias) : nullptr,
-            batch_size, in_features, out_features
-        );
-    default:
-        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+// 逐行 (输出通道) 对称 INT8 量化, 再按相同面板布局打包
+void linear_pack_weight_q8(std::byte *packed, float *scales, const std::byte *weight, llaisysDataType_t type,
+                           size_t in_features, size_t out_features) {
+    std::vector<int8_t> q(out_features * in_features);
+    quantize::quantize_rows_i8(q.data(), scales, weight, type, out_features, in_features);
+    gemm::pack_b(packed, reinterpret_cast<const std::byte *>(q.data()), in_features, LLAISYS_DTYPE_I8,
+                 out_features, in_features);
+}
+
+size_t linear_packed_q4_bytes(size_t in_features, size_t out_features) {
+    return gemm::packed_q4_bytes(out_features, in_features);
+}
+
+size_t linear_packed_q4_groups_numel(size_t in_features, size_t out_features, size_t group_size) {
+    return gemm::packed_q4_groups_numel(out_features, in_features, group_size);
+}
+
+// 按输入维度分组的 4-bit 量化 (每组一个 fp16 缩放, 可选最小值/零点), 两个码字打包进一个字节
+void linear_pack_weight_q4(std::byte *packed, fp16_t *scales, fp16_t *mins, const std::byte *weight,
+                           llaisysDataType_t type, size_t in_features, size_t out_features, size_t group_size) {
+    size_t groups = quantize::q4_groups(in_features, group_size);
+    std::vector<uint8_t> q(out_features * in_features);
+    std::vector<fp16_t> row_scales(out_features * groups), row_mins(mins ? out_features * groups : 0);
+    quantize::quantize_rows_q4(q.data(), row_scales.data(), mins ? row_mins.data() : nullptr, weight, type,
+                               out_features, in_features, group_size);
+    gemm::pack_b_q4(packed, scales, mins, q.data(), row_scales.data(), mins ? row_mins.data() : nullptr,
+                    out_features, in_features, group_size);
+}
+
+size_t linear_packed_w8a8_bytes(size_t in_features, size_t out_features) {
+    return gemm::packed_w8a8_bytes(out_features, in_features);
+}
+
+// 与 Q8 相同的逐行量化, 面板内每 4 个输入交错存放, 供整数点积指令 (VPDPBUSD 等) 直接读取
+void linear_pack_weight_w8a8(std::byte *packed, float *scales, int32_t *row_sums, const std::byte *weight,
+                             llaisysDataType_t type, size_t in_features, size_t out_features) {
+    std::vector<int8_t> q(out_features * in_features);
+    quantize::quantize_rows_i8(q.data(), scales, weight, type, out_features, in_features);
+    gemm::pack_b_w8a8(packed, row_sums, q.data(), out_features, in_features);
+}
+
+size_t linear_gate_up_rows(size_t inter_features) {
+    size_t nr = gemm::panel_width(), half = nr / 2;
+    return (inter_features + half - 1) / half * nr;
+}
+
+// gate/up 按面板交错: 每 nr 行中前 nr/2 行为 gate, 后 nr/2 行为对应的 up, 不足的行补零
+// 这样每个输出面板恰好包含同一组列的 gate 和 up, 可在收尾阶段直接算出 SwiGLU
+void linear_interleave_gate_up(std::byte *fused, const std::byte *gate, const std::byte *up, llaisysDataType_t type,
+                               size_t in_features, size_t inter_features) {
+    size_t half = gemm::panel_width() / 2;
+    size_t row_bytes = in_features * utils::dsize(type);
+    size_t rows = linear_gate_up_rows(inter_features);
+    for (size_t r = 0; r < rows; r++) {
+        size_t i = r % (2 * half);
+        size_t src_row = r / (2 * half) * half + i % half;
+        std::byte *dst = fused + r * row_bytes;
+        if (src_row < inter_features) {
+            std::memcpy(dst, (i < half ? gate : up) + src_row * row_bytes, row_bytes);
+        } else {
+            std::memset(dst, 0, row_bytes);
+        }
+    }
+}
+
+// 预打包权重: GEMM 直接读取面板, 解码 GEMV 顺序流式读取
+// 量化权重在寄存器中展开为 fp32: INT8 缩放在累加结束后按输出通道施加, 4-bit 按组施加
+// W8A8 在任意 batch 下都走整数 GEMM (激活逐 token 量化)
+// gate/up 权重: 按交错后的行数计算, 只写出 out_features 个 SwiGLU 结果
+void linear_packed(std::byte *out, const std::byte *in, const PackedWeight &weight, const LinearEpilogue &epilogue,
+                   llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features) {
+    size_t rows = weight.swiglu_features ? linear_gate_up_rows(out_features) : out_features;
+    if (batch_size == 1 && weight.format != LLAISYS_LINEAR_WEIGHT_W8A8) {
+        return gemv::gemv_packed(out, in, weight, gemm::panel_width(), epilogue, type, rows, in_features);
+    }
+    gemm::gemm_packed(out, out_features, in, in_features, weight, epilogue,
+                      type, batch_size, rows, in_features);
+}
+
+// 融合 LM head 与 top-k: 按词表面板流式读取权重, 各线程在寄存器/局部堆中保留最优的 topk 个输出,
+// 最后合并; 不写出 [batch, out_features] 的 logits
+// 逐行走 GEMV, 适合解码时的少量行
+void linear_packed_topk(int64_t *indices, float *values, size_t topk, const std::byte *in, const PackedWeight &weight,
+                        llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features,
+                        float temperature, uint64_t seed) {
+    size_t row_bytes = in_features * utils::dsize(type);
+    for (size_t b = 0; b < batch_size; b++) {
+        gemv::gemv_packed_topk(indices + b * topk, values + b * topk, topk, in + b * row_bytes, weight,
+                               gemm::panel_width(), type, out_features, in_features, temperature,
+                               seed + 0xD1B54A32D192ED03ull * b);
     }
 }
 } // namespace llaisys::ops::cpu
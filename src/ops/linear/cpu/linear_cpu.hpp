@@ -1,9 +1,52 @@
 #pragma once
 #include "llaisys.h"
 
+#include "linear_epilogue.hpp"
+#include "packed_weight.hpp"
+
 #include <cstddef>
 
 namespace llaisys::ops::cpu {
-void linear(std::byte *out, const std::byte *in, const std::byte *weight, const std::byte *bias,
-            llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features);
+// `weight_type` is `type` or an FP8 type. The epilogue's stages (bias, activation, RoPE,
+// residual) are applied to the finished tiles; see LinearEpilogue.
+void linear(std::byte *out, const std::byte *in, const std::byte *weight, const LinearEpilogue &epilogue,
+            llaisysDataType_t type, llaisysDataType_t weight_type, size_t batch_size, size_t in_features,
+            size_t out_features);
+
+// Weight layout consumed by linear_packed; see gemm::pack_b.
+size_t linear_packed_numel(size_t in_features, size_t out_features);
+void linear_pack_weight(std::byte *packed, const std::byte *weight, llaisysDataType_t type,
+                        size_t in_features, size_t out_features);
+// Same layout in FP8 E4M3, converted with saturation; `type` is any float type.
+void linear_pack_weight_f8(std::byte *packed, const std::byte *weight, llaisysDataType_t type,
+                           size_t in_features, size_t out_features);
+// Same layout in int8: each output row is quantized symmetrically with scales[row] = amax / 127.
+void linear_pack_weight_q8(std::byte *packed, float *scales, const std::byte *weight, llaisysDataType_t type,
+                           size_t in_features, size_t out_features);
+// 4-bit layout: `packed` holds linear_packed_q4_bytes bytes, `scales` and `mins` (null for
+// symmetric quantization) linear_packed_q4_groups_numel halves each.
+size_t linear_packed_q4_bytes(size_t in_features, size_t out_features);
+size_t linear_packed_q4_groups_numel(size_t in_features, size_t out_features, size_t group_size);
+void linear_pack_weight_q4(std::byte *packed, fp16_t *scales, fp16_t *mins, const std::byte *weight,
+                           llaisysDataType_t type, size_t in_features, size_t out_features, size_t group_size);
+// Q8 codes and scales in the W8A8 layout, plus the int32 row sums of the codes.
+size_t linear_packed_w8a8_bytes(size_t in_features, size_t out_features);
+void linear_pack_weight_w8a8(std::byte *packed, float *scales, int32_t *row_sums, const std::byte *weight,
+                             llaisysDataType_t type, size_t in_features, size_t out_features);
+// Gate and up weights of a SwiGLU MLP, both [inter_features, in_features], interleaved into
+// one [linear_gate_up_rows(inter_features), in_features] weight: each panel of the packed
+// layout holds panel_width / 2 gate rows and then the matching up rows, zero-padded at the end.
+size_t linear_gate_up_rows(size_t inter_features);
+void linear_interleave_gate_up(std::byte *fused, const std::byte *gate, const std::byte *up, llaisysDataType_t type,
+                               size_t in_features, size_t inter_features);
+// For a gate/up weight (weight.swiglu_features == out_features), out is [batch_size, out_features]
+// of silu(gate) * up.
+void linear_packed(std::byte *out, const std::byte *in, const PackedWeight &weight, const LinearEpilogue &epilogue,
+                   llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features);
+// indices/values [batch_size, topk]: the topk best outputs of every row of in @ weight^T, best
+// first, without storing the product (see gemv::gemv_packed_topk). Row b samples with seed
+// mixed with b when temperature > 0.
+void linear_packed_topk(int64_t *indices, float *values, size_t topk, const std::byte *in, const PackedWeight &weight,
+                        llaisysDataType_t type, size_t batch_size, size_t in_features, size_t out_features,
+                        float temperature, uint64_t seed);
 }
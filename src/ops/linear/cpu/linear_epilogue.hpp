@@ -0,0 +1,27 @@
+#pragma once
+#include "llaisys/ops.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace llaisys::ops::cpu {
+// Output stages fused into the linear kernels. They run on the fp32 result of each finished
+// tile, before it leaves registers/L1, in this order:
+//   bias        + bias[col], of the output type
+//   activation  SiLU or GELU
+//   rope        the leading rope_cols columns are rotated as heads of rope_head_dim with the
+//               positions rope_pos[row], as by the RoPE op
+//   residual    + residual[row, col], of the output type with the output's row stride; may be
+//               the output itself, which then accumulates the product
+//   store       conversion to the output type
+// A null pointer or zero count disables a stage.
+struct LinearEpilogue {
+    const std::byte *bias = nullptr;
+    llaisysActivation_t activation = LLAISYS_ACTIVATION_NONE;
+    const int64_t *rope_pos = nullptr;
+    size_t rope_cols = 0;
+    size_t rope_head_dim = 0;
+    float rope_theta = 10000.0f;
+    const std::byte *residual = nullptr;
+};
+} // namespace llaisys::ops::cpu
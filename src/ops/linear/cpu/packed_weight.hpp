@@ -0,0 +1,34 @@
+#pragma once
+#include "llaisys/ops.h"
+
+#include "../../../utils/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace llaisys::ops::cpu {
+// A row-major [n, k] linear weight in the panel layout of gemm::pack_b, as read by the
+// packed GEMM and decode GEMV kernels:
+//   PACKED: elements of `dtype`, the activation type or an FP8 type.
+//   F8:     FP8 E4M3 elements, read like PACKED.
+//   Q8:     int8 codes, w = scales[row] * q.
+//   Q4:     4-bit codes, per k step nr / 2 bytes with byte i holding rows i (low nibble) and
+//           i + nr / 2 (high nibble) of the panel. Each group of group_size k steps has an
+//           fp16 scale and min per row, stored per panel as [group][nr]:
+//           w = group_scales * q + group_mins, with group_mins null meaning -8 * scale.
+//   W8A8:   int8 codes as for Q8, but each panel is stored as [ceil(k / 4)][nr][4] (k padded with
+//           zeros) for 4-way integer dot products, with row_sums[row] = sum of the row's codes.
+// Any format may hold an interleaved gate/up weight (see linear_interleave_gate_up), in which
+// case the kernels emit silu(gate) * up for `swiglu_features` outputs instead of the rows.
+struct PackedWeight {
+    const std::byte *data;
+    llaisysLinearWeightFormat_t format;
+    llaisysDataType_t dtype; // element type of data
+    const float *scales = nullptr;
+    const fp16_t *group_scales = nullptr;
+    const fp16_t *group_mins = nullptr;
+    size_t group_size = 0;
+    const int32_t *row_sums = nullptr;
+    size_t swiglu_features = 0;
+};
+} // namespace llaisys::ops::cpu
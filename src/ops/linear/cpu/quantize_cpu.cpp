@@ -0,0 +1,324 @@
+#include "../../../utils/simd_x86.hpp"
+
+#include "quantize_cpu.hpp"
+
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace llaisys::ops::cpu::quantize {
+namespace {
+template <typename T>
+void quantize_rows_i8_(int8_t *dst, float *scales, const T *src, size_t rows, size_t cols) {
+    std::vector<float> row(cols);
+    for (size_t r = 0; r < rows; r++) {
+        utils::simd::to_f32(row.data(), src + r * cols, cols);
+        float amax = 0.0f;
+        for (size_t c = 0; c < cols; c++) {
+            amax = std::max(amax, std::fabs(row[c]));
+        }
+        float scale = amax / 127.0f;
+        scales[r] = scale;
+        int8_t *q = dst + r * cols;
+        if (scale == 0.0f) {
+            std::fill(q, q + cols, int8_t(0));
+            continue;
+        }
+        for (size_t c = 0; c < cols; c++) {
+            q[c] = static_cast<int8_t>(std::clamp(std::nearbyint(row[c] / scale), -127.0f, 127.0f));
+        }
+    }
+}
+
+int8_t a8_code(float x, float inv, bool offset) {
+    int q = static_cast<int>(std::clamp(std::nearbyint(x * inv), -127.0f, 127.0f));
+    return static_cast<int8_t>(offset ? q ^ 0x80 : q);
+}
+
+template <typename T>
+float amax_scalar(const T *src, size_t n) {
+    float amax = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        amax = std::max(amax, std::fabs(utils::cast<float>(src[i])));
+    }
+    return amax;
+}
+
+template <typename T>
+void quantize_a8_scalar(int8_t *dst, const T *src, size_t n, float inv, bool offset) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = a8_code(utils::cast<float>(src[i]), inv, offset);
+    }
+}
+
+#if defined(LLAISYS_X86)
+// Rounded, clamped codes of 8 lanes; the offset flips the sign bit of each byte.
+LLAISYS_TARGET_AVX2 inline void store_a8_8(int8_t *dst, __m256 x, __m256 inv, bool offset) {
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, inv));
+    q = _mm256_min_epi32(_mm256_max_epi32(q, _mm256_set1_epi32(-127)), _mm256_set1_epi32(127));
+    __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+    __m128i b = _mm_packs_epi16(w, w);
+    if (offset) {
+        b = _mm_xor_si128(b, _mm_set1_epi8(char(0x80)));
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), b);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 float amax_avx2(const T *src, size_t n) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 m = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        m = _mm256_max_ps(m, _mm256_and_ps(utils::simd::load8(src + i), abs_mask));
+    }
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+    return std::max(_mm_cvtss_f32(h), amax_scalar(src + i, n - i));
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 void quantize_a8_avx2(int8_t *dst, const T *src, size_t n, float inv, bool offset) {
+    __m256 vinv = _mm256_set1_ps(inv);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        store_a8_8(dst + i, utils::simd::load8(src + i), vinv, offset);
+    }
+    quantize_a8_scalar(dst + i, src + i, n - i, inv, offset);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 float amax_avx512(const T *src, size_t n) {
+    __m512 m = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        m = _mm512_max_ps(m, _mm512_abs_ps(utils::simd::load16(src + i)));
+    }
+    return std::max(_mm512_reduce_max_ps(m), amax_scalar(src + i, n - i));
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 void quantize_a8_avx512(int8_t *dst, const T *src, size_t n, float inv, bool offset) {
+    __m512 vinv = _mm512_set1_ps(inv);
+    __m512i lo = _mm512_set1_epi32(-127), hi = _mm512_set1_epi32(127);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i q = _mm512_cvtps_epi32(_mm512_mul_ps(utils::simd::load16(src + i), vinv));
+        __m128i b = _mm512_cvtepi32_epi8(_mm512_min_epi32(_mm512_max_epi32(q, lo), hi));
+        if (offset) {
+            b = _mm_xor_si128(b, _mm_set1_epi8(char(0x80)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), b);
+    }
+    quantize_a8_scalar(dst + i, src + i, n - i, inv, offset);
+}
+#endif
+
+template <typename T>
+void quantize_rows_a8_(int8_t *dst, size_t ldd, float *scales, const T *src, size_t lds,
+                       size_t rows, size_t cols, bool offset) {
+    utils::CpuIsa isa = utils::cpu_info().isa;
+    for (size_t r = 0; r < rows; r++) {
+        const T *x = src + r * lds;
+        int8_t *q = dst + r * ldd;
+        float amax;
+#if defined(LLAISYS_X86)
+        if (isa == utils::CpuIsa::AVX512) {
+            amax = amax_avx512(x, cols);
+        } else if (isa == utils::CpuIsa::AVX2) {
+            amax = amax_avx2(x, cols);
+        } else
+#endif
+        {
+            amax = amax_scalar(x, cols);
+        }
+        scales[r] = amax / 127.0f;
+        float inv = amax > 0.0f ? 127.0f / amax : 0.0f;
+#if defined(LLAISYS_X86)
+        if (isa == utils::CpuIsa::AVX512) {
+            quantize_a8_avx512(q, x, cols, inv, offset);
+        } else if (isa == utils::CpuIsa::AVX2) {
+            quantize_a8_avx2(q, x, cols, inv, offset);
+        } else
+#endif
+        {
+            quantize_a8_scalar(q, x, cols, inv, offset);
+        }
+    }
+}
+
+// Quantize one group of `n` values; returns the fp16 scale and min actually used.
+void quantize_group_q4(uint8_t *q, fp16_t &scale, fp16_t *min, const float *w, size_t n) {
+    if (!min) {
+        float amax = 0.0f;
+        for (size_t i = 0; i < n; i++) {
+            amax = std::max(amax, std::fabs(w[i]));
+        }
+        scale = utils::cast<fp16_t>(amax / 7.0f);
+        float s = utils::cast<float>(scale);
+        for (size_t i = 0; i < n; i++) {
+            q[i] = s == 0.0f ? 8 : static_cast<uint8_t>(std::clamp(std::nearbyint(w[i] / s), -8.0f, 7.0f) + 8.0f);
+        }
+        return;
+    }
+    float lo = w[0], hi = w[0];
+    for (size_t i = 1; i < n; i++) {
+        lo = std::min(lo, w[i]);
+        hi = std::max(hi, w[i]);
+    }
+    scale = utils::cast<fp16_t>((hi - lo) / 15.0f);
+    *min = utils::cast<fp16_t>(lo);
+    float s = utils::cast<float>(scale), m = utils::cast<float>(*min);
+    for (size_t i = 0; i < n; i++) {
+        q[i] = s == 0.0f ? 0 : static_cast<uint8_t>(std::clamp(std::nearbyint((w[i] - m) / s), 0.0f, 15.0f));
+    }
+}
+
+template <typename T>
+void quantize_rows_q4_(uint8_t *dst, fp16_t *scales, fp16_t *mins, const T *src, size_t rows, size_t cols, size_t group) {
+    size_t groups = q4_groups(cols, group);
+    std::vector<float> row(cols);
+    for (size_t r = 0; r < rows; r++) {
+        utils::simd::to_f32(row.data(), src + r * cols, cols);
+        for (size_t g = 0; g < groups; g++) {
+            size_t c0 = g * group, n = std::min(group, cols - c0);
+            quantize_group_q4(dst + r * cols + c0, scales[r * groups + g], mins ? &mins[r * groups + g] : nullptr,
+                              row.data() + c0, n);
+        }
+    }
+}
+
+void dequantize_q4_scalar(float *dst, const uint8_t *panel, const fp16_t *scales, const fp16_t *mins,
+                          size_t nr, size_t k0, size_t kc, size_t group) {
+    size_t half = nr / 2;
+    for (size_t p = k0; p < k0 + kc; p++) {
+        const uint8_t *codes = panel + p * half;
+        const fp16_t *s = scales + (p / group) * nr;
+        const fp16_t *m = mins ? mins + (p / group) * nr : nullptr;
+        for (size_t r = 0; r < nr; r++) {
+            float q = float(r < half ? codes[r] & 0x0F : codes[r - half] >> 4);
+            float sr = utils::cast<float>(s[r]);
+            dst[r] = sr * q + (m ? utils::cast<float>(m[r]) : -8.0f * sr);
+        }
+        dst += nr;
+    }
+}
+
+#if defined(LLAISYS_X86)
+// Scale and min vectors of one group; with the min folded in, w = q * scale + min is one FMA.
+LLAISYS_TARGET_AVX2 inline void group_coeffs8(const fp16_t *s, const fp16_t *m, __m256 &scale, __m256 &min) {
+    scale = utils::simd::load8(s);
+    min = m ? utils::simd::load8(m) : _mm256_mul_ps(scale, _mm256_set1_ps(-8.0f));
+}
+
+LLAISYS_TARGET_AVX2 void dequantize_q4_avx2_16(float *dst, const uint8_t *panel, const fp16_t *scales, const fp16_t *mins,
+                                               size_t k0, size_t kc, size_t group) {
+    __m256 s0, s1, m0, m1;
+    size_t g_loaded = SIZE_MAX;
+    for (size_t p = k0; p < k0 + kc; p++) {
+        size_t g = p / group;
+        if (g != g_loaded) {
+            group_coeffs8(scales + g * 16, mins ? mins + g * 16 : nullptr, s0, m0);
+            group_coeffs8(scales + g * 16 + 8, mins ? mins + g * 16 + 8 : nullptr, s1, m1);
+            g_loaded = g;
+        }
+        __m256 lo, hi;
+        utils::simd::load8_u4(panel + p * 8, lo, hi);
+        _mm256_storeu_ps(dst, _mm256_fmadd_ps(lo, s0, m0));
+        _mm256_storeu_ps(dst + 8, _mm256_fmadd_ps(hi, s1, m1));
+        dst += 16;
+    }
+}
+
+LLAISYS_TARGET_AVX512 inline void group_coeffs16(const fp16_t *s, const fp16_t *m, __m512 &scale, __m512 &min) {
+    scale = utils::simd::load16(s);
+    min = m ? utils::simd::load16(m) : _mm512_mul_ps(scale, _mm512_set1_ps(-8.0f));
+}
+
+LLAISYS_TARGET_AVX512 void dequantize_q4_avx512_32(float *dst, const uint8_t *panel, const fp16_t *scales, const fp16_t *mins,
+                                                   size_t k0, size_t kc, size_t group) {
+    __m512 s0, s1, m0, m1;
+    size_t g_loaded = SIZE_MAX;
+    for (size_t p = k0; p < k0 + kc; p++) {
+        size_t g = p / group;
+        if (g != g_loaded) {
+            group_coeffs16(scales + g * 32, mins ? mins + g * 32 : nullptr, s0, m0);
+            group_coeffs16(scales + g * 32 + 16, mins ? mins + g * 32 + 16 : nullptr, s1, m1);
+            g_loaded = g;
+        }
+        __m512 lo, hi;
+        utils::simd::load16_u4(panel + p * 16, lo, hi);
+        _mm512_storeu_ps(dst, _mm512_fmadd_ps(lo, s0, m0));
+        _mm512_storeu_ps(dst + 16, _mm512_fmadd_ps(hi, s1, m1));
+        dst += 32;
+    }
+}
+#endif
+} // namespace
+
+void quantize_rows_i8(int8_t *dst, float *scales, const std::byte *src, llaisysDataType_t type,
+                      size_t rows, size_t cols) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return quantize_rows_i8_(dst, scales, reinterpret_cast<const float *>(src), rows, cols);
+    case LLAISYS_DTYPE_BF16:
+        return quantize_rows_i8_(dst, scales, reinterpret_cast<const llaisys::bf16_t *>(src), rows, cols);
+    case LLAISYS_DTYPE_F16:
+        return quantize_rows_i8_(dst, scales, reinterpret_cast<const llaisys::fp16_t *>(src), rows, cols);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+void quantize_rows_a8(int8_t *dst, size_t ldd, float *scales, const std::byte *src, size_t lds,
+                      llaisysDataType_t type, size_t rows, size_t cols, bool offset) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return quantize_rows_a8_(dst, ldd, scales, reinterpret_cast<const float *>(src), lds, rows, cols, offset);
+    case LLAISYS_DTYPE_BF16:
+        return quantize_rows_a8_(dst, ldd, scales, reinterpret_cast<const llaisys::bf16_t *>(src), lds, rows, cols, offset);
+    case LLAISYS_DTYPE_F16:
+        return quantize_rows_a8_(dst, ldd, scales, reinterpret_cast<const llaisys::fp16_t *>(src), lds, rows, cols, offset);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+size_t q4_groups(size_t cols, size_t group) {
+    return (cols + group - 1) / group;
+}
+
+void quantize_rows_q4(uint8_t *dst, fp16_t *scales, fp16_t *mins, const std::byte *src, llaisysDataType_t type,
+                      size_t rows, size_t cols, size_t group) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return quantize_rows_q4_(dst, scales, mins, reinterpret_cast<const float *>(src), rows, cols, group);
+    case LLAISYS_DTYPE_BF16:
+        return quantize_rows_q4_(dst, scales, mins, reinterpret_cast<const llaisys::bf16_t *>(src), rows, cols, group);
+    case LLAISYS_DTYPE_F16:
+        return quantize_rows_q4_(dst, scales, mins, reinterpret_cast<const llaisys::fp16_t *>(src), rows, cols, group);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+
+void dequantize_q4_panel(float *dst, const uint8_t *panel, const fp16_t *scales, const fp16_t *mins,
+                         size_t nr, size_t k0, size_t kc, size_t group) {
+#if defined(LLAISYS_X86)
+    // The panel width is fixed by the ISA the weights were packed for.
+    switch (nr) {
+    case 32:
+        return dequantize_q4_avx512_32(dst, panel, scales, mins, k0, kc, group);
+    case 16:
+        return dequantize_q4_avx2_16(dst, panel, scales, mins, k0, kc, group);
+    default:
+        break;
+    }
+#endif
+    dequantize_q4_scalar(dst, panel, scales, mins, nr, k0, kc, group);
+}
+} // namespace llaisys::ops::cpu::quantize
@@ -0,0 +1,37 @@
+#pragma once
+#include "llaisys.h"
+
+#include "../../../utils/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace llaisys::ops::cpu::quantize {
+// Symmetric per-row int8 quantization of a row-major [rows, cols] matrix of `type`:
+// scales[r] = max|src[r, :]| / 127, dst[r, c] = round(src[r, c] / scales[r]) (ties to even).
+// All-zero rows get scale 0 and zero codes.
+void quantize_rows_i8(int8_t *dst, float *scales, const std::byte *src, llaisysDataType_t type,
+                      size_t rows, size_t cols);
+
+// Per-token int8 quantization of activations for W8A8, rows of `src` with stride lds elements:
+// scales[r] = amax / 127, q = round(x * (127 / amax)) (ties to even) clamped to +-127, stored as
+// q + 128 (uint8) when `offset` is set. All-zero rows get scale 0 and zero codes.
+void quantize_rows_a8(int8_t *dst, size_t ldd, float *scales, const std::byte *src, size_t lds,
+                      llaisysDataType_t type, size_t rows, size_t cols, bool offset);
+
+// Number of 4-bit groups per row; the last group may be shorter than `group`.
+size_t q4_groups(size_t cols, size_t group);
+
+// Group-wise 4-bit quantization of a row-major [rows, cols] matrix, one code (0..15) per byte
+// of dst, with fp16 scales/mins of shape [rows, q4_groups(cols, group)]:
+//   mins == null: symmetric, scale = amax / 7, q = round(w / scale) + 8, w = scale * (q - 8)
+//   otherwise:    scale = (max - min) / 15, q = round((w - min) / scale), w = scale * q + min
+// Codes are computed against the fp16-rounded scale and min that are stored.
+void quantize_rows_q4(uint8_t *dst, fp16_t *scales, fp16_t *mins, const std::byte *src, llaisysDataType_t type,
+                      size_t rows, size_t cols, size_t group);
+
+// Expand k steps [k0, k0 + kc) of one 4-bit panel (see PackedWeight) to fp32 [kc][nr].
+// `panel`, `scales` and `mins` (null when symmetric) point at the start of the panel.
+void dequantize_q4_panel(float *dst, const uint8_t *panel, const fp16_t *scales, const fp16_t *mins,
+                         size_t nr, size_t k0, size_t kc, size_t group);
+} // namespace llaisys::ops::cpu::quantize
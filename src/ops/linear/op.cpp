@@ -6,6 +6,38 @@
 #include "cpu/linear_cpu.hpp"
 
 namespace llaisys::ops {
+namespace {
+cpu::PackedWeight cpu_packed_weight(const LinearWeight &weight) {
+    cpu::PackedWeight packed{weight.data(), weight.format(), weight.storageDtype()};
+    if (weight.format() == LLAISYS_LINEAR_WEIGHT_Q8 || weight.format() == LLAISYS_LINEAR_WEIGHT_W8A8) {
+        packed.scales = reinterpret_cast<const float *>(weight.scales());
+        packed.row_sums = reinterpret_cast<const int32_t *>(weight.rowSums());
+    } else if (weight.groupSize() > 0) {
+        packed.group_scales = reinterpret_cast<const fp16_t *>(weight.scales());
+        packed.group_mins = reinterpret_cast<const fp16_t *>(weight.mins());
+        packed.group_size = weight.groupSize();
+    }
+    if (weight.isGateUp()) {
+        packed.swiglu_features = weight.outFeatures();
+    }
+    return packed;
+}
+
+cpu::LinearEpilogue cpu_epilogue(const LinearEpilogue &epilogue) {
+    cpu::LinearEpilogue ep;
+    ep.bias = epilogue.bias ? epilogue.bias->data() : nullptr;
+    ep.activation = epilogue.activation;
+    if (epilogue.rope_pos_ids) {
+        ep.rope_pos = reinterpret_cast<const int64_t *>(epilogue.rope_pos_ids->data());
+        ep.rope_cols = epilogue.rope_cols;
+        ep.rope_head_dim = epilogue.rope_head_dim;
+        ep.rope_theta = epilogue.rope_theta;
+    }
+    ep.residual = epilogue.residual ? epilogue.residual->data() : nullptr;
+    return ep;
+}
+} // namespace
+
 void linear(tensor_t out, tensor_t in, tensor_t weight, tensor_t bias) {
     // Check that input tensors are on same device
     CHECK_SAME_DEVICE(out, in, weight);
@@ -13,8 +45,11 @@ void linear(tensor_t out, tensor_t in, tensor_t weight, tensor_t bias) {
         CHECK_SAME_DEVICE(out, bias);
     }
     
-    // Check data types
-    CHECK_SAME_DTYPE(out->dtype(), in->dtype(), weight->dtype());
+    // Check data types; FP8 weights are read directly with any activation type
+    CHECK_SAME_DTYPE(out->dtype(), in->dtype());
+    if (!utils::is_fp8(weight->dtype())) {
+        CHECK_SAME_DTYPE(out->dtype(), weight->dtype());
+    }
     if (bias) {
         CHECK_SAME_DTYPE(out->dtype(), bias->dtype());
     }
@@ -47,20 +82,170 @@ void linear(tensor_t out, tensor_t in, tensor_t weight, tensor_t bias) {
         ASSERT(bias->shape()[0] == out_features, "Linear: bias size must match output features");
     }
 
+    cpu::LinearEpilogue epilogue;
+    epilogue.bias = bias ? bias->data() : nullptr;
+
     // always support cpu calculation
     if (out->deviceType() == LLAISYS_DEVICE_CPU) {
-        return cpu::linear(out->data(), in->data(), weight->data(), 
-                          bias ? bias->data() : nullptr,
-                          out->dtype(), batch_size, in_features, out_features);
+        return cpu::linear(out->data(), in->data(), weight->data(), epilogue,
+                          out->dtype(), weight->dtype(), batch_size, in_features, out_features);
     }
 
     llaisys::core::context().setDevice(out->deviceType(), out->deviceId());
 
     switch (out->deviceType()) {
     case LLAISYS_DEVICE_CPU:
-        return cpu::linear(out->data(), in->data(), weight->data(), 
-                          bias ? bias->data() : nullptr,
-                          out->dtype(), batch_size, in_features, out_features);
+        return cpu::linear(out->data(), in->data(), weight->data(), epilogue,
+                          out->dtype(), weight->dtype(), batch_size, in_features, out_features);
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+void linear(tensor_t out, tensor_t in, linear_weight_t weight, tensor_t bias) {
+    LinearEpilogue epilogue;
+    epilogue.bias = bias;
+    linear(out, in, weight, epilogue);
+}
+
+void linear(tensor_t out, tensor_t in, linear_weight_t weight, const LinearEpilogue &epilogue) {
+    ASSERT(!weight->isGateUp(), "Linear: gate/up weights are only used by linear_swiglu");
+    CHECK_SAME_DEVICE(out, in);
+    CHECK_SAME_DEVICE(out, weight);
+
+    CHECK_SAME_DTYPE(out->dtype(), in->dtype());
+    if (!utils::is_fp8(weight->storageDtype())) {
+        CHECK_SAME_DTYPE(out->dtype(), weight->dtype());
+    }
+
+    ASSERT(out->isContiguous() && in->isContiguous(), "Linear: input tensors must be contiguous");
+    ASSERT(in->ndim() == 2, "Linear: input must be 2D tensor");
+    ASSERT(out->ndim() == 2, "Linear: output must be 2D tensor");
+
+    size_t batch_size = in->shape()[0];
+    size_t in_features = in->shape()[1];
+    size_t out_features = weight->outFeatures();
+
+    ASSERT(weight->inFeatures() == in_features, "Linear: weight input dimension must match input features");
+    ASSERT(out->shape()[0] == batch_size, "Linear: output batch size must match input batch size");
+    ASSERT(out->shape()[1] == out_features, "Linear: output features must match weight output features");
+
+    // Epilogue stages
+    if (tensor_t bias = epilogue.bias) {
+        CHECK_SAME_DEVICE(out, bias);
+        CHECK_SAME_DTYPE(out->dtype(), bias->dtype());
+        ASSERT(bias->isContiguous(), "Linear: bias must be contiguous");
+        ASSERT(bias->ndim() == 1, "Linear: bias must be 1D tensor");
+        ASSERT(bias->shape()[0] == out_features, "Linear: bias size must match output features");
+    }
+    ASSERT(epilogue.activation == LLAISYS_ACTIVATION_NONE || epilogue.activation == LLAISYS_ACTIVATION_SILU
+               || epilogue.activation == LLAISYS_ACTIVATION_GELU,
+           "Linear: unknown activation");
+    if (tensor_t pos_ids = epilogue.rope_pos_ids) {
+        CHECK_SAME_DEVICE(out, pos_ids);
+        ASSERT(pos_ids->dtype() == LLAISYS_DTYPE_I64, "Linear: RoPE position ids must be int64");
+        ASSERT(pos_ids->isContiguous() && pos_ids->ndim() == 1 && pos_ids->shape()[0] == batch_size,
+               "Linear: RoPE position ids must be a contiguous [batch] tensor");
+        ASSERT(epilogue.rope_head_dim > 0 && epilogue.rope_head_dim % 2 == 0, "Linear: RoPE head dim must be even");
+        ASSERT(epilogue.rope_cols % epilogue.rope_head_dim == 0 && epilogue.rope_cols <= out_features,
+               "Linear: RoPE columns must be whole heads within the output");
+    }
+    if (tensor_t residual = epilogue.residual) {
+        CHECK_SAME_DEVICE(out, residual);
+        CHECK_SAME_DTYPE(out->dtype(), residual->dtype());
+        CHECK_SAME_SHAPE(out->shape(), residual->shape());
+        ASSERT(residual->isContiguous(), "Linear: residual must be contiguous");
+    }
+
+    switch (out->deviceType()) {
+    case LLAISYS_DEVICE_CPU:
+        return cpu::linear_packed(out->data(), in->data(), cpu_packed_weight(*weight), cpu_epilogue(epilogue),
+                                  out->dtype(), batch_size, in_features, out_features);
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+void linear_swiglu(tensor_t out, tensor_t in, linear_weight_t gate_up) {
+    ASSERT(gate_up->isGateUp(), "LinearSwiGLU: weight must be built by LinearWeight::createGateUp");
+    CHECK_SAME_DEVICE(out, in);
+    CHECK_SAME_DEVICE(out, gate_up);
+
+    CHECK_SAME_DTYPE(out->dtype(), in->dtype());
+    if (!utils::is_fp8(gate_up->storageDtype())) {
+        CHECK_SAME_DTYPE(out->dtype(), gate_up->dtype());
+    }
+
+    ASSERT(out->isContiguous() && in->isContiguous(), "LinearSwiGLU: input tensors must be contiguous");
+    ASSERT(in->ndim() == 2, "LinearSwiGLU: input must be 2D tensor");
+    ASSERT(out->ndim() == 2, "LinearSwiGLU: output must be 2D tensor");
+
+    size_t batch_size = in->shape()[0];
+    size_t in_features = in->shape()[1];
+    size_t inter_features = gate_up->outFeatures();
+
+    ASSERT(gate_up->inFeatures() == in_features, "LinearSwiGLU: weight input dimension must match input features");
+    ASSERT(out->shape()[0] == batch_size, "LinearSwiGLU: output batch size must match input batch size");
+    ASSERT(out->shape()[1] == inter_features, "LinearSwiGLU: output features must match weight inter features");
+
+    switch (out->deviceType()) {
+    case LLAISYS_DEVICE_CPU:
+        return cpu::linear_packed(out->data(), in->data(), cpu_packed_weight(*gate_up), cpu::LinearEpilogue{},
+                                  out->dtype(), batch_size, in_features, inter_features);
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+void linear_topk(tensor_t indices, tensor_t values, tensor_t in, linear_weight_t weight, float temperature,
+                 uint64_t seed) {
+    ASSERT(!weight->isGateUp(), "LinearTopK: gate/up weights are only used by linear_swiglu");
+    CHECK_ARGUMENT(weight->format() != LLAISYS_LINEAR_WEIGHT_W8A8, "LinearTopK: W8A8 weights are not supported");
+    CHECK_SAME_DEVICE(indices, values, in);
+    CHECK_SAME_DEVICE(in, weight);
+
+    if (!utils::is_fp8(weight->storageDtype())) {
+        CHECK_SAME_DTYPE(in->dtype(), weight->dtype());
+    }
+    ASSERT(indices->dtype() == LLAISYS_DTYPE_I64, "LinearTopK: indices must be int64");
+    ASSERT(values->dtype() == LLAISYS_DTYPE_F32, "LinearTopK: values must be float32");
+
+    ASSERT(indices->isContiguous() && values->isContiguous() && in->isContiguous(),
+           "LinearTopK: all tensors must be contiguous");
+    ASSERT(in->ndim() == 2, "LinearTopK: input must be 2D tensor");
+    ASSERT(indices->ndim() == 2, "LinearTopK: indices must be 2D tensor");
+    CHECK_SAME_SHAPE(indices->shape(), values->shape());
+
+    size_t batch_size = in->shape()[0];
+    size_t in_features = in->shape()[1];
+    size_t out_features = weight->outFeatures();
+    size_t topk = indices->shape()[1];
+
+    ASSERT(weight->inFeatures() == in_features, "LinearTopK: weight input dimension must match input features");
+    ASSERT(indices->shape()[0] == batch_size, "LinearTopK: output batch size must match input batch size");
+    ASSERT(topk > 0 && topk <= out_features, "LinearTopK: k must be in [1, out_features]");
+
+    switch (in->deviceType()) {
+    case LLAISYS_DEVICE_CPU:
+        return cpu::linear_packed_topk(reinterpret_cast<int64_t *>(indices->data()),
+                                       reinterpret_cast<float *>(values->data()), topk, in->data(),
+                                       cpu_packed_weight(*weight), in->dtype(), batch_size, in_features,
+                                       out_features, temperature, seed);
 #ifdef ENABLE_NVIDIA_API
     case LLAISYS_DEVICE_NVIDIA:
         TO_BE_IMPLEMENTED();
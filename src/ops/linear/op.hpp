@@ -1,7 +1,31 @@
 #pragma once
 
 #include "../../tensor/tensor.hpp"
+#include "weight.hpp"
 
 namespace llaisys::ops {
+// Output stages fused into linear(), applied in this order: bias, activation, RoPE on the
+// first rope_cols columns (heads of rope_head_dim at positions rope_pos_ids), residual, and
+// the conversion to the output dtype. Null tensors and zero counts disable a stage.
+struct LinearEpilogue {
+    tensor_t bias;         // [out_features]
+    llaisysActivation_t activation = LLAISYS_ACTIVATION_NONE;
+    tensor_t rope_pos_ids; // [batch] int64
+    size_t rope_cols = 0;
+    size_t rope_head_dim = 0;
+    float rope_theta = 10000.0f;
+    tensor_t residual;     // [batch, out_features], may be `out`
+};
+
 void linear(tensor_t out, tensor_t in, tensor_t weight, tensor_t bias);
+// Same as above with a weight converted ahead of time by LinearWeight::create.
+void linear(tensor_t out, tensor_t in, linear_weight_t weight, tensor_t bias);
+void linear(tensor_t out, tensor_t in, linear_weight_t weight, const LinearEpilogue &epilogue);
+// out = silu(in @ gate^T) * (in @ up^T) with a weight from LinearWeight::createGateUp.
+void linear_swiglu(tensor_t out, tensor_t in, linear_weight_t gate_up);
+// indices (I64) / values (F32) [batch, k]: the k largest outputs of every row of in @ weight^T,
+// best first, without materializing the product. temperature > 0 ranks by output / temperature
+// plus Gumbel noise from `seed` instead, sampling k outputs without replacement.
+void linear_topk(tensor_t indices, tensor_t values, tensor_t in, linear_weight_t weight, float temperature,
+                 uint64_t seed);
 }
@@ -0,0 +1,171 @@
+#include "weight.hpp"
+
+#include "../../core/llaisys_core.hpp"
+#include "../../utils.hpp"
+
+#include "cpu/linear_cpu.hpp"
+
+namespace llaisys::ops {
+LinearWeight::LinearWeight(llaisysLinearWeightFormat_t format, size_t out_features, size_t in_features,
+                           llaisysDataType_t dtype, size_t group_size, tensor_t data, tensor_t scales, tensor_t mins,
+                           tensor_t row_sums)
+    : _format(format), _out_features(out_features), _in_features(in_features), _dtype(dtype),
+      _group_size(group_size), _data(std::move(data)), _scales(std::move(scales)), _mins(std::move(mins)),
+      _row_sums(std::move(row_sums)) {}
+
+linear_weight_t LinearWeight::create(tensor_t weight, llaisysLinearWeightFormat_t format, size_t group_size) {
+    ASSERT(weight->ndim() == 2, "LinearWeight: weight must be 2D tensor");
+    ASSERT(weight->isContiguous(), "LinearWeight: weight must be contiguous");
+    bool q4 = format == LLAISYS_LINEAR_WEIGHT_Q4 || format == LLAISYS_LINEAR_WEIGHT_Q4_ZP;
+    CHECK_ARGUMENT(q4 || format == LLAISYS_LINEAR_WEIGHT_PACKED || format == LLAISYS_LINEAR_WEIGHT_Q8
+                       || format == LLAISYS_LINEAR_WEIGHT_W8A8 || format == LLAISYS_LINEAR_WEIGHT_F8,
+                   "LinearWeight: unknown format");
+    if (utils::is_fp8(weight->dtype())) {
+        CHECK_ARGUMENT(format == LLAISYS_LINEAR_WEIGHT_PACKED || format == LLAISYS_LINEAR_WEIGHT_F8,
+                       "LinearWeight: FP8 weights can only be packed");
+    }
+    if (q4) {
+        group_size = group_size ? group_size : DEFAULT_GROUP_SIZE;
+        CHECK_ARGUMENT(group_size == 32 || group_size == 64 || group_size == 128,
+                       "LinearWeight: 4-bit group size must be 32, 64 or 128");
+    } else {
+        group_size = 0;
+    }
+
+    size_t out_features = weight->shape()[0];
+    size_t in_features = weight->shape()[1];
+    llaisysDeviceType_t device = weight->deviceType();
+    int device_id = weight->deviceId();
+
+    switch (device) {
+    case LLAISYS_DEVICE_CPU: {
+        size_t numel = cpu::linear_packed_numel(in_features, out_features);
+        tensor_t data, scales, mins, row_sums;
+        if (format == LLAISYS_LINEAR_WEIGHT_W8A8) {
+            data = Tensor::create({cpu::linear_packed_w8a8_bytes(in_features, out_features)}, LLAISYS_DTYPE_I8,
+                                  device, device_id);
+            scales = Tensor::create({out_features}, LLAISYS_DTYPE_F32, device, device_id);
+            row_sums = Tensor::create({out_features}, LLAISYS_DTYPE_I32, device, device_id);
+            cpu::linear_pack_weight_w8a8(data->data(), reinterpret_cast<float *>(scales->data()),
+                                         reinterpret_cast<int32_t *>(row_sums->data()), weight->data(),
+                                         weight->dtype(), in_features, out_features);
+        } else if (format == LLAISYS_LINEAR_WEIGHT_Q8) {
+            data = Tensor::create({numel}, LLAISYS_DTYPE_I8, device, device_id);
+            scales = Tensor::create({out_features}, LLAISYS_DTYPE_F32, device, device_id);
+            cpu::linear_pack_weight_q8(data->data(), reinterpret_cast<float *>(scales->data()), weight->data(),
+                                       weight->dtype(), in_features, out_features);
+        } else if (q4) {
+            size_t groups_numel = cpu::linear_packed_q4_groups_numel(in_features, out_features, group_size);
+            data = Tensor::create({cpu::linear_packed_q4_bytes(in_features, out_features)}, LLAISYS_DTYPE_U8,
+                                  device, device_id);
+            scales = Tensor::create({groups_numel}, LLAISYS_DTYPE_F16, device, device_id);
+            if (format == LLAISYS_LINEAR_WEIGHT_Q4_ZP) {
+                mins = Tensor::create({groups_numel}, LLAISYS_DTYPE_F16, device, device_id);
+            }
+            cpu::linear_pack_weight_q4(data->data(), reinterpret_cast<fp16_t *>(scales->data()),
+                                       mins ? reinterpret_cast<fp16_t *>(mins->data()) : nullptr,
+                                       weight->data(), weight->dtype(), in_features, out_features, group_size);
+        } else if (format == LLAISYS_LINEAR_WEIGHT_F8) {
+            data = Tensor::create({numel}, LLAISYS_DTYPE_F8, device, device_id);
+            cpu::linear_pack_weight_f8(data->data(), weight->data(), weight->dtype(), in_features, out_features);
+        } else {
+            data = Tensor::create({numel}, weight->dtype(), device, device_id);
+            cpu::linear_pack_weight(data->data(), weight->data(), weight->dtype(), in_features, out_features);
+        }
+        return std::shared_ptr<LinearWeight>(new LinearWeight(format, out_features, in_features, weight->dtype(),
+                                                              group_size, data, scales, mins, row_sums));
+    }
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return nullptr;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+linear_weight_t LinearWeight::createGateUp(tensor_t gate, tensor_t up, llaisysLinearWeightFormat_t format,
+                                           size_t group_size) {
+    CHECK_SAME_DEVICE(gate, up);
+    CHECK_SAME_DTYPE(gate->dtype(), up->dtype());
+    ASSERT(gate->ndim() == 2, "LinearWeight: gate must be 2D tensor");
+    CHECK_SAME_SHAPE(gate->shape(), up->shape());
+    ASSERT(gate->isContiguous() && up->isContiguous(), "LinearWeight: gate and up must be contiguous");
+
+    size_t inter_features = gate->shape()[0];
+    size_t in_features = gate->shape()[1];
+
+    switch (gate->deviceType()) {
+    case LLAISYS_DEVICE_CPU: {
+        tensor_t fused = Tensor::create({cpu::linear_gate_up_rows(inter_features), in_features}, gate->dtype(),
+                                        gate->deviceType(), gate->deviceId());
+        cpu::linear_interleave_gate_up(fused->data(), gate->data(), up->data(), gate->dtype(), in_features,
+                                       inter_features);
+        linear_weight_t weight = create(fused, format, group_size);
+        weight->_out_features = inter_features;
+        weight->_gate_up = true;
+        return weight;
+    }
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return nullptr;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+llaisysLinearWeightFormat_t LinearWeight::format() const {
+    return _format;
+}
+
+size_t LinearWeight::outFeatures() const {
+    return _out_features;
+}
+
+size_t LinearWeight::inFeatures() const {
+    return _in_features;
+}
+
+llaisysDataType_t LinearWeight::dtype() const {
+    return _dtype;
+}
+
+llaisysDataType_t LinearWeight::storageDtype() const {
+    return _data->dtype();
+}
+
+size_t LinearWeight::groupSize() const {
+    return _group_size;
+}
+
+bool LinearWeight::isGateUp() const {
+    return _gate_up;
+}
+
+llaisysDeviceType_t LinearWeight::deviceType() const {
+    return _data->deviceType();
+}
+
+int LinearWeight::deviceId() const {
+    return _data->deviceId();
+}
+
+const std::byte *LinearWeight::data() const {
+    return _data->data();
+}
+
+const std::byte *LinearWeight::scales() const {
+    return _scales ? _scales->data() : nullptr;
+}
+
+const std::byte *LinearWeight::mins() const {
+    return _mins ? _mins->data() : nullptr;
+}
+
+const std::byte *LinearWeight::rowSums() const {
+    return _row_sums ? _row_sums->data() : nullptr;
+}
+} // namespace llaisys::ops
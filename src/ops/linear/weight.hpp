@@ -0,0 +1,63 @@
+#pragma once
+
+#include "llaisys/ops.h"
+
+#include "../../tensor/tensor.hpp"
+
+namespace llaisys::ops {
+class LinearWeight;
+using linear_weight_t = std::shared_ptr<LinearWeight>;
+
+// Weight of a linear layer in the layout its kernels read directly, built once from a
+// row-major [out_features, in_features] tensor.
+class LinearWeight {
+private:
+    llaisysLinearWeightFormat_t _format;
+    size_t _out_features;
+    size_t _in_features;
+    llaisysDataType_t _dtype;
+    size_t _group_size;
+    tensor_t _data;
+    tensor_t _scales;   // Q8/W8A8: F32 [out_features]; Q4: F16 group scales; else null
+    tensor_t _mins;     // Q4_ZP: F16 group mins; else null
+    tensor_t _row_sums; // W8A8: I32 [out_features] sums of the codes; else null
+    bool _gate_up = false;
+    LinearWeight(llaisysLinearWeightFormat_t format, size_t out_features, size_t in_features,
+                 llaisysDataType_t dtype, size_t group_size, tensor_t data, tensor_t scales, tensor_t mins,
+                 tensor_t row_sums);
+
+public:
+    // Default number of input features sharing one 4-bit scale.
+    static constexpr size_t DEFAULT_GROUP_SIZE = 32;
+
+    // `group_size` applies to the Q4 formats only (32, 64 or 128; 0 selects the default).
+    static linear_weight_t create(tensor_t weight, llaisysLinearWeightFormat_t format, size_t group_size = 0);
+    // Gate and up weights of a SwiGLU MLP, both [inter_features, in_features], interleaved
+    // into one weight whose product is silu(x @ gate^T) * (x @ up^T), see ops::linear_swiglu.
+    static linear_weight_t createGateUp(tensor_t gate, tensor_t up, llaisysLinearWeightFormat_t format,
+                                        size_t group_size = 0);
+    ~LinearWeight() = default;
+
+    llaisysLinearWeightFormat_t format() const;
+    // inter_features for a gate/up weight
+    size_t outFeatures() const;
+    size_t inFeatures() const;
+    // Element type of the source tensor, which inputs and outputs must match unless data() is FP8.
+    llaisysDataType_t dtype() const;
+    // Element type of data(): dtype(), F8 for F8, I8 for Q8 and W8A8, U8 (two codes per byte) for Q4.
+    llaisysDataType_t storageDtype() const;
+    // Input features per 4-bit group, 0 for the other formats.
+    size_t groupSize() const;
+    // Built by createGateUp.
+    bool isGateUp() const;
+    llaisysDeviceType_t deviceType() const;
+    int deviceId() const;
+    const std::byte *data() const;
+    // Dequantization scales (see _scales), null unless quantized.
+    const std::byte *scales() const;
+    // Group mins of Q4_ZP, null otherwise.
+    const std::byte *mins() const;
+    // Code row sums of W8A8, null otherwise.
+    const std::byte *rowSums() const;
+};
+} // namespace llaisys::ops
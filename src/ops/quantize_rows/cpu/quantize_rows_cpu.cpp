@@ -0,0 +1,93 @@
+#include "quantize_rows_cpu.hpp"
+
+#include "../../linear/cpu/quantize_cpu.hpp"
+
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// 按行对称量化, 每行一个 float 缩放因子:
+//   I8:  scale = amax / 127, q = round(x / scale), 复用 W8A8 的激活量化
+//   FP8: scale = amax / 最大有限值 (E4M3 448, E5M2 57344), q = fp8(x / scale)
+// 全零行的 scale 为 0, 编码为 0
+// in 的行可以不连续 (如融合 QKV 输出中的 V 视图), out 与 scales 连续
+
+template <typename T, typename TQ>
+void quantize_rows_f8_(TQ *out, float *scales, const T *in, size_t lds, size_t rows, size_t cols, float qmax) {
+    std::vector<float> row(cols);
+    for (size_t r = 0; r < rows; r++) {
+        llaisys::utils::simd::to_f32(row.data(), in + r * lds, cols);
+        float amax = 0.0f;
+        for (size_t c = 0; c < cols; c++) {
+            amax = std::max(amax, std::fabs(row[c]));
+        }
+        float scale = amax / qmax;
+        scales[r] = scale;
+        float inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+        for (size_t c = 0; c < cols; c++) {
+            row[c] *= inv;
+        }
+        llaisys::utils::simd::from_f32(out + r * cols, row.data(), cols);
+    }
+}
+
+template <typename T>
+void quantize_block_(std::byte *out, float *scales, const std::byte *in, size_t lds, size_t rows, size_t cols,
+                     llaisysDataType_t out_type, llaisysDataType_t in_type) {
+    switch (out_type) {
+    case LLAISYS_DTYPE_I8:
+        return llaisys::ops::cpu::quantize::quantize_rows_a8(reinterpret_cast<int8_t *>(out), cols, scales, in, lds,
+                                                             in_type, rows, cols, false);
+    case LLAISYS_DTYPE_F8:
+        return quantize_rows_f8_(reinterpret_cast<llaisys::f8e4m3_t *>(out), scales, reinterpret_cast<const T *>(in),
+                                 lds, rows, cols, 448.0f);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return quantize_rows_f8_(reinterpret_cast<llaisys::f8e5m2_t *>(out), scales, reinterpret_cast<const T *>(in),
+                                 lds, rows, cols, 57344.0f);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(out_type);
+    }
+}
+
+template <typename T>
+void quantize_rows_(std::byte *out, float *scales, const std::byte *in, const std::vector<size_t> &shape,
+                    const std::vector<ptrdiff_t> &in_strides, llaisysDataType_t out_type, llaisysDataType_t in_type) {
+    size_t ndim = shape.size();
+    size_t cols = shape[ndim - 1];
+    // 最后两维一次处理: rows 行, 行距 lds; 更外层的维度逐个展开
+    size_t rows = ndim >= 2 ? shape[ndim - 2] : 1;
+    size_t lds = ndim >= 2 ? static_cast<size_t>(in_strides[ndim - 2]) : cols;
+    size_t outer = 1;
+    for (size_t i = 0; i + 2 < ndim; i++) {
+        outer *= shape[i];
+    }
+    size_t out_elem = llaisys::utils::dsize(out_type);
+    for (size_t o = 0; o < outer; o++) {
+        ptrdiff_t offset = 0;
+        for (size_t i = ndim >= 2 ? ndim - 2 : 0, rem = o; i-- > 0;) {
+            offset += static_cast<ptrdiff_t>(rem % shape[i]) * in_strides[i];
+            rem /= shape[i];
+        }
+        quantize_block_<T>(out + o * rows * cols * out_elem, scales + o * rows,
+                           in + offset * static_cast<ptrdiff_t>(sizeof(T)), lds, rows, cols, out_type, in_type);
+    }
+}
+
+namespace llaisys::ops::cpu {
+void quantize_rows(std::byte *out, float *scales, const std::byte *in, const std::vector<size_t> &shape,
+                   const std::vector<ptrdiff_t> &in_strides, llaisysDataType_t out_type, llaisysDataType_t in_type) {
+    switch (in_type) {
+    case LLAISYS_DTYPE_F32:
+        return quantize_rows_<float>(out, scales, in, shape, in_strides, out_type, in_type);
+    case LLAISYS_DTYPE_BF16:
+        return quantize_rows_<llaisys::bf16_t>(out, scales, in, shape, in_strides, out_type, in_type);
+    case LLAISYS_DTYPE_F16:
+        return quantize_rows_<llaisys::fp16_t>(out, scales, in, shape, in_strides, out_type, in_type);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(in_type);
+    }
+}
+} // namespace llaisys::ops::cpu
@@ -0,0 +1,12 @@
+#pragma once
+#include "llaisys.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace llaisys::ops::cpu {
+// Quantize each row (last dim) of `in` (F32, BF16 or F16; strides in elements, the last one 1)
+// into the contiguous `out` of out_type (I8 or FP8), one fp32 scale per row in `scales`.
+void quantize_rows(std::byte *out, float *scales, const std::byte *in, const std::vector<size_t> &shape,
+                   const std::vector<ptrdiff_t> &in_strides, llaisysDataType_t out_type, llaisysDataType_t in_type);
+}
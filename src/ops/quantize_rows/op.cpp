@@ -0,0 +1,40 @@
+#include "op.hpp"
+
+#include "../../core/llaisys_core.hpp"
+#include "../../utils.hpp"
+
+#include "cpu/quantize_rows_cpu.hpp"
+
+namespace llaisys::ops {
+void quantize_rows(tensor_t out, tensor_t scales, tensor_t in) {
+    CHECK_SAME_DEVICE(out, scales, in);
+    CHECK_ARGUMENT(out->dtype() == LLAISYS_DTYPE_I8 || utils::is_fp8(out->dtype()),
+                   "Quantize Rows: out must be I8 or FP8");
+    CHECK_SAME_DTYPE(scales->dtype(), LLAISYS_DTYPE_F32);
+    ASSERT(out->isContiguous() && scales->isContiguous(), "Quantize Rows: out and scales must be contiguous");
+
+    ASSERT(in->ndim() >= 1, "Quantize Rows: in must have at least one dim");
+    ASSERT(in->strides().back() == 1, "Quantize Rows: rows of in must be contiguous");
+    CHECK_SAME_SHAPE(out->shape(), in->shape());
+    std::vector<size_t> row_shape(in->shape().begin(), in->shape().end() - 1);
+    CHECK_SAME_SHAPE(scales->shape(), row_shape);
+
+    // always support cpu calculation
+    if (out->deviceType() == LLAISYS_DEVICE_CPU) {
+        return cpu::quantize_rows(out->data(), reinterpret_cast<float *>(scales->data()), in->data(),
+                                  in->shape(), in->strides(), out->dtype(), in->dtype());
+    }
+
+    llaisys::core::context().setDevice(out->deviceType(), out->deviceId());
+
+    switch (out->deviceType()) {
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+} // namespace llaisys::ops
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../../tensor/tensor.hpp"
+
+namespace llaisys::ops {
+// Symmetric per-row quantization over the last dim: scales[...] = max|in[..., :]| / qmax,
+// out[..., j] = in[..., j] / scales[...], in I8 (qmax 127, rounded) or FP8 (qmax 448 / 57344).
+void quantize_rows(tensor_t out, tensor_t scales, tensor_t in);
+}
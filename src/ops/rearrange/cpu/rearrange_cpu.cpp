@@ -0,0 +1,132 @@
+#include "rearrange_cpu.hpp"
+
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+namespace {
+// Copy one innermost row of n elements; contiguous rows go through the bulk converters.
+template <typename TO, typename TI>
+void copy_row(TO *out, ptrdiff_t os, const TI *in, ptrdiff_t is, size_t n, float *buf) {
+    if (os == 1 && is == 1) {
+        if constexpr (std::is_same_v<TO, TI>) {
+            std::memcpy(out, in, n * sizeof(TO));
+        } else {
+            llaisys::utils::simd::to_f32(buf, in, n);
+            llaisys::utils::simd::from_f32(out, buf, n);
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if constexpr (std::is_same_v<TO, TI>) {
+            out[i * os] = in[i * is];
+        } else {
+            out[i * os] = llaisys::utils::cast<TO>(in[i * is]);
+        }
+    }
+}
+
+template <typename TO, typename TI>
+void rearrange_(TO *out, const TI *in, const std::vector<size_t> &shape, const std::vector<ptrdiff_t> &out_strides,
+                const std::vector<ptrdiff_t> &in_strides) {
+    size_t ndim = shape.size();
+    size_t numel = 1;
+    for (size_t d : shape) {
+        numel *= d;
+    }
+    if (numel == 0) {
+        return;
+    }
+    if (ndim == 0) {
+        float buf[1];
+        return copy_row(out, 1, in, 1, 1, buf);
+    }
+
+    // Walk the outer dimensions with an odometer index; rows run along the last dimension.
+    size_t row_len = shape[ndim - 1];
+    std::vector<float> buf(std::is_same_v<TO, TI> ? 0 : row_len);
+    std::vector<size_t> idx(ndim - 1, 0);
+    for (size_t r = 0; r < numel / row_len; r++) {
+        ptrdiff_t oo = 0, io = 0;
+        for (size_t d = 0; d + 1 < ndim; d++) {
+            oo += static_cast<ptrdiff_t>(idx[d]) * out_strides[d];
+            io += static_cast<ptrdiff_t>(idx[d]) * in_strides[d];
+        }
+        copy_row(out + oo, out_strides[ndim - 1], in + io, in_strides[ndim - 1], row_len, buf.data());
+        for (size_t d = ndim - 1; d-- > 0;) {
+            if (++idx[d] < shape[d]) {
+                break;
+            }
+            idx[d] = 0;
+        }
+    }
+}
+
+template <typename TO>
+void rearrange_from(std::byte *out, const std::byte *in, const std::vector<size_t> &shape,
+                    const std::vector<ptrdiff_t> &out_strides, const std::vector<ptrdiff_t> &in_strides,
+                    llaisysDataType_t in_type) {
+    auto *o = reinterpret_cast<TO *>(out);
+    switch (in_type) {
+    case LLAISYS_DTYPE_F32:
+        return rearrange_(o, reinterpret_cast<const float *>(in), shape, out_strides, in_strides);
+    case LLAISYS_DTYPE_BF16:
+        return rearrange_(o, reinterpret_cast<const llaisys::bf16_t *>(in), shape, out_strides, in_strides);
+    case LLAISYS_DTYPE_F16:
+        return rearrange_(o, reinterpret_cast<const llaisys::fp16_t *>(in), shape, out_strides, in_strides);
+    case LLAISYS_DTYPE_F8:
+        return rearrange_(o, reinterpret_cast<const llaisys::f8e4m3_t *>(in), shape, out_strides, in_strides);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return rearrange_(o, reinterpret_cast<const llaisys::f8e5m2_t *>(in), shape, out_strides, in_strides);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(in_type);
+    }
+}
+
+// Same-type copies only depend on the element size.
+template <size_t SIZE>
+struct Bytes {
+    std::byte b[SIZE];
+};
+} // namespace
+
+namespace llaisys::ops::cpu {
+void rearrange(std::byte *out, const std::byte *in, const std::vector<size_t> &shape,
+               const std::vector<ptrdiff_t> &out_strides, const std::vector<ptrdiff_t> &in_strides,
+               llaisysDataType_t out_type, llaisysDataType_t in_type) {
+    if (out_type == in_type) {
+        switch (utils::dsize(out_type)) {
+        case 1:
+            return rearrange_(reinterpret_cast<Bytes<1> *>(out), reinterpret_cast<const Bytes<1> *>(in),
+                              shape, out_strides, in_strides);
+        case 2:
+            return rearrange_(reinterpret_cast<Bytes<2> *>(out), reinterpret_cast<const Bytes<2> *>(in),
+                              shape, out_strides, in_strides);
+        case 4:
+            return rearrange_(reinterpret_cast<Bytes<4> *>(out), reinterpret_cast<const Bytes<4> *>(in),
+                              shape, out_strides, in_strides);
+        case 8:
+            return rearrange_(reinterpret_cast<Bytes<8> *>(out), reinterpret_cast<const Bytes<8> *>(in),
+                              shape, out_strides, in_strides);
+        default:
+            EXCEPTION_UNSUPPORTED_DATATYPE(out_type);
+        }
+    }
+    switch (out_type) {
+    case LLAISYS_DTYPE_F32:
+        return rearrange_from<float>(out, in, shape, out_strides, in_strides, in_type);
+    case LLAISYS_DTYPE_BF16:
+        return rearrange_from<llaisys::bf16_t>(out, in, shape, out_strides, in_strides, in_type);
+    case LLAISYS_DTYPE_F16:
+        return rearrange_from<llaisys::fp16_t>(out, in, shape, out_strides, in_strides, in_type);
+    case LLAISYS_DTYPE_F8:
+        return rearrange_from<llaisys::f8e4m3_t>(out, in, shape, out_strides, in_strides, in_type);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return rearrange_from<llaisys::f8e5m2_t>(out, in, shape, out_strides, in_strides, in_type);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(out_type);
+    }
+}
+} // namespace llaisys::ops::cpu
@@ -0,0 +1,14 @@
+#pragma once
+#include "llaisys.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace llaisys::ops::cpu {
+// out[idx] = in[idx] over `shape`, with strides in elements of each tensor's own type.
+// Equal types are copied bitwise; otherwise both must be floating point (F32, BF16, F16 or
+// FP8) and values are converted through fp32, rounding to nearest even.
+void rearrange(std::byte *out, const std::byte *in, const std::vector<size_t> &shape,
+               const std::vector<ptrdiff_t> &out_strides, const std::vector<ptrdiff_t> &in_strides,
+               llaisysDataType_t out_type, llaisysDataType_t in_type);
+}
@@ -1,53 +1,42 @@
 #include "rms_norm_cpu.hpp"
 
+#include "../../../device/cpu/thread_pool.hpp"
 #include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
+
+// 低于此元素数时单线程处理
+constexpr size_t MIN_ELEMS_PER_THREAD = size_t(1) << 15;
 
 // RMS Normalization: Y_i = (W_i × X_i) / sqrt((1/d) * sum(X_j^2) + epsilon)
-// 对每一行进行归一化
+// 对每一行进行归一化; 半精度输入在寄存器中转换为float, 全部在float精度下计算
 template <typename T>
-void rms_norm_(T *out, const T *in, const T *weight, 
+void rms_norm_(T *out, const T *in, const T *weight,
                size_t batch_size, size_t feature_dim, float eps) {
-    
-    for (size_t b = 0; b < batch_size; b++) {
-        // 计算当前行的指针
-        const T *row_in = in + b * feature_dim;
-        T *row_out = out + b * feature_dim;
-        
-        // 步骤1：计算平方和 (在float精度下进行)
-        float sum_of_squares = 0.0f;
-        for (size_t i = 0; i < feature_dim; i++) {
-            if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                float val = llaisys::utils::cast<float>(row_in[i]);
-                sum_of_squares += val * val;
-            } else {
-                float val = static_cast<float>(row_in[i]);
-                sum_of_squares += val * val;
-            }
-        }
-        
-        // 步骤2：计算RMS (Root Mean Square)
-        // rms = sqrt((1/d) * sum(x^2) + eps)
-        float mean_square = sum_of_squares / static_cast<float>(feature_dim);
-        float rms = std::sqrt(mean_square + eps);
-        float inv_rms = 1.0f / rms;  // 归一化因子
-        
-        // 步骤3：应用归一化和权重: Y_i = (W_i * X_i) / rms
-        for (size_t i = 0; i < feature_dim; i++) {
-            if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                float x_val = llaisys::utils::cast<float>(row_in[i]);
-                float w_val = llaisys::utils::cast<float>(weight[i]);
-                float result = (w_val * x_val) * inv_rms;
-                row_out[i] = llaisys::utils::cast<T>(result);
-            } else {
-                float x_val = static_cast<float>(row_in[i]);
-                float w_val = static_cast<float>(weight[i]);
-                float result = (w_val * x_val) * inv_rms;
-                row_out[i] = static_cast<T>(result);
+    std::vector<float> w(feature_dim);
+    llaisys::utils::simd::to_f32(w.data(), weight, feature_dim);
+
+    // 按行并行, 每个线程至少处理 MIN_ELEMS_PER_THREAD 个元素
+    size_t grain = std::max<size_t>(MIN_ELEMS_PER_THREAD / std::max<size_t>(feature_dim, 1), 1);
+    llaisys::device::cpu::parallel_for(batch_size, grain, [&](size_t b0, size_t b1) {
+        std::vector<float> row(feature_dim);
+        for (size_t b = b0; b < b1; b++) {
+            llaisys::utils::simd::to_f32(row.data(), in + b * feature_dim, feature_dim);
+
+            // rms = sqrt((1/d) * sum(x^2) + eps)
+            float sum_of_squares = llaisys::utils::simd::dot(row.data(), row.data(), feature_dim);
+            float inv_rms = 1.0f / std::sqrt(sum_of_squares / static_cast<float>(feature_dim) + eps);
+
+            // Y_i = (W_i * X_i) / rms
+            for (size_t i = 0; i < feature_dim; i++) {
+                row[i] = (w[i] * row[i]) * inv_rms;
             }
+            llaisys::utils::simd::from_f32(out + b * feature_dim, row.data(), feature_dim);
         }
-    }
+    });
 }
 
 namespace llaisys::ops::cpu {
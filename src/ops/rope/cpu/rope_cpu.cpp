@@ -1,94 +1,118 @@
 #include "rope_cpu.hpp"
 
+#include "../../../device/cpu/thread_pool.hpp"
 #include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
 
+#include <algorithm>
 #include <cmath>
-#include <cassert>
+#include <vector>
+
+// 低于此元素数时单线程处理
+constexpr size_t MIN_ELEMS_PER_THREAD = size_t(1) << 14;
 
 // RoPE (Rotary Position Embedding) 实现
-// 输入形状: [seq_len, n_heads, head_dim]
+// 输入形状: [seq_len, n_heads, head_dim], 位置和头两个维度可以带步长 (如融合QKV输出中的视图)
 // pos_ids 形状: [seq_len] (int64)
-template <typename T>
+// HD 非0时为编译期的 head_dim (常见的 64/96/128), 0 为运行期 head_dim 的通用版本
+template <typename T, size_t HD>
 void rope_(T *out, const T *in, const int64_t *pos_ids,
-           size_t seq_len, size_t n_heads, size_t head_dim, float theta) {
-    
+           size_t seq_len, size_t n_heads, size_t head_dim,
+           ptrdiff_t in_stride_seq, ptrdiff_t in_stride_head, float theta) {
+
     // head_dim 必须是偶数 (这在上层已经检查过了)
-    // assert(head_dim % 2 == 0);
-    
-    size_t half_dim = head_dim / 2;
-    
-    for (size_t s = 0; s < seq_len; s++) {
-        // 获取当前位置ID
-        float position = static_cast<float>(pos_ids[s]);
-        
-        for (size_t h = 0; h < n_heads; h++) {
+    const size_t hd = HD ? HD : head_dim;
+    const size_t half_dim = hd / 2;
+
+    // 旋转频率与位置无关, 使用与PyTorch相同的方式: freqs = positions / (theta ** (2 * i / head_dim))
+    std::vector<float> freq_base(half_dim);
+    for (size_t i = 0; i < half_dim; i++) {
+        float freq_exp = (2.0f * static_cast<float>(i)) / static_cast<float>(hd);
+        freq_base[i] = std::pow(theta, freq_exp);
+    }
+
+    // 按(位置, 头)并行, 每个线程至少处理 MIN_ELEMS_PER_THREAD 个元素
+    size_t grain = std::max<size_t>(MIN_ELEMS_PER_THREAD / std::max<size_t>(hd, 1), 1);
+    llaisys::device::cpu::parallel_for(seq_len * n_heads, grain, [&](size_t p0, size_t p1) {
+        std::vector<float> cos_sin(hd); // 当前位置的 cos[half_dim], sin[half_dim], 同一位置的所有头共用
+        std::vector<float> row(hd);
+        size_t cur_seq = seq_len;
+
+        for (size_t p = p0; p < p1; p++) {
+            size_t s = p / n_heads, h = p % n_heads;
+            if (s != cur_seq) {
+                float position = static_cast<float>(pos_ids[s]);
+                for (size_t i = 0; i < half_dim; i++) {
+                    float angle = position / freq_base[i];
+                    cos_sin[i] = std::cos(angle);
+                    cos_sin[half_dim + i] = std::sin(angle);
+                }
+                cur_seq = s;
+            }
+
             // 计算当前头的输入和输出偏移
-            const T *head_in = in + (s * n_heads + h) * head_dim;
-            T *head_out = out + (s * n_heads + h) * head_dim;
-            
-            // 处理每一对(a, b)
+            const T *head_in = in + static_cast<ptrdiff_t>(s) * in_stride_seq + static_cast<ptrdiff_t>(h) * in_stride_head;
+            T *head_out = out + (s * n_heads + h) * hd;
+            llaisys::utils::simd::to_f32(row.data(), head_in, hd);
+
+            // 应用旋转：
+            // a' = a * cos - b * sin
+            // b' = b * cos + a * sin
+            float *a = row.data(), *b = row.data() + half_dim;
             for (size_t i = 0; i < half_dim; i++) {
-                // 计算旋转频率，使用与PyTorch相同的方式: freqs = positions / (theta ** (2 * i / head_dim))
-                float freq_exp = (2.0f * static_cast<float>(i)) / static_cast<float>(head_dim);
-                float freq_base = std::pow(theta, freq_exp);
-                float angle = position / freq_base;
-                
-                float cos_val = std::cos(angle);
-                float sin_val = std::sin(angle);
-                
-                // 获取输入的a和b值
-                float a_val, b_val;
-                if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                    a_val = llaisys::utils::cast<float>(head_in[i]);
-                    b_val = llaisys::utils::cast<float>(head_in[i + half_dim]);
-                } else {
-                    a_val = static_cast<float>(head_in[i]);
-                    b_val = static_cast<float>(head_in[i + half_dim]);
-                }
-                
-                // 应用旋转：
-                // a' = a * cos - b * sin
-                // b' = b * cos + a * sin
-                float a_new = a_val * cos_val - b_val * sin_val;
-                float b_new = b_val * cos_val + a_val * sin_val;
-                
-                // 存储结果
-                if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                    head_out[i] = llaisys::utils::cast<T>(a_new);
-                    head_out[i + half_dim] = llaisys::utils::cast<T>(b_new);
-                } else {
-                    head_out[i] = static_cast<T>(a_new);
-                    head_out[i + half_dim] = static_cast<T>(b_new);
-                }
+                float a_val = a[i], b_val = b[i];
+                a[i] = a_val * cos_sin[i] - b_val * cos_sin[half_dim + i];
+                b[i] = b_val * cos_sin[i] + a_val * cos_sin[half_dim + i];
             }
+
+            // 存储结果
+            llaisys::utils::simd::from_f32(head_out, row.data(), hd);
         }
+    });
+}
+
+// 按 head_dim 选择实例
+template <typename T>
+void rope_dispatch(T *out, const T *in, const int64_t *pos_ids,
+                   size_t seq_len, size_t n_heads, size_t head_dim,
+                   ptrdiff_t in_stride_seq, ptrdiff_t in_stride_head, float theta) {
+    switch (head_dim) {
+    case 64:
+        return rope_<T, 64>(out, in, pos_ids, seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta);
+    case 96:
+        return rope_<T, 96>(out, in, pos_ids, seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta);
+    case 128:
+        return rope_<T, 128>(out, in, pos_ids, seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta);
+    default:
+        return rope_<T, 0>(out, in, pos_ids, seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta);
     }
 }
 
 namespace llaisys::ops::cpu {
 void rope(std::byte *out, const std::byte *in, const std::byte *pos_ids, 
-          llaisysDataType_t type, size_t seq_len, size_t n_heads, size_t head_dim, float theta) {
+          llaisysDataType_t type, size_t seq_len, size_t n_heads, size_t head_dim,
+          ptrdiff_t in_stride_seq, ptrdiff_t in_stride_head, float theta) {
     switch (type) {
     case LLAISYS_DTYPE_F32:
-        return rope_(
+        return rope_dispatch(
             reinterpret_cast<float *>(out),
             reinterpret_cast<const float *>(in),
             reinterpret_cast<const int64_t *>(pos_ids),
-            seq_len, n_heads, head_dim, theta
+            seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta
         );
     case LLAISYS_DTYPE_BF16:
-        return rope_(
+        return rope_dispatch(
             reinterpret_cast<llaisys::bf16_t *>(out),
             reinterpret_cast<const llaisys::bf16_t *>(in),
             reinterpret_cast<const int64_t *>(pos_ids),
-            seq_len, n_heads, head_dim, theta
+            seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta
         );
     case LLAISYS_DTYPE_F16:
-        return rope_(
+        return rope_dispatch(
             reinterpret_cast<llaisys::fp16_t *>(out),
             reinterpret_cast<const llaisys::fp16_t *>(in),
             reinterpret_cast<const int64_t *>(pos_ids),
-            seq_len, n_heads, head_dim, theta
+            seq_len, n_heads, head_dim, in_stride_seq, in_stride_head, theta
         );
     default:
         EXCEPTION_UNSUPPORTED_DATATYPE(type);
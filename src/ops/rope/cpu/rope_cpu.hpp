@@ -4,6 +4,8 @@
 #include <cstddef>
 
 namespace llaisys::ops::cpu {
+// `in` may be strided over positions and heads (in elements); out is contiguous.
 void rope(std::byte *out, const std::byte *in, const std::byte *pos_ids, 
-          llaisysDataType_t type, size_t seq_len, size_t n_heads, size_t head_dim, float theta);
+          llaisysDataType_t type, size_t seq_len, size_t n_heads, size_t head_dim,
+          ptrdiff_t in_stride_seq, ptrdiff_t in_stride_head, float theta);
 }
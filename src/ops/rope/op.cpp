@@ -14,14 +14,14 @@ void rope(tensor_t out, tensor_t in, tensor_t pos_ids, float theta) {
     CHECK_SAME_DTYPE(out->dtype(), in->dtype());
     ASSERT(pos_ids->dtype() == LLAISYS_DTYPE_I64, "RoPE: pos_ids must be int64");
     
-    // Check contiguity
-    ASSERT(out->isContiguous() && in->isContiguous() && pos_ids->isContiguous(), 
-           "RoPE: all tensors must be contiguous");
+    // Check contiguity; the input may be a strided view (e.g. q/k of a fused QKV output)
+    ASSERT(out->isContiguous() && pos_ids->isContiguous(), "RoPE: output and pos_ids must be contiguous");
     
     // Check dimensions
     ASSERT(in->ndim() == 3, "RoPE: input must be 3D tensor [seq_len, n_heads, head_dim]");
     ASSERT(out->ndim() == 3, "RoPE: output must be 3D tensor [seq_len, n_heads, head_dim]");
     ASSERT(pos_ids->ndim() == 1, "RoPE: pos_ids must be 1D tensor [seq_len]");
+    ASSERT(in->strides()[2] == 1, "RoPE: input head_dim must be contiguous");
     
     // Check shapes are compatible
     size_t seq_len = in->shape()[0];
@@ -37,7 +37,8 @@ void rope(tensor_t out, tensor_t in, tensor_t pos_ids, float theta) {
     // always support cpu calculation
     if (out->deviceType() == LLAISYS_DEVICE_CPU) {
         return cpu::rope(out->data(), in->data(), pos_ids->data(), 
-                        out->dtype(), seq_len, n_heads, head_dim, theta);
+                        out->dtype(), seq_len, n_heads, head_dim,
+                        in->strides()[0], in->strides()[1], theta);
     }
 
     llaisys::core::context().setDevice(out->deviceType(), out->deviceId());
@@ -45,7 +46,8 @@ void rope(tensor_t out, tensor_t in, tensor_t pos_ids, float theta) {
     switch (out->deviceType()) {
     case LLAISYS_DEVICE_CPU:
         return cpu::rope(out->data(), in->data(), pos_ids->data(), 
-                        out->dtype(), seq_len, n_heads, head_dim, theta);
+                        out->dtype(), seq_len, n_heads, head_dim,
+                        in->strides()[0], in->strides()[1], theta);
 #ifdef ENABLE_NVIDIA_API
     case LLAISYS_DEVICE_NVIDIA:
         TO_BE_IMPLEMENTED();
@@ -0,0 +1,165 @@
+#include "sample_cpu.hpp"
+
+#include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// 采样步骤 (均在 fp32 上进行):
+//   1. 重复惩罚: history 中出现过的 token (去重后各一次), 正 logit 除以 penalty, 负的乘以 penalty
+//   2. temperature <= 0 或 top_k == 1: 直接取 argmax (并列取下标小者), 不消耗随机数
+//   3. 除以 temperature, 求最大值 m
+//   4. 候选集: SIMD 比较并压缩出 x >= 阈值 的下标, 阈值 = max(m - margin, 下限)
+//      下限 = m + log(min_p) (min-p), 或 m - TAIL (概率比 < e^-40, 可忽略)
+//      有 top_k 时从小 margin 开始, 候选不足 k 个则放宽, 再用 nth_element 截到 k 个; 不做全排序
+//   5. top-p: 候选的概率按 m - x 分桶 (宽 BIN) 累加, 从 margin = BIN 起逐桶放宽, 直到 margin 内的
+//      候选概率达到 top_p (nucleus 必在其中); 只对这些候选排序并累加, 保留累计概率达到 top_p 的最少前缀
+//   6. 按候选的未归一化概率 exp(x - m) 抽样
+// 随机数为 splitmix64, 状态由调用方按请求保存
+
+namespace {
+constexpr float TAIL = 40.0f;
+constexpr float BIN = 0.5f;
+constexpr size_t NBIN = static_cast<size_t>(TAIL / BIN) + 1;
+
+uint64_t next_u64(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+double next_unit(uint64_t &state) {
+    return static_cast<double>(next_u64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void apply_repetition_penalty(float *x, size_t n, const int64_t *history, size_t nhistory, float penalty) {
+    std::vector<int64_t> tokens(history, history + nhistory);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    for (int64_t t : tokens) {
+        if (t < 0 || static_cast<size_t>(t) >= n) {
+            continue;
+        }
+        x[t] = x[t] > 0.0f ? x[t] / penalty : x[t] * penalty;
+    }
+}
+
+int64_t sample_f32(float *x, size_t n, const int64_t *history, size_t nhistory, float temperature, size_t top_k,
+                   float top_p, float min_p, float repetition_penalty, uint64_t *rng_state) {
+    if (repetition_penalty != 1.0f && nhistory > 0) {
+        apply_repetition_penalty(x, n, history, nhistory, repetition_penalty);
+    }
+    if (temperature <= 0.0f || top_k == 1) {
+        return std::max_element(x, x + n) - x;
+    }
+
+    float inv_temp = 1.0f / temperature;
+    for (size_t i = 0; i < n; i++) {
+        x[i] *= inv_temp;
+    }
+    float m = llaisys::utils::simd::max(x, n);
+    float floor = m - TAIL;
+    if (min_p > 0.0f) {
+        floor = std::max(floor, m + std::log(min_p));
+    }
+
+    // Candidates: every output at or above the threshold, widened until there are top_k of them
+    thread_local std::vector<uint32_t> idx;
+    idx.resize(n);
+    size_t k = top_k == 0 ? n : std::min(top_k, n);
+    size_t count = 0;
+    for (float margin = 2.0f;; margin *= 4.0f) {
+        float threshold = top_k == 0 ? floor : std::max(floor, m - margin);
+        count = llaisys::utils::simd::select_ge(idx.data(), x, threshold, n);
+        if (count >= k || threshold <= floor) {
+            break;
+        }
+    }
+    auto better = [x](uint32_t a, uint32_t b) { return x[a] > x[b] || (x[a] == x[b] && a < b); };
+    if (count > k) {
+        std::nth_element(idx.begin(), idx.begin() + (k - 1), idx.begin() + count, better);
+        count = k;
+    }
+
+    thread_local std::vector<float> probs;
+    probs.resize(count);
+    for (size_t j = 0; j < count; j++) {
+        probs[j] = x[idx[j]];
+    }
+    double mass = llaisys::utils::simd::exp_sum(probs.data(), m, count);
+    if (top_p < 1.0f) {
+        // The nucleus lies within the candidates less than margin below m once those hold top_p
+        // of the mass. Their mass per BIN-wide bin of m - x gives the smallest such margin in one
+        // pass; only the candidates of those bins are sorted.
+        double target = top_p * mass;
+        auto bin_of = [x, m](uint32_t i) { return std::min(static_cast<size_t>((m - x[i]) / BIN), NBIN - 1); };
+        double bins[NBIN] = {};
+        for (size_t j = 0; j < count; j++) {
+            bins[bin_of(idx[j])] += probs[j];
+        }
+        size_t last_bin = 0;
+        for (double part = bins[0]; part < target && last_bin + 1 < NBIN;) {
+            part += bins[++last_bin];
+        }
+        size_t narrowed = std::partition(idx.begin(), idx.begin() + count,
+                                         [&bin_of, last_bin](uint32_t i) { return bin_of(i) <= last_bin; })
+                        - idx.begin();
+        std::sort(idx.begin(), idx.begin() + narrowed, better);
+        for (size_t j = 0; j < narrowed; j++) {
+            probs[j] = x[idx[j]];
+        }
+        llaisys::utils::simd::exp_sum(probs.data(), m, narrowed);
+        double cum = 0.0;
+        size_t kept = 0;
+        while (kept < narrowed && (kept == 0 || cum < target)) {
+            cum += probs[kept++];
+        }
+        count = kept;
+        mass = cum;
+    }
+
+    double u = next_unit(*rng_state) * mass;
+    for (size_t j = 0; j < count; j++) {
+        u -= probs[j];
+        if (u < 0.0) {
+            return idx[j];
+        }
+    }
+    // Rounding left u at or above the last probability
+    return idx[count - 1];
+}
+
+template <typename T>
+int64_t sample_widened(const T *logits, size_t n, const int64_t *history, size_t nhistory, float temperature,
+                       size_t top_k, float top_p, float min_p, float repetition_penalty, uint64_t *rng_state) {
+    thread_local std::vector<float> x;
+    x.resize(n);
+    llaisys::utils::simd::to_f32(x.data(), logits, n);
+    return sample_f32(x.data(), n, history, nhistory, temperature, top_k, top_p, min_p, repetition_penalty,
+                      rng_state);
+}
+} // namespace
+
+namespace llaisys::ops::cpu {
+int64_t sample(std::byte *logits, llaisysDataType_t type, size_t n, const int64_t *history, size_t nhistory,
+               float temperature, size_t top_k, float top_p, float min_p, float repetition_penalty,
+               uint64_t *rng_state) {
+    switch (type) {
+    case LLAISYS_DTYPE_F32:
+        return sample_f32(reinterpret_cast<float *>(logits), n, history, nhistory, temperature, top_k, top_p, min_p,
+                          repetition_penalty, rng_state);
+    case LLAISYS_DTYPE_BF16:
+        return sample_widened(reinterpret_cast<const llaisys::bf16_t *>(logits), n, history, nhistory, temperature,
+                              top_k, top_p, min_p, repetition_penalty, rng_state);
+    case LLAISYS_DTYPE_F16:
+        return sample_widened(reinterpret_cast<const llaisys::fp16_t *>(logits), n, history, nhistory, temperature,
+                              top_k, top_p, min_p, repetition_penalty, rng_state);
+    default:
+        EXCEPTION_UNSUPPORTED_DATATYPE(type);
+    }
+}
+} // namespace llaisys::ops::cpu
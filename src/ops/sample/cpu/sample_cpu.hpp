@@ -0,0 +1,14 @@
+#pragma once
+#include "llaisys.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace llaisys::ops::cpu {
+// Token drawn from n logits of `type` (F32, BF16 or F16); see ops::sample for the stages. F32
+// logits are penalized and scaled in place, the others in a widened copy. rng_state may be
+// null for greedy parameters.
+int64_t sample(std::byte *logits, llaisysDataType_t type, size_t n, const int64_t *history, size_t nhistory,
+               float temperature, size_t top_k, float top_p, float min_p, float repetition_penalty,
+               uint64_t *rng_state);
+}
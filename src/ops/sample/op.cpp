@@ -0,0 +1,50 @@
+#include "op.hpp"
+
+#include "../../core/llaisys_core.hpp"
+#include "../../utils.hpp"
+
+#include "cpu/sample_cpu.hpp"
+
+namespace llaisys::ops {
+void sample(tensor_t out_idx, tensor_t logits, tensor_t history, const SamplingParams &params, uint64_t *rng_state) {
+    CHECK_SAME_DEVICE(out_idx, logits);
+    ASSERT(out_idx->dtype() == LLAISYS_DTYPE_I64, "Sample: out_idx must be int64");
+    ASSERT(out_idx->numel() == 1, "Sample: out_idx must be scalar");
+    ASSERT(logits->ndim() == 1 && logits->numel() > 0, "Sample: logits must be a non-empty 1D tensor");
+    ASSERT(out_idx->isContiguous() && logits->isContiguous(), "Sample: out_idx and logits must be contiguous");
+    const int64_t *history_ids = nullptr;
+    size_t nhistory = 0;
+    if (history) {
+        CHECK_SAME_DEVICE(history, logits);
+        ASSERT(history->dtype() == LLAISYS_DTYPE_I64, "Sample: history must be int64");
+        ASSERT(history->ndim() == 1 && history->isContiguous(), "Sample: history must be a contiguous 1D tensor");
+        history_ids = reinterpret_cast<const int64_t *>(history->data());
+        nhistory = history->numel();
+    }
+    CHECK_ARGUMENT(params.top_p > 0.0f, "Sample: top_p must be positive");
+    CHECK_ARGUMENT(params.min_p >= 0.0f && params.min_p <= 1.0f, "Sample: min_p must be in [0, 1]");
+    CHECK_ARGUMENT(params.repetition_penalty > 0.0f, "Sample: repetition_penalty must be positive");
+    CHECK_ARGUMENT(rng_state || params.temperature <= 0.0f || params.top_k == 1,
+                   "Sample: a generator state is needed unless decoding greedily");
+
+    // always support cpu calculation
+    if (logits->deviceType() == LLAISYS_DEVICE_CPU) {
+        *reinterpret_cast<int64_t *>(out_idx->data()) = cpu::sample(
+            logits->data(), logits->dtype(), logits->numel(), history_ids, nhistory, params.temperature, params.top_k,
+            params.top_p, params.min_p, params.repetition_penalty, rng_state);
+        return;
+    }
+
+    llaisys::core::context().setDevice(logits->deviceType(), logits->deviceId());
+
+    switch (logits->deviceType()) {
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+} // namespace llaisys::ops
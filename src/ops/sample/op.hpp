@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../../tensor/tensor.hpp"
+
+namespace llaisys::ops {
+// Token selection stages of sample(), in order: repetition penalty, temperature, top-k, min-p,
+// top-p. The defaults disable every stage, which is greedy decoding.
+struct SamplingParams {
+    float temperature = 0.0f; // <= 0: argmax after the penalty
+    size_t top_k = 0;         // 0: no limit
+    float top_p = 1.0f;
+    float min_p = 0.0f;
+    float repetition_penalty = 1.0f;
+};
+
+// out_idx (I64, one element): a token drawn from logits [voc] with `params`, history (I64 [n])
+// the tokens the repetition penalty applies to, or null. F32 logits are penalized and scaled
+// in place. *rng_state advances by one draw unless the params are greedy.
+void sample(tensor_t out_idx, tensor_t logits, tensor_t history, const SamplingParams &params, uint64_t *rng_state);
+}
@@ -0,0 +1,177 @@
+#include "../../../utils/simd_x86.hpp"
+
+#include "attention_kernels.hpp"
+
+#include "../../../utils/simd.hpp"
+
+namespace llaisys::ops::cpu::attention {
+namespace {
+void scores_generic(const float *q, const float *k, size_t n, size_t hd, float *s) {
+    for (size_t c = 0; c < n; c++) {
+        s[c] = utils::simd::dot(q, k + c * hd, hd);
+    }
+}
+
+void accumulate_generic(float *o, const float *p, const float *v, size_t n, size_t hd) {
+    for (size_t c = 0; c < n; c++) {
+        utils::simd::axpy(o, p[c], v + c * hd, hd);
+    }
+}
+
+#if defined(LLAISYS_X86)
+// q stays in HD / 8 ymm registers; four keys per step for independent accumulators.
+template <size_t HD>
+LLAISYS_TARGET_AVX2 void scores_avx2(const float *q, const float *k, size_t n, size_t, float *s) {
+    constexpr size_t V = HD / 8;
+    __m256 qv[V];
+    for (size_t v = 0; v < V; v++) {
+        qv[v] = _mm256_loadu_ps(q + v * 8);
+    }
+    size_t c = 0;
+    for (; c + 4 <= n; c += 4) {
+        const float *k0 = k + c * HD;
+        __m256 a0 = _mm256_mul_ps(qv[0], _mm256_loadu_ps(k0));
+        __m256 a1 = _mm256_mul_ps(qv[0], _mm256_loadu_ps(k0 + HD));
+        __m256 a2 = _mm256_mul_ps(qv[0], _mm256_loadu_ps(k0 + 2 * HD));
+        __m256 a3 = _mm256_mul_ps(qv[0], _mm256_loadu_ps(k0 + 3 * HD));
+        for (size_t v = 1; v < V; v++) {
+            a0 = _mm256_fmadd_ps(qv[v], _mm256_loadu_ps(k0 + v * 8), a0);
+            a1 = _mm256_fmadd_ps(qv[v], _mm256_loadu_ps(k0 + HD + v * 8), a1);
+            a2 = _mm256_fmadd_ps(qv[v], _mm256_loadu_ps(k0 + 2 * HD + v * 8), a2);
+            a3 = _mm256_fmadd_ps(qv[v], _mm256_loadu_ps(k0 + 3 * HD + v * 8), a3);
+        }
+        s[c] = utils::simd::hsum8(a0);
+        s[c + 1] = utils::simd::hsum8(a1);
+        s[c + 2] = utils::simd::hsum8(a2);
+        s[c + 3] = utils::simd::hsum8(a3);
+    }
+    for (; c < n; c++) {
+        __m256 a = _mm256_mul_ps(qv[0], _mm256_loadu_ps(k + c * HD));
+        for (size_t v = 1; v < V; v++) {
+            a = _mm256_fmadd_ps(qv[v], _mm256_loadu_ps(k + c * HD + v * 8), a);
+        }
+        s[c] = utils::simd::hsum8(a);
+    }
+}
+
+// o stays in HD / 8 ymm registers across the block.
+template <size_t HD>
+LLAISYS_TARGET_AVX2 void accumulate_avx2(float *o, const float *p, const float *v, size_t n, size_t) {
+    constexpr size_t V = HD / 8;
+    __m256 ov[V];
+    for (size_t j = 0; j < V; j++) {
+        ov[j] = _mm256_loadu_ps(o + j * 8);
+    }
+    for (size_t c = 0; c < n; c++) {
+        __m256 pc = _mm256_set1_ps(p[c]);
+        for (size_t j = 0; j < V; j++) {
+            ov[j] = _mm256_fmadd_ps(pc, _mm256_loadu_ps(v + c * HD + j * 8), ov[j]);
+        }
+    }
+    for (size_t j = 0; j < V; j++) {
+        _mm256_storeu_ps(o + j * 8, ov[j]);
+    }
+}
+
+template <size_t HD>
+LLAISYS_TARGET_AVX512 void scores_avx512(const float *q, const float *k, size_t n, size_t, float *s) {
+    constexpr size_t V = HD / 16;
+    __m512 qv[V];
+    for (size_t v = 0; v < V; v++) {
+        qv[v] = _mm512_loadu_ps(q + v * 16);
+    }
+    size_t c = 0;
+    for (; c + 4 <= n; c += 4) {
+        const float *k0 = k + c * HD;
+        __m512 a0 = _mm512_mul_ps(qv[0], _mm512_loadu_ps(k0));
+        __m512 a1 = _mm512_mul_ps(qv[0], _mm512_loadu_ps(k0 + HD));
+        __m512 a2 = _mm512_mul_ps(qv[0], _mm512_loadu_ps(k0 + 2 * HD));
+        __m512 a3 = _mm512_mul_ps(qv[0], _mm512_loadu_ps(k0 + 3 * HD));
+        for (size_t v = 1; v < V; v++) {
+            a0 = _mm512_fmadd_ps(qv[v], _mm512_loadu_ps(k0 + v * 16), a0);
+            a1 = _mm512_fmadd_ps(qv[v], _mm512_loadu_ps(k0 + HD + v * 16), a1);
+            a2 = _mm512_fmadd_ps(qv[v], _mm512_loadu_ps(k0 + 2 * HD + v * 16), a2);
+            a3 = _mm512_fmadd_ps(qv[v], _mm512_loadu_ps(k0 + 3 * HD + v * 16), a3);
+        }
+        s[c] = _mm512_reduce_add_ps(a0);
+        s[c + 1] = _mm512_reduce_add_ps(a1);
+        s[c + 2] = _mm512_reduce_add_ps(a2);
+        s[c + 3] = _mm512_reduce_add_ps(a3);
+    }
+    for (; c < n; c++) {
+        __m512 a = _mm512_mul_ps(qv[0], _mm512_loadu_ps(k + c * HD));
+        for (size_t v = 1; v < V; v++) {
+            a = _mm512_fmadd_ps(qv[v], _mm512_loadu_ps(k + c * HD + v * 16), a);
+        }
+        s[c] = _mm512_reduce_add_ps(a);
+    }
+}
+
+template <size_t HD>
+LLAISYS_TARGET_AVX512 void accumulate_avx512(float *o, const float *p, const float *v, size_t n, size_t) {
+    constexpr size_t V = HD / 16;
+    __m512 ov[V];
+    for (size_t j = 0; j < V; j++) {
+        ov[j] = _mm512_loadu_ps(o + j * 16);
+    }
+    for (size_t c = 0; c < n; c++) {
+        __m512 pc = _mm512_set1_ps(p[c]);
+        for (size_t j = 0; j < V; j++) {
+            ov[j] = _mm512_fmadd_ps(pc, _mm512_loadu_ps(v + c * HD + j * 16), ov[j]);
+        }
+    }
+    for (size_t j = 0; j < V; j++) {
+        _mm512_storeu_ps(o + j * 16, ov[j]);
+    }
+}
+
+template <size_t HD>
+const Kernels &avx2_kernels() {
+    static const Kernels k{&scores_avx2<HD>, &accumulate_avx2<HD>};
+    return k;
+}
+
+template <size_t HD>
+const Kernels &avx512_kernels() {
+    static const Kernels k{&scores_avx512<HD>, &accumulate_avx512<HD>};
+    return k;
+}
+#endif
+} // namespace
+
+const Kernels &kernels(utils::CpuIsa isa, size_t hd) {
+    static const Kernels generic{&scores_generic, &accumulate_generic};
+#if defined(LLAISYS_X86)
+    switch (isa) {
+    case utils::CpuIsa::AVX512:
+        switch (hd) {
+        case 64:
+            return avx512_kernels<64>();
+        case 96:
+            return avx512_kernels<96>();
+        case 128:
+            return avx512_kernels<128>();
+        default:
+            return generic;
+        }
+    case utils::CpuIsa::AVX2:
+        switch (hd) {
+        case 64:
+            return avx2_kernels<64>();
+        case 96:
+            return avx2_kernels<96>();
+        case 128:
+            return avx2_kernels<128>();
+        default:
+            return generic;
+        }
+    default:
+        break;
+    }
+#else
+    (void)isa;
+    (void)hd;
+#endif
+    return generic;
+}
+} // namespace llaisys::ops::cpu::attention
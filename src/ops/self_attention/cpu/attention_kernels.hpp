@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../../../utils/cpu_info.hpp"
+
+#include <cstddef>
+
+namespace llaisys::ops::cpu::attention {
+// Inner loops of the decode kernel over one block of n keys, widened to fp32 as rows of hd floats.
+//   scores:     s[c] = dot(q, k + c * hd)
+//   accumulate: o[d] += sum_c p[c] * v[c * hd + d]
+// The head sizes of common models (64, 96, 128) have instances with hd fixed at compile time
+// that keep q, respectively o, in registers across the whole block; other sizes and the
+// portable path loop over utils::simd::dot / axpy.
+typedef void (*scores_fn)(const float *q, const float *k, size_t n, size_t hd, float *s);
+typedef void (*accumulate_fn)(float *o, const float *p, const float *v, size_t n, size_t hd);
+
+struct Kernels {
+    scores_fn scores;
+    accumulate_fn accumulate;
+};
+
+const Kernels &kernels(utils::CpuIsa isa, size_t hd);
+} // namespace llaisys::ops::cpu::attention
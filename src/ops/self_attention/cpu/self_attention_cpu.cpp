@@ -1,144 +1,392 @@
 #include "self_attention_cpu.hpp"
 
+#include "attention_kernels.hpp"
+
+#include "../../linear/cpu/gemm_kernels.hpp"
+
+#include "../../../device/cpu/thread_pool.hpp"
 #include "../../../utils.hpp"
+#include "../../../utils/simd.hpp"
 
-#include <cmath>
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <vector>
 
 // Self-Attention 实现
 // q: [qlen, nh, hd]
-// k: [kvlen, nkvh, hd] 
-// v: [kvlen, nkvh, hd]
+// k: [kvlen, nkvh, hd], 或分页的 [nblocks, block_size, nkvh, hd] 加块表 (见 KVRows)
+// v: 同 k
 // attn_val: [qlen, nh, hd]
-template <typename T>
-void self_attention_(T *attn_val, const T *q, const T *k, const T *v,
-                    size_t qlen, size_t kvlen, size_t nh, size_t nkvh, size_t hd, float scale) {
-    
-    // Group Query Attention: 每个kv头对应多少个query头
+// 半精度/FP8/INT8 的 K/V 行在点积和累加前逐块转换为float, 全程float累加
+// 量化缓存的每个 (位置, kv头) 行带一个 float 缩放因子, 转换时一并乘上
+// T 为 q/attn_val 类型, TKV 为 K/V 缓存类型 (T 本身, FP8 或 INT8)
+
+// 每个线程至少分到的 kvlen * hd 乘加量, 低于此值时唤醒线程池得不偿失
+constexpr size_t MIN_WORK_PER_THREAD = size_t(1) << 16;
+
+// 分块 (FlashAttention 式) 预填充的块大小: 每块 KV_BLOCK 个 key, 每块 Q_PANELS 个 mr 行的 query 面板
+constexpr size_t KV_BLOCK = 64;
+constexpr size_t Q_PANELS = 4;
+// 解码时每个 split-K 分片的 key 数
+constexpr size_t KV_SPLIT = 256;
+
+// 因果mask: PyTorch逻辑 mask = ~torch.ones(L, S).tril(diagonal=S-L)
+// 即只有 ki <= qi + (S-L) 的位置可见, 返回第 qi 行可见的 key 数
+inline size_t visible_keys(size_t qi, size_t qlen, size_t kvlen) {
+    ptrdiff_t last_visible = static_cast<ptrdiff_t>(qi + kvlen) - static_cast<ptrdiff_t>(qlen);
+    return static_cast<size_t>(std::clamp<ptrdiff_t>(last_visible + 1, 0, static_cast<ptrdiff_t>(kvlen)));
+}
+
+// K/V 行的寻址: 连续存储的 [kvlen, nkvh, hd], 或分页存储的 [nblocks, block_size, nkvh, hd],
+// 第 pos 个位置在 block_table[pos / block_size] 块的第 pos % block_size 行
+// scales 非空时与数据同样寻址, 每行 nkvh 个, 反量化为 x = scale * q
+template <typename TKV>
+struct KVRows {
+    const TKV *data;
+    const float *scales;        // 为空时不缩放
+    size_t nkvh;
+    size_t hd;
+    const int64_t *block_table; // 为空时连续存储
+    size_t block_size;
+
+    size_t index(size_t pos, size_t kv_head) const {
+        size_t r = block_table ? static_cast<size_t>(block_table[pos / block_size]) * block_size + pos % block_size : pos;
+        return r * nkvh + kv_head;
+    }
+
+    // 第 pos 个位置第 kv_head 个头的一行转换为float, 不乘缩放因子
+    void load_codes(float *dst, size_t pos, size_t kv_head) const {
+        llaisys::utils::simd::to_f32(dst, data + index(pos, kv_head) * hd, hd);
+    }
+
+    // 同上, 并乘上缩放因子
+    void load(float *dst, size_t pos, size_t kv_head) const {
+        size_t i = index(pos, kv_head);
+        llaisys::utils::simd::to_f32(dst, data + i * hd, hd);
+        if (scales) {
+            for (size_t d = 0; d < hd; d++) {
+                dst[d] *= scales[i];
+            }
+        }
+    }
+};
+
+// 解码实现, 用于 decode 等 query 行数不足一个面板的情况
+// 共享同一个kv头的所有 (query, head) 行一起处理, 每个 K/V 行只转换/读取一次
+// 分数与累加的内层循环见 attention_kernels, 常见的 head_dim 有编译期展开的版本
+// 量化缓存的缩放因子不乘到 K/V 行上, 而是乘到分数 (K) 和概率 (V) 上: 每个 key 只需 rows 次乘法
+// 长上下文按 KV_SPLIT 个 key 切分 (split-K), 每个任务是 (kv头, 分片), 各分片得到部分结果
+// (O, m, l), 最后按 log-sum-exp 合并: O = sum exp(m_s - M) O_s / sum exp(m_s - M) l_s
+// 分片大小固定, 结果与线程数无关
+template <typename T, typename TKV = T>
+void self_attention_decode_(T *attn_val, const T *q, KVRows<TKV> k, KVRows<TKV> v,
+                            size_t qlen, size_t kvlen, size_t nh, size_t nkvh, size_t hd, float scale) {
+    namespace simd = llaisys::utils::simd;
     size_t group_size = nh / nkvh;
-    
-    // 为每个query位置和每个头计算注意力
-    for (size_t qi = 0; qi < qlen; qi++) {
-        for (size_t h = 0; h < nh; h++) {
-            // 确定当前query头对应的kv头
-            size_t kv_head = h / group_size;
-            
-            const T *q_head = q + (qi * nh + h) * hd;  // 当前query向量
-            T *out_head = attn_val + (qi * nh + h) * hd;  // 输出位置
-            
-            // 步骤1：计算注意力分数 Q @ K^T * scale
-            float *attn_scores = new float[kvlen];  // 注意力分数
-            
-            for (size_t ki = 0; ki < kvlen; ki++) {
-                const T *k_head = k + (ki * nkvh + kv_head) * hd;  // 对应的key向量
-                
-                // 计算点积 q · k
-                float score = 0.0f;
+    size_t rows = qlen * group_size; // 一个kv头对应的 (query, head) 行, 第 r 行为 (r / group_size, r % group_size)
+    size_t nsplit = std::max<size_t>((kvlen + KV_SPLIT - 1) / KV_SPLIT, 1);
+    size_t stride = hd + 2; // 每行的部分结果: O[hd], m, l
+    std::vector<float> partial(nkvh * nsplit * rows * stride);
+    const auto &kernels = llaisys::ops::cpu::attention::kernels(llaisys::utils::cpu_info().isa, hd);
+
+    size_t grain = std::max<size_t>(MIN_WORK_PER_THREAD / std::max<size_t>(KV_SPLIT * rows * hd, 1), 1);
+    llaisys::device::cpu::parallel_for(nkvh * nsplit, grain, [&](size_t u0, size_t u1) {
+        std::vector<float> q_rows(rows * hd);
+        std::vector<float> kv(KV_BLOCK * hd);
+        std::vector<float> scores(rows * KV_BLOCK);
+        std::vector<float> p(KV_BLOCK);
+        std::vector<float> k_scale(KV_BLOCK), v_scale(KV_BLOCK);
+
+        for (size_t u = u0; u < u1; u++) {
+            size_t kv_head = u / nsplit, k0 = (u % nsplit) * KV_SPLIT;
+            size_t limit = std::min(k0 + KV_SPLIT, visible_keys(qlen - 1, qlen, kvlen)); // 最后一行可见的最多
+            float *part = partial.data() + u * rows * stride;
+
+            for (size_t r = 0; r < rows; r++) {
+                size_t qi = r / group_size, h = kv_head * group_size + r % group_size;
+                float *qr = q_rows.data() + r * hd;
+                simd::to_f32(qr, q + (qi * nh + h) * hd, hd);
                 for (size_t d = 0; d < hd; d++) {
-                    float q_val, k_val;
-                    if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                        q_val = llaisys::utils::cast<float>(q_head[d]);
-                        k_val = llaisys::utils::cast<float>(k_head[d]);
-                    } else {
-                        q_val = static_cast<float>(q_head[d]);
-                        k_val = static_cast<float>(k_head[d]);
+                    qr[d] *= scale;
+                }
+                std::fill(part + r * stride, part + r * stride + hd, 0.0f);
+                part[r * stride + hd] = -std::numeric_limits<float>::infinity();
+                part[r * stride + hd + 1] = 0.0f;
+            }
+
+            for (size_t kb = k0; kb < limit; kb += KV_BLOCK) {
+                size_t bk = std::min(KV_BLOCK, limit - kb);
+                for (size_t c = 0; c < bk; c++) {
+                    k.load_codes(kv.data() + c * hd, kb + c, kv_head);
+                }
+                if (k.scales) {
+                    for (size_t c = 0; c < bk; c++) {
+                        k_scale[c] = k.scales[k.index(kb + c, kv_head)];
+                        v_scale[c] = v.scales[v.index(kb + c, kv_head)];
+                    }
+                }
+
+                // 分数与在线softmax, 同 self_attention_tiled_
+                for (size_t r = 0; r < rows; r++) {
+                    size_t row_limit = visible_keys(r / group_size, qlen, kvlen);
+                    size_t vis = row_limit > kb ? std::min(bk, row_limit - kb) : 0;
+                    if (vis == 0) {
+                        continue;
+                    }
+                    float *s = scores.data() + r * KV_BLOCK;
+                    kernels.scores(q_rows.data() + r * hd, kv.data(), vis, hd, s);
+                    if (k.scales) {
+                        for (size_t c = 0; c < vis; c++) {
+                            s[c] *= k_scale[c];
+                        }
+                    }
+                    float *o = part + r * stride, &row_max = o[hd], &row_sum = o[hd + 1];
+                    float m = std::max(row_max, *std::max_element(s, s + vis));
+                    float alpha = std::exp(row_max - m);
+                    row_sum = row_sum * alpha + simd::exp_sum(s, m, vis);
+                    row_max = m;
+                    if (alpha != 1.0f) {
+                        for (size_t d = 0; d < hd; d++) {
+                            o[d] *= alpha;
+                        }
                     }
-                    score += q_val * k_val;
                 }
-                
-                score *= scale;  // 应用缩放因子
-                
-                // 步骤2：应用因果mask
-                // PyTorch逻辑: mask = ~torch.ones(L, S).tril(diagonal=S-L) 
-                // 即：mask[i,j] = True if j > i + (S-L)
-                if (static_cast<int>(ki) > static_cast<int>(qi) + static_cast<int>(kvlen) - static_cast<int>(qlen)) {
-                    score = -std::numeric_limits<float>::infinity();
+
+                for (size_t c = 0; c < bk; c++) {
+                    v.load_codes(kv.data() + c * hd, kb + c, kv_head);
                 }
-                
-                attn_scores[ki] = score;
-            }
-            
-            // 步骤3：Softmax归一化
-            // 先找到最大值（数值稳定性）
-            float max_score = -std::numeric_limits<float>::infinity();
-            for (size_t ki = 0; ki < kvlen; ki++) {
-                if (attn_scores[ki] > max_score) {
-                    max_score = attn_scores[ki];
+                for (size_t r = 0; r < rows; r++) {
+                    size_t row_limit = visible_keys(r / group_size, qlen, kvlen);
+                    size_t vis = row_limit > kb ? std::min(bk, row_limit - kb) : 0;
+                    const float *pr = scores.data() + r * KV_BLOCK;
+                    if (v.scales) {
+                        for (size_t c = 0; c < vis; c++) {
+                            p[c] = pr[c] * v_scale[c];
+                        }
+                        pr = p.data();
+                    }
+                    kernels.accumulate(part + r * stride, pr, kv.data(), vis, hd);
                 }
             }
-            
-            // 计算exp和sum
-            float sum_exp = 0.0f;
-            for (size_t ki = 0; ki < kvlen; ki++) {
-                attn_scores[ki] = std::exp(attn_scores[ki] - max_score);
-                sum_exp += attn_scores[ki];
+        }
+    });
+
+    // 合并各分片, 没有可见 key 的行输出 0
+    std::vector<float> out_row(hd);
+    for (size_t kv_head = 0; kv_head < nkvh; kv_head++) {
+        const float *head_part = partial.data() + kv_head * nsplit * rows * stride;
+        for (size_t r = 0; r < rows; r++) {
+            float m = -std::numeric_limits<float>::infinity();
+            for (size_t sp = 0; sp < nsplit; sp++) {
+                m = std::max(m, head_part[(sp * rows + r) * stride + hd]);
             }
-            
-            // 归一化
-            for (size_t ki = 0; ki < kvlen; ki++) {
-                attn_scores[ki] /= sum_exp;
+            std::fill(out_row.begin(), out_row.end(), 0.0f);
+            float sum = 0.0f;
+            if (m != -std::numeric_limits<float>::infinity()) {
+                for (size_t sp = 0; sp < nsplit; sp++) {
+                    const float *o = head_part + (sp * rows + r) * stride;
+                    float w = std::exp(o[hd] - m);
+                    sum += w * o[hd + 1];
+                    simd::axpy(out_row.data(), w, o, hd);
+                }
             }
-            
-            // 步骤4：加权求和 attn_scores @ V
+            float inv_sum = sum > 0.0f ? 1.0f / sum : 0.0f;
             for (size_t d = 0; d < hd; d++) {
-                float output_val = 0.0f;
-                
-                for (size_t ki = 0; ki < kvlen; ki++) {
-                    const T *v_head = v + (ki * nkvh + kv_head) * hd;  // 对应的value向量
-                    
-                    float v_val;
-                    if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                        v_val = llaisys::utils::cast<float>(v_head[d]);
-                    } else {
-                        v_val = static_cast<float>(v_head[d]);
+                out_row[d] *= inv_sum;
+            }
+            size_t qi = r / group_size, h = kv_head * group_size + r % group_size;
+            simd::from_f32(attn_val + (qi * nh + h) * hd, out_row.data(), hd);
+        }
+    }
+}
+
+// 分块实现: 每个任务是 (query块, 头), query块为 Q_PANELS 个 mr 行面板
+// 对每个 KV_BLOCK 大小的 key 块:
+//   S = Q K^T      Q 面板 [hd][mr] (已乘 scale), K 块转置打包为 [hd][nr] 面板, 由 GEMM 微内核计算
+//   在线softmax    每行维护 m(最大值) 与 l(指数和), 最大值变大时 O 和 l 乘以 exp(m_old - m_new)
+//   O += P V       P 打包为 [key][mr] 面板, V 块按行连续打包为 [key][nr] 面板
+// 完全被因果mask遮住的 key 块 (超出本块最后一行的可见范围) 直接跳过, 最后 O / l 写回
+template <typename T, typename TKV = T>
+void self_attention_tiled_(T *attn_val, const T *q, KVRows<TKV> k, KVRows<TKV> v,
+                           size_t qlen, size_t kvlen, size_t nh, size_t nkvh, size_t hd, float scale,
+                           const llaisys::ops::cpu::gemm::Microkernel &uk) {
+    namespace simd = llaisys::utils::simd;
+    size_t group_size = nh / nkvh;
+    size_t mr = uk.mr, nr = uk.nr;
+    size_t q_block = Q_PANELS * mr;
+    size_t nqb = (qlen + q_block - 1) / q_block;
+    size_t hd_pad = (hd + nr - 1) / nr * nr; // O 与 V 面板按 nr 列对齐
+
+    // 越靠后的 query 块可见的 key 越多; 交替排列重块与轻块, 让等长的线程分片工作量相近
+    auto qblock_of = [nqb](size_t r) { return r % 2 == 0 ? r / 2 : nqb - 1 - r / 2; };
+
+    size_t grain = std::max<size_t>(MIN_WORK_PER_THREAD / std::max<size_t>(q_block * kvlen * hd, 1), 1);
+    llaisys::device::cpu::parallel_for(nqb * nh, grain, [&](size_t u0, size_t u1) {
+        std::vector<float> q_pack(Q_PANELS * hd * mr);
+        std::vector<float> k_pack(hd * KV_BLOCK);
+        std::vector<float> v_pack(KV_BLOCK * hd_pad);
+        std::vector<float> p_pack(KV_BLOCK * mr);
+        std::vector<float> scores(q_block * KV_BLOCK);
+        std::vector<float> out(q_block * hd_pad);
+        std::vector<float> row_max(q_block), row_sum(q_block);
+        std::vector<float> row(std::max(hd, hd_pad));
+
+        for (size_t u = u0; u < u1; u++) {
+            size_t q0 = qblock_of(u / nh) * q_block, h = u % nh;
+            size_t bq = std::min(q_block, qlen - q0);
+            size_t npanels = (bq + mr - 1) / mr;
+            size_t kv_head = h / group_size;
+            size_t limit = visible_keys(q0 + bq - 1, qlen, kvlen); // 本块所有行可见 key 的并集
+
+            // 打包 Q 面板, 多余的行补零
+            std::fill(q_pack.begin(), q_pack.begin() + npanels * hd * mr, 0.0f);
+            for (size_t r = 0; r < bq; r++) {
+                simd::to_f32(row.data(), q + ((q0 + r) * nh + h) * hd, hd);
+                float *panel = q_pack.data() + (r / mr) * hd * mr + r % mr;
+                for (size_t d = 0; d < hd; d++) {
+                    panel[d * mr] = row[d] * scale;
+                }
+            }
+            std::fill(out.begin(), out.begin() + npanels * mr * hd_pad, 0.0f);
+            std::fill(row_max.begin(), row_max.end(), -std::numeric_limits<float>::infinity());
+            std::fill(row_sum.begin(), row_sum.end(), 0.0f);
+
+            for (size_t kb = 0; kb < limit; kb += KV_BLOCK) {
+                size_t bk = std::min(KV_BLOCK, limit - kb);
+                size_t nkp = (bk + nr - 1) / nr;
+
+                // K 块转置打包为 [hd][nr] 面板, 多余的列补零
+                std::fill(k_pack.begin(), k_pack.begin() + nkp * hd * nr, 0.0f);
+                for (size_t c = 0; c < bk; c++) {
+                    k.load(row.data(), kb + c, kv_head);
+                    float *panel = k_pack.data() + (c / nr) * hd * nr + c % nr;
+                    for (size_t d = 0; d < hd; d++) {
+                        panel[d * nr] = row[d];
                     }
-                    
-                    output_val += attn_scores[ki] * v_val;
                 }
-                
-                // 存储结果
-                if constexpr (std::is_same_v<T, llaisys::bf16_t> || std::is_same_v<T, llaisys::fp16_t>) {
-                    out_head[d] = llaisys::utils::cast<T>(output_val);
-                } else {
-                    out_head[d] = static_cast<T>(output_val);
+                // V 块: 每个 key 一行, 按 nr 列切成面板 [bk][nr]
+                for (size_t c = 0; c < bk; c++) {
+                    v.load(row.data(), kb + c, kv_head);
+                    std::fill(row.begin() + hd, row.begin() + hd_pad, 0.0f);
+                    for (size_t j = 0; j < hd_pad; j += nr) {
+                        std::copy(row.begin() + j, row.begin() + j + nr, v_pack.begin() + j * bk + c * nr);
+                    }
                 }
+
+                // S = Q K^T
+                for (size_t pi = 0; pi < npanels; pi++) {
+                    for (size_t jp = 0; jp < nkp; jp++) {
+                        uk.compute(hd, q_pack.data() + pi * hd * mr, k_pack.data() + jp * hd * nr,
+                                   scores.data() + pi * mr * KV_BLOCK + jp * nr, KV_BLOCK, false);
+                    }
+                }
+
+                // 在线softmax, 结果 P 原地写回 S; 不可见的位置与多余的行为 0
+                for (size_t r = 0; r < npanels * mr; r++) {
+                    float *s = scores.data() + r * KV_BLOCK;
+                    size_t row_limit = r < bq ? visible_keys(q0 + r, qlen, kvlen) : 0;
+                    size_t vis = row_limit > kb ? std::min(bk, row_limit - kb) : 0;
+                    if (vis > 0) {
+                        float m = std::max(row_max[r], *std::max_element(s, s + vis));
+                        float alpha = std::exp(row_max[r] - m);
+                        row_sum[r] = row_sum[r] * alpha + simd::exp_sum(s, m, vis);
+                        row_max[r] = m;
+                        if (alpha != 1.0f) {
+                            float *o = out.data() + r * hd_pad;
+                            for (size_t d = 0; d < hd; d++) {
+                                o[d] *= alpha;
+                            }
+                        }
+                    }
+                    std::fill(s + vis, s + bk, 0.0f);
+                }
+
+                // O += P V
+                for (size_t pi = 0; pi < npanels; pi++) {
+                    for (size_t c = 0; c < bk; c++) {
+                        for (size_t r = 0; r < mr; r++) {
+                            p_pack[c * mr + r] = scores[(pi * mr + r) * KV_BLOCK + c];
+                        }
+                    }
+                    for (size_t j = 0; j < hd_pad; j += nr) {
+                        uk.compute(bk, p_pack.data(), v_pack.data() + j * bk,
+                                   out.data() + pi * mr * hd_pad + j, hd_pad, true);
+                    }
+                }
+            }
+
+            // O / l, 没有可见 key 的行输出 0
+            for (size_t r = 0; r < bq; r++) {
+                float *o = out.data() + r * hd_pad;
+                float inv_sum = row_sum[r] > 0.0f ? 1.0f / row_sum[r] : 0.0f;
+                for (size_t d = 0; d < hd; d++) {
+                    o[d] *= inv_sum;
+                }
+                simd::from_f32(attn_val + ((q0 + r) * nh + h) * hd, o, hd);
             }
-            
-            delete[] attn_scores;
         }
+    });
+}
+
+template <typename T, typename TKV = T>
+void self_attention_(T *attn_val, const T *q, KVRows<TKV> k, KVRows<TKV> v,
+                     size_t qlen, size_t kvlen, size_t nh, size_t nkvh, size_t hd, float scale) {
+    const auto &uk = llaisys::ops::cpu::gemm::microkernel(llaisys::utils::cpu_info().isa);
+    if (qlen < uk.mr) {
+        return self_attention_decode_(attn_val, q, k, v, qlen, kvlen, nh, nkvh, hd, scale);
     }
+    self_attention_tiled_(attn_val, q, k, v, qlen, kvlen, nh, nkvh, hd, scale, uk);
 }
 
 namespace llaisys::ops::cpu {
+namespace {
+template <typename T, typename TKV>
+void self_attention_typed(std::byte *attn_val, const std::byte *q, const std::byte *k, const std::byte *v,
+                          const float *k_scales, const float *v_scales, const int64_t *block_table,
+                          size_t block_size, size_t qlen, size_t kvlen, size_t nh, size_t nkvh, size_t hd,
+                          float scale) {
+    KVRows<TKV> k_rows{reinterpret_cast<const TKV *>(k), k_scales, nkvh, hd, block_table, block_size};
+    KVRows<TKV> v_rows{reinterpret_cast<const TKV *>(v), v_scales, nkvh, hd, block_table, block_size};
+    self_attention_(reinterpret_cast<T *>(attn_val), reinterpret_cast<const T *>(q), k_rows, v_rows,
+                    qlen, kvlen, nh, nkvh, hd, scale);
+}
+
+template <typename T>
+void self_attention_kv(std::byte *attn_val, const std::byte *q, const std::byte *k, const std::byte *v,
+                       llaisysDataType_t type, llaisysDataType_t kv_type, const float *k_scales,
+                       const float *v_scales, const int64_t *block_table, size_t block_size, size_t qlen,
+                       size_t kvlen, size_t nh, size_t nkvh, size_t hd, float scale) {
+    switch (kv_type) {
+    case LLAISYS_DTYPE_F8:
+        return self_attention_typed<T, llaisys::f8e4m3_t>(attn_val, q, k, v, k_scales, v_scales, block_table,
+                                                           block_size, qlen, kvlen, nh, nkvh, hd, scale);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return self_attention_typed<T, llaisys::f8e5m2_t>(attn_val, q, k, v, k_scales, v_scales, block_table,
+                                                           block_size, qlen, kvlen, nh, nkvh, hd, scale);
+    case LLAISYS_DTYPE_I8:
+        CHECK_ARGUMENT(k_scales && v_scales, "Self-Attention: I8 k/v need scales");
+        return self_attention_typed<T, int8_t>(attn_val, q, k, v, k_scales, v_scales, block_table,
+                                               block_size, qlen, kvlen, nh, nkvh, hd, scale);
+    default:
+        CHECK_ARGUMENT(kv_type == type, "Self-Attention: k/v type must match q or be FP8 / I8");
+        return self_attention_typed<T, T>(attn_val, q, k, v, k_scales, v_scales, block_table, block_size,
+                                          qlen, kvlen, nh, nkvh, hd, scale);
+    }
+}
+} // namespace
+
 void self_attention(std::byte *attn_val, const std::byte *q, const std::byte *k, const std::byte *v,
-                   llaisysDataType_t type, size_t qlen, size_t kvlen, size_t nh, size_t nkvh, 
-                   size_t hd, float scale) {
+                    llaisysDataType_t type, llaisysDataType_t kv_type, size_t qlen, size_t kvlen, size_t nh,
+                    size_t nkvh, size_t hd, float scale, const int64_t *block_table, size_t block_size,
+                    const float *k_scales, const float *v_scales) {
     switch (type) {
     case LLAISYS_DTYPE_F32:
-        return self_attention_(
-            reinterpret_cast<float *>(attn_val),
-            reinterpret_cast<const float *>(q),
-            reinterpret_cast<const float *>(k),
-            reinterpret_cast<const float *>(v),
-            qlen, kvlen, nh, nkvh, hd, scale
-        );
+        return self_attention_kv<float>(attn_val, q, k, v, type, kv_type, k_scales, v_scales, block_table, block_size, qlen, kvlen, nh, nkvh, hd, scale);
     case LLAISYS_DTYPE_BF16:
-        return self_attention_(
-            reinterpret_cast<llaisys::bf16_t *>(attn_val),
-            reinterpret_cast<const llaisys::bf16_t *>(q),
-            reinterpret_cast<const llaisys::bf16_t *>(k),
-            reinterpret_cast<const llaisys::bf16_t *>(v),
-            qlen, kvlen, nh, nkvh, hd, scale
-        );
+        return self_attention_kv<llaisys::bf16_t>(attn_val, q, k, v, type, kv_type, k_scales, v_scales, block_table, block_size, qlen, kvlen, nh, nkvh, hd, scale);
     case LLAISYS_DTYPE_F16:
-        return self_attention_(
-            reinterpret_cast<llaisys::fp16_t *>(attn_val),
-            reinterpret_cast<const llaisys::fp16_t *>(q),
-            reinterpret_cast<const llaisys::fp16_t *>(k),
-            reinterpret_cast<const llaisys::fp16_t *>(v),
-            qlen, kvlen, nh, nkvh, hd, scale
-        );
+        return self_attention_kv<llaisys::fp16_t>(attn_val, q, k, v, type, kv_type, k_scales, v_scales, block_table, block_size, qlen, kvlen, nh, nkvh, hd, scale);
     default:
         EXCEPTION_UNSUPPORTED_DATATYPE(type);
     }
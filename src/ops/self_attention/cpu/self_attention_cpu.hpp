@@ -2,9 +2,16 @@
 #include "llaisys.h"
 
 #include <cstddef>
+#include <cstdint>
 
 namespace llaisys::ops::cpu {
+// k and v share `kv_type`: `type`, or an FP8 or I8 type (KV cache storage).
+// With a block table, k and v are paged as [nblocks, block_size, nkvh, hd] and position p is
+// row p % block_size of block block_table[p / block_size]; otherwise they are [kvlen, nkvh, hd].
+// k_scales/v_scales (required for I8, optional for FP8) hold one fp32 scale per row of hd values,
+// laid out like k/v without the last dim; a stored row q stands for scale * q.
 void self_attention(std::byte *attn_val, const std::byte *q, const std::byte *k, const std::byte *v,
-                   llaisysDataType_t type, size_t qlen, size_t kvlen, size_t nh, size_t nkvh, 
-                   size_t hd, float scale);
+                    llaisysDataType_t type, llaisysDataType_t kv_type, size_t qlen, size_t kvlen, size_t nh,
+                    size_t nkvh, size_t hd, float scale, const int64_t *block_table = nullptr,
+                    size_t block_size = 0, const float *k_scales = nullptr, const float *v_scales = nullptr);
 }
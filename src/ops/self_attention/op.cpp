@@ -10,8 +10,12 @@ void self_attention(tensor_t attn_val, tensor_t q, tensor_t k, tensor_t v, float
     // Check that tensors are on same device
     CHECK_SAME_DEVICE(attn_val, q, k, v);
     
-    // Check data types
-    CHECK_SAME_DTYPE(attn_val->dtype(), q->dtype(), k->dtype(), v->dtype());
+    // Check data types; the KV cache may be stored in FP8
+    CHECK_SAME_DTYPE(attn_val->dtype(), q->dtype());
+    CHECK_SAME_DTYPE(k->dtype(), v->dtype());
+    if (!utils::is_fp8(k->dtype())) {
+        CHECK_SAME_DTYPE(attn_val->dtype(), k->dtype());
+    }
     
     // Check contiguity
     ASSERT(attn_val->isContiguous() && q->isContiguous() && k->isContiguous() && v->isContiguous(), 
@@ -47,7 +51,7 @@ void self_attention(tensor_t attn_val, tensor_t q, tensor_t k, tensor_t v, float
     // always support cpu calculation
     if (attn_val->deviceType() == LLAISYS_DEVICE_CPU) {
         return cpu::self_attention(attn_val->data(), q->data(), k->data(), v->data(),
-                                  attn_val->dtype(), qlen, kvlen, nh, nkvh, hd, scale);
+                                  attn_val->dtype(), k->dtype(), qlen, kvlen, nh, nkvh, hd, scale);
     }
 
     llaisys::core::context().setDevice(attn_val->deviceType(), attn_val->deviceId());
@@ -55,7 +59,77 @@ void self_attention(tensor_t attn_val, tensor_t q, tensor_t k, tensor_t v, float
     switch (attn_val->deviceType()) {
     case LLAISYS_DEVICE_CPU:
         return cpu::self_attention(attn_val->data(), q->data(), k->data(), v->data(),
-                                  attn_val->dtype(), qlen, kvlen, nh, nkvh, hd, scale);
+                                  attn_val->dtype(), k->dtype(), qlen, kvlen, nh, nkvh, hd, scale);
+#ifdef ENABLE_NVIDIA_API
+    case LLAISYS_DEVICE_NVIDIA:
+        TO_BE_IMPLEMENTED();
+        return;
+#endif
+    default:
+        EXCEPTION_UNSUPPORTED_DEVICE;
+    }
+}
+
+void self_attention_paged(tensor_t attn_val, tensor_t q, tensor_t k_blocks, tensor_t v_blocks,
+                          tensor_t k_scales, tensor_t v_scales, tensor_t block_table, size_t kvlen, float scale) {
+    CHECK_SAME_DEVICE(attn_val, q, k_blocks, v_blocks, block_table);
+
+    CHECK_SAME_DTYPE(attn_val->dtype(), q->dtype());
+    CHECK_SAME_DTYPE(k_blocks->dtype(), v_blocks->dtype());
+    bool quantized = k_blocks->dtype() == LLAISYS_DTYPE_I8 || utils::is_fp8(k_blocks->dtype());
+    if (!quantized) {
+        CHECK_SAME_DTYPE(attn_val->dtype(), k_blocks->dtype());
+    }
+    ASSERT((k_scales == nullptr) == (v_scales == nullptr), "Self-Attention: k_scales and v_scales go together");
+    ASSERT(k_scales || k_blocks->dtype() != LLAISYS_DTYPE_I8, "Self-Attention: I8 k/v blocks need scales");
+    CHECK_SAME_DTYPE(block_table->dtype(), LLAISYS_DTYPE_I64);
+
+    ASSERT(attn_val->isContiguous() && q->isContiguous() && k_blocks->isContiguous() && v_blocks->isContiguous()
+               && block_table->isContiguous(),
+           "Self-Attention: all tensors must be contiguous");
+
+    ASSERT(q->ndim() == 3, "Self-Attention: q must be 3D tensor [qlen, nh, hd]");
+    ASSERT(attn_val->ndim() == 3 && attn_val->shape() == q->shape(), "Self-Attention: attn_val must match q");
+    ASSERT(k_blocks->ndim() == 4, "Self-Attention: k_blocks must be 4D tensor [nblocks, block_size, nkvh, hd]");
+    ASSERT(v_blocks->shape() == k_blocks->shape(), "Self-Attention: v_blocks must match k_blocks");
+    ASSERT(block_table->ndim() == 1, "Self-Attention: block_table must be 1D");
+
+    size_t qlen = q->shape()[0];
+    size_t nh = q->shape()[1];
+    size_t hd = q->shape()[2];
+    size_t nblocks = k_blocks->shape()[0];
+    size_t block_size = k_blocks->shape()[1];
+    size_t nkvh = k_blocks->shape()[2];
+
+    ASSERT(k_blocks->shape()[3] == hd, "Self-Attention: k head_dim must match q");
+    ASSERT(nh % nkvh == 0, "Self-Attention: query heads must be divisible by key/value heads");
+    ASSERT(block_size > 0, "Self-Attention: block_size must be positive");
+    if (k_scales) {
+        ASSERT(quantized, "Self-Attention: scales need I8 or FP8 k/v blocks");
+        CHECK_SAME_DEVICE(attn_val, k_scales, v_scales);
+        CHECK_SAME_DTYPE(k_scales->dtype(), v_scales->dtype(), LLAISYS_DTYPE_F32);
+        ASSERT(k_scales->isContiguous() && v_scales->isContiguous(), "Self-Attention: scales must be contiguous");
+        std::vector<size_t> scale_shape{nblocks, block_size, nkvh};
+        CHECK_SAME_SHAPE(k_scales->shape(), v_scales->shape(), scale_shape);
+    }
+    size_t used_blocks = (kvlen + block_size - 1) / block_size;
+    CHECK_ARGUMENT(block_table->shape()[0] >= used_blocks, "Self-Attention: block_table is shorter than kvlen");
+
+    if (attn_val->deviceType() == LLAISYS_DEVICE_CPU) {
+        const int64_t *table = reinterpret_cast<const int64_t *>(block_table->data());
+        for (size_t b = 0; b < used_blocks; b++) {
+            CHECK_ARGUMENT(table[b] >= 0 && static_cast<size_t>(table[b]) < nblocks, "Self-Attention: block index out of range");
+        }
+        return cpu::self_attention(attn_val->data(), q->data(), k_blocks->data(), v_blocks->data(),
+                                   attn_val->dtype(), k_blocks->dtype(), qlen, kvlen, nh, nkvh, hd, scale,
+                                   table, block_size,
+                                   k_scales ? reinterpret_cast<const float *>(k_scales->data()) : nullptr,
+                                   v_scales ? reinterpret_cast<const float *>(v_scales->data()) : nullptr);
+    }
+
+    llaisys::core::context().setDevice(attn_val->deviceType(), attn_val->deviceId());
+
+    switch (attn_val->deviceType()) {
 #ifdef ENABLE_NVIDIA_API
     case LLAISYS_DEVICE_NVIDIA:
         TO_BE_IMPLEMENTED();
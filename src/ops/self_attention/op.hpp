@@ -4,4 +4,9 @@
 
 namespace llaisys::ops {
 void self_attention(tensor_t attn_val, tensor_t q, tensor_t k, tensor_t v, float scale);
+// K/V in a paged cache: k_blocks/v_blocks are [nblocks, block_size, nkvh, hd] and the keys are
+// the first kvlen positions of the sequence whose blocks are listed in block_table (int64).
+// k_scales/v_scales ([nblocks, block_size, nkvh] fp32, or null) dequantize I8 or FP8 blocks.
+void self_attention_paged(tensor_t attn_val, tensor_t q, tensor_t k_blocks, tensor_t v_blocks,
+                          tensor_t k_scales, tensor_t v_scales, tensor_t block_table, size_t kvlen, float scale);
 }
@@ -1,14 +1,18 @@
 #include "swiglu_cpu.hpp"
 
+#include "../../../device/cpu/thread_pool.hpp"
 #include "../../../utils.hpp"
 
 #include <cmath>
 
+// 低于此元素数时单线程处理
+constexpr size_t MIN_ELEMS_PER_THREAD = size_t(1) << 15;
+
 // SwiGLU: out_i = up_i * sigmoid(gate_i)
 // 其中 sigmoid(x) = x / (1 + exp(-x))
 template <typename T>
-void swiglu_(T *out, const T *gate, const T *up, size_t numel) {
-    for (size_t i = 0; i < numel; i++) {
+void swiglu_range(T *out, const T *gate, const T *up, size_t i0, size_t i1) {
+    for (size_t i = i0; i < i1; i++) {
         float gate_val, up_val;
         
         // 转换到float精度进行计算
@@ -46,6 +50,14 @@ void swiglu_(T *out, const T *gate, const T *up, size_t numel) {
     }
 }
 
+// 按元素分块并行, 每个线程至少处理 MIN_ELEMS_PER_THREAD 个元素
+template <typename T>
+void swiglu_(T *out, const T *gate, const T *up, size_t numel) {
+    llaisys::device::cpu::parallel_for(numel, MIN_ELEMS_PER_THREAD, [&](size_t i0, size_t i1) {
+        swiglu_range(out, gate, up, i0, i1);
+    });
+}
+
 namespace llaisys::ops::cpu {
 void swiglu(std::byte *out, const std::byte *gate, const std::byte *up, 
            llaisysDataType_t type, size_t numel) {
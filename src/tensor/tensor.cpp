@@ -97,7 +97,8 @@ template <typename T>
 void print_data(const T *data, const std::vector<size_t> &shape, const std::vector<ptrdiff_t> &strides, size_t dim) {
     if (dim == shape.size() - 1) {
         for (size_t i = 0; i < shape[dim]; i++) {
-            if constexpr (std::is_same_v<T, bf16_t> || std::is_same_v<T, fp16_t>) {
+            if constexpr (std::is_same_v<T, bf16_t> || std::is_same_v<T, fp16_t> || std::is_same_v<T, f8e4m3_t>
+                          || std::is_same_v<T, f8e5m2_t>) {
                 std::cout << utils::cast<float>(data[i * strides[dim]]) << " ";
             } else {
                 std::cout << data[i * strides[dim]] << " ";
@@ -133,6 +134,10 @@ void debug_print(const std::byte *data, const std::vector<size_t> &shape, const
         return print_data(reinterpret_cast<const uint32_t *>(data), shape, strides, 0);
     case LLAISYS_DTYPE_U64:
         return print_data(reinterpret_cast<const uint64_t *>(data), shape, strides, 0);
+    case LLAISYS_DTYPE_F8:
+        return print_data(reinterpret_cast<const f8e4m3_t *>(data), shape, strides, 0);
+    case LLAISYS_DTYPE_F8_E5M2:
+        return print_data(reinterpret_cast<const f8e5m2_t *>(data), shape, strides, 0);
     case LLAISYS_DTYPE_F16:
         return print_data(reinterpret_cast<const fp16_t *>(data), shape, strides, 0);
     case LLAISYS_DTYPE_F32:
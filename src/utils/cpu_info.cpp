@@ -0,0 +1,157 @@
+#include "cpu_info.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(LLAISYS_X86)
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace llaisys::utils {
+namespace {
+#if defined(LLAISYS_X86)
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<uint32_t>(r[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+// Deterministic cache parameters (leaf 4 on Intel, 0x8000001D on AMD).
+void detect_caches(CpuInfo &info, uint32_t max_leaf, uint32_t max_ext_leaf, bool amd) {
+    uint32_t leaf = 0;
+    if (amd && max_ext_leaf >= 0x8000001D) {
+        leaf = 0x8000001D;
+    } else if (!amd && max_leaf >= 4) {
+        leaf = 4;
+    } else {
+        return;
+    }
+    uint32_t r[4];
+    for (uint32_t i = 0; i < 16; i++) {
+        cpuid(leaf, i, r);
+        uint32_t type = r[0] & 0x1F;
+        if (type == 0) {
+            break;
+        }
+        if (type == 2) { // instruction cache
+            continue;
+        }
+        uint32_t level = (r[0] >> 5) & 0x7;
+        size_t ways = ((r[1] >> 22) & 0x3FF) + 1;
+        size_t partitions = ((r[1] >> 12) & 0x3FF) + 1;
+        size_t line = (r[1] & 0xFFF) + 1;
+        size_t sets = static_cast<size_t>(r[2]) + 1;
+        size_t size = ways * partitions * line * sets;
+        if (level == 1) {
+            info.l1d_size = size;
+        } else if (level == 2) {
+            info.l2_size = size;
+        } else if (level == 3) {
+            info.l3_size = size;
+        }
+    }
+}
+#endif
+
+CpuIsa cap_isa_from_env(CpuIsa isa) {
+    const char *env = std::getenv("LLAISYS_CPU_ISA");
+    if (env == nullptr) {
+        return isa;
+    }
+    CpuIsa cap = isa;
+    if (std::strcmp(env, "scalar") == 0) {
+        cap = CpuIsa::SCALAR;
+    } else if (std::strcmp(env, "avx2") == 0) {
+        cap = CpuIsa::AVX2;
+    } else if (std::strcmp(env, "avx512") == 0) {
+        cap = CpuIsa::AVX512;
+    }
+    return cap < isa ? cap : isa;
+}
+
+CpuInfo detect() {
+    CpuInfo info{};
+    info.l1d_size = 32 * 1024;
+    info.l2_size = 1024 * 1024;
+    info.l3_size = 8 * 1024 * 1024;
+
+#if defined(LLAISYS_X86)
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+    bool amd = r[1] == 0x68747541; // "Auth"enticAMD
+    cpuid(0x80000000, 0, r);
+    uint32_t max_ext_leaf = r[0];
+
+    if (max_leaf >= 1) {
+        cpuid(1, 0, r);
+        bool osxsave = (r[2] >> 27) & 1;
+        bool avx = (r[2] >> 28) & 1;
+        info.fma = (r[2] >> 12) & 1;
+        info.f16c = (r[2] >> 29) & 1;
+
+        // The OS must save YMM (and ZMM/opmask) state for these to be usable.
+        uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+        bool ymm_ok = avx && (xcr0 & 0x6) == 0x6;
+        bool zmm_ok = ymm_ok && (xcr0 & 0xE0) == 0xE0;
+        if (!ymm_ok) {
+            info.fma = info.f16c = false;
+        }
+
+        if (max_leaf >= 7) {
+            cpuid(7, 0, r);
+            info.avx2 = ymm_ok && ((r[1] >> 5) & 1);
+            info.avx512f = zmm_ok && ((r[1] >> 16) & 1);
+            info.avx512dq = zmm_ok && ((r[1] >> 17) & 1);
+            info.avx512bw = zmm_ok && ((r[1] >> 30) & 1);
+            info.avx512vl = zmm_ok && ((r[1] >> 31) & 1);
+            info.avx512_vnni = zmm_ok && ((r[2] >> 11) & 1);
+            cpuid(7, 1, r);
+            info.avx512_bf16 = zmm_ok && ((r[0] >> 5) & 1);
+            info.avx_vnni = ymm_ok && ((r[0] >> 4) & 1);
+        }
+    }
+    detect_caches(info, max_leaf, max_ext_leaf, amd);
+
+    if (info.avx512f && info.avx512bw && info.avx512vl && info.avx512dq && info.fma && info.f16c) {
+        info.isa = CpuIsa::AVX512;
+    } else if (info.avx2 && info.fma && info.f16c) {
+        info.isa = CpuIsa::AVX2;
+    } else {
+        info.isa = CpuIsa::SCALAR;
+    }
+#else
+    info.isa = CpuIsa::SCALAR;
+#endif
+    info.isa = cap_isa_from_env(info.isa);
+    return info;
+}
+} // namespace
+
+const CpuInfo &cpu_info() {
+    static const CpuInfo info = detect();
+    return info;
+}
+} // namespace llaisys::utils
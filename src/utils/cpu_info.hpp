@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+// x86 SIMD kernels are compiled per function with target attributes so that the
+// library itself keeps the baseline ISA and picks kernels at runtime from CPUID.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LLAISYS_X86 1
+#endif
+
+#if defined(LLAISYS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LLAISYS_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define LLAISYS_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx2,fma,f16c")))
+#define LLAISYS_TARGET_AVX512VNNI __attribute__((target("avx512vnni,avx512f,avx512bw,avx512vl,avx512dq,avx2,fma,f16c")))
+#else
+#define LLAISYS_TARGET_AVX2
+#define LLAISYS_TARGET_AVX512
+#define LLAISYS_TARGET_AVX512VNNI
+#endif
+
+namespace llaisys::utils {
+// Instruction set levels for kernel dispatch, ordered by capability.
+enum class CpuIsa {
+    SCALAR = 0,
+    AVX2 = 1,   // AVX2 + FMA + F16C
+    AVX512 = 2, // AVX-512 F/BW/VL/DQ
+};
+
+struct CpuInfo {
+    bool avx2;
+    bool fma;
+    bool f16c;
+    bool avx512f;
+    bool avx512bw;
+    bool avx512vl;
+    bool avx512dq;
+    bool avx512_vnni;
+    bool avx512_bf16;
+    bool avx_vnni;
+
+    // Data cache sizes in bytes. L1/L2 are per core, L3 is the whole shared cache.
+    size_t l1d_size;
+    size_t l2_size;
+    size_t l3_size;
+
+    // Best ISA level usable on this machine, capped by env LLAISYS_CPU_ISA
+    // ("scalar", "avx2" or "avx512") if set.
+    CpuIsa isa;
+};
+
+// Detected once and cached for the lifetime of the process.
+const CpuInfo &cpu_info();
+} // namespace llaisys::utils
@@ -0,0 +1,492 @@
+#include "simd_x86.hpp"
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#if defined(LLAISYS_X86) && ((defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 10) || (defined(__clang__) && __clang_major__ >= 9))
+#define LLAISYS_HAS_AVX512BF16_INTRIN 1
+#endif
+
+namespace llaisys::utils::simd {
+namespace {
+template <typename T>
+inline float load1(const T *p) {
+    return cast<float>(*p);
+}
+
+// FP8 has only 256 codes, so the portable path widens through a lookup table.
+template <typename T>
+std::array<float, 256> make_fp8_table() {
+    std::array<float, 256> table;
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = cast<float>(T{static_cast<uint8_t>(i)});
+    }
+    return table;
+}
+
+const std::array<float, 256> fp8e4m3_table = make_fp8_table<f8e4m3_t>();
+const std::array<float, 256> fp8e5m2_table = make_fp8_table<f8e5m2_t>();
+
+inline float load1(const f8e4m3_t *p) {
+    return fp8e4m3_table[p->_v];
+}
+
+inline float load1(const f8e5m2_t *p) {
+    return fp8e5m2_table[p->_v];
+}
+
+template <typename T>
+inline void store1(T *p, float v) {
+    *p = cast<T>(v);
+}
+
+// Portable fallback; the fp32 loops auto-vectorize with the baseline ISA.
+template <typename T>
+void to_f32_scalar(float *dst, const T *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = load1(src + i);
+    }
+}
+
+template <typename T>
+void from_f32_scalar(T *dst, const float *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        store1(dst + i, src[i]);
+    }
+}
+
+template <typename T>
+float dot_scalar(const float *a, const T *b, size_t n) {
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = 0; j < 4; j++) {
+            acc[j] += a[i + j] * load1(b + i + j);
+        }
+    }
+    for (; i < n; i++) {
+        acc[0] += a[i] * load1(b + i);
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+template <typename T>
+void axpy_scalar(float *y, float alpha, const T *x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] += alpha * load1(x + i);
+    }
+}
+
+float exp_sum_scalar(float *x, float shift, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        x[i] = std::exp(x[i] - shift);
+        sum += x[i];
+    }
+    return sum;
+}
+
+float max_scalar(const float *x, size_t n) {
+    float m = -INFINITY;
+    for (size_t i = 0; i < n; i++) {
+        m = std::max(m, x[i]);
+    }
+    return m;
+}
+
+size_t select_ge_scalar(uint32_t *idx, const float *x, float threshold, size_t n, size_t base = 0) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        idx[count] = static_cast<uint32_t>(base + i);
+        count += x[i] >= threshold;
+    }
+    return count;
+}
+
+#if defined(LLAISYS_X86)
+// exp(x) = 2^k * exp(r) with k = round(x / ln2) and |r| <= ln2 / 2, where ln2 is split in two
+// parts so that x - k * ln2 is exact; exp(r) is the degree-6 Cephes expf polynomial.
+constexpr float EXP_HI = 88.0f;           // keeps 2^k a normal float
+constexpr float EXP_LO = -87.3365447504f; // below this the result is flushed to 0
+constexpr float LOG2E = 1.44269504088896341f;
+constexpr float LN2_HI = 0.693359375f;
+constexpr float LN2_LO = -2.12194440e-4f;
+constexpr float EXP_P[6] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                            4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+LLAISYS_TARGET_AVX2 inline __m256 exp8(__m256 x) {
+    __m256 tiny = _mm256_cmp_ps(x, _mm256_set1_ps(EXP_LO), _CMP_LT_OQ);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_LO), r);
+    __m256 p = _mm256_set1_ps(EXP_P[0]);
+    for (size_t i = 1; i < 6; i++) {
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P[i]));
+    }
+    __m256 y = _mm256_fmadd_ps(_mm256_mul_ps(p, r), r, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    return _mm256_andnot_ps(tiny, _mm256_mul_ps(y, _mm256_castsi256_ps(e)));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 exp16(__m512 x) {
+    __mmask16 keep = _mm512_cmp_ps_mask(x, _mm512_set1_ps(EXP_LO), _CMP_GE_OQ);
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+    __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_HI), x);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_LO), r);
+    __m512 p = _mm512_set1_ps(EXP_P[0]);
+    for (size_t i = 1; i < 6; i++) {
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P[i]));
+    }
+    __m512 y = _mm512_fmadd_ps(_mm512_mul_ps(p, r), r, _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+    return _mm512_maskz_mov_ps(keep, _mm512_scalef_ps(y, k));
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 void to_f32_avx2(float *dst, const T *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, load8(src + i));
+    }
+    to_f32_scalar(dst + i, src + i, n - i);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 void from_f32_avx2(T *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        store8(dst + i, _mm256_loadu_ps(src + i));
+    }
+    from_f32_scalar(dst + i, src + i, n - i);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 float dot_avx2(const float *a, const T *b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), load8(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), load8(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), load8(b + i), acc0);
+    }
+    // The tail stays in this function: calling the SSE fallback with the partial sum live would
+    // skip VZEROUPPER and pay an AVX/SSE transition on every call.
+    float sum = hsum8(_mm256_add_ps(acc0, acc1));
+    for (; i < n; i++) {
+        sum += a[i] * load1(b + i);
+    }
+    return sum;
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX2 void axpy_avx2(float *y, float alpha, const T *x, size_t n) {
+    __m256 va = _mm256_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, load8(x + i), _mm256_loadu_ps(y + i)));
+    }
+    axpy_scalar(y + i, alpha, x + i, n - i);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 void to_f32_avx512(float *dst, const T *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(dst + i, load16(src + i));
+    }
+    to_f32_scalar(dst + i, src + i, n - i);
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 void from_f32_avx512(T *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        store16(dst + i, _mm512_loadu_ps(src + i));
+    }
+    from_f32_scalar(dst + i, src + i, n - i);
+}
+
+#if defined(LLAISYS_HAS_AVX512BF16_INTRIN)
+// Native VCVTNEPS2BF16 (round to nearest even) on CPUs with AVX512_BF16.
+__attribute__((target("avx512bf16,avx512f,avx512vl,avx512bw"))) void from_f32_avx512bf16(bf16_t *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        std::memcpy(dst + i, &h, sizeof(h));
+    }
+    from_f32_scalar(dst + i, src + i, n - i);
+}
+#endif
+
+template <typename T>
+LLAISYS_TARGET_AVX512 float dot_avx512(const float *a, const T *b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), load16(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), load16(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), load16(b + i), acc0);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < n; i++) {
+        sum += a[i] * load1(b + i);
+    }
+    return sum;
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 void axpy_avx512(float *y, float alpha, const T *x, size_t n) {
+    __m512 va = _mm512_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, load16(x + i), _mm512_loadu_ps(y + i)));
+    }
+    axpy_scalar(y + i, alpha, x + i, n - i);
+}
+
+LLAISYS_TARGET_AVX2 float exp_sum_avx2(float *x, float shift, size_t n) {
+    __m256 vs = _mm256_set1_ps(shift), acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 e = exp8(_mm256_sub_ps(_mm256_loadu_ps(x + i), vs));
+        _mm256_storeu_ps(x + i, e);
+        acc = _mm256_add_ps(acc, e);
+    }
+    if (i < n) {
+        // Tail through a padded lane block, so every element goes through the same polynomial.
+        alignas(32) float tail[8];
+        std::fill(tail, tail + 8, -INFINITY);
+        std::copy(x + i, x + n, tail);
+        __m256 e = exp8(_mm256_sub_ps(_mm256_load_ps(tail), vs));
+        _mm256_store_ps(tail, e);
+        std::copy(tail, tail + (n - i), x + i);
+        acc = _mm256_add_ps(acc, e);
+    }
+    return hsum8(acc);
+}
+
+LLAISYS_TARGET_AVX512 float exp_sum_avx512(float *x, float shift, size_t n) {
+    __m512 vs = _mm512_set1_ps(shift), acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 e = exp16(_mm512_sub_ps(_mm512_loadu_ps(x + i), vs));
+        _mm512_storeu_ps(x + i, e);
+        acc = _mm512_add_ps(acc, e);
+    }
+    if (i < n) {
+        __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512 e = exp16(_mm512_sub_ps(_mm512_maskz_loadu_ps(m, x + i), vs));
+        e = _mm512_maskz_mov_ps(m, e);
+        _mm512_mask_storeu_ps(x + i, m, e);
+        acc = _mm512_add_ps(acc, e);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+LLAISYS_TARGET_AVX2 float max_avx2(const float *x, size_t n) {
+    __m256 m0 = _mm256_set1_ps(-INFINITY), m1 = m0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        m0 = _mm256_max_ps(m0, _mm256_loadu_ps(x + i));
+        m1 = _mm256_max_ps(m1, _mm256_loadu_ps(x + i + 8));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_max_ps(m0, m1));
+    float m = max_scalar(lanes, 8);
+    for (; i < n; i++) {
+        m = std::max(m, x[i]);
+    }
+    return m;
+}
+
+LLAISYS_TARGET_AVX512 float max_avx512(const float *x, size_t n) {
+    __m512 m0 = _mm512_set1_ps(-INFINITY), m1 = m0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        m0 = _mm512_max_ps(m0, _mm512_loadu_ps(x + i));
+        m1 = _mm512_max_ps(m1, _mm512_loadu_ps(x + i + 16));
+    }
+    float m = _mm512_reduce_max_ps(_mm512_max_ps(m0, m1));
+    for (; i < n; i++) {
+        m = std::max(m, x[i]);
+    }
+    return m;
+}
+
+// The hits of a block are read off the compare mask, lowest bit first
+LLAISYS_TARGET_AVX2 size_t select_ge_avx2(uint32_t *idx, const float *x, float threshold, size_t n) {
+    __m256 vt = _mm256_set1_ps(threshold);
+    size_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + i), vt, _CMP_GE_OQ)));
+        while (mask) {
+            idx[count++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count + select_ge_scalar(idx + count, x + i, threshold, n - i, i);
+}
+
+LLAISYS_TARGET_AVX512 size_t select_ge_avx512(uint32_t *idx, const float *x, float threshold, size_t n) {
+    __m512 vt = _mm512_set1_ps(threshold);
+    __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 hit = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), vt, _CMP_GE_OQ);
+        if (hit) {
+            __m512i index = _mm512_add_epi32(lane, _mm512_set1_epi32(static_cast<int>(i)));
+            _mm512_mask_compressstoreu_epi32(idx + count, hit, index);
+            count += static_cast<size_t>(__builtin_popcount(hit));
+        }
+    }
+    return count + select_ge_scalar(idx + count, x + i, threshold, n - i, i);
+}
+#endif
+} // namespace
+
+template <typename T>
+void to_f32(float *dst, const T *src, size_t n) {
+    if constexpr (std::is_same_v<T, float>) {
+        std::memcpy(dst, src, n * sizeof(float));
+        return;
+    }
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return to_f32_avx512(dst, src, n);
+    case CpuIsa::AVX2:
+        return to_f32_avx2(dst, src, n);
+    default:
+        break;
+    }
+#endif
+    to_f32_scalar(dst, src, n);
+}
+
+template <typename T>
+void from_f32(T *dst, const float *src, size_t n) {
+    if constexpr (std::is_same_v<T, float>) {
+        std::memcpy(dst, src, n * sizeof(float));
+        return;
+    }
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+#if defined(LLAISYS_HAS_AVX512BF16_INTRIN)
+        if constexpr (std::is_same_v<T, bf16_t>) {
+            if (cpu_info().avx512_bf16) {
+                return from_f32_avx512bf16(dst, src, n);
+            }
+        }
+#endif
+        return from_f32_avx512(dst, src, n);
+    case CpuIsa::AVX2:
+        return from_f32_avx2(dst, src, n);
+    default:
+        break;
+    }
+#endif
+    from_f32_scalar(dst, src, n);
+}
+
+template <typename T>
+float dot(const float *a, const T *b, size_t n) {
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return dot_avx512(a, b, n);
+    case CpuIsa::AVX2:
+        return dot_avx2(a, b, n);
+    default:
+        break;
+    }
+#endif
+    return dot_scalar(a, b, n);
+}
+
+template <typename T>
+void axpy(float *y, float alpha, const T *x, size_t n) {
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return axpy_avx512(y, alpha, x, n);
+    case CpuIsa::AVX2:
+        return axpy_avx2(y, alpha, x, n);
+    default:
+        break;
+    }
+#endif
+    axpy_scalar(y, alpha, x, n);
+}
+
+float exp_sum(float *x, float shift, size_t n) {
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return exp_sum_avx512(x, shift, n);
+    case CpuIsa::AVX2:
+        return exp_sum_avx2(x, shift, n);
+    default:
+        break;
+    }
+#endif
+    return exp_sum_scalar(x, shift, n);
+}
+
+float max(const float *x, size_t n) {
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return max_avx512(x, n);
+    case CpuIsa::AVX2:
+        return max_avx2(x, n);
+    default:
+        break;
+    }
+#endif
+    return max_scalar(x, n);
+}
+
+size_t select_ge(uint32_t *idx, const float *x, float threshold, size_t n) {
+#if defined(LLAISYS_X86)
+    switch (cpu_info().isa) {
+    case CpuIsa::AVX512:
+        return select_ge_avx512(idx, x, threshold, n);
+    case CpuIsa::AVX2:
+        return select_ge_avx2(idx, x, threshold, n);
+    default:
+        break;
+    }
+#endif
+    return select_ge_scalar(idx, x, threshold, n);
+}
+
+#define LLAISYS_SIMD_INSTANTIATE(T)                               \
+    template void to_f32<T>(float *, const T *, size_t);          \
+    template void from_f32<T>(T *, const float *, size_t);        \
+    template float dot<T>(const float *, const T *, size_t);      \
+    template void axpy<T>(float *, float, const T *, size_t);
+
+LLAISYS_SIMD_INSTANTIATE(float)
+LLAISYS_SIMD_INSTANTIATE(bf16_t)
+LLAISYS_SIMD_INSTANTIATE(fp16_t)
+LLAISYS_SIMD_INSTANTIATE(f8e4m3_t)
+LLAISYS_SIMD_INSTANTIATE(f8e5m2_t)
+
+// Quantized data is only ever widened.
+template void to_f32<int8_t>(float *, const int8_t *, size_t);
+template float dot<int8_t>(const float *, const int8_t *, size_t);
+template void axpy<int8_t>(float *, float, const int8_t *, size_t);
+
+#undef LLAISYS_SIMD_INSTANTIATE
+} // namespace llaisys::utils::simd
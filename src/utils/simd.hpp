@@ -0,0 +1,39 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstddef>
+
+// Bulk vector primitives over fp32, half-precision and fp8 arrays (int8 for the widening ones).
+// Narrow inputs are widened in registers (F16C / AVX-512, bit shifts for bf16, fp8 through fp16)
+// and all arithmetic is done in fp32.
+// The implementation is chosen once per call from utils::cpu_info().
+namespace llaisys::utils::simd {
+// dst[i] = float(src[i])
+template <typename T>
+void to_f32(float *dst, const T *src, size_t n);
+
+// dst[i] = T(src[i]), round to nearest even (fp8 E4M3 saturates, see utils::cast)
+template <typename T>
+void from_f32(T *dst, const float *src, size_t n);
+
+// sum(a[i] * b[i])
+template <typename T>
+float dot(const float *a, const T *b, size_t n);
+
+// y[i] += alpha * x[i]
+template <typename T>
+void axpy(float *y, float alpha, const T *x, size_t n);
+
+// x[i] = exp(x[i] - shift), returns sum(x[i]); shift >= max(x) keeps the results in (0, 1].
+// The vector paths use a polynomial within a few ulp of std::exp and flush results below
+// ~1e-38 (including exp(-inf)) to 0.
+float exp_sum(float *x, float shift, size_t n);
+
+// max(x[i]), -inf for n == 0
+float max(const float *x, size_t n);
+
+// Writes the indices i with x[i] >= threshold to idx in ascending order and returns how many;
+// idx needs room for n. A vector compare per block, so sparse hits cost little beyond the read.
+size_t select_ge(uint32_t *idx, const float *x, float threshold, size_t n);
+} // namespace llaisys::utils::simd
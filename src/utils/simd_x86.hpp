@@ -0,0 +1,189 @@
+#pragma once
+
+// Inline x86 register helpers shared by the SIMD kernels: widening loads and rounding stores
+// for fp32/bf16/fp16/fp8, plus widening loads of int8 and packed 4-bit codes (quantized weights).
+// Must be included before llaisys.h, whose __C macro clashes with the parameter names in the
+// intrinsics headers.
+#include "cpu_info.hpp"
+
+#if defined(LLAISYS_X86)
+// GCC 12's AVX-512 headers trip -Wuninitialized through _mm512_undefined_*() (GCC PR105593).
+// The warnings are reported at lines of the intrinsics headers, so muting them around the
+// include leaves the includers' own code checked.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include "types.hpp"
+
+namespace llaisys::utils::simd {
+// ---- AVX2: 8 lanes ----
+LLAISYS_TARGET_AVX2 inline __m256 load8(const float *p) {
+    return _mm256_loadu_ps(p);
+}
+
+LLAISYS_TARGET_AVX2 inline __m256 load8(const bf16_t *p) {
+    __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(w, 16));
+}
+
+LLAISYS_TARGET_AVX2 inline __m256 load8(const fp16_t *p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+}
+
+// FP8 widens through fp16: E5M2 is the upper byte of an fp16, and E4M3 shifted into the fp16
+// field layout is exact up to the exponent bias (scaled back by 2^8); its NaN code is patched.
+LLAISYS_TARGET_AVX2 inline __m128i fp8e4m3_to_f16_bits(__m128i b16) {
+    __m128i mag = _mm_slli_epi16(_mm_and_si128(b16, _mm_set1_epi16(0x7F)), 7);
+    __m128i sign = _mm_slli_epi16(_mm_and_si128(b16, _mm_set1_epi16(0x80)), 8);
+    __m128i nan = _mm_and_si128(_mm_cmpeq_epi16(mag, _mm_set1_epi16(0x3F80)), _mm_set1_epi16(0x7E00));
+    return _mm_or_si128(_mm_or_si128(mag, sign), nan);
+}
+
+LLAISYS_TARGET_AVX2 inline __m256 load8(const f8e4m3_t *p) {
+    __m128i b16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)));
+    return _mm256_mul_ps(_mm256_cvtph_ps(fp8e4m3_to_f16_bits(b16)), _mm256_set1_ps(256.0f));
+}
+
+LLAISYS_TARGET_AVX2 inline __m256 load8(const f8e5m2_t *p) {
+    __m128i b16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)));
+    return _mm256_cvtph_ps(_mm_slli_epi16(b16, 8));
+}
+
+LLAISYS_TARGET_AVX2 inline __m256 load8(const int8_t *p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+}
+
+// 8 bytes of packed nibbles: lo[i] = p[i] & 0xF, hi[i] = p[i] >> 4
+LLAISYS_TARGET_AVX2 inline void load8_u4(const uint8_t *p, __m256 &lo, __m256 &hi) {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    __m128i mask = _mm_set1_epi8(0x0F);
+    lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_and_si128(v, mask)));
+    hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_and_si128(_mm_srli_epi16(v, 4), mask)));
+}
+
+LLAISYS_TARGET_AVX2 inline void store8(float *p, __m256 v) {
+    _mm256_storeu_ps(p, v);
+}
+
+LLAISYS_TARGET_AVX2 inline void store8(bf16_t *p, __m256 v) {
+    // Round to nearest even on the upper 16 bits, then narrow.
+    __m256i u = _mm256_castps_si256(v);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+    u = _mm256_add_epi32(u, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7FFF)));
+    u = _mm256_srli_epi32(u, 16);
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(u), _mm256_extracti128_si256(u, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), packed);
+}
+
+LLAISYS_TARGET_AVX2 inline void store8(fp16_t *p, __m256 v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+
+// FP8 narrowing (saturation, RNE at the reduced precision) goes through the scalar converter;
+// FP8 is a storage format, so only cache writes and weight packing take this path.
+template <typename T>
+LLAISYS_TARGET_AVX2 inline void store8_fp8(T *p, __m256 v) {
+    alignas(32) float tmp[8];
+    _mm256_store_ps(tmp, v);
+    for (size_t i = 0; i < 8; i++) {
+        p[i] = cast<T>(tmp[i]);
+    }
+}
+
+LLAISYS_TARGET_AVX2 inline void store8(f8e4m3_t *p, __m256 v) {
+    store8_fp8(p, v);
+}
+
+LLAISYS_TARGET_AVX2 inline void store8(f8e5m2_t *p, __m256 v) {
+    store8_fp8(p, v);
+}
+
+LLAISYS_TARGET_AVX2 inline float hsum8(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// ---- AVX-512: 16 lanes ----
+LLAISYS_TARGET_AVX512 inline __m512 load16(const float *p) {
+    return _mm512_loadu_ps(p);
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 load16(const bf16_t *p) {
+    __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(w, 16));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 load16(const fp16_t *p) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 load16(const f8e4m3_t *p) {
+    __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    __m256i mag = _mm256_slli_epi16(_mm256_and_si256(b16, _mm256_set1_epi16(0x7F)), 7);
+    __m256i sign = _mm256_slli_epi16(_mm256_and_si256(b16, _mm256_set1_epi16(0x80)), 8);
+    __m256i nan = _mm256_and_si256(_mm256_cmpeq_epi16(mag, _mm256_set1_epi16(0x3F80)), _mm256_set1_epi16(0x7E00));
+    __m256i h = _mm256_or_si256(_mm256_or_si256(mag, sign), nan);
+    return _mm512_mul_ps(_mm512_cvtph_ps(h), _mm512_set1_ps(256.0f));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 load16(const f8e5m2_t *p) {
+    __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    return _mm512_cvtph_ps(_mm256_slli_epi16(b16, 8));
+}
+
+LLAISYS_TARGET_AVX512 inline __m512 load16(const int8_t *p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))));
+}
+
+// 16 bytes of packed nibbles: lo[i] = p[i] & 0xF, hi[i] = p[i] >> 4
+// Each byte is widened once and both nibbles are looked up in a 16-entry fp32 table with
+// VPERMPS, which only reads the low 4 bits of every index lane.
+LLAISYS_TARGET_AVX512 inline void load16_u4(const uint8_t *p, __m512 &lo, __m512 &hi) {
+    const __m512 codes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i v = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    lo = _mm512_permutexvar_ps(v, codes);
+    hi = _mm512_permutexvar_ps(_mm512_srli_epi32(v, 4), codes);
+}
+
+LLAISYS_TARGET_AVX512 inline void store16(float *p, __m512 v) {
+    _mm512_storeu_ps(p, v);
+}
+
+LLAISYS_TARGET_AVX512 inline void store16(bf16_t *p, __m512 v) {
+    __m512i u = _mm512_castps_si512(v);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(1));
+    u = _mm512_add_epi32(u, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7FFF)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvtepi32_epi16(_mm512_srli_epi32(u, 16)));
+}
+
+LLAISYS_TARGET_AVX512 inline void store16(fp16_t *p, __m512 v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+
+template <typename T>
+LLAISYS_TARGET_AVX512 inline void store16_fp8(T *p, __m512 v) {
+    alignas(64) float tmp[16];
+    _mm512_store_ps(tmp, v);
+    for (size_t i = 0; i < 16; i++) {
+        p[i] = cast<T>(tmp[i]);
+    }
+}
+
+LLAISYS_TARGET_AVX512 inline void store16(f8e4m3_t *p, __m512 v) {
+    store16_fp8(p, v);
+}
+
+LLAISYS_TARGET_AVX512 inline void store16(f8e5m2_t *p, __m512 v) {
+    store16_fp8(p, v);
+}
+} // namespace llaisys::utils::simd
+#endif
@@ -1,5 +1,6 @@
 #include "types.hpp"
 
+#include <cmath>
 #include <cstring>
 
 namespace llaisys::utils {
@@ -52,11 +53,18 @@ fp16_t _f32_to_f16(float val) {
         // Infinity
         return fp16_t{static_cast<uint16_t>(sign | 0x7C00)};
     } else if (exponent >= -14) { // Normalized case
-        return fp16_t{(uint16_t)(sign | ((exponent + 15) << 10) | (mantissa >> 13))};
-    } else if (exponent >= -24) {
+        uint32_t bits = ((exponent + 15) << 10) | (mantissa >> 13);
+        // Round to nearest even; a carry out of the mantissa correctly bumps the exponent (up to Inf)
+        uint32_t rest = mantissa & 0x1FFF;
+        bits += rest > 0x1000 || (rest == 0x1000 && (bits & 1));
+        return fp16_t{(uint16_t)(sign | bits)};
+    } else if (exponent >= -25) {
         mantissa |= 0x800000; // Add implicit leading 1
-        mantissa >>= (-14 - exponent);
-        return fp16_t{(uint16_t)(sign | (mantissa >> 13))};
+        uint32_t shift = 13 + (-14 - exponent);
+        uint32_t bits = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), half = 1u << (shift - 1);
+        bits += rest > half || (rest == half && (bits & 1));
+        return fp16_t{(uint16_t)(sign | bits)};
     } else {
         // Too small for subnormal: return signed zero
         return fp16_t{(uint16_t)sign};
@@ -82,4 +90,72 @@ bf16_t _f32_to_bf16(float val) {
 
     return bf16_t{bf16_bits};
 }
+
+namespace {
+// Magnitude bits of |val| (f32 bits without the sign) rounded to nearest even in a format with
+// `mbits` mantissa bits and exponent bias `bias`, including its subnormals. A carry out of the
+// mantissa moves to the next exponent; the caller handles values beyond the largest exponent.
+uint32_t round_to_small_float(uint32_t abs_bits, int32_t bias, uint32_t mbits) {
+    int32_t exponent = static_cast<int32_t>(abs_bits >> 23) - 127;
+    uint32_t mantissa = abs_bits & 0x7FFFFF;
+    uint32_t shift, bits;
+    if (exponent >= 1 - bias) {
+        shift = 23 - mbits;
+        bits = (static_cast<uint32_t>(exponent + bias) << mbits) | (mantissa >> shift);
+    } else {
+        int32_t sub_shift = static_cast<int32_t>(23 - mbits) + (1 - bias - exponent);
+        if (sub_shift > 24) { // below half of the smallest subnormal
+            return 0;
+        }
+        shift = static_cast<uint32_t>(sub_shift);
+        mantissa |= 0x800000;
+        bits = mantissa >> shift;
+    }
+    uint32_t rest = mantissa & ((1u << shift) - 1), half = 1u << (shift - 1);
+    return bits + (rest > half || (rest == half && (bits & 1)));
+}
+} // namespace
+
+float _f8e4m3_to_f32(f8e4m3_t val) {
+    uint16_t magnitude = val._v & 0x7F;
+    if (magnitude == 0x7F) {
+        return (val._v & 0x80) ? -NAN : NAN;
+    }
+    // The magnitude bits read as fp16 have the exponent bias off by 15 - 7, subnormals included.
+    float f = _f16_to_f32(fp16_t{static_cast<uint16_t>(magnitude << 7)}) * 256.0f;
+    return (val._v & 0x80) ? -f : f;
+}
+
+f8e4m3_t _f32_to_f8e4m3(float val) {
+    uint32_t f32;
+    memcpy(&f32, &val, sizeof(f32));
+    uint8_t sign = (f32 >> 24) & 0x80;
+    uint32_t abs_bits = f32 & 0x7FFFFFFF;
+    if (abs_bits > 0x7F800000) { // NaN
+        return f8e4m3_t{static_cast<uint8_t>(sign | 0x7F)};
+    }
+    if (abs_bits >= 0x43E00000) { // 448 and beyond, infinity included
+        return f8e4m3_t{static_cast<uint8_t>(sign | 0x7E)};
+    }
+    return f8e4m3_t{static_cast<uint8_t>(sign | round_to_small_float(abs_bits, 7, 3))};
+}
+
+float _f8e5m2_to_f32(f8e5m2_t val) {
+    // E5M2 is the upper byte of an fp16.
+    return _f16_to_f32(fp16_t{static_cast<uint16_t>(val._v << 8)});
+}
+
+f8e5m2_t _f32_to_f8e5m2(float val) {
+    uint32_t f32;
+    memcpy(&f32, &val, sizeof(f32));
+    uint8_t sign = (f32 >> 24) & 0x80;
+    uint32_t abs_bits = f32 & 0x7FFFFFFF;
+    if (abs_bits > 0x7F800000) { // NaN
+        return f8e5m2_t{static_cast<uint8_t>(sign | 0x7E)};
+    }
+    if (abs_bits >= 0x47800000) { // 2^16 and beyond round to infinity
+        return f8e5m2_t{static_cast<uint8_t>(sign | 0x7C)};
+    }
+    return f8e5m2_t{static_cast<uint8_t>(sign | round_to_small_float(abs_bits, 15, 2))};
+}
 } // namespace llaisys::utils
@@ -1,3 +1,4 @@
+#pragma once
 #include "llaisys.h"
 
 #include <iostream>
@@ -14,6 +15,19 @@ struct CustomBFloat16 {
 };
 typedef struct CustomBFloat16 bf16_t;
 
+// FP8 storage formats (OCP 8-bit floating point):
+//   E4M3: bias 7, no infinities, S.1111.111 is NaN, largest finite 448
+//   E5M2: bias 15, IEEE-style infinities and NaNs, largest finite 57344
+struct CustomFloat8E4M3 {
+    uint8_t _v;
+};
+typedef struct CustomFloat8E4M3 f8e4m3_t;
+
+struct CustomFloat8E5M2 {
+    uint8_t _v;
+};
+typedef struct CustomFloat8E5M2 f8e5m2_t;
+
 namespace utils {
 inline size_t dsize(llaisysDataType_t dtype) {
     switch (dtype) {
@@ -38,7 +52,9 @@ inline size_t dsize(llaisysDataType_t dtype) {
     case LLAISYS_DTYPE_U64:
         return sizeof(uint64_t);
     case LLAISYS_DTYPE_F8:
-        return 1; // usually 8-bit float (custom)
+        return 1; // FP8 E4M3
+    case LLAISYS_DTYPE_F8_E5M2:
+        return 1;
     case LLAISYS_DTYPE_F16:
         return 2; // 16-bit float
     case LLAISYS_DTYPE_BF16:
@@ -84,7 +100,9 @@ inline const char *dtype_to_str(llaisysDataType_t dtype) {
     case LLAISYS_DTYPE_U64:
         return "uint64";
     case LLAISYS_DTYPE_F8:
-        return "float8";
+        return "float8_e4m3";
+    case LLAISYS_DTYPE_F8_E5M2:
+        return "float8_e5m2";
     case LLAISYS_DTYPE_F16:
         return "float16";
     case LLAISYS_DTYPE_BF16:
@@ -113,26 +131,46 @@ fp16_t _f32_to_f16(float val);
 float _bf16_to_f32(bf16_t val);
 bf16_t _f32_to_bf16(float val);
 
+// Round to nearest even. E4M3 has no infinities, so larger magnitudes (and infinities)
+// saturate to +-448 as usual for storage; E5M2 overflows to infinity like IEEE formats.
+float _f8e4m3_to_f32(f8e4m3_t val);
+f8e4m3_t _f32_to_f8e4m3(float val);
+
+float _f8e5m2_to_f32(f8e5m2_t val);
+f8e5m2_t _f32_to_f8e5m2(float val);
+
+inline bool is_fp8(llaisysDataType_t dtype) {
+    return dtype == LLAISYS_DTYPE_F8 || dtype == LLAISYS_DTYPE_F8_E5M2;
+}
+
 template <typename TypeTo, typename TypeFrom>
 TypeTo cast(TypeFrom val) {
     if constexpr (std::is_same<TypeTo, TypeFrom>::value) {
         return val;
+    } else if constexpr (std::is_same<TypeTo, f8e4m3_t>::value) {
+        return _f32_to_f8e4m3(cast<float>(val));
+    } else if constexpr (std::is_same<TypeTo, f8e5m2_t>::value) {
+        return _f32_to_f8e5m2(cast<float>(val));
+    } else if constexpr (std::is_same<TypeFrom, f8e4m3_t>::value) {
+        return cast<TypeTo>(_f8e4m3_to_f32(val));
+    } else if constexpr (std::is_same<TypeFrom, f8e5m2_t>::value) {
+        return cast<TypeTo>(_f8e5m2_to_f32(val));
     } else if constexpr (std::is_same<TypeTo, fp16_t>::value && std::is_same<TypeFrom, float>::value) {
         return _f32_to_f16(val);
     } else if constexpr (std::is_same<TypeTo, fp16_t>::value && !std::is_same<TypeFrom, float>::value) {
-        return _f32_to_f16(static_cast<float>(val));
+        return _f32_to_f16(cast<float>(val));
     } else if constexpr (std::is_same<TypeFrom, fp16_t>::value && std::is_same<TypeTo, float>::value) {
         return _f16_to_f32(val);
     } else if constexpr (std::is_same<TypeFrom, fp16_t>::value && !std::is_same<TypeTo, float>::value) {
-        return static_cast<TypeTo>(_f16_to_f32(val));
+        return cast<TypeTo>(_f16_to_f32(val));
     } else if constexpr (std::is_same<TypeTo, bf16_t>::value && std::is_same<TypeFrom, float>::value) {
         return _f32_to_bf16(val);
     } else if constexpr (std::is_same<TypeTo, bf16_t>::value && !std::is_same<TypeFrom, float>::value) {
-        return _f32_to_bf16(static_cast<float>(val));
+        return _f32_to_bf16(cast<float>(val));
     } else if constexpr (std::is_same<TypeFrom, bf16_t>::value && std::is_same<TypeTo, float>::value) {
         return _bf16_to_f32(val);
     } else if constexpr (std::is_same<TypeFrom, bf16_t>::value && !std::is_same<TypeTo, float>::value) {
-        return static_cast<TypeTo>(_bf16_to_f32(val));
+        return cast<TypeTo>(_bf16_to_f32(val));
     } else {
         return static_cast<TypeTo>(val);
     }
@@ -27,6 +27,13 @@ def test_op_embedding(
 
     check_equal(out_, out, strict=True)
 
+    # FP8 tables are widened to the output type while copying rows
+    for embd_dtype_name in ("f8e4m3", "f8e5m2"):
+        embd_f8, embd_f8_ = random_tensor(embd_shape, embd_dtype_name, device_name)
+        torch_embedding(out, idx, embd_f8.to(out.dtype))
+        llaisys.Ops.embedding(out_, idx_, embd_f8_)
+        assert check_equal(out_, out, strict=True)
+
     if profile:
         benchmark(
             lambda: torch_embedding(out, idx, embd),
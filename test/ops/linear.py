@@ -5,13 +5,75 @@ parent_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
 sys.path.insert(0, parent_dir)
 import llaisys
 import torch
-from test_utils import random_tensor, check_equal, benchmark
+from test_utils import arrange_tensor, random_tensor, zero_tensor, check_equal, benchmark
 
 
 def torch_linear(out, x, w, bias):
     torch.nn.functional.linear(x, w, bias, out=out)
 
 
+def torch_linear_q8(out, x, w, bias):
+    """Reference for Q8 weights: per-output-row symmetric INT8, dequantized in fp32."""
+    w_f32 = w.float()
+    scale = w_f32.abs().amax(dim=1, keepdim=True) / 127
+    q = torch.where(scale > 0, (w_f32 / scale).round().clamp(-127, 127), torch.zeros_like(w_f32))
+    bias_f32 = bias.float() if bias is not None else None
+    out.copy_(torch.nn.functional.linear(x.float(), q * scale, bias_f32))
+
+
+def torch_linear_q4(out, x, w, bias, group_size, zero_point):
+    """Reference for Q4 weights: 4-bit codes per group of inputs with fp16 scale (and min)."""
+    w_f32 = w.float()
+    w_deq = torch.empty_like(w_f32)
+    for k0 in range(0, w.shape[1], group_size):
+        g = w_f32[:, k0 : k0 + group_size]
+        if zero_point:
+            lo, hi = g.amin(dim=1, keepdim=True), g.amax(dim=1, keepdim=True)
+            scale = ((hi - lo) / 15).half().float()
+            lo = lo.half().float()
+            q = torch.where(scale > 0, ((g - lo) / scale).round().clamp(0, 15), torch.zeros_like(g))
+            w_deq[:, k0 : k0 + group_size] = q * scale + lo
+        else:
+            scale = (g.abs().amax(dim=1, keepdim=True) / 7).half().float()
+            q = torch.where(scale > 0, (g / scale).round().clamp(-8, 7), torch.zeros_like(g))
+            w_deq[:, k0 : k0 + group_size] = q * scale
+    bias_f32 = bias.float() if bias is not None else None
+    out.copy_(torch.nn.functional.linear(x.float(), w_deq, bias_f32))
+
+
+def torch_linear_w8a8(out, x, w, bias):
+    """Reference for W8A8: Q8 weights times per-token symmetric INT8 activations."""
+    w_f32, x_f32 = w.float(), x.float()
+    w_scale = w_f32.abs().amax(dim=1, keepdim=True) / 127
+    w_q = torch.where(w_scale > 0, (w_f32 / w_scale).round().clamp(-127, 127), torch.zeros_like(w_f32))
+    x_amax = x_f32.abs().amax(dim=1, keepdim=True)
+    x_q = torch.where(x_amax > 0, (x_f32 * (127 / x_amax)).round().clamp(-127, 127), torch.zeros_like(x_f32))
+    acc = (x_q.double() @ w_q.double().T).float()
+    y = acc * (x_amax / 127) * w_scale.T
+    if bias is not None:
+        y = y + bias.float()
+    out.copy_(y)
+
+
+def torch_linear_f8(out, x, w_f8, bias):
+    """Reference for FP8 weights: the FP8 values widened exactly, fp32 accumulation."""
+    bias_f32 = bias.float() if bias is not None else None
+    out.copy_(torch.nn.functional.linear(x.float(), w_f8.float(), bias_f32))
+
+
+def measure_memory_bandwidth(nbytes=1 << 28, repeat=5):
+    """Streaming bandwidth in bytes/s, from a large device-to-device copy (read + write)."""
+    import time
+
+    src = torch.empty(nbytes, dtype=torch.uint8)
+    dst = torch.empty_like(src)
+    dst.copy_(src)
+    start = time.time()
+    for _ in range(repeat):
+        dst.copy_(src)
+    return 2 * nbytes * repeat / (time.time() - start)
+
+
 def test_op_linear(
     out_shape,
     x_shape,
@@ -22,6 +84,7 @@ def test_op_linear(
     rtol=1e-5,
     device_name="cpu",
     profile=False,
+    memory_bandwidth=None,
 ):
     print(f"   out {out_shape}, x {x_shape}, w {w_shape}, bias {use_bias}, dtype <{dtype_name}>")
     x, x_ = random_tensor(x_shape, dtype_name, device_name, scale=0.1)
@@ -37,12 +100,231 @@ def test_op_linear(
 
     assert check_equal(out_, out, atol=atol, rtol=rtol)
 
+    w_packed_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.PACKED)
+    _, out_packed_ = random_tensor(out_shape, dtype_name, device_name)
+    llaisys.Ops.linear_packed(out_packed_, x_, w_packed_, bias_)
+    assert check_equal(out_packed_, out, atol=atol, rtol=rtol)
+
+    w_q8_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.Q8)
+    out_q8 = torch.empty_like(out)
+    torch_linear_q8(out_q8, x, w, bias)
+    _, out_q8_ = random_tensor(out_shape, dtype_name, device_name)
+    llaisys.Ops.linear_packed(out_q8_, x_, w_q8_, bias_)
+    assert check_equal(out_q8_, out_q8, atol=atol, rtol=rtol)
+
+    w_w8a8_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.W8A8)
+    out_w8a8 = torch.empty_like(out)
+    torch_linear_w8a8(out_w8a8, x, w, bias)
+    _, out_w8a8_ = random_tensor(out_shape, dtype_name, device_name)
+    llaisys.Ops.linear_packed(out_w8a8_, x_, w_w8a8_, bias_)
+    assert check_equal(out_w8a8_, out_w8a8, atol=atol, rtol=rtol)
+
+    # FP8 weights are read directly by the plain and packed kernels with any activation type
+    for f8_name in ("f8e4m3", "f8e5m2"):
+        w_f8, w_f8_ = random_tensor(w_shape, f8_name, device_name, scale=0.01)
+        out_f8 = torch.empty_like(out)
+        torch_linear_f8(out_f8, x, w_f8, bias)
+        _, out_f8_ = random_tensor(out_shape, dtype_name, device_name)
+        llaisys.Ops.linear(out_f8_, x_, w_f8_, bias_)
+        assert check_equal(out_f8_, out_f8, atol=atol, rtol=rtol)
+        llaisys.Ops.linear_packed(
+            out_f8_, x_, llaisys.LinearWeight(w_f8_, llaisys.LinearWeightFormat.PACKED), bias_
+        )
+        assert check_equal(out_f8_, out_f8, atol=atol, rtol=rtol)
+
+    w_f8_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.F8)
+    out_f8 = torch.empty_like(out)
+    torch_linear_f8(out_f8, x, w.float().to(torch.float8_e4m3fn), bias)
+    _, out_f8_ = random_tensor(out_shape, dtype_name, device_name)
+    llaisys.Ops.linear_packed(out_f8_, x_, w_f8_, bias_)
+    assert check_equal(out_f8_, out_f8, atol=atol, rtol=rtol)
+
+    for weight_format in (llaisys.LinearWeightFormat.Q4, llaisys.LinearWeightFormat.Q4_ZP):
+        for group_size in (32, 64, 128):
+            w_q4_ = llaisys.LinearWeight(w_, weight_format, group_size)
+            out_q4 = torch.empty_like(out)
+            torch_linear_q4(
+                out_q4, x, w, bias, group_size, weight_format == llaisys.LinearWeightFormat.Q4_ZP
+            )
+            _, out_q4_ = random_tensor(out_shape, dtype_name, device_name)
+            llaisys.Ops.linear_packed(out_q4_, x_, w_q4_, bias_)
+            assert check_equal(out_q4_, out_q4, atol=atol, rtol=rtol)
+
     if profile:
-        benchmark(
+        _, llaisys_time = benchmark(
             lambda: torch_linear(out, x, w, bias),
             lambda: llaisys.Ops.linear(out_, x_, w_, bias_),
             device_name,
         )
+        print("        Packed weight:")
+        _, packed_time = benchmark(
+            lambda: torch_linear(out, x, w, bias),
+            lambda: llaisys.Ops.linear_packed(out_packed_, x_, w_packed_, bias_),
+            device_name,
+        )
+        llaisys_time = min(llaisys_time, packed_time)
+        print("        Q8 weight:")
+        _, q8_time = benchmark(
+            lambda: torch_linear(out, x, w, bias),
+            lambda: llaisys.Ops.linear_packed(out_q8_, x_, w_q8_, bias_),
+            device_name,
+        )
+        print("        Q4 weight (group 32):")
+        w_q4_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.Q4, 32)
+        _, q4_time = benchmark(
+            lambda: torch_linear(out, x, w, bias),
+            lambda: llaisys.Ops.linear_packed(out_q8_, x_, w_q4_, bias_),
+            device_name,
+        )
+        print("        F8 weight:")
+        _, f8_time = benchmark(
+            lambda: torch_linear(out, x, w, bias),
+            lambda: llaisys.Ops.linear_packed(out_f8_, x_, w_f8_, bias_),
+            device_name,
+        )
+        print("        W8A8 weight:")
+        _, w8a8_time = benchmark(
+            lambda: torch_linear(out, x, w, bias),
+            lambda: llaisys.Ops.linear_packed(out_w8a8_, x_, w_w8a8_, bias_),
+            device_name,
+        )
+        flops = 2 * x_shape[0] * w_shape[0] * w_shape[1]
+        print(f"        W8A8 throughput: {flops / w8a8_time / 1e9:.1f} GOP/s")
+        # Decode GEMV is bound by streaming the weights once.
+        if x_shape[0] == 1 and memory_bandwidth:
+            for name, nbytes, t in (
+                ("", w.numel() * w.element_size(), llaisys_time),
+                ("Q8 ", w.numel(), q8_time),
+                ("F8 ", w.numel(), f8_time),
+                ("Q4 ", w.numel() // 2, q4_time),
+            ):
+                bandwidth = nbytes / t
+                print(
+                    f"        {name}Weight bandwidth: {bandwidth / 1e9:.2f} GB/s "
+                    f"({100 * bandwidth / memory_bandwidth:.1f}% of copy bandwidth)"
+                )
+
+
+def test_op_linear_swiglu(
+    inter, x_shape, dtype_name="f32", atol=1e-5, rtol=1e-5, device_name="cpu"
+):
+    print(f"   gate/up ({inter}, {x_shape[1]}), x {x_shape}, dtype <{dtype_name}>")
+    x, x_ = random_tensor(x_shape, dtype_name, device_name, scale=0.1)
+    gate, gate_ = random_tensor((inter, x_shape[1]), dtype_name, device_name, scale=0.1)
+    up, up_ = random_tensor((inter, x_shape[1]), dtype_name, device_name, scale=0.1)
+
+    # gate and up stay in fp32 inside the fused kernel
+    g = torch.nn.functional.linear(x.float(), gate.float())
+    out = (g * torch.sigmoid(g) * torch.nn.functional.linear(x.float(), up.float())).to(x.dtype)
+    _, out_ = random_tensor((x_shape[0], inter), dtype_name, device_name)
+    llaisys.Ops.linear_swiglu(out_, x_, llaisys.LinearWeight.gate_up(gate_, up_))
+    assert check_equal(out_, out, atol=atol, rtol=rtol)
+
+    # Quantized gate/up: each projection is quantized as on its own
+    g_q8 = torch.empty(x_shape[0], inter)
+    u_q8 = torch.empty(x_shape[0], inter)
+    torch_linear_q8(g_q8, x, gate, None)
+    torch_linear_q8(u_q8, x, up, None)
+    out_q8 = (g_q8 * torch.sigmoid(g_q8) * u_q8).to(x.dtype)
+    llaisys.Ops.linear_swiglu(
+        out_, x_, llaisys.LinearWeight.gate_up(gate_, up_, llaisys.LinearWeightFormat.Q8)
+    )
+    assert check_equal(out_, out_q8, atol=atol, rtol=rtol)
+
+
+def test_op_linear_fused(
+    x_shape,
+    w_shape,
+    head_dim,
+    rope_heads,
+    dtype_name="f32",
+    atol=1e-5,
+    rtol=1e-5,
+    device_name="cpu",
+):
+    print(f"   x {x_shape}, w {w_shape}, rope {rope_heads} x {head_dim}, dtype <{dtype_name}>")
+    x, x_ = random_tensor(x_shape, dtype_name, device_name, scale=0.1)
+    w, w_ = random_tensor(w_shape, dtype_name, device_name, scale=0.1)
+    bias, bias_ = random_tensor((w_shape[0],), dtype_name, device_name)
+    residual, residual_ = random_tensor((x_shape[0], w_shape[0]), dtype_name, device_name)
+    pos_ids, pos_ids_ = arrange_tensor(3, 3 + x_shape[0], device_name)
+    theta = 10000.0
+    rope_cols = rope_heads * head_dim
+    weight_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.PACKED)
+
+    for activation in (llaisys.Activation.NONE, llaisys.Activation.SILU, llaisys.Activation.GELU):
+        # Every stage runs on the fp32 product, which is rounded once at the end
+        y = torch.nn.functional.linear(x.float(), w.float(), bias.float())
+        if activation == llaisys.Activation.SILU:
+            y = torch.nn.functional.silu(y)
+        elif activation == llaisys.Activation.GELU:
+            y = torch.nn.functional.gelu(y)
+        if rope_cols:
+            heads = y[:, :rope_cols].reshape(x_shape[0], rope_heads, head_dim)
+            i = torch.arange(0, head_dim // 2, dtype=torch.float32)
+            freqs = pos_ids.to(torch.float32).unsqueeze(1) / (theta ** (2 * i / head_dim))
+            sin, cos = freqs.sin().unsqueeze(1), freqs.cos().unsqueeze(1)
+            a, b = heads[..., : head_dim // 2], heads[..., head_dim // 2 :]
+            y[:, :rope_cols] = torch.cat((a * cos - b * sin, b * cos + a * sin), dim=-1).reshape(
+                x_shape[0], rope_cols
+            )
+        out = (y + residual.float()).to(x.dtype)
+
+        _, out_ = random_tensor(residual.shape, dtype_name, device_name)
+        llaisys.Ops.linear_fused(
+            out_, x_, weight_, bias_, activation, pos_ids_, rope_cols, head_dim, theta, residual_
+        )
+        assert check_equal(out_, out, atol=atol, rtol=rtol)
+
+        # The residual may be the output itself, which then accumulates the product
+        llaisys.Ops.rearrange(out_, residual_)
+        llaisys.Ops.linear_fused(
+            out_, x_, weight_, bias_, activation, pos_ids_, rope_cols, head_dim, theta, out_
+        )
+        assert check_equal(out_, out, atol=atol, rtol=rtol)
+
+
+def test_op_linear_topk(x_shape, w_shape, k, dtype_name="f32", device_name="cpu"):
+    print(f"   x {x_shape}, w {w_shape}, k {k}, dtype <{dtype_name}>")
+    x, x_ = random_tensor(x_shape, dtype_name, device_name, scale=0.1)
+    w, w_ = random_tensor(w_shape, dtype_name, device_name, scale=0.1)
+    indices, indices_ = zero_tensor((x_shape[0], k), "i64", device_name)
+    _, values_ = zero_tensor((x_shape[0], k), "f32", device_name)
+    api = llaisys.RuntimeAPI(indices_.device_type())
+
+    def selected(y):
+        # Outputs at the returned indices; near-ties may legitimately come out in either order
+        api.memcpy_sync(
+            indices.data_ptr(), indices_.data_ptr(), indices.numel() * indices.element_size(), llaisys.MemcpyKind.D2D
+        )
+        return torch.gather(y, 1, indices)
+
+    # Outputs are ranked in fp32, before rounding to the input dtype
+    y_q8 = torch.empty(x_shape[0], w_shape[0])
+    torch_linear_q8(y_q8, x, w, None)
+    for fmt, y in (
+        (llaisys.LinearWeightFormat.PACKED, torch.nn.functional.linear(x.float(), w.float())),
+        (llaisys.LinearWeightFormat.Q8, y_q8),
+    ):
+        weight_ = llaisys.LinearWeight(w_, fmt)
+        values = torch.topk(y, k, dim=-1).values
+        llaisys.Ops.linear_topk(indices_, values_, x_, weight_)
+        assert check_equal(values_, values, atol=1e-4, rtol=1e-4)
+        assert torch.allclose(selected(y), values, atol=1e-4, rtol=1e-4)
+
+        # A vanishing temperature leaves the Gumbel noise no say in the order
+        llaisys.Ops.linear_topk(indices_, values_, x_, weight_, 1e-6, 7)
+        assert torch.allclose(selected(y), values, atol=1e-4, rtol=1e-4)
+
+    # Sampling is a function of the seed: rerunning with it draws the same indices,
+    # and the values are the plain outputs at them
+    weight_ = llaisys.LinearWeight(w_, llaisys.LinearWeightFormat.PACKED)
+    y = torch.nn.functional.linear(x.float(), w.float())
+    llaisys.Ops.linear_topk(indices_, values_, x_, weight_, 1.0, 1234)
+    sampled = selected(y)
+    assert check_equal(values_, sampled, atol=1e-4, rtol=1e-4)
+    llaisys.Ops.linear_topk(indices_, values_, x_, weight_, 1.0, 1234)
+    assert torch.equal(selected(y), sampled)
 
 
 if __name__ == "__main__":
@@ -54,6 +336,9 @@ if __name__ == "__main__":
     args = parser.parse_args()
     testShapes = [
         ((2, 3), (2, 4), (3, 4), True),
+        ((1, 8960), (1, 1536), (8960, 1536), True),
+        ((1, 1536), (1, 8960), (1536, 8960), False),
+        ((37, 300), (37, 513), (300, 513), False),
         ((512, 4096), (512, 4096), (4096, 4096), True),
     ]
     testDtypePrec = [
@@ -62,9 +347,39 @@ if __name__ == "__main__":
         ("f16", 1e-3, 1e-3),
         ("bf16", 1e-2, 1e-2),
     ]
+    memory_bandwidth = None
+    if args.profile and args.device == "cpu":
+        memory_bandwidth = measure_memory_bandwidth()
+        print(f"Memory copy bandwidth: {memory_bandwidth / 1e9:.2f} GB/s")
     print(f"Testing Ops.linear on {args.device}")
     for shapes in testShapes:
         for dtype_name, atol, rtol in testDtypePrec:
-            test_op_linear(*shapes, dtype_name, atol, rtol, args.device, args.profile)
+            test_op_linear(
+                *shapes, dtype_name, atol, rtol, args.device, args.profile, memory_bandwidth
+            )
+
+    print(f"Testing Ops.linear_swiglu on {args.device}")
+    for inter, x_shape in [(7, (1, 33)), (300, (1, 512)), (8960, (1, 1536)), (100, (37, 257))]:
+        for dtype_name, atol, rtol in testDtypePrec:
+            test_op_linear_swiglu(inter, x_shape, dtype_name, atol, rtol, args.device)
+
+    print(f"Testing Ops.linear_fused on {args.device}")
+    for x_shape, w_shape, head_dim, rope_heads in [
+        ((1, 64), (300, 64), 64, 3),
+        ((5, 96), (520, 96), 128, 3),
+        ((37, 257), (200, 257), 0, 0),
+        ((130, 128), (2304, 128), 128, 16),
+    ]:
+        for dtype_name, atol, rtol in testDtypePrec:
+            test_op_linear_fused(x_shape, w_shape, head_dim, rope_heads, dtype_name, atol, rtol, args.device)
+
+    print(f"Testing Ops.linear_topk on {args.device}")
+    for x_shape, w_shape, k in [
+        ((1, 64), (300, 64), 1),
+        ((3, 257), (1000, 257), 5),
+        ((1, 1536), (151936, 1536), 50),
+    ]:
+        for dtype_name, _, _ in testDtypePrec:
+            test_op_linear_topk(x_shape, w_shape, k, dtype_name, args.device)
 
     print("\033[92mTest passed!\033[0m\n")
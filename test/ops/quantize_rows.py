@@ -0,0 +1,89 @@
+import sys
+import os
+
+parent_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sys.path.insert(0, parent_dir)
+import llaisys
+import torch
+from test_utils import random_tensor, zero_tensor, check_equal, benchmark
+
+QMAX = {"i8": 127.0, "f8e4m3": 448.0, "f8e5m2": 57344.0}
+
+
+def torch_quantize_rows(out, scales, inp, out_dtype_name):
+    x = inp.float()
+    scales.copy_(x.abs().amax(dim=-1) / QMAX[out_dtype_name])
+    q = x / scales.unsqueeze(-1).clamp_min(torch.finfo(torch.float32).tiny)
+    if out_dtype_name == "i8":
+        q = q.round().clamp(-127, 127)
+    out.copy_(q.to(out.dtype))
+
+
+def llaisys_to_torch(tensor_, like):
+    result = torch.empty_like(like)
+    api = llaisys.RuntimeAPI(tensor_.device_type())
+    api.memcpy_sync(
+        result.data_ptr(),
+        tensor_.data_ptr(),
+        result.numel() * result.element_size(),
+        llaisys.MemcpyKind.D2D,
+    )
+    return result
+
+
+def test_op_quantize_rows(
+    shape,
+    dtype_name="f32",
+    out_dtype_name="i8",
+    device_name="cpu",
+    profile=False,
+):
+    print(f"   shape {shape} dtype <{dtype_name}> out <{out_dtype_name}>")
+    # Strided rows: a slice of the heads of a wider tensor, like V in the fused QKV output
+    wide, wide_ = random_tensor((*shape[:-2], shape[-2] + 2, shape[-1]), dtype_name, device_name, scale=8.0, bias=-4.0)
+    ndim = len(shape)
+    x = wide.narrow(ndim - 2, 1, shape[-2])
+    x_ = wide_.slice(ndim - 2, 1, 1 + shape[-2])
+
+    out, out_ = zero_tensor(shape, out_dtype_name, device_name)
+    scales, scales_ = zero_tensor(shape[:-1], "f32", device_name)
+    torch_quantize_rows(out, scales, x, out_dtype_name)
+    llaisys.Ops.quantize_rows(out_, scales_, x_)
+
+    assert check_equal(scales_, scales, atol=0, rtol=1e-6)
+    # Codes may differ by one step where x / scale sits on a rounding boundary
+    got = llaisys_to_torch(out_, out).float()
+    step = 1.0 if out_dtype_name == "i8" else 0.13 * out.float().abs() + 2.0**-9
+    assert torch.all((got - out.float()).abs() <= step)
+
+    if profile:
+        benchmark(
+            lambda: torch_quantize_rows(out, scales, x, out_dtype_name),
+            lambda: llaisys.Ops.quantize_rows(out_, scales_, x_),
+            device_name,
+        )
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--device", default="cpu", choices=["cpu", "nvidia"], type=str)
+    parser.add_argument("--profile", action="store_true")
+    args = parser.parse_args()
+    # [tokens, heads, head_dim]
+    testShapes = [(1, 2, 64), (7, 3, 128), (64, 2, 80)]
+    testDtypes = [
+        # type, out type
+        ("f32", "i8"),
+        ("bf16", "i8"),
+        ("f16", "i8"),
+        ("f32", "f8e4m3"),
+        ("bf16", "f8e5m2"),
+    ]
+    print(f"Testing Ops.quantize_rows on {args.device}")
+    for shape in testShapes:
+        for dtype_name, out_dtype_name in testDtypes:
+            test_op_quantize_rows(shape, dtype_name, out_dtype_name, args.device, args.profile)
+
+    print("\033[92mTest passed!\033[0m\n")
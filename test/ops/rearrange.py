@@ -0,0 +1,70 @@
+import sys
+import os
+
+parent_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sys.path.insert(0, parent_dir)
+import llaisys
+import torch
+from test_utils import random_tensor, check_equal, benchmark
+
+
+def torch_rearrange(out, inp):
+    out.copy_(inp)
+
+
+def test_op_rearrange(
+    shape,
+    dtype_name="f32",
+    storage_dtype_name="f32",
+    device_name="cpu",
+    profile=False,
+):
+    print(f"   shape {shape} dtype <{dtype_name}> storage <{storage_dtype_name}>")
+    x, x_ = random_tensor(shape, dtype_name, device_name)
+    perm = tuple(reversed(range(len(shape))))
+    perm_shape = tuple(shape[i] for i in perm)
+
+    # Strided source: a permuted view copied (and converted) into a contiguous tensor
+    stored, stored_ = random_tensor(perm_shape, storage_dtype_name, device_name)
+    torch_rearrange(stored, x.permute(perm))
+    llaisys.Ops.rearrange(stored_, x_.permute(*perm))
+
+    # Strided destination: converted back into a slice of a larger buffer, like a KV cache
+    n = perm_shape[1]
+    cache, cache_ = random_tensor((perm_shape[0], n + 3, *perm_shape[2:]), dtype_name, device_name)
+    torch_rearrange(cache[:, 1 : 1 + n], stored)
+    llaisys.Ops.rearrange(cache_.slice(1, 1, 1 + n), stored_)
+    assert check_equal(cache_, cache, strict=True)
+
+    if profile:
+        benchmark(
+            lambda: torch_rearrange(stored, x.permute(perm)),
+            lambda: llaisys.Ops.rearrange(stored_, x_.permute(*perm)),
+            device_name,
+        )
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--device", default="cpu", choices=["cpu", "nvidia"], type=str)
+    parser.add_argument("--profile", action="store_true")
+    args = parser.parse_args()
+    testShapes = [(2, 3), (16, 4, 64), (512, 4096)]
+    testDtypes = [
+        # type, storage type
+        ("f32", "f32"),
+        ("f16", "f16"),
+        ("bf16", "bf16"),
+        ("f32", "bf16"),
+        ("f32", "f8e4m3"),
+        ("bf16", "f8e4m3"),
+        ("f16", "f8e5m2"),
+    ]
+    print(f"Testing Ops.rearrange on {args.device}")
+    for shape in testShapes:
+        for dtype_name, storage_dtype_name in testDtypes:
+            test_op_rearrange(shape, dtype_name, storage_dtype_name, args.device, args.profile)
+
+    print("\033[92mTest passed!\033[0m\n")
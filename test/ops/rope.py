@@ -51,6 +51,14 @@ def test_op_rope(
 
     assert check_equal(y_, y, atol=atol, rtol=rtol)
 
+    # Strided input: the middle heads of a wider [seq_len, 3 * n_heads, head_dim] tensor,
+    # like q/k inside a fused QKV projection output
+    seq_len, n_heads, head_dim = shape
+    x_qkv, x_qkv_ = random_tensor((seq_len, 3 * n_heads, head_dim), dtype_name, device_name)
+    torch_rope(y, x_qkv[:, n_heads : 2 * n_heads], pos_ids, theta)
+    llaisys.Ops.rope(y_, x_qkv_.slice(1, n_heads, 2 * n_heads), pos_ids_, theta)
+    assert check_equal(y_, y, atol=atol, rtol=rtol)
+
     if profile:
         benchmark(
             lambda: torch_rope(y, x, pos_ids, theta),
@@ -68,7 +76,11 @@ if __name__ == "__main__":
     args = parser.parse_args()
     testShapes = [
         ((2, 1, 4), (0, 2)), 
-        ((512, 4, 4096), (512, 1024))]
+        ((512, 4, 4096), (512, 1024)),
+        # head sizes with compile-time instances
+        ((7, 3, 64), (10, 17)),
+        ((7, 3, 96), (10, 17)),
+        ((7, 3, 128), (10, 17))]
     testDtypePrec = [
         # type, atol, rtol
         ("f32", 1e-4, 1e-4),
@@ -0,0 +1,105 @@
+import sys
+import os
+
+parent_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sys.path.insert(0, parent_dir)
+import llaisys
+import torch
+from test_utils import random_tensor, zero_tensor, benchmark
+
+
+def read_index(idx_):
+    idx, _ = zero_tensor((1,), "i64", "cpu")
+    llaisys.RuntimeAPI(idx_.device_type()).memcpy_sync(
+        idx.data_ptr(), idx_.data_ptr(), idx.element_size(), llaisys.MemcpyKind.D2D
+    )
+    return int(idx.item())
+
+
+def fresh_logits(vals, dtype_name, device_name):
+    # F32 logits are penalized and scaled in place, so every call gets its own copy
+    _, vals_ = zero_tensor(vals.shape, dtype_name, device_name)
+    llaisys.RuntimeAPI(vals_.device_type()).memcpy_sync(
+        vals_.data_ptr(), vals.data_ptr(), vals.numel() * vals.element_size(), llaisys.MemcpyKind.D2D
+    )
+    return vals_
+
+
+def draw(vals, dtype_name, device_name, ndraw, seed, history_=None, **params):
+    _, idx_ = zero_tensor((1,), "i64", device_name)
+    state = seed
+    tokens = []
+    for _ in range(ndraw):
+        state = llaisys.Ops.sample(idx_, fresh_logits(vals, dtype_name, device_name), history_, rng_state=state, **params)
+        tokens.append(read_index(idx_))
+    return tokens
+
+
+def test_op_sample(voc, dtype_name="f32", device_name="cpu", profile=False):
+    print(f"   voc {voc} dtype <{dtype_name}>")
+    vals, vals_ = random_tensor((voc,), dtype_name, device_name, scale=8.0)
+    x = vals.float()
+    order = torch.sort(x, descending=True, stable=True).indices
+
+    # Greedy: temperature 0 and top_k 1 are both the argmax, and leave the generator alone
+    assert draw(vals, dtype_name, device_name, 1, 0) == [int(order[0])]
+    _, idx_ = zero_tensor((1,), "i64", device_name)
+    assert llaisys.Ops.sample(idx_, vals_, temperature=1.0, top_k=1, rng_state=5) == 5
+    assert read_index(idx_) == int(order[0])
+
+    # The repetition penalty moves the argmax off a token of the history
+    history = order[0].repeat(3)
+    _, history_ = zero_tensor((3,), "i64", device_name)
+    llaisys.RuntimeAPI(history_.device_type()).memcpy_sync(
+        history_.data_ptr(), history.data_ptr(), history.numel() * history.element_size(), llaisys.MemcpyKind.D2D
+    )
+    if x[order[0]] > 0 and x[order[0]] / 1e3 < x[order[1]]:
+        assert draw(vals, dtype_name, device_name, 1, 0, history_, repetition_penalty=1e3) == [int(order[1])]
+
+    # Truncation: every draw stays within the kept set (with a little slack at the boundaries)
+    k = 8
+    tokens = draw(vals, dtype_name, device_name, 200, 1, temperature=2.0, top_k=k)
+    assert set(tokens) <= set(order[:k].tolist())
+    probs = torch.softmax(x / 0.7, dim=-1)
+    cum = torch.cumsum(probs[order], dim=-1)
+    nucleus = set(order[: int((cum < 0.5 + 1e-3).sum()) + 1].tolist())
+    assert set(draw(vals, dtype_name, device_name, 200, 2, temperature=0.7, top_p=0.5)) <= nucleus
+    above = set(torch.nonzero(probs >= 0.0999 * probs.max()).flatten().tolist())
+    assert set(draw(vals, dtype_name, device_name, 200, 3, temperature=0.7, min_p=0.1)) <= above
+
+    # Same seed, same tokens
+    assert draw(vals, dtype_name, device_name, 20, 42, temperature=1.0) == draw(
+        vals, dtype_name, device_name, 20, 42, temperature=1.0
+    )
+
+    # Draws follow softmax(logits / temperature) over a small vocabulary
+    small = torch.tensor([1.0, 0.5, 0.0, -1.0])
+    tokens = draw(small, "f32", device_name, 4000, 7, temperature=1.0)
+    freq = torch.bincount(torch.tensor(tokens), minlength=4).float() / len(tokens)
+    assert torch.allclose(freq, torch.softmax(small, dim=-1), atol=0.03)
+
+    if profile:
+        # temperature 1 keeps the in-place scaling of F32 logits from compounding across calls
+        _, idx_ = zero_tensor((1,), "i64", device_name)
+        benchmark(
+            lambda: torch.multinomial(torch.softmax(torch.topk(x, 50).values, dim=-1), 1),
+            lambda: llaisys.Ops.sample(idx_, vals_, temperature=1.0, top_k=50, top_p=0.8),
+            device_name,
+        )
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--device", default="cpu", choices=["cpu", "nvidia"], type=str)
+    parser.add_argument("--profile", action="store_true")
+    args = parser.parse_args()
+    testVocs = [37, 4096, 151936]
+    testDtype = ["f32", "f16", "bf16"]
+    print(f"Testing Ops.sample on {args.device}")
+    for voc in testVocs:
+        for dtype_name in testDtype:
+            test_op_sample(voc, dtype_name, args.device, args.profile)
+
+    print("\033[92mTest passed!\033[0m\n")
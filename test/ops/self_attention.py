@@ -5,7 +5,7 @@ parent_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
 sys.path.insert(0, parent_dir)
 import llaisys
 import torch
-from test_utils import random_tensor, check_equal, benchmark
+from test_utils import random_tensor, random_int_tensor, zero_tensor, check_equal, benchmark
 
 
 def torch_self_attention(attn_val, query, key, value, scale):
@@ -53,6 +53,14 @@ def test_op_self_attention(
     llaisys.Ops.self_attention(attn_val_, q_, k_, v_, scale)
     assert check_equal(attn_val_, attn_val, atol=atol, rtol=rtol)
 
+    # FP8 KV cache: K/V are widened while reading, q and the output keep their type
+    for kv_dtype_name in ("f8e4m3", "f8e5m2"):
+        k_f8, k_f8_ = random_tensor((kvlen, nkvh, hd), kv_dtype_name, device_name)
+        v_f8, v_f8_ = random_tensor((kvlen, nkvh, hd), kv_dtype_name, device_name)
+        torch_self_attention(attn_val, q, k_f8.to(q.dtype), v_f8.to(q.dtype), scale)
+        llaisys.Ops.self_attention(attn_val_, q_, k_f8_, v_f8_, scale)
+        assert check_equal(attn_val_, attn_val, atol=atol, rtol=rtol)
+
     if profile:
         benchmark(
             lambda: torch_self_attention(attn_val, q, k, v, scale),
@@ -61,6 +69,62 @@ def test_op_self_attention(
         )
 
 
+def test_op_self_attention_paged(
+    qlen,
+    kvlen,
+    nh,
+    nkvh,
+    hd,
+    block_size,
+    dtype_name="f32",
+    atol=1e-5,
+    rtol=1e-5,
+    device_name="cpu",
+    kv_dtype_name=None,
+):
+    print(
+        f"   qlen={qlen} kvlen={kvlen} nh={nh} nkvh={nkvh} hd={hd} block_size={block_size} dtype <{dtype_name}>"
+        + (f" kv <{kv_dtype_name}>" if kv_dtype_name else "")
+    )
+    q, q_ = random_tensor((qlen, nh, hd), dtype_name, device_name)
+    scale = 1.0 / (hd**0.5)
+
+    # Blocks of the sequence in reverse pool order, with unused blocks left in the pool
+    nblocks = (kvlen + block_size - 1) // block_size
+    pool = nblocks + 2
+    block_table, block_table_ = zero_tensor((nblocks,), "i64", device_name)
+    block_table.copy_(torch.arange(pool - 1, pool - 1 - nblocks, -1))
+    block_table_.load(block_table.data_ptr())
+    block_shape = (pool, block_size, nkvh, hd)
+    k_scales = v_scales = k_scales_ = v_scales_ = None
+    if kv_dtype_name is None:
+        k_blocks, k_blocks_ = random_tensor(block_shape, dtype_name, device_name)
+        v_blocks, v_blocks_ = random_tensor(block_shape, dtype_name, device_name)
+    else:
+        # Quantized blocks: codes with one scale per (position, kv head) row
+        if kv_dtype_name == "i8":
+            k_blocks, k_blocks_ = random_int_tensor(block_shape, device_name, "i8", low=-127, high=128)
+            v_blocks, v_blocks_ = random_int_tensor(block_shape, device_name, "i8", low=-127, high=128)
+        else:
+            k_blocks, k_blocks_ = random_tensor(block_shape, kv_dtype_name, device_name, scale=400.0)
+            v_blocks, v_blocks_ = random_tensor(block_shape, kv_dtype_name, device_name, scale=400.0)
+        k_scales, k_scales_ = random_tensor(block_shape[:-1], "f32", device_name, scale=0.01)
+        v_scales, v_scales_ = random_tensor(block_shape[:-1], "f32", device_name, scale=0.01)
+    rows = block_table.repeat_interleave(block_size)[:kvlen] * block_size + torch.arange(kvlen) % block_size
+    k = k_blocks.reshape(-1, nkvh, hd)[rows]
+    v = v_blocks.reshape(-1, nkvh, hd)[rows]
+    if kv_dtype_name is not None:
+        k = (k.float() * k_scales.reshape(-1, nkvh, 1)[rows]).to(q.dtype)
+        v = (v.float() * v_scales.reshape(-1, nkvh, 1)[rows]).to(q.dtype)
+
+    attn_val, attn_val_ = random_tensor((qlen, nh, hd), dtype_name, device_name)
+    torch_self_attention(attn_val, q, k, v, scale)
+    llaisys.Ops.self_attention_paged(
+        attn_val_, q_, k_blocks_, v_blocks_, block_table_, kvlen, scale, k_scales_, v_scales_
+    )
+    assert check_equal(attn_val_, attn_val, atol=atol, rtol=rtol)
+
+
 if __name__ == "__main__":
     import argparse
 
@@ -72,6 +136,10 @@ if __name__ == "__main__":
         # qlen, kvlen, nh, nkvh, hd
         (2, 2, 1, 1, 4),
         (5, 11, 4, 2, 8),
+        # several query and key blocks of the tiled prefill kernel
+        (70, 150, 4, 2, 80),
+        # GQA decode over several split-K slices of the key range
+        (1, 600, 12, 2, 64),
     ]
     testDtypePrec = [
         # type, atol, rtol
@@ -86,4 +154,18 @@ if __name__ == "__main__":
                 *shape, dtype_name, atol, rtol, args.device, args.profile
             )
 
+    testPagedShapes = [
+        # qlen, kvlen, nh, nkvh, hd, block_size
+        (1, 37, 4, 2, 16, 16),
+        (5, 40, 4, 2, 16, 8),
+        (70, 150, 4, 2, 80, 16),
+    ]
+    print(f"Testing Ops.self_attention_paged on {args.device}")
+    for shape in testPagedShapes:
+        for dtype_name, atol, rtol in testDtypePrec:
+            test_op_self_attention_paged(*shape, dtype_name, atol, rtol, args.device)
+        # Quantized KV cache, dequantized while reading
+        for kv_dtype_name in ("i8", "f8e4m3", "f8e5m2"):
+            test_op_self_attention_paged(*shape, "f32", 1e-5, 1e-5, args.device, kv_dtype_name)
+
     print("\033[92mTest passed!\033[0m\n")
@@ -0,0 +1,388 @@
+import llaisys
+import torch
+from llaisys.libllaisys import LIB_LLAISYS, DataType, DeviceType, LlaisysSamplingParams
+from llaisys.libllaisys.models import LlaisysQwen2Meta, LlaisysQwen2GenerateParams, LlaisysQwen2TokenCallback, Qwen2Status
+from ctypes import byref, c_float, c_int, c_int64, c_size_t
+
+BLOCK_SIZE = 4
+VOC = 64
+
+
+def create_tiny_model():
+    """Random 1-layer Qwen2: enough to drive the cache through llaisysQwen2ModelStep."""
+    meta = LlaisysQwen2Meta(DataType.F32, 1, 32, 2, 1, 16, 64, 256, VOC, 1e-6, 10000.0, -1)
+    model = LIB_LLAISYS.llaisysQwen2ModelCreate(byref(meta), DeviceType.CPU, (c_int * 1)(0), 1)
+    weights = LIB_LLAISYS.llaisysQwen2ModelWeights(model).contents
+    torch.manual_seed(0)
+    tensors = [weights.in_embed, weights.out_embed, weights.out_norm_w]
+    for field_name in (
+        "attn_norm_w", "attn_q_w", "attn_q_b", "attn_k_w", "attn_k_b", "attn_v_w", "attn_v_b",
+        "attn_o_w", "mlp_norm_w", "mlp_gate_w", "mlp_up_w", "mlp_down_w",
+    ):
+        tensors.append(getattr(weights, field_name)[0])
+    for tensor in tensors:
+        shape = (c_size_t * 2)()
+        LIB_LLAISYS.tensorGetShape(tensor, shape)
+        data = torch.randn([shape[i] for i in range(LIB_LLAISYS.tensorGetNdim(tensor))]) * 0.5
+        LIB_LLAISYS.tensorLoad(tensor, data.data_ptr())
+    return model
+
+
+def create_cache(nblocks):
+    return LIB_LLAISYS.kvCacheCreate(1, 1, 16, DataType.F32, BLOCK_SIZE, nblocks, DeviceType.CPU, 0)
+
+
+def step(model, cache, seqs, chunks, want_next=True):
+    """One llaisysQwen2ModelStep: seqs[s] appends chunks[s]. Returns (status, next tokens);
+    without want_next the step passes next_tokens NULL and only appends K/V."""
+    token_ids = [t for chunk in chunks for t in chunk]
+    next_tokens = (c_int64 * len(seqs))() if want_next else None
+    status = LIB_LLAISYS.llaisysQwen2ModelStep(
+        model,
+        (c_int64 * len(token_ids))(*token_ids),
+        (c_size_t * len(seqs))(*[len(chunk) for chunk in chunks]),
+        (c_int64 * len(seqs))(*seqs),
+        len(seqs),
+        cache,
+        next_tokens,
+    )
+    return status, list(next_tokens) if want_next else None
+
+
+def match_prefix(cache, prompt):
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    return seq, LIB_LLAISYS.kvCacheMatchPrefix(cache, seq, (c_int64 * len(prompt))(*prompt), len(prompt))
+
+
+def run_prompt(model, cache, prompt):
+    """New sequence over prompt, attached to its cached prefix. Returns (seq, matched, next token)."""
+    seq, matched = match_prefix(cache, prompt)
+    status, next_tokens = step(model, cache, [seq], [prompt[matched:]])
+    assert status == 0
+    return seq, matched, next_tokens[0]
+
+
+def uncached_next_token(model, prompt):
+    cache = create_cache(16)
+    _, _, next_token = run_prompt(model, cache, prompt)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    return next_token
+
+
+def generate(model, cache, prompt, max_new_tokens, prefill_chunk=0, stop_tokens=(), stop_sequences=(), stop_after=0):
+    """Greedy llaisysQwen2ModelGenerate; the callback stops it after stop_after tokens if given.
+    Returns (status, tokens passed to the callback)."""
+    tokens = []
+
+    def on_token(token, _user_data):
+        tokens.append(token)
+        return 1 if len(tokens) == stop_after else 0
+
+    stop_flat = [t for stop in stop_sequences for t in stop]
+    params = LlaisysQwen2GenerateParams(
+        max_new_tokens=max_new_tokens,
+        sampling=LlaisysSamplingParams(0.0, 1, 1.0, 0.0, 1.0),
+        seed=0,
+        prefill_chunk=prefill_chunk,
+        stop_tokens=(c_int64 * len(stop_tokens))(*stop_tokens),
+        nstop_tokens=len(stop_tokens),
+        stop_sequences=(c_int64 * len(stop_flat))(*stop_flat),
+        stop_sequence_lens=(c_size_t * len(stop_sequences))(*[len(stop) for stop in stop_sequences]),
+        nstop_sequences=len(stop_sequences),
+    )
+    status = LIB_LLAISYS.llaisysQwen2ModelGenerate(
+        model, (c_int64 * len(prompt))(*prompt), len(prompt), cache, byref(params),
+        LlaisysQwen2TokenCallback(on_token), None,
+    )
+    return status, tokens
+
+
+def greedy_reference(model, prompt, n):
+    """n tokens of a Step/argmax loop on a cache of its own."""
+    cache = create_cache(16)
+    seq, _, token = run_prompt(model, cache, prompt)
+    tokens = [token]
+    while len(tokens) < n:
+        status, next_tokens = step(model, cache, [seq], [[token]])
+        assert status == 0
+        token = next_tokens[0]
+        tokens.append(token)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    return tokens
+
+
+def logits_at(model, cache, seq, tokens, positions):
+    """llaisysQwen2ModelInferPagedLogits appending tokens to seq. Returns (next token, the logits
+    after every token of positions)."""
+    logits = llaisys.Tensor((len(positions), VOC), DataType.F32, DeviceType.CPU, 0)
+    next_token = LIB_LLAISYS.llaisysQwen2ModelInferPagedLogits(
+        model, (c_int64 * len(tokens))(*tokens), len(tokens), cache, seq,
+        (c_size_t * len(positions))(*positions), len(positions), logits.lib_tensor(),
+    )
+    rows = (c_float * (len(positions) * VOC)).from_address(logits.data_ptr())
+    return next_token, [list(rows[j * VOC:(j + 1) * VOC]) for j in range(len(positions))]
+
+
+def last_logits(model, cache, seq, tokens):
+    """Logits after the last of tokens, appended to seq."""
+    next_token, rows = logits_at(model, cache, seq, tokens, [len(tokens) - 1])
+    assert next_token >= 0
+    return rows[0]
+
+
+def assert_close(a, b, atol=1e-4):
+    assert max(abs(x - y) for x, y in zip(a, b)) <= atol
+
+
+def num_free(cache):
+    return LIB_LLAISYS.kvCacheNumFreeBlocks(cache)
+
+
+def num_cached(cache):
+    return LIB_LLAISYS.kvCacheNumCachedBlocks(cache)
+
+
+def test_prefix_reuse(model):
+    print("Testing prefix reuse...")
+    cache = create_cache(8)
+    prompt = list(range(1, 11))  # two full blocks and a partial one
+    seq, matched, _ = run_prompt(model, cache, prompt)
+    assert matched == 0
+    assert num_free(cache) == 5 and num_cached(cache) == 0
+    # Freeing keeps the full blocks cached; the partial one returns to the free list
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    assert num_cached(cache) == 2 and num_free(cache) == 8
+
+    # At least one token is left to run: a prompt of exactly two cached blocks reuses one
+    seq, matched = match_prefix(cache, prompt[:8])
+    assert matched == BLOCK_SIZE
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    seq, matched = match_prefix(cache, prompt[:8] + [9])
+    assert matched == 2 * BLOCK_SIZE
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    # A longer prompt reuses whole blocks only, takes new blocks for the rest, and predicts
+    # what an uncached run predicts
+    longer = prompt + [11, 12, 13, 14, 15]
+    seq, matched, next_token = run_prompt(model, cache, longer)
+    assert matched == 2 * BLOCK_SIZE
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == len(longer)
+    assert num_free(cache) == 4 and num_cached(cache) == 0
+    assert next_token == uncached_next_token(model, longer)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    assert num_cached(cache) == 3 and num_free(cache) == 8
+
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_lru_eviction(model):
+    print("Testing LRU eviction...")
+    cache = create_cache(7)
+    a = list(range(1, 9))
+    b = list(range(11, 19))
+    for prompt in (a, b):
+        seq, _, _ = run_prompt(model, cache, prompt)
+        LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    assert num_cached(cache) == 4 and num_free(cache) == 7
+
+    # Reusing a makes b the least recently used prefix
+    seq, matched, _ = run_prompt(model, cache, a + [9])
+    assert matched == len(a)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    # New blocks come from the free list while it lasts: nothing is evicted
+    held, _, _ = run_prompt(model, cache, [21, 22, 23, 24])
+    assert num_cached(cache) == 4 and num_free(cache) == 6
+
+    # Three blocks with two left on the free list: the last block of b goes first
+    held2, _, _ = run_prompt(model, cache, list(range(31, 43)))
+    assert num_cached(cache) == 3 and num_free(cache) == 3
+    for prompt, expected in ((a + [9], len(a)), (b + [19], BLOCK_SIZE)):
+        seq, matched = match_prefix(cache, prompt)
+        assert matched == expected
+        LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    LIB_LLAISYS.kvCacheFreeSequence(cache, held)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, held2)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_out_of_blocks(model):
+    print("Testing a step without enough blocks...")
+    cache = create_cache(4)
+    prompt = list(range(1, 7))
+    seq, _, _ = run_prompt(model, cache, prompt)
+    assert num_free(cache) == 2
+
+    # Needs three more blocks: refused, and the sequence is left as it was
+    status, _ = step(model, cache, [seq], [list(range(7, 20))])
+    assert status == Qwen2Status.OUT_OF_BLOCKS
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == len(prompt)
+    assert num_free(cache) == 2
+    # Likewise for every sequence of a batch, even if one of them would fit
+    other = LIB_LLAISYS.kvCacheAddSequence(cache)
+    status, _ = step(model, cache, [seq, other], [[7], list(range(1, 10))])
+    assert status == Qwen2Status.OUT_OF_BLOCKS
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == len(prompt)
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, other) == 0
+    assert num_free(cache) == 2
+    # Bad arguments are told apart from a full pool
+    for seqs in ([seq, seq], [seq, other + 100]):
+        status, _ = step(model, cache, seqs, [[7], [8]])
+        assert status == Qwen2Status.INVALID_ARGUMENT
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == len(prompt)
+
+    # The sequence continues from where it was
+    status, next_tokens = step(model, cache, [seq], [[7, 8]])
+    assert status == 0
+    assert next_tokens[0] == uncached_next_token(model, prompt + [7, 8])
+
+    LIB_LLAISYS.kvCacheFreeSequence(cache, other)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_shared_block(model):
+    print("Testing sequences completing the same block...")
+    cache = create_cache(8)
+    prompt = list(range(1, 7))  # one full block and a partial one
+    s1 = LIB_LLAISYS.kvCacheAddSequence(cache)
+    s2 = LIB_LLAISYS.kvCacheAddSequence(cache)
+    status, next_tokens = step(model, cache, [s1, s2], [prompt, prompt])
+    assert status == 0
+    assert next_tokens[0] == next_tokens[1]
+    # The second sequence takes the first one's full block and returns its own
+    assert num_free(cache) == 8 - 3
+    LIB_LLAISYS.kvCacheFreeSequence(cache, s1)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, s2)
+    assert num_cached(cache) == 1 and num_free(cache) == 8
+
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_chunked_prefill(model):
+    print("Testing chunked prefill and mixed prefill/decode steps...")
+    prompt = [3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5]
+    other = [2, 7, 1, 8, 2, 8]
+    cache = create_cache(16)
+    whole = LIB_LLAISYS.kvCacheAddSequence(cache)
+    reference = last_logits(model, cache, whole, prompt)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, whole)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+
+    # Chunks that are not the last skip the LM head, yet leave the same K/V behind
+    cache = create_cache(16)
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    status, next_tokens = step(model, cache, [seq], [prompt[:3]], want_next=False)
+    assert status == 0 and next_tokens is None
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == 3
+    status, next_tokens = step(model, cache, [seq], [prompt[3:8]])
+    assert status == 0
+    assert next_tokens[0] == uncached_next_token(model, prompt[:8])
+    assert_close(last_logits(model, cache, seq, prompt[8:]), reference)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+
+    # The decode row of another sequence rides along with every chunk
+    cache = create_cache(16)
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    decoding, _, token = run_prompt(model, cache, other)
+    history = other + [token]
+    for begin in range(0, 8, 4):
+        status, next_tokens = step(model, cache, [decoding, seq], [[token], prompt[begin:begin + 4]])
+        assert status == 0
+        assert next_tokens[0] == uncached_next_token(model, history)
+        token = next_tokens[0]
+        history.append(token)
+    status, next_tokens = step(model, cache, [seq, decoding], [prompt[8:], [token]])
+    assert status == 0
+    assert next_tokens[0] == uncached_next_token(model, prompt)
+    assert next_tokens[1] == uncached_next_token(model, history)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    LIB_LLAISYS.kvCacheFreeSequence(cache, decoding)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_generate(model):
+    print("Testing the native generation loop...")
+    prompt = [3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5]
+    reference = greedy_reference(model, prompt, 12)
+    cache = create_cache(16)
+
+    # Whole or chunked prefill, the second run reusing the prefix the first one left cached
+    for prefill_chunk in (0, 4):
+        assert generate(model, cache, prompt, 12, prefill_chunk) == (12, reference)
+    # The sequence is freed, its full blocks cached: all positions run, the last token excepted
+    assert num_free(cache) == 16
+    seq, matched = match_prefix(cache, prompt + reference)
+    assert matched == (len(prompt) + len(reference) - 1) // BLOCK_SIZE * BLOCK_SIZE
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    # Stop conditions; the stopping token is still reported
+    assert generate(model, cache, prompt, 5) == (5, reference[:5])
+    first = reference.index(reference[6]) + 1
+    assert generate(model, cache, prompt, 12, stop_tokens=[reference[6]]) == (first, reference[:first])
+    stop = reference[3:5]
+    first = next(i for i in range(2, 6) if reference[i - 2:i] == stop)
+    assert generate(model, cache, prompt, 12, stop_sequences=[[63, 63, 63], stop]) == (first, reference[:first])
+    assert generate(model, cache, prompt, 12, stop_after=3) == (3, reference[:3])
+
+    # Failures tell a full pool from bad arguments
+    small = create_cache(2)
+    assert generate(model, small, prompt, 12)[0] == Qwen2Status.OUT_OF_BLOCKS
+    assert num_free(small) == 2
+    LIB_LLAISYS.kvCacheDestroy(small)
+    assert generate(model, cache, [], 12)[0] == Qwen2Status.INVALID_ARGUMENT
+
+    assert num_free(cache) == 16
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+def test_selected_logits(model):
+    print("Testing logits of selected positions...")
+    prompt = [3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5]
+    cache = create_cache(16)
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    next_token, full = logits_at(model, cache, seq, prompt, list(range(len(prompt))))
+    assert next_token == max(range(VOC), key=lambda v: full[-1][v])
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    # Any subset, in any order and with repeats, matches the rows of the full forward; the
+    # next token is still the one after the last token
+    positions = [7, 2, 7, 0]
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    selected_next, selected = logits_at(model, cache, seq, prompt, positions)
+    assert selected_next == next_token
+    for row, p in zip(selected, positions):
+        assert_close(row, full[p])
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+
+    # Positions index the tokens of the call, which leaves a bad request's sequence unchanged
+    seq = LIB_LLAISYS.kvCacheAddSequence(cache)
+    status, _ = logits_at(model, cache, seq, prompt, [len(prompt)])
+    assert status == Qwen2Status.INVALID_ARGUMENT
+    assert LIB_LLAISYS.kvCacheSequenceLength(cache, seq) == 0
+    LIB_LLAISYS.kvCacheFreeSequence(cache, seq)
+    LIB_LLAISYS.kvCacheDestroy(cache)
+    print("     Passed")
+
+
+if __name__ == "__main__":
+    model = create_tiny_model()
+    test_prefix_reuse(model)
+    test_lru_eviction(model)
+    test_out_of_blocks(model)
+    test_shared_block(model)
+    test_chunked_prefill(model)
+    test_selected_logits(model)
+    test_generate(model)
+    LIB_LLAISYS.llaisysQwen2ModelDestroy(model)
+
+    print("\033[92mTest passed!\033[0m\n")
@@ -2,6 +2,10 @@ import llaisys
 import torch
 from test_utils import *
 import argparse
+import os
+import subprocess
+import sys
+import threading
 
 
 def test_basic_runtime_api(device_name: str = "cpu"):
@@ -53,10 +57,98 @@ def test_memcpy(api, size_bytes: int):
     torch.testing.assert_close(a, b)
 
 
+def test_num_threads():
+    default = llaisys.get_num_threads()
+    print(f"Thread pool runs {default} threads per op")
+    assert default >= 1
+    for n in (1, 3, default + 2):
+        llaisys.set_num_threads(n)
+        assert llaisys.get_num_threads() == n
+    llaisys.set_num_threads(0)
+    assert llaisys.get_num_threads() == default
+
+    # LLAISYS_NUM_THREADS replaces the default, also the one set_num_threads(0) restores
+    script = "import llaisys; llaisys.set_num_threads(1); llaisys.set_num_threads(0); print(llaisys.get_num_threads())"
+    env = dict(os.environ, LLAISYS_NUM_THREADS="3", PYTHONPATH=os.pathsep.join(sys.path))
+    out = subprocess.run([sys.executable, "-c", script], env=env, capture_output=True, text=True, check=True)
+    assert int(out.stdout.split()[-1]) == 3
+
+    print("     Passed")
+
+
+def read_tensor(llaisys_tensor: llaisys.Tensor, dtype_name: str):
+    result, _ = zero_tensor(tuple(llaisys_tensor.shape()), dtype_name, "cpu")
+    llaisys.RuntimeAPI(llaisys_tensor.device_type()).memcpy_sync(
+        result.data_ptr(),
+        llaisys_tensor.data_ptr(),
+        result.numel() * result.element_size(),
+        llaisys.MemcpyKind.D2D,
+    )
+    return result
+
+
+def run_threaded_ops(inputs):
+    """Ops split across the pool: prefill GEMM, batch-1 GEMV, decode attention and RMSNorm."""
+    x, x1, w, b, q, k, v, norm_w = inputs
+    _, gemm_ = zero_tensor((x.shape()[0], w.shape()[0]), "f32", "cpu")
+    _, gemv_ = zero_tensor((1, w.shape()[0]), "f32", "cpu")
+    _, attn_ = zero_tensor(tuple(q.shape()), "f32", "cpu")
+    _, norm_ = zero_tensor(tuple(x.shape()), "f32", "cpu")
+    llaisys.Ops.linear(gemm_, x, w, b)
+    llaisys.Ops.linear(gemv_, x1, w, b)
+    llaisys.Ops.self_attention(attn_, q, k, v, 0.125)
+    llaisys.Ops.rms_norm(norm_, x, norm_w, 1e-6)
+    return [gemm_, gemv_, attn_, norm_]
+
+
+def test_thread_count_invariance():
+    # Work is split along outputs (and fixed-size KV splits), never by thread count, so results
+    # are bitwise the same for any pool size and any number of concurrent callers
+    default = llaisys.get_num_threads()
+    _, x = random_tensor((64, 1024), "f32", "cpu")
+    _, x1 = random_tensor((1, 1024), "f32", "cpu")
+    _, w = random_tensor((2048, 1024), "f32", "cpu", scale=0.1)
+    _, b = random_tensor((2048,), "f32", "cpu")
+    _, q = random_tensor((1, 16, 64), "f32", "cpu")
+    _, k = random_tensor((4096, 4, 64), "f32", "cpu")
+    _, v = random_tensor((4096, 4, 64), "f32", "cpu")
+    _, norm_w = random_tensor((1024,), "f32", "cpu")
+    inputs = (x, x1, w, b, q, k, v, norm_w)
+
+    llaisys.set_num_threads(1)
+    expected = [read_tensor(t, "f32") for t in run_threaded_ops(inputs)]
+    for n in sorted({2, 3, max(default, 4)}):
+        print(f"   {n} threads")
+        llaisys.set_num_threads(n)
+        for result, answer in zip(run_threaded_ops(inputs), expected):
+            assert check_equal(result, answer, strict=True)
+
+        # Ops issued from several threads at once share the pool
+        results = [None] * 4
+
+        def worker(i):
+            results[i] = run_threaded_ops(inputs)
+
+        threads = [threading.Thread(target=worker, args=(i,)) for i in range(len(results))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        for outputs in results:
+            for result, answer in zip(outputs, expected):
+                assert check_equal(result, answer, strict=True)
+    llaisys.set_num_threads(0)
+
+    print("     Passed")
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--device", default="cpu", choices=["cpu", "nvidia"], type=str)
     args = parser.parse_args()
     test_basic_runtime_api(args.device)
+    if args.device == "cpu":
+        test_num_threads()
+        test_thread_count_invariance()
     
     print("\033[92mTest passed!\033[0m\n")
@@ -5,15 +5,18 @@ import torch
 def random_tensor(
     shape, dtype_name, device_name, device_id=0, scale=None, bias=None
 ) -> tuple[torch.Tensor, llaisys.Tensor]:
+    dtype = torch_dtype(dtype_name)
+    # torch.rand has no float8 kernels: sample in float32 and round once
     torch_tensor = torch.rand(
         shape,
-        dtype=torch_dtype(dtype_name),
+        dtype=dtype if dtype.itemsize > 1 else torch.float32,
         device=torch_device(device_name, device_id),
     )
     if scale is not None:
         torch_tensor *= scale
     if bias is not None:
         torch_tensor += bias
+    torch_tensor = torch_tensor.to(dtype)
 
     llaisys_tensor = llaisys.Tensor(
         shape,
@@ -181,6 +184,7 @@ def benchmark(torch_func, llaisys_func, device_name, warmup=10, repeat=100):
     print(
         f"        Torch time: {torch_time*1000:.5f} ms \n        LLAISYS time: {llaisys_time*1000:.5f} ms"
     )
+    return torch_time, llaisys_time
 
 
 def torch_device(device_name: str, device_id=0):
@@ -219,6 +223,12 @@ def torch_dtype(dtype_name: str):
         return torch.float64
     elif dtype_name == "bf16":
         return torch.bfloat16
+    elif dtype_name == "f8e4m3":
+        return torch.float8_e4m3fn
+    elif dtype_name == "f8e5m2":
+        return torch.float8_e5m2
+    elif dtype_name == "i8":
+        return torch.int8
     elif dtype_name == "i32":
         return torch.int32
     elif dtype_name == "i64":
@@ -242,6 +252,12 @@ def llaisys_dtype(dtype_name: str):
         return llaisys.DataType.F64
     elif dtype_name == "bf16":
         return llaisys.DataType.BF16
+    elif dtype_name == "f8e4m3":
+        return llaisys.DataType.F8
+    elif dtype_name == "f8e5m2":
+        return llaisys.DataType.F8_E5M2
+    elif dtype_name == "i8":
+        return llaisys.DataType.I8
     elif dtype_name == "i32":
         return llaisys.DataType.I32
     elif dtype_name == "i64":
@@ -265,6 +281,12 @@ def dtype_name(llaisys_dtype: llaisys.DataType):
         return "f64"
     elif llaisys_dtype == llaisys.DataType.BF16:
         return "bf16"
+    elif llaisys_dtype == llaisys.DataType.F8:
+        return "f8e4m3"
+    elif llaisys_dtype == llaisys.DataType.F8_E5M2:
+        return "f8e5m2"
+    elif llaisys_dtype == llaisys.DataType.I8:
+        return "i8"
     elif llaisys_dtype == llaisys.DataType.I32:
         return "i32"
     elif llaisys_dtype == llaisys.DataType.I64: